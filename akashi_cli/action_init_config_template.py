@@ -37,5 +37,10 @@ def akconfig():
 
             audio_codec='aac',
             # audio_ffmpeg_codec_opts="b=384k",
+
+            # renditions=(
+            #     ak.RenditionConf('./dist/web.mp4', resolution=(1280, 720),
+            #                      video_codec='libx264', audio_codec='aac'),
+            # ),
         )
     )
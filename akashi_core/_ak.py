@@ -26,6 +26,7 @@ __all__ = [
     "PlaybackConf",
     "UIConf",
     "EncodeConf",
+    "RenditionConf",
     "AKConf",
     "from_relpath",
     "frag",
@@ -84,6 +85,7 @@ from .config import (
     PlaybackConf,
     UIConf,
     EncodeConf,
+    RenditionConf,
     AKConf,
     from_relpath,
 )
@@ -80,6 +80,17 @@ class UIConf:
 VideoEncodeMethod = Literal['', 'sw', 'vaapi', 'vaapi_copy']
 
 
+@dataclass(frozen=True)
+class RenditionConf:
+    out_fname: str  # relative to the directory of the config
+    resolution: Tuple[int, int] = (0, 0)  # (0, 0) for the resolution of the video
+    video_codec: str = ''
+    audio_codec: str = ''
+    ffmpeg_format_opts: str = ''
+    video_ffmpeg_codec_opts: str = ''
+    audio_ffmpeg_codec_opts: str = ''
+
+
 @dataclass(frozen=True)
 class EncodeConf:
     video_codec: str = ''
@@ -89,6 +100,8 @@ class EncodeConf:
     audio_ffmpeg_codec_opts: str = ''
     encode_max_queue_count: int = 10  # max queue element counts
     encode_method: VideoEncodeMethod = 'sw'
+    # other outputs encoded along with the main one, from the same frames and audio
+    renditions: Tuple[RenditionConf, ...] = ()
     out_fname: str = field(default='', init=False)
 
 
@@ -78,7 +78,7 @@ ExternalProject_Add(
   SOURCE_DIR ${CMAKE_BINARY_DIR}/.ext/glad/
   INSTALL_DIR ${AKASHI_PRIV_SHARED_DEPS_ROOT}/glad
 
-  CONFIGURE_COMMAND cd <SOURCE_DIR> && mkdir -p build && mkdir -p <INSTALL_DIR> && cd build && cmake .. -DBUILD_SHARED_LIBS=OFF -DGLAD_INSTALL=ON -DGLAD_ALL_EXTENSIONS=OFF -DGLAD_REPRODUCIBLE=OFF -DHAS_EGL=ON -DGLAD_PROFILE="core" -DGLAD_API="gl=4.2" -DGLAD_EXTENSIONS="GL_EXT_texture_compression_s3tc,GL_ARB_debug_output" -DCMAKE_INSTALL_PREFIX=<INSTALL_DIR> -GNinja
+  CONFIGURE_COMMAND cd <SOURCE_DIR> && mkdir -p build && mkdir -p <INSTALL_DIR> && cd build && cmake .. -DBUILD_SHARED_LIBS=OFF -DGLAD_INSTALL=ON -DGLAD_ALL_EXTENSIONS=OFF -DGLAD_REPRODUCIBLE=OFF -DHAS_EGL=ON -DGLAD_PROFILE="core" -DGLAD_API="gl=4.2" -DGLAD_EXTENSIONS="GL_EXT_texture_compression_s3tc,GL_ARB_debug_output,GL_ARB_buffer_storage" -DCMAKE_INSTALL_PREFIX=<INSTALL_DIR> -GNinja
   BUILD_COMMAND cd <SOURCE_DIR>/build && ninja -j4
   INSTALL_COMMAND COMMAND cd <SOURCE_DIR>/build && ninja install
     COMMAND ${CMAKE_COMMAND} -E make_directory ${CMAKE_SOURCE_DIR}/vendor/credits/glad/
@@ -0,0 +1,318 @@
+#include "./audio_mixdown.h"
+
+#include <libakcore/logger.h>
+#include <libakcore/rational.h>
+#include <libakcore/memory.h>
+#include <libakcore/audio_kernel.h>
+#include <libakstate/akstate.h>
+#include <libakcodec/akcodec.h>
+#include <libakbuffer/avbuffer.h>
+#include <libakbuffer/audio_buffer.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        struct MixdownWorker {
+            core::RenderProfile render_prof;
+            core::owned_ptr<codec::AKDecoder> decoder;
+            core::owned_ptr<buffer::AudioBuffer> abuffer;
+            std::thread* th = nullptr;
+
+            // guards abuffer and decode_ended
+            std::mutex mtx;
+            std::condition_variable cv;
+            // true when the decoder ended and all of its outputs were written to abuffer
+            bool decode_ended = false;
+        };
+
+        static size_t max_worker_count(void) {
+            auto nb_threads = static_cast<size_t>(std::thread::hardware_concurrency());
+            return std::clamp(nb_threads / 2, static_cast<size_t>(1), static_cast<size_t>(4));
+        }
+
+        static codec::DecodeArg make_decode_arg(core::borrowed_ptr<state::AKState> state) {
+            codec::DecodeArg decode_args;
+            std::lock_guard<std::mutex> lock(state->m_prop_mtx);
+            decode_args.out_audio_spec = state->m_atomic_state.audio_spec.load();
+            decode_args.preferred_decode_method =
+                state->m_atomic_state.preferred_decode_method.load();
+            decode_args.video_max_queue_count = state->m_prop.video_max_queue_count;
+            decode_args.vaapi_device = state->m_video_conf.vaapi_device;
+            return decode_args;
+        }
+
+        AudioMixdown::AudioMixdown(core::borrowed_ptr<state::AKState> state,
+                                   const core::RenderProfile& render_prof,
+                                   const size_t nb_samples_per_frame)
+            : m_state(state) {
+            size_t audio_max_queue_size = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_state->m_prop_mtx);
+                audio_max_queue_size = m_state->m_prop.audio_max_queue_size;
+            }
+            m_duration = render_prof.duration;
+            m_audio_spec = m_state->m_atomic_state.audio_spec.load();
+            m_nb_samples_per_frame = nb_samples_per_frame;
+            m_frame_size = nb_samples_per_frame * core::size_table(m_audio_spec.format) *
+                           m_audio_spec.channels;
+            m_frame_dur = core::Rational(m_frame_size, core::bytes_per_second(m_audio_spec));
+            m_mix_buf = std::make_unique<uint8_t[]>(m_frame_size);
+
+            size_t nb_layers = 0;
+            for (const auto& atom_prof : render_prof.atom_profiles) {
+                nb_layers += atom_prof.av_layers.size();
+            }
+            auto nb_workers = std::min(nb_layers, max_worker_count());
+
+            for (size_t i = 0; i < nb_workers; i++) {
+                auto worker = make_owned<MixdownWorker>();
+                worker->render_prof = render_prof;
+                for (auto&& atom_prof : worker->render_prof.atom_profiles) {
+                    atom_prof.av_layers.clear();
+                }
+                m_workers.push_back(std::move(worker));
+            }
+
+            // distribute the layers in a round-robin manner
+            size_t layer_idx = 0;
+            for (size_t atom_idx = 0; atom_idx < render_prof.atom_profiles.size(); atom_idx++) {
+                for (const auto& layer_prof : render_prof.atom_profiles[atom_idx].av_layers) {
+                    auto& worker = m_workers[layer_idx % nb_workers];
+                    auto& audio_layers = worker->render_prof.atom_profiles[atom_idx].av_layers;
+                    auto& audio_layer = audio_layers.emplace_back(layer_prof);
+                    // [XXX] video streams are skipped when the audio flag is set
+                    audio_layer.type = core::MediaFlagAudio;
+                    layer_idx += 1;
+                }
+            }
+
+            for (auto&& worker : m_workers) {
+                worker->decoder = make_owned<codec::AKDecoder>(worker->render_prof, Rational(0, 1));
+                worker->abuffer = make_owned<buffer::AudioBuffer>(
+                    m_audio_spec, std::max(audio_max_queue_size / nb_workers, m_frame_size * 2));
+            }
+
+            AKLOG_INFO("AudioMixdown: {} layers, {} workers", nb_layers, nb_workers);
+        }
+
+        AudioMixdown::~AudioMixdown() { this->close_and_wait(); }
+
+        void AudioMixdown::run(void) {
+            for (auto&& worker : m_workers) {
+                worker->th = new std::thread(&AudioMixdown::worker_thread, this, worker.get());
+            }
+            m_mix_th = new std::thread(&AudioMixdown::mix_thread, this);
+        }
+
+        void AudioMixdown::close_and_wait(void) {
+            m_should_close = true;
+            this->notify_all();
+
+            if (m_mix_th) {
+                m_mix_th->join();
+                delete m_mix_th;
+                m_mix_th = nullptr;
+            }
+            for (auto&& worker : m_workers) {
+                if (worker->th) {
+                    worker->th->join();
+                    delete worker->th;
+                    worker->th = nullptr;
+                }
+            }
+        }
+
+        std::vector<codec::EncodeArg> AudioMixdown::pull(const core::Rational& max_pts,
+                                                         const core::Rational& min_pts) {
+            std::vector<codec::EncodeArg> datasets;
+            {
+                std::unique_lock<std::mutex> lock(m_ready_mtx);
+                m_ready_cv.wait(lock, [&] {
+                    return m_should_close || m_err || m_mix_ended || m_last_pts >= min_pts;
+                });
+                if (m_err) {
+                    throw std::runtime_error("Audio mixdown aborted");
+                }
+                while (!m_ready_frames.empty() && m_ready_frames.front().pts <= max_pts) {
+                    datasets.push_back(std::move(m_ready_frames.front()));
+                    m_ready_frames.pop_front();
+                }
+            }
+            m_ready_cv.notify_all();
+
+            return datasets;
+        }
+
+        bool AudioMixdown::ended(void) {
+            std::lock_guard<std::mutex> lock(m_ready_mtx);
+            return m_err || (m_mix_ended && m_ready_frames.empty());
+        }
+
+        void AudioMixdown::worker_thread(AudioMixdown* mixdown, MixdownWorker* worker) {
+            const auto decode_args = make_decode_arg(mixdown->m_state);
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(worker->mtx);
+                    worker->cv.wait(lock, [&] {
+                        return mixdown->m_should_close || worker->abuffer->write_ready();
+                    });
+                    if (mixdown->m_should_close) {
+                        return;
+                    }
+                }
+
+                auto decode_res = worker->decoder->decode(decode_args);
+
+                if (decode_res.result == codec::DecodeResultCode::ERROR) {
+                    AKLOG_ERROR("AudioMixdown: decode error, code: {}", decode_res.result);
+                    return mixdown->abort();
+                } else if (decode_res.result == codec::DecodeResultCode::DECODE_ENDED) {
+                    break;
+                } else if (decode_res.result != codec::DecodeResultCode::OK ||
+                           decode_res.buffer->prop().media_type != buffer::AVBufferType::AUDIO) {
+                    continue;
+                }
+
+                buffer::AudioBuffer::Result enqueue_res;
+                {
+                    std::lock_guard<std::mutex> lock(worker->mtx);
+                    enqueue_res = worker->abuffer->enqueue(std::move(decode_res.buffer));
+                }
+                worker->cv.notify_all();
+
+                if (enqueue_res == buffer::AudioBuffer::Result::ERR) {
+                    AKLOG_ERRORN("AudioMixdown: failed to enqueue the decoded audio");
+                    return mixdown->abort();
+                }
+            }
+
+            // write out the pending buffer, if any
+            {
+                std::unique_lock<std::mutex> lock(worker->mtx);
+                while (true) {
+                    worker->cv.wait(lock, [&] {
+                        return mixdown->m_should_close || worker->abuffer->write_ready();
+                    });
+                    if (mixdown->m_should_close ||
+                        worker->abuffer->flush() != buffer::AudioBuffer::Result::OUT_OF_RANGE) {
+                        break;
+                    }
+                }
+                worker->decode_ended = true;
+            }
+            worker->cv.notify_all();
+            AKLOG_INFON("AudioMixdown: worker ended");
+        }
+
+        void AudioMixdown::mix_thread(AudioMixdown* mixdown) {
+            auto audio_encode_pts = core::Rational(0, 1);
+
+            while (!mixdown->m_should_close) {
+                auto frame_pts = audio_encode_pts < Rational(0, 1)
+                                     ? Rational(0, 1)
+                                     : mixdown->m_frame_dur + audio_encode_pts;
+                if (frame_pts > mixdown->m_duration) {
+                    break;
+                }
+
+                codec::EncodeArg frame;
+                frame.pts = frame_pts;
+                frame.buf_size = mixdown->m_frame_size;
+                frame.buffer.reset(new uint8_t[frame.buf_size]());
+                frame.nb_samples = mixdown->m_nb_samples_per_frame;
+                frame.type = buffer::AVBufferType::AUDIO;
+
+                if (!mixdown->mix_frame(frame) || !mixdown->push_frame(std::move(frame))) {
+                    break;
+                }
+                audio_encode_pts = frame_pts;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mixdown->m_ready_mtx);
+                mixdown->m_mix_ended = true;
+            }
+            mixdown->m_ready_cv.notify_all();
+            AKLOG_INFON("AudioMixdown: mix ended");
+        }
+
+        bool AudioMixdown::mix_frame(codec::EncodeArg& frame) {
+            const auto& kernel = core::audio_kernel();
+
+            for (size_t i = 0; i < m_workers.size(); i++) {
+                auto& worker = *m_workers[i];
+                // the first worker writes to the frame directly
+                auto dst = i == 0 ? frame.buffer.get() : m_mix_buf.get();
+
+                buffer::AudioBuffer::Result res;
+                {
+                    // wait until the worker fills its buffer, or reaches at the end
+                    std::unique_lock<std::mutex> lock(worker.mtx);
+                    worker.cv.wait(lock, [&] {
+                        return m_should_close || m_err || worker.decode_ended ||
+                               !worker.abuffer->write_ready();
+                    });
+                    if (m_should_close || m_err) {
+                        return false;
+                    }
+                    res = worker.abuffer->dequeue(dst, frame.buf_size, frame.pts);
+                }
+                worker.cv.notify_all();
+
+                if (res != buffer::AudioBuffer::Result::OK) {
+                    AKLOG_ERROR("AudioMixdown: got invalid result {}", static_cast<int>(res));
+                    this->abort();
+                    return false;
+                }
+                if (i > 0) {
+                    kernel.mix_gain(reinterpret_cast<float*>(frame.buffer.get()),
+                                    reinterpret_cast<const float*>(m_mix_buf.get()),
+                                    frame.buf_size / sizeof(float), 1.0f);
+                }
+            }
+            return true;
+        }
+
+        bool AudioMixdown::push_frame(codec::EncodeArg frame) {
+            {
+                std::unique_lock<std::mutex> lock(m_ready_mtx);
+                m_ready_cv.wait(lock, [&] {
+                    return m_should_close || m_ready_frames.size() < MAX_READY_FRAMES;
+                });
+                if (m_should_close) {
+                    return false;
+                }
+                m_last_pts = frame.pts;
+                m_ready_frames.push_back(std::move(frame));
+            }
+            m_ready_cv.notify_all();
+            return true;
+        }
+
+        void AudioMixdown::abort(void) {
+            m_err = true;
+            this->notify_all();
+        }
+
+        void AudioMixdown::notify_all(void) {
+            // [XXX] must not be called while holding any of the locks below
+            for (auto&& worker : m_workers) {
+                {
+                    std::lock_guard<std::mutex> lock(worker->mtx);
+                }
+                worker->cv.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_ready_mtx);
+            }
+            m_ready_cv.notify_all();
+        }
+
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <libakcore/memory.h>
+#include <libakcore/rational.h>
+#include <libakcore/audio.h>
+#include <libakcore/element.h>
+#include <libakcodec/encode_item.h>
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace akashi {
+    namespace state {
+        class AKState;
+    }
+    namespace codec {
+        class AKDecoder;
+    }
+    namespace buffer {
+        class AudioBuffer;
+    }
+    namespace encoder {
+
+        struct MixdownWorker;
+
+        /**
+         * Decodes and mixes all the audio layers of a render profile ahead of the video path.
+         *
+         * The audio layers are distributed across several workers, each of which owns its own
+         * decoder and AudioBuffer. A mixer thread sums up the workers' outputs into frames of
+         * `nb_samples_per_frame` samples, which are stored in a bounded queue until the encode
+         * loop pulls them.
+         */
+        class AudioMixdown final {
+          public:
+            explicit AudioMixdown(core::borrowed_ptr<state::AKState> state,
+                                  const core::RenderProfile& render_prof,
+                                  const size_t nb_samples_per_frame);
+
+            virtual ~AudioMixdown();
+
+            void run(void);
+
+            void close_and_wait(void);
+
+            /**
+             * Returns the mixed frames whose pts are not greater than `max_pts`.
+             * Blocks only until the frames up to `min_pts` get ready, so that the caller is not
+             * gated by the mixdown unless it falls too far behind.
+             *
+             * Throws std::runtime_error when the mixdown was aborted by an error.
+             */
+            std::vector<codec::EncodeArg> pull(const core::Rational& max_pts,
+                                               const core::Rational& min_pts);
+
+            bool ended(void);
+
+          private:
+            static void worker_thread(AudioMixdown* mixdown, MixdownWorker* worker);
+
+            static void mix_thread(AudioMixdown* mixdown);
+
+            bool mix_frame(codec::EncodeArg& frame);
+
+            bool push_frame(codec::EncodeArg frame);
+
+            void abort(void);
+
+            void notify_all(void);
+
+          private:
+            // max number of the mixed frames stored ahead
+            const size_t MAX_READY_FRAMES = 512;
+
+          private:
+            core::borrowed_ptr<state::AKState> m_state;
+            core::Rational m_duration = core::Rational(0, 1);
+            core::AKAudioSpec m_audio_spec;
+            size_t m_nb_samples_per_frame = 0;
+            size_t m_frame_size = 0;
+            core::Rational m_frame_dur = core::Rational(0, 1);
+
+            std::vector<core::owned_ptr<MixdownWorker>> m_workers;
+            std::thread* m_mix_th = nullptr;
+            std::unique_ptr<uint8_t[]> m_mix_buf = nullptr;
+
+            std::deque<codec::EncodeArg> m_ready_frames;
+            std::mutex m_ready_mtx;
+            std::condition_variable m_ready_cv;
+            core::Rational m_last_pts = core::Rational(-1, 1);
+            bool m_mix_ended = false;
+
+            std::atomic<bool> m_should_close = false;
+            std::atomic<bool> m_err = false;
+        };
+
+    }
+}
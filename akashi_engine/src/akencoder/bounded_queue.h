@@ -0,0 +1,79 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace akashi {
+    namespace encoder {
+
+        /**
+         * A FIFO queue connecting two stages of the encode pipeline.
+         *
+         * The producer blocks while the queue is full, and the consumer blocks while it is
+         * empty, so that the pipeline runs at the pace of the slowest stage.
+         */
+        template <typename T>
+        class BoundedQueue final {
+          public:
+            explicit BoundedQueue(size_t capacity) : m_capacity(capacity){};
+
+            virtual ~BoundedQueue() = default;
+
+            /**
+             * Returns false when the queue is closed.
+             */
+            bool push(T&& item) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mtx);
+                    m_not_full_cv.wait(lock,
+                                       [this] { return m_closed || m_items.size() < m_capacity; });
+                    if (m_closed) {
+                        return false;
+                    }
+                    m_items.push_back(std::move(item));
+                }
+                m_not_empty_cv.notify_one();
+                return true;
+            }
+
+            /**
+             * Returns false when the queue is closed and no item is left.
+             */
+            bool pop(T& item) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mtx);
+                    m_not_empty_cv.wait(lock, [this] { return m_closed || !m_items.empty(); });
+                    if (m_items.empty()) {
+                        return false;
+                    }
+                    item = std::move(m_items.front());
+                    m_items.pop_front();
+                }
+                m_not_full_cv.notify_one();
+                return true;
+            }
+
+            /**
+             * Wakes up both ends. The items already pushed can still be popped.
+             */
+            void close(void) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    m_closed = true;
+                }
+                m_not_full_cv.notify_all();
+                m_not_empty_cv.notify_all();
+            }
+
+          private:
+            const size_t m_capacity;
+            std::deque<T> m_items;
+            bool m_closed = false;
+            std::mutex m_mtx;
+            std::condition_variable m_not_full_cv;
+            std::condition_variable m_not_empty_cv;
+        };
+
+    }
+}
@@ -9,8 +9,6 @@
 #include <libakcodec/akcodec.h>
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/video_queue.h>
-#include <libakbuffer/audio_queue.h>
-#include <libakbuffer/audio_buffer.h>
 
 using namespace akashi::core;
 
@@ -18,7 +16,7 @@ namespace akashi {
     namespace encoder {
 
         DecodeResult exec_decode(DecodeParams& decode_params) {
-            auto [state, decoder, buffer, abuffer] = decode_params;
+            auto [state, decoder, buffer] = decode_params;
             codec::DecodeArg decode_args;
             {
                 std::lock_guard<std::mutex> lock(state->m_prop_mtx);
@@ -29,9 +27,11 @@ namespace akashi {
                 decode_args.video_max_queue_count = state->m_prop.video_max_queue_count;
                 decode_args.vaapi_device = state->m_video_conf.vaapi_device;
             }
+            // audio is decoded separately in AudioMixdown
+            decode_args.skip_audio = true;
 
             while (true) {
-                if (!state->get_video_decode_ready() || !abuffer->write_ready()) {
+                if (!state->get_video_decode_ready()) {
                     break;
                 }
                 auto decode_res = decoder->decode(decode_args);
@@ -66,16 +66,6 @@ namespace akashi {
                                 }
                                 break;
                             }
-                            case buffer::AVBufferType::AUDIO: {
-                                if (state->m_encode_conf.audio_codec != "") {
-                                    const auto comp_layer_uuid = decode_res.layer_uuid;
-                                    auto pts = decode_res.buffer->prop().pts;
-                                    abuffer->enqueue(std::move(decode_res.buffer));
-                                    AKLOG_INFO("AudioBuffer Enqueued, pts: {}, id: {}",
-                                               pts.to_decimal(), comp_layer_uuid);
-                                }
-                                break;
-                            }
                             default: {
                             }
                         }
@@ -92,5 +82,51 @@ namespace akashi {
             return DecodeResult::OK;
         }
 
+        void DecodeWorker::run(void) {
+            m_th = new std::thread(&DecodeWorker::decode_thread, this);
+        }
+
+        void DecodeWorker::close_and_wait(void) {
+            if (m_th) {
+                m_should_close = true;
+                // wakes up the thread waiting for room in the queue
+                m_decode_params.state->set_video_decode_ready(true);
+                m_th->join();
+                delete m_th;
+                m_th = nullptr;
+            }
+        }
+
+        DecodeResult DecodeWorker::wait_for_frames(void) {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, [this] {
+                return m_finished || !m_decode_params.state->get_video_decode_ready();
+            });
+            return m_result;
+        }
+
+        void DecodeWorker::decode_thread(DecodeWorker* worker) {
+            auto state = worker->m_decode_params.state;
+            auto result = DecodeResult::OK;
+            while (!worker->m_should_close && result == DecodeResult::OK) {
+                state->wait_for_video_decode_ready();
+                if (worker->m_should_close) {
+                    break;
+                }
+                // returns when the queue gets full
+                result = exec_decode(worker->m_decode_params);
+                {
+                    std::lock_guard<std::mutex> lock(worker->m_mtx);
+                    worker->m_result = result;
+                }
+                worker->m_cv.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> lock(worker->m_mtx);
+                worker->m_finished = true;
+            }
+            worker->m_cv.notify_all();
+        }
+
     }
 }
@@ -2,6 +2,11 @@
 
 #include <libakcore/memory.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
 namespace akashi {
     namespace state {
         class AKState;
@@ -11,7 +16,6 @@ namespace akashi {
     }
     namespace buffer {
         class AVBuffer;
-        class AudioBuffer;
     }
     namespace encoder {
 
@@ -19,11 +23,46 @@ namespace akashi {
             core::borrowed_ptr<state::AKState> state;
             core::borrowed_ptr<codec::AKDecoder> decoder;
             core::borrowed_ptr<buffer::AVBuffer> buffer;
-            core::borrowed_ptr<buffer::AudioBuffer> abuffer;
         };
 
         enum class DecodeResult { ERR = -1, ENDED = 0, OK = 1 };
 
         DecodeResult exec_decode(DecodeParams& decode_params);
+
+        /**
+         * Runs exec_decode() on its own thread, refilling the video queue whenever the renderer
+         * makes room in it.
+         */
+        class DecodeWorker final {
+          public:
+            explicit DecodeWorker(const DecodeParams& decode_params)
+                : m_decode_params(decode_params){};
+
+            virtual ~DecodeWorker() { this->close_and_wait(); };
+
+            void run(void);
+
+            void close_and_wait(void);
+
+            /**
+             * Blocks until the video queue is full or the decoding is over, which is the state
+             * the renderer used to see after calling exec_decode() by itself.
+             */
+            DecodeResult wait_for_frames(void);
+
+          private:
+            static void decode_thread(DecodeWorker* worker);
+
+          private:
+            DecodeParams m_decode_params;
+            std::thread* m_th = nullptr;
+
+            std::mutex m_mtx;
+            std::condition_variable m_cv;
+            DecodeResult m_result = DecodeResult::OK;
+            bool m_finished = false;
+
+            std::atomic<bool> m_should_close = false;
+        };
     }
 }
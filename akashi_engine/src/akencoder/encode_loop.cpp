@@ -2,7 +2,10 @@
 
 #include "./window.h"
 #include "./decoder.h"
-#include "./audio_renderer.h"
+#include "./audio_mixdown.h"
+#include "./bounded_queue.h"
+#include "./segmented_export.h"
+#include "./passthrough.h"
 
 #include <libakcore/logger.h>
 #include <libakcore/element.h>
@@ -16,15 +19,14 @@
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/video_queue.h>
 #include <libakbuffer/audio_queue.h>
-#include <libakbuffer/audio_buffer.h>
 #include <libakbuffer/hwframe.h>
 #include <libakgraphics/akgraphics.h>
 #include <libakgraphics/item.h>
 #include <libakcodec/encoder.h>
 
+#include <algorithm>
 #include <csignal>
 #include <unistd.h>
-#include <chrono>
 #include <thread>
 #include <mutex>
 
@@ -33,6 +35,16 @@ using namespace akashi::core;
 namespace akashi {
     namespace encoder {
 
+        // max delay of the audio behind the video allowed before the encode loop waits for it
+        static const core::Rational AUDIO_MAX_LAG = core::Rational(2l);
+        // the audio pulled at a time after the video
+        static const core::Rational AUDIO_PULL_CHUNK = core::Rational(1l);
+
+        // max number of the evaluated frames waiting for the renderer
+        static constexpr const size_t MAX_QUEUED_FRAMES = 4;
+        // max number of the video frames and audio samples waiting for the encoder
+        static constexpr const size_t MAX_QUEUED_ENCODE_ARGS = 16;
+
         struct ExitContext {
             EncodeLoop* loop = nullptr;
             eval::AKEval* eval = nullptr;
@@ -44,6 +56,8 @@ namespace akashi {
             Rational next_pts;
             Rational fps;
             Rational duration;
+            // the frames from here are not encoded
+            Rational end_pts;
             int video_width;
             int video_height;
             core::Path entry_path{""};
@@ -51,14 +65,24 @@ namespace akashi {
             core::owned_ptr<codec::AKDecoder> decoder;
             core::owned_ptr<buffer::AVBuffer> buffer;
 
-            core::owned_ptr<buffer::AudioBuffer> abuffer;
+            core::owned_ptr<AudioMixdown> mixdown;
 
-            core::Rational audio_encode_pts = core::Rational(0, 1);
+            PassthroughPlanner passthrough;
 
-            core::owned_ptr<graphics::AKGraphics> gfx;
+            // declared before gfx, so that the GL context outlives it
             core::owned_ptr<Window> window;
+            core::owned_ptr<graphics::AKGraphics> gfx;
+
+            // the buffer for the software encoders, which is recycled until a frame is read back
+            core::VideoBufferFormat video_format = core::VideoBufferFormat::RGB24;
+            size_t video_buffer_size = 0;
+            std::unique_ptr<uint8_t[]> video_buffer;
+        };
 
-            bool decode_ended = false;
+        struct FrameItem {
+            std::vector<core::FrameContext> frame_ctx;
+            // the frames copied from the source instead of being rendered
+            const PassthroughWindow* passthrough = nullptr;
         };
 
         static core::owned_ptr<EncodeContext>
@@ -70,8 +94,6 @@ namespace akashi {
             RenderProfile profile;
             int video_width = -1;
             int video_height = -1;
-            core::AKAudioSpec encode_audio_spec;
-            size_t audio_max_queue_size = 1;
             int msaa = 1;
             {
                 std::lock_guard<std::mutex> lock(ctx.state->m_prop_mtx);
@@ -80,8 +102,6 @@ namespace akashi {
                 fps = ctx.state->m_prop.fps;
                 video_width = ctx.state->m_prop.video_width;
                 video_height = ctx.state->m_prop.video_height;
-                encode_audio_spec = ctx.state->m_atomic_state.encode_audio_spec.load();
-                audio_max_queue_size = ctx.state->m_prop.audio_max_queue_size;
                 msaa = ctx.state->m_video_conf.msaa;
             }
 
@@ -96,6 +116,14 @@ namespace akashi {
 
             ctx.state->set_decode_layers_not_empty(core::has_layers(profile), true);
 
+            Rational end_pts = profile.duration;
+            if (ctx.segment.count > 1) {
+                segment_range(&start_pts, &end_pts, ctx.segment, profile.duration, fps,
+                              ctx.state->m_encode_conf.video_ffmpeg_codec_opts);
+                AKLOG_INFO("Encoding the segment {}/{}, from {} to {}", ctx.segment.index + 1,
+                           ctx.segment.count, start_pts.to_decimal(), end_pts.to_decimal());
+            }
+
             core::owned_ptr<EncodeContext> encode_ctx{new EncodeContext};
 
             encode_ctx->render_profile = profile;
@@ -103,24 +131,78 @@ namespace akashi {
             encode_ctx->next_pts = start_pts;
             encode_ctx->fps = fps;
             encode_ctx->duration = profile.duration;
+            encode_ctx->end_pts = end_pts;
             encode_ctx->video_width = video_width;
             encode_ctx->video_height = video_height;
             encode_ctx->entry_path = entry_path;
             encode_ctx->elem_name = elem_name;
-            encode_ctx->decoder = make_owned<codec::AKDecoder>(profile, start_pts);
             encode_ctx->buffer = make_owned<buffer::AVBuffer>(borrowed_ptr(ctx.state));
-            encode_ctx->abuffer =
-                make_owned<buffer::AudioBuffer>(encode_audio_spec, audio_max_queue_size);
+            encode_ctx->mixdown = nullptr;
             encode_ctx->gfx = nullptr;
-            encode_ctx->window = make_owned<Window>(msaa);
+            // the audio is decoded by the mixdown
+            if (ctx.state->m_encode_conf.video_codec != "") {
+                encode_ctx->decoder = make_owned<codec::AKDecoder>(profile, start_pts);
+                encode_ctx->window = Window::create(msaa);
+            }
 
             return encode_ctx;
         }
 
-        static void init_encode_context(EncodeLoopContext& ctx, EncodeContext& encode_ctx) {
+        static void init_encode_context(EncodeLoopContext& ctx, EncodeContext& encode_ctx,
+                                        const size_t nb_samples_per_frame) {
+            if (ctx.state->m_encode_conf.audio_codec != "") {
+                encode_ctx.mixdown = make_owned<AudioMixdown>(
+                    ctx.state, encode_ctx.render_profile, nb_samples_per_frame);
+                encode_ctx.mixdown->run();
+            }
+            if (!encode_ctx.window) {
+                return;
+            }
             encode_ctx.gfx =
                 make_owned<graphics::AKGraphics>(ctx.state, borrowed_ptr(encode_ctx.buffer));
-            encode_ctx.gfx->load_api({Window::get_proc_address}, {Window::egl_get_proc_address});
+            encode_ctx.gfx->load_api(encode_ctx.window->get_proc_address(),
+                                     encode_ctx.window->egl_get_proc_address());
+        }
+
+        static graphics::EncodeRenderParams video_render_params(EncodeContext& encode_ctx) {
+            if (!encode_ctx.video_buffer) {
+                encode_ctx.video_buffer.reset(new uint8_t[encode_ctx.video_buffer_size]);
+            }
+            graphics::EncodeRenderParams er_params = {
+                .format = encode_ctx.video_format,
+                .hwframe = core::borrowed_ptr((buffer::HWFrame*)nullptr)};
+            er_params.buffer = encode_ctx.video_buffer.get();
+            return er_params;
+        }
+
+        // the frames are read back a few frames late
+        static void push_video_buffer(EncodeContext& encode_ctx,
+                                      const graphics::EncodeRenderParams& er_params,
+                                      BoundedQueue<codec::EncodeArg>& encode_queue) {
+            if (!er_params.filled) {
+                return;
+            }
+            codec::EncodeArg vencode_arg = {};
+            vencode_arg.pts = er_params.pts;
+            vencode_arg.buffer = std::move(encode_ctx.video_buffer);
+            vencode_arg.buf_size = encode_ctx.video_buffer_size;
+            vencode_arg.video_format = encode_ctx.video_format;
+            vencode_arg.type = buffer::AVBufferType::VIDEO;
+            encode_queue.push(std::move(vencode_arg));
+        }
+
+        // the frames still being read back
+        static void flush_video_buffers(EncodeContext& encode_ctx,
+                                        BoundedQueue<codec::EncodeArg>& encode_queue,
+                                        EncodeLoop* loop) {
+            while (!loop->should_close()) {
+                auto er_params = video_render_params(encode_ctx);
+                encode_ctx.gfx->encode_flush(er_params);
+                if (!er_params.filled) {
+                    break;
+                }
+                push_video_buffer(encode_ctx, er_params, encode_queue);
+            }
         }
 
         static void update_encode_context(EncodeContext& encode_ctx) {
@@ -174,168 +256,395 @@ namespace akashi {
             return buffer::AVBufferType::UNKNOWN <= type && type <= buffer::AVBufferType::AUDIO;
         }
 
+        // writes out the packets ready in the encoder, and returns the number of them, or -1
+        static int receive_packets(codec::AKEncoder& encoder, const buffer::AVBufferType& type) {
+            int nb_packets = 0;
+            while (true) {
+                auto write_result = encoder.write({type});
+                switch (write_result.result) {
+                    case codec::EncodeResultCode::OK: {
+                        nb_packets += 1;
+                        break;
+                    }
+                    case codec::EncodeResultCode::RECV_EAGAIN:
+                    case codec::EncodeResultCode::RECV_EOF: {
+                        return nb_packets;
+                    }
+                    default: {
+                        return -1;
+                    }
+                }
+            }
+        }
+
         static void exec_encode(codec::AKEncoder& encoder,
                                 std::deque<codec::EncodeArg>& encode_args, EncodeLoop* loop) {
-            // send until EAGAIN or ERROR
+            // send until ERROR
             while (!encode_args.empty()) {
                 if (loop && loop->should_close()) {
                     break;
                 }
                 const auto& data = encode_args.front();
-                if (!is_valid_type(data.type) || (!data.buffer && !data.hwframe)) {
+                if (!is_valid_type(data.type) ||
+                    (!data.buffer && !data.hwframe && !data.stream_copy)) {
                     break;
                 }
-                auto send_result = encoder.send(data);
-                if (send_result == codec::EncodeResultCode::OK) {
-                    encode_args.pop_front();
-                    auto write_result = encoder.write({data.type});
-                    if (write_result.result == codec::EncodeResultCode::ERROR) {
-                        AKLOG_ERROR("encode error {}, {}", data.pts.to_decimal(),
-                                    write_result.result);
-                        // [TODO] throw exception?
-                        AKLOG_ERRORN("...skipping this frame");
-                        break;
+                if (data.stream_copy) {
+                    if (!encoder.copy_packets(*data.stream_copy)) {
+                        AKLOG_ERROR("stream copy error {}", data.pts.to_decimal());
+                        throw std::runtime_error("Encoding aborted");
                     }
-                } else if (send_result == codec::EncodeResultCode::SEND_EAGAIN) {
+                    encode_args.pop_front();
+                    continue;
+                }
+                auto send_result = encoder.send(data);
+                if (send_result == codec::EncodeResultCode::SEND_EAGAIN) {
+                    // the encoder takes the frame once its output is received
                     AKLOG_DEBUG("SEND_EAGAIN {}", data.pts.to_decimal());
-                    break;
-                } else {
+                    if (receive_packets(encoder, data.type) <= 0) {
+                        AKLOG_ERROR("encode error {}, no packets to receive",
+                                    data.pts.to_decimal());
+                        throw std::runtime_error("Encoding aborted");
+                    }
+                    continue;
+                } else if (send_result != codec::EncodeResultCode::OK) {
                     AKLOG_ERROR("encode error {}, {}", data.pts.to_decimal(), send_result);
                     throw std::runtime_error("Encoding aborted");
                 }
+
+                const auto pts = data.pts;
+                const auto type = data.type;
+                encode_args.pop_front();
+                if (receive_packets(encoder, type) < 0) {
+                    AKLOG_ERROR("encode error {}", pts.to_decimal());
+                    // [TODO] throw exception?
+                    AKLOG_ERRORN("...skipping this frame");
+                    break;
+                }
             }
         }
 
         static void early_exit() { kill(getpid(), SIGTERM); }
 
-        void EncodeLoop::encode_thread(EncodeLoopContext ctx, EncodeLoop* loop) {
-            AKLOG_INFON("Encoder init");
-
-            auto encoder = core::make_owned<codec::AKEncoder>(ctx.state);
-
-            if (ctx.state->m_encode_conf.audio_codec != "") {
-                // [XXX] must be done before decoder initialization
-                auto aformat = encoder->validate_audio_format(
-                    ctx.state->m_atomic_state.encode_audio_spec.load().format);
-                if (aformat == AKAudioSampleFormat::NONE) {
-                    return early_exit();
-                } else {
-                    auto decode_spec = ctx.state->m_atomic_state.audio_spec.load();
-                    decode_spec.format = aformat;
-                    ctx.state->m_atomic_state.audio_spec.store(decode_spec);
-                    ctx.state->m_atomic_state.encode_audio_spec.store(decode_spec);
-                }
+        static bool frame_shows_as_is(core::borrowed_ptr<state::AKState> state,
+                                      const EncodeContext& encode_ctx,
+                                      const core::FrameContext& frame_ctx,
+                                      const PassthroughWindow& window) {
+            if (frame_ctx.plane_ctxs.size() != 1 || frame_ctx.plane_ctxs[0].level != 0) {
+                return false;
             }
-            if (!encoder->open()) {
-                return early_exit();
+            const auto& plane_ctx = frame_ctx.plane_ctxs[0];
+            std::vector<core::LayerContext> layer_ctxs;
+            {
+                std::lock_guard<std::mutex> lock(state->m_eval_gctx_mtx);
+                auto gctx = reinterpret_cast<eval::GlobalContext*>(state->m_eval_gctx);
+                layer_ctxs = plane_ctx.eval(core::borrowed_ptr(gctx), plane_ctx);
             }
+            return shows_as_is(layer_ctxs, window.layer_uuid, encode_ctx.video_width,
+                               encode_ctx.video_height);
+        }
 
-            eval::AKEval eval{ctx.state};
-
-            // enqueue data until all frames processed
-
-            auto encode_ctx = create_encode_context(ctx, borrowed_ptr(&eval));
-            init_encode_context(ctx, *encode_ctx);
-
-            auto nb_samples_per_frame = encoder->nb_samples_per_frame();
-            // [TODO] maybe we should need an assertion that audio buffer size is grater than or
-            // equal to the value of nb_samples_per_frame
-
-            DecodeParams decode_params = {
-                borrowed_ptr(ctx.state), borrowed_ptr(encode_ctx->decoder),
-                borrowed_ptr(encode_ctx->buffer), borrowed_ptr(encode_ctx->abuffer)};
+        /**
+         * Evaluates the frames of the window, and returns true when all of them can be copied.
+         * Leaves the context at the last frame of them.
+         */
+        static bool eval_window(EncodeLoopContext& ctx, EncodeContext& encode_ctx,
+                                const PassthroughWindow& window,
+                                std::vector<std::vector<core::FrameContext>>* frames,
+                                std::atomic<bool>* failed) {
+            bool as_is = window.end_pts <= encode_ctx.end_pts;
+            while (can_produce(encode_ctx)) {
+                auto frame_ctx = pull_frame_context(ctx.state, encode_ctx);
+                if (frame_ctx.size() == 1) {
+                    AKLOG_ERROR("got only {} counts from evaluation", frame_ctx.size());
+                    *failed = true;
+                    return false;
+                }
+                if (frame_ctx.empty() || frame_ctx[0].pts >= encode_ctx.end_pts) {
+                    return false;
+                }
+                encode_ctx.cur_pts = frame_ctx[0].pts;
+                encode_ctx.next_pts = frame_ctx[1].pts;
+                as_is = as_is && frame_shows_as_is(ctx.state, encode_ctx, frame_ctx[0], window);
+                frames->push_back(std::move(frame_ctx));
 
-            std::deque<codec::EncodeArg> encode_args = {};
+                if (encode_ctx.next_pts >= window.end_pts) {
+                    break;
+                }
+                update_encode_context(encode_ctx);
+            }
+            return as_is && encode_ctx.next_pts == window.end_pts;
+        }
 
+        // evaluates the frames ahead of the renderer
+        static void eval_stage(EncodeLoopContext ctx, EncodeContext* encode_ctx,
+                               BoundedQueue<FrameItem>* frame_queue, EncodeLoop* loop,
+                               std::atomic<bool>* failed) {
             for (; can_produce(*encode_ctx); update_encode_context(*encode_ctx)) {
-                // eval
-                if (loop->m_should_close) {
+                if (loop->should_close()) {
                     break;
                 }
+                if (auto window = encode_ctx->passthrough.find(encode_ctx->cur_pts); window) {
+                    std::vector<std::vector<core::FrameContext>> frames;
+                    if (eval_window(ctx, *encode_ctx, *window, &frames, failed)) {
+                        if (!frame_queue->push({{}, window})) {
+                            break;
+                        }
+                        continue;
+                    }
+                    // rendered as usual
+                    bool pushed = true;
+                    for (size_t i = 0; pushed && i < frames.size(); i++) {
+                        pushed = frame_queue->push({std::move(frames[i]), nullptr});
+                    }
+                    if (!pushed || frames.empty() || *failed) {
+                        break;
+                    }
+                    continue;
+                }
                 auto frame_ctx = pull_frame_context(ctx.state, *encode_ctx);
                 if (frame_ctx.empty()) {
                     break;
                 }
                 if (frame_ctx.size() < 2) {
                     AKLOG_ERROR("got only {} counts from evaluation", frame_ctx.size());
+                    *failed = true;
+                    break;
+                }
+                if (frame_ctx[0].pts >= encode_ctx->end_pts) {
                     break;
                 }
                 encode_ctx->cur_pts = frame_ctx[0].pts;
                 encode_ctx->next_pts = frame_ctx[1].pts;
 
-                // decode
-                if (loop->m_should_close) {
+                if (!frame_queue->push({std::move(frame_ctx), nullptr})) {
                     break;
                 }
-                if (!encode_ctx->decode_ended && ctx.state->get_decode_layers_not_empty()) {
-                    auto decode_result = exec_decode(decode_params);
-                    if (decode_result == DecodeResult::ERR) {
-                        break;
-                    } else if (decode_result == DecodeResult::ENDED) {
-                        encode_ctx->decode_ended = true;
-                    }
+            }
+            frame_queue->close();
+        }
+
+        // sends the frames to the encoder, and writes the packets out
+        static void encode_stage(codec::AKEncoder* encoder,
+                                 BoundedQueue<codec::EncodeArg>* encode_queue, EncodeLoop* loop,
+                                 std::atomic<bool>* failed) {
+            std::deque<codec::EncodeArg> encode_args = {};
+            try {
+                codec::EncodeArg encode_arg;
+                while (encode_queue->pop(encode_arg)) {
+                    encode_args.push_back(std::move(encode_arg));
+                    exec_encode(*encoder, encode_args, loop);
                 }
 
-                // video render
-                if (loop->m_should_close) {
-                    break;
+                // the frames left by an error or the close request
+                // [TODO] Should we skip them when loop->m_should_close == true?
+                exec_encode(*encoder, encode_args, nullptr);
+                if (!encode_args.empty()) {
+                    AKLOG_WARN("{} frames dropped", encode_args.size());
                 }
-                if (ctx.state->m_encode_conf.video_codec != "") {
-                    if (ctx.state->m_encode_conf.encode_method == core::VideoEncodeMethod::VAAPI) {
-                        auto hwframe = encoder->create_hwframe();
+            } catch (const std::runtime_error& e) {
+                AKLOG_ERROR("{}", e.what());
+                *failed = true;
+                early_exit();
+                // keeps the renderer from blocking on the full queue
+                encode_queue->close();
+            }
+        }
 
-                        graphics::EncodeRenderParams er_params = {.hwframe =
-                                                                      core::borrowed_ptr(hwframe)};
-                        encode_ctx->gfx->encode_render(er_params, frame_ctx[0]);
+        // renders the frames, and sends them to the encode stage along with the audio
+        static void render_stage(EncodeLoopContext ctx, EncodeContext& encode_ctx,
+                                 codec::AKEncoder& encoder,
+                                 BoundedQueue<codec::EncodeArg>& encode_queue, EncodeLoop* loop,
+                                 std::atomic<bool>* failed) {
+            DecodeParams decode_params = {borrowed_ptr(ctx.state),
+                                          borrowed_ptr(encode_ctx.decoder),
+                                          borrowed_ptr(encode_ctx.buffer)};
+            auto decode_worker = make_owned<DecodeWorker>(decode_params);
+            const bool decodes_video = ctx.state->get_decode_layers_not_empty();
+            if (decodes_video) {
+                decode_worker->run();
+            }
+            // true after the frames are copied, until the decoder catches up with the renderer
+            bool decoder_behind = false;
 
-                        codec::EncodeArg vencode_arg = {};
-                        vencode_arg.pts = encode_ctx->cur_pts;
-                        vencode_arg.hwframe = std::move(hwframe);
-                        vencode_arg.type = buffer::AVBufferType::VIDEO;
-                        // std::move?
-                        encode_args.push_back(std::move(vencode_arg));
+            BoundedQueue<FrameItem> frame_queue{MAX_QUEUED_FRAMES};
 
-                    } else {
-                        graphics::EncodeRenderParams er_params = {
-                            .hwframe = core::borrowed_ptr((buffer::HWFrame*)nullptr)};
-                        er_params.buffer =
-                            new uint8_t[encode_ctx->video_width * encode_ctx->video_height * 3];
-                        encode_ctx->gfx->encode_render(er_params, frame_ctx[0]);
-
-                        codec::EncodeArg vencode_arg = {};
-                        vencode_arg.pts = encode_ctx->cur_pts;
-                        vencode_arg.buffer.reset(er_params.buffer);
-                        vencode_arg.buf_size =
-                            encode_ctx->video_width * encode_ctx->video_height * 3;
-                        vencode_arg.type = buffer::AVBufferType::VIDEO;
-                        // std::move?
-                        encode_args.push_back(std::move(vencode_arg));
+            std::thread eval_th(eval_stage, ctx, &encode_ctx, &frame_queue, loop, failed);
+
+            // render
+            FrameItem item;
+            while (frame_queue.pop(item)) {
+                if (loop->should_close() || *failed) {
+                    break;
+                }
+                if (item.passthrough) {
+                    // the frames rendered so far go before the copied ones
+                    flush_video_buffers(encode_ctx, encode_queue, loop);
+
+                    codec::EncodeArg vencode_arg = {};
+                    vencode_arg.pts = item.passthrough->copy.pts;
+                    vencode_arg.stream_copy =
+                        std::make_unique<codec::StreamCopyArg>(item.passthrough->copy);
+                    vencode_arg.type = buffer::AVBufferType::VIDEO;
+                    encode_queue.push(std::move(vencode_arg));
+
+                    if (encode_ctx.mixdown) {
+                        const auto last_pts =
+                            item.passthrough->end_pts - (Rational(1, 1) / encode_ctx.fps);
+                        auto datasets =
+                            encode_ctx.mixdown->pull(last_pts, last_pts - AUDIO_MAX_LAG);
+                        for (auto&& dataset : datasets) {
+                            encode_queue.push(std::move(dataset));
+                        }
                     }
+                    decoder_behind = decodes_video;
+                    continue;
+                }
+                const auto& frame_ctx = item.frame_ctx;
+                const auto pts = frame_ctx[0].pts;
+
+                if (decoder_behind) {
+                    // the decoder restarts from here, as the queued frames are too old
+                    decode_worker->close_and_wait();
+                    encode_ctx.buffer->vq->clear();
+                    encode_ctx.decoder =
+                        make_owned<codec::AKDecoder>(encode_ctx.render_profile, pts);
+                    decode_params.decoder = borrowed_ptr(encode_ctx.decoder);
+                    decode_worker = make_owned<DecodeWorker>(decode_params);
+                    decode_worker->run();
+                    decoder_behind = false;
                 }
+                // the frames to render must be in the video queue
+                if (decodes_video && decode_worker->wait_for_frames() == DecodeResult::ERR) {
+                    AKLOG_ERROR("Failed to decode the frames for {}", pts.to_decimal());
+                    *failed = true;
+                    break;
+                }
+
+                if (ctx.state->m_encode_conf.encode_method == core::VideoEncodeMethod::VAAPI) {
+                    auto hwframe = encoder.create_hwframe();
+
+                    graphics::EncodeRenderParams er_params = {.hwframe =
+                                                                  core::borrowed_ptr(hwframe)};
+                    encode_ctx.gfx->encode_render(er_params, frame_ctx[0]);
+
+                    codec::EncodeArg vencode_arg = {};
+                    vencode_arg.pts = pts;
+                    vencode_arg.hwframe = std::move(hwframe);
+                    vencode_arg.type = buffer::AVBufferType::VIDEO;
+                    encode_queue.push(std::move(vencode_arg));
 
-                // audio render
-                if (ctx.state->m_encode_conf.audio_codec != "") {
-                    auto datasets =
-                        render_audio(&encode_ctx->audio_encode_pts, borrowed_ptr(ctx.state),
-                                     borrowed_ptr(encode_ctx->abuffer), nb_samples_per_frame,
-                                     encode_ctx->cur_pts);
+                } else {
+                    auto er_params = video_render_params(encode_ctx);
+                    encode_ctx.gfx->encode_render(er_params, frame_ctx[0]);
+                    push_video_buffer(encode_ctx, er_params, encode_queue);
+                }
 
+                // audio
+                if (encode_ctx.mixdown) {
+                    // wait for the mixdown only when it falls too far behind
+                    auto datasets = encode_ctx.mixdown->pull(pts, pts - AUDIO_MAX_LAG);
                     for (auto&& dataset : datasets) {
-                        encode_args.push_back(std::move(dataset));
+                        encode_queue.push(std::move(dataset));
                     }
                 }
+            }
+            // stops the eval stage, if the loop was aborted
+            frame_queue.close();
+            eval_th.join();
+            decode_worker->close_and_wait();
+
+            // the rest of the video
+            if (ctx.state->m_encode_conf.encode_method != core::VideoEncodeMethod::VAAPI) {
+                flush_video_buffers(encode_ctx, encode_queue, loop);
+            }
+        }
+
+        void EncodeLoop::encode_thread(EncodeLoopContext ctx, EncodeLoop* loop) {
+            AKLOG_INFON("Encoder init");
+
+            auto encoder = core::make_owned<codec::AKEncoder>(ctx.state);
 
-                // encode
-                exec_encode(*encoder, encode_args, loop);
+            if (ctx.state->m_encode_conf.audio_codec != "") {
+                // [XXX] must be done before decoder initialization
+                auto aformat = encoder->validate_audio_format(
+                    ctx.state->m_atomic_state.encode_audio_spec.load().format);
+                if (aformat == AKAudioSampleFormat::NONE) {
+                    return early_exit();
+                } else {
+                    auto decode_spec = ctx.state->m_atomic_state.audio_spec.load();
+                    decode_spec.format = aformat;
+                    ctx.state->m_atomic_state.audio_spec.store(decode_spec);
+                    ctx.state->m_atomic_state.encode_audio_spec.store(decode_spec);
+                }
+            }
+            if (!encoder->open()) {
+                return early_exit();
             }
 
-            // draining
-            // [TODO] Should we skip draining when loop->m_should_close == true?
-            while (!encode_args.empty()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                exec_encode(*encoder, encode_args, nullptr);
+            eval::AKEval eval{ctx.state};
+
+            // enqueue data until all frames processed
+
+            auto nb_samples_per_frame = encoder->nb_samples_per_frame();
+            // [TODO] maybe we should need an assertion that audio buffer size is grater than or
+            // equal to the value of nb_samples_per_frame
+
+            auto encode_ctx = create_encode_context(ctx, borrowed_ptr(&eval));
+            if (ctx.state->m_encode_conf.video_codec != "" && !encode_ctx->window) {
+                AKLOG_ERRORN("Failed to create a GL context");
+                return early_exit();
+            }
+            init_encode_context(ctx, *encode_ctx, nb_samples_per_frame);
+
+            if (auto format = encoder->video_buffer_format();
+                format != core::VideoBufferFormat::NONE) {
+                encode_ctx->video_format = format;
+            }
+            encode_ctx->video_buffer_size = core::video_buffer_size(
+                encode_ctx->video_format, encode_ctx->video_width, encode_ctx->video_height);
+
+            // [XXX] the read back frames are flushed before the copied ones, which the hardware
+            // encoders do not need
+            if (ctx.state->m_encode_conf.video_codec != "" &&
+                ctx.state->m_encode_conf.encode_method != core::VideoEncodeMethod::VAAPI) {
+                encode_ctx->passthrough.plan(encode_ctx->render_profile, encode_ctx->fps,
+                                             *encoder);
+            }
+
+            BoundedQueue<codec::EncodeArg> encode_queue{MAX_QUEUED_ENCODE_ARGS};
+            // set by any of the stages, so that a truncated output is not reported as finished
+            std::atomic<bool> failed = false;
+            std::thread encode_th(encode_stage, encoder.get(), &encode_queue, loop, &failed);
+
+            // nothing is evaluated nor rendered for the audio only exports
+            if (ctx.state->m_encode_conf.video_codec != "") {
+                render_stage(ctx, *encode_ctx, *encoder, encode_queue, loop, &failed);
+            }
+
+            // the rest of the audio, or all of it for the audio only exports
+            Rational min_pts = Rational(0, 1);
+            while (encode_ctx->mixdown && !loop->m_should_close && !failed &&
+                   !encode_ctx->mixdown->ended()) {
+                // waits for a chunk at a time, as the mixdown stops when its queue gets full
+                auto datasets = encode_ctx->mixdown->pull(
+                    encode_ctx->duration, std::min(min_pts, encode_ctx->duration));
+                for (auto&& dataset : datasets) {
+                    min_pts = dataset.pts + AUDIO_PULL_CHUNK;
+                    encode_queue.push(std::move(dataset));
+                }
+            }
+            if (encode_ctx->mixdown) {
+                encode_ctx->mixdown->close_and_wait();
+            }
+
+            encode_queue.close();
+            encode_th.join();
+
+            // the output may be written out only here
+            if (!encoder->close()) {
+                failed = true;
             }
-            encoder->close();
 
             eval.exit();
 
@@ -346,6 +655,7 @@ namespace akashi {
 
             AKLOG_INFON("Encoder finished");
 
+            loop->m_finished = !loop->m_should_close && !failed;
             kill(getpid(), SIGTERM);
         }
 
@@ -12,8 +12,15 @@ namespace akashi {
     }
     namespace encoder {
 
+        // the part of the video encoded by a worker of the segmented export
+        struct EncodeSegment {
+            int index = 0;
+            int count = 1;
+        };
+
         struct EncodeLoopContext {
             core::borrowed_ptr<state::AKState> state;
+            EncodeSegment segment;
         };
 
         struct ExitContext;
@@ -38,12 +45,16 @@ namespace akashi {
 
             bool should_close() const { return m_should_close; }
 
+            // true when all the frames have been encoded
+            bool finished() const { return m_finished; }
+
           private:
             static void encode_thread(EncodeLoopContext ctx, EncodeLoop* loop);
 
           private:
             std::thread* m_th = nullptr;
             std::atomic<bool> m_should_close = false;
+            std::atomic<bool> m_finished = false;
         };
 
     }
@@ -1,11 +1,14 @@
 #include "./encode_loop.h"
+#include "./segmented_export.h"
 
 #include <libakcore/logger.h>
 
 #include <libakcore/config.h>
 #include <libakcore/memory.h>
+#include <libakcore/path.h>
 #include <libakstate/akstate.h>
 
+#include <filesystem>
 #include <string>
 #include <signal.h>
 #include <string.h>
@@ -16,6 +19,16 @@
 
 using namespace akashi::core;
 
+// the relative paths in the config are in the project directory, where the config is
+static std::string resolve_out_fname(const std::string& out_fname, const Path& project_dir) {
+    const std::filesystem::path path(out_fname);
+    // the urls of the protocols of ffmpeg are left as they are
+    if (out_fname.empty() || path.is_absolute() || out_fname.find(':') != std::string::npos) {
+        return out_fname;
+    }
+    return (std::filesystem::path(project_dir.to_str()) / path).lexically_normal().string();
+}
+
 void do_sigwait(sigset_t& ss) {
     int signum;
     sigwait(&ss, &signum);
@@ -62,12 +75,48 @@ int main(int argc, char** argv) {
 
     auto akconf = akashi::core::parse_akconfig(argv[1]);
     akconf.encode.out_fname = argv[3];
-    akashi::state::AKState state(akconf, argv[2]);
-    akashi::encoder::EncodeLoop encode_loop;
-    encode_loop.run({akashi::core::borrowed_ptr(&state)});
+    {
+        const auto project_dir = Path(argv[2]).to_abspath().to_dirpath();
+        for (auto& rendition : akconf.encode.renditions) {
+            rendition.out_fname = resolve_out_fname(rendition.out_fname, project_dir);
+        }
+    }
 
-    do_sigwait(ss);
-    encode_loop.close_and_wait();
+    int ret = 0;
+    const auto worker = akashi::encoder::worker_spec();
+    const int nb_segments = akashi::encoder::nb_encode_segments();
+    // [XXX] the renditions are not split into segments
+    if (worker.kind == akashi::encoder::WorkerKind::NONE && nb_segments > 1 &&
+        akconf.encode.video_codec != "" && akconf.encode.renditions.empty()) {
+        akashi::encoder::SegmentedExport segmented_export;
+        segmented_export.run({argv[0], argv[1], argv[2], akconf.encode, nb_segments});
+
+        do_sigwait(ss);
+        segmented_export.close_and_wait();
+        ret = segmented_export.finished() ? 0 : 1;
+    } else {
+        // the workers write one of the streams into an intermediate file
+        if (worker.kind != akashi::encoder::WorkerKind::NONE) {
+            akconf.encode.ffmpeg_format_opts = "";
+            if (worker.kind == akashi::encoder::WorkerKind::VIDEO) {
+                akconf.encode.audio_codec = "";
+            } else {
+                akconf.encode.video_codec = "";
+            }
+        }
+        akashi::encoder::EncodeSegment segment;
+        if (worker.kind == akashi::encoder::WorkerKind::VIDEO) {
+            segment = {worker.index, worker.count};
+        }
+
+        akashi::state::AKState state(akconf, argv[2]);
+        akashi::encoder::EncodeLoop encode_loop;
+        encode_loop.run({akashi::core::borrowed_ptr(&state), segment});
+
+        do_sigwait(ss);
+        encode_loop.close_and_wait();
+        ret = encode_loop.finished() ? 0 : 1;
+    }
 
 #ifndef NDEBUG
     if (std::getenv("AK_DEBUG_WINDOW")) {
@@ -76,5 +125,5 @@ int main(int argc, char** argv) {
 #endif
 
     destroy_logger();
-    return 0;
+    return ret;
 }
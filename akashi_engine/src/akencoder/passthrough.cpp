@@ -0,0 +1,131 @@
+#include "./passthrough.h"
+
+#include <libakcore/logger.h>
+#include <libakcore/element.h>
+#include <libakcodec/encoder.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        static bool passthrough_enabled(void) {
+            const char* env = std::getenv("AK_PASSTHROUGH");
+            return !env || std::atoi(env) != 0;
+        }
+
+        static bool on_frame_grid(const Rational& pts, const Rational& fps) {
+            return (pts * fps).den() == 1;
+        }
+
+        void PassthroughPlanner::plan(const core::RenderProfile& render_prof,
+                                      const core::Rational& fps, codec::AKEncoder& encoder) {
+            m_windows.clear();
+            if (!passthrough_enabled()) {
+                return;
+            }
+
+            // probed once for each source
+            std::unordered_map<std::string, std::vector<Rational>> keyframes_map;
+
+            for (const auto& atom_prof : render_prof.atom_profiles) {
+                for (const auto& layer_prof : atom_prof.av_layers) {
+                    if (!(layer_prof.type & MediaFlagVideo)) {
+                        continue;
+                    }
+                    const auto& src = layer_prof.src;
+                    if (keyframes_map.find(src) == keyframes_map.end()) {
+                        keyframes_map[src] = encoder.stream_copy_keyframes(src);
+                    }
+                    const auto& keyframes = keyframes_map[src];
+                    if (keyframes.size() < 2) {
+                        continue;
+                    }
+
+                    const auto from = std::max(layer_prof.from, atom_prof.from);
+                    const auto to = std::min(layer_prof.to, atom_prof.to);
+                    // the time in the source shown at t is t + offset, until the layer loops
+                    const auto offset =
+                        layer_prof.start + layer_prof.layer_local_offset - layer_prof.from;
+                    auto src_limit = keyframes.back();
+                    if (layer_prof.end > Rational(0, 1)) {
+                        src_limit = std::min(src_limit, layer_prof.end);
+                    }
+
+                    for (size_t i = 0; i + 1 < keyframes.size(); i++) {
+                        const auto& src_begin = keyframes[i];
+                        const auto& src_end = keyframes[i + 1];
+                        if (src_end > src_limit) {
+                            break;
+                        }
+                        const auto pts = src_begin - offset;
+                        const auto end_pts = src_end - offset;
+                        if (pts < from || end_pts > to || !on_frame_grid(pts, fps) ||
+                            !on_frame_grid(end_pts, fps)) {
+                            continue;
+                        }
+                        PassthroughWindow window;
+                        window.layer_uuid = layer_prof.uuid;
+                        window.copy.src = layer_prof.src;
+                        window.copy.src_begin = src_begin;
+                        window.copy.src_end = src_end;
+                        window.copy.pts = pts;
+                        window.end_pts = end_pts;
+                        m_windows.emplace(pts, window);
+                    }
+                }
+            }
+            AKLOG_INFO("{} windows found for the passthrough", m_windows.size());
+        }
+
+        const PassthroughWindow* PassthroughPlanner::find(const core::Rational& pts) const {
+            auto it = m_windows.find(pts);
+            return it != m_windows.end() ? &it->second : nullptr;
+        }
+
+        bool shows_as_is(const std::vector<core::LayerContext>& layer_ctxs,
+                         const std::string& layer_uuid, int width, int height) {
+            const LayerContext* shown = nullptr;
+            for (const auto& layer_ctx : layer_ctxs) {
+                if (!layer_ctx.display) {
+                    continue;
+                }
+                if (shown) {
+                    return false;
+                }
+                shown = &layer_ctx;
+            }
+            if (!shown || shown->uuid != layer_uuid || !shown->t_video || !shown->t_transform) {
+                return false;
+            }
+            if (shown->t_image || shown->t_text || shown->t_rect || shown->t_circle ||
+                shown->t_tri || shown->t_line || shown->t_unit) {
+                return false;
+            }
+            if (const auto& shader = shown->t_shader;
+                shader && (!shader->frag.empty() || !shader->poly.empty())) {
+                return false;
+            }
+            if (const auto& texture = shown->t_texture;
+                texture && (texture->uv_flip_v || texture->uv_flip_h ||
+                            texture->crop_begin != std::array<long, 2>{0, 0} ||
+                            texture->crop_end != std::array<long, 2>{0, 0})) {
+                return false;
+            }
+
+            // placed at the center, which is the default position
+            const auto& transform = *shown->t_transform;
+            const std::array<long, 2> out_size = {width, height};
+            return transform.x == width / 2 && transform.y == height / 2 && transform.z == 0 &&
+                   transform.rotation == Rational(0, 1) &&
+                   transform.scale == std::array<double, 3>{1.0, 1.0, 1.0} &&
+                   (transform.layer_size == std::array<long, 2>{-1, -1} ||
+                    transform.layer_size == out_size);
+        }
+
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <libakcore/rational.h>
+#include <libakcodec/encode_item.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace akashi {
+    namespace core {
+        struct RenderProfile;
+        struct LayerContext;
+    }
+    namespace codec {
+        class AKEncoder;
+    }
+    namespace encoder {
+
+        /**
+         * Smart rendering
+         *
+         * The runs of frames which show nothing but a video layer as it is, at the size and the
+         * frame rate of the output, are copied from the source instead of being rendered and
+         * reencoded. The candidates are the spans between the keyframes of the sources, and each
+         * frame in them is checked before being skipped, so that any of the layer changes falls
+         * back to the rendering.
+         *
+         * Disabled when `AK_PASSTHROUGH` is set to 0.
+         */
+
+        struct PassthroughWindow {
+            std::string layer_uuid;
+            codec::StreamCopyArg copy;
+            // the pts of the first frame after the window
+            core::Rational end_pts = core::Rational(0, 1);
+        };
+
+        class PassthroughPlanner final {
+          public:
+            explicit PassthroughPlanner() = default;
+
+            virtual ~PassthroughPlanner() = default;
+
+            void plan(const core::RenderProfile& render_prof, const core::Rational& fps,
+                      codec::AKEncoder& encoder);
+
+            // the window starting at `pts`, or nullptr
+            const PassthroughWindow* find(const core::Rational& pts) const;
+
+          private:
+            std::map<core::Rational, PassthroughWindow> m_windows;
+        };
+
+        // true when the frame of the layers shows the video layer of `layer_uuid` as it is
+        bool shows_as_is(const std::vector<core::LayerContext>& layer_ctxs,
+                         const std::string& layer_uuid, int width, int height);
+
+    }
+}
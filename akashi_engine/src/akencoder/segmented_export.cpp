@@ -0,0 +1,220 @@
+#include "./segmented_export.h"
+
+#include "./encode_loop.h"
+
+#include <libakcore/logger.h>
+#include <libakcodec/encoder.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        static constexpr const char* SEGMENT_ENV = "AK_ENCODE_SEGMENT";
+
+        WorkerSpec worker_spec(void) {
+            WorkerSpec spec;
+            const char* env = std::getenv(SEGMENT_ENV);
+            if (!env) {
+                return spec;
+            }
+            if (std::strcmp(env, "audio") == 0) {
+                spec.kind = WorkerKind::AUDIO;
+            } else if (std::sscanf(env, "%d/%d", &spec.index, &spec.count) == 2 &&
+                       0 <= spec.index && spec.index < spec.count) {
+                spec.kind = WorkerKind::VIDEO;
+            } else {
+                AKLOG_ERROR("Invalid {} found: {}", SEGMENT_ENV, env);
+            }
+            return spec;
+        }
+
+        int nb_encode_segments(void) {
+            const char* env = std::getenv("AK_ENCODE_SEGMENTS");
+            return env ? std::max(std::atoi(env), 1) : 1;
+        }
+
+        // the value of the `g` option, or 0
+        static int64_t gop_size(const std::string& codec_opts) {
+            std::istringstream iss(codec_opts);
+            std::string opt;
+            while (iss >> opt) {
+                if (opt.rfind("g=", 0) == 0) {
+                    return std::max(std::atoll(opt.c_str() + 2), 0ll);
+                }
+            }
+            return 0;
+        }
+
+        void segment_range(core::Rational* begin, core::Rational* end,
+                           const EncodeSegment& segment, const core::Rational& duration,
+                           const core::Rational& fps, const std::string& codec_opts) {
+            const int64_t nb_frames = static_cast<int64_t>((duration * fps).to_decimal());
+            int64_t gop = gop_size(codec_opts);
+            if (gop <= 0) {
+                gop = std::max(static_cast<int64_t>(fps.to_decimal() + 0.5), int64_t(1));
+            }
+
+            const int64_t nb_gops = (nb_frames + gop - 1) / gop;
+            const int64_t begin_gop = nb_gops * segment.index / segment.count;
+            const int64_t end_gop = nb_gops * (segment.index + 1) / segment.count;
+
+            *begin = Rational(begin_gop * gop, 1) / fps;
+            *end = Rational(std::min(end_gop * gop, nb_frames), 1) / fps;
+        }
+
+        static std::string segment_fname(const std::string& out_fname, int index) {
+            return out_fname + ".seg" + std::to_string(index) + ".mkv";
+        }
+
+        static std::string audio_fname(const std::string& out_fname) {
+            return out_fname + ".audio.mka";
+        }
+
+        void SegmentedExport::export_thread(SegmentedExportContext ctx, SegmentedExport* exp) {
+            const auto& out_fname = ctx.encode_conf.out_fname;
+            const bool has_audio = ctx.encode_conf.audio_codec != "";
+
+            codec::ConcatArg concat_arg;
+            concat_arg.out_fname = out_fname;
+            concat_arg.format_opts = ctx.encode_conf.ffmpeg_format_opts;
+            for (int i = 0; i < ctx.nb_segments; i++) {
+                concat_arg.video_fnames.push_back(segment_fname(out_fname, i));
+            }
+            if (has_audio) {
+                concat_arg.audio_fname = audio_fname(out_fname);
+            }
+
+            AKLOG_INFO("Segmented export with {} workers", ctx.nb_segments);
+
+            bool success = true;
+            for (int i = 0; success && i < ctx.nb_segments; i++) {
+                auto spec = std::to_string(i) + "/" + std::to_string(ctx.nb_segments);
+                success = exp->spawn_worker(ctx, spec, concat_arg.video_fnames[i]);
+            }
+            // the audio is mixed once, along with the video
+            if (success && has_audio) {
+                success = exp->spawn_worker(ctx, "audio", concat_arg.audio_fname);
+            }
+            if (!success) {
+                exp->terminate_workers();
+            }
+            success = exp->wait_workers() && success && !exp->m_should_close;
+
+            if (success) {
+                success = codec::concat_segments(concat_arg);
+            }
+
+            for (const auto& fname : concat_arg.video_fnames) {
+                std::remove(fname.c_str());
+            }
+            if (has_audio) {
+                std::remove(concat_arg.audio_fname.c_str());
+            }
+
+            if (success) {
+                AKLOG_INFON("Segmented export finished");
+            } else {
+                AKLOG_ERRORN("Segmented export failed");
+            }
+            exp->m_finished = success;
+            kill(getpid(), SIGTERM);
+        }
+
+        bool SegmentedExport::spawn_worker(const SegmentedExportContext& ctx,
+                                           const std::string& spec,
+                                           const std::string& out_fname) {
+            // the environment of this process, with the spec replacing the segment settings
+            std::vector<std::string> envs;
+            for (char** env = environ; *env; env++) {
+                if (std::strncmp(*env, SEGMENT_ENV, std::strlen(SEGMENT_ENV)) != 0) {
+                    envs.push_back(*env);
+                }
+            }
+            envs.push_back(std::string(SEGMENT_ENV) + "=" + spec);
+
+            std::vector<char*> envp;
+            for (auto&& env : envs) {
+                envp.push_back(env.data());
+            }
+            envp.push_back(nullptr);
+
+            auto exec_name = ctx.exec_name;
+            auto akconf_str = ctx.akconf_str;
+            auto conf_path = ctx.conf_path;
+            auto worker_out_fname = out_fname;
+            char* argv[] = {exec_name.data(), akconf_str.data(), conf_path.data(),
+                            worker_out_fname.data(), nullptr};
+
+            std::lock_guard<std::mutex> lock(m_pids_mtx);
+            if (m_should_close) {
+                return false;
+            }
+            pid_t pid;
+            if (auto err = posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv, envp.data());
+                err != 0) {
+                AKLOG_ERROR("posix_spawn() failed, ret={}", std::strerror(err));
+                return false;
+            }
+            AKLOG_INFO("Worker {} started, pid={}", spec, pid);
+            m_pids.push_back(pid);
+            return true;
+        }
+
+        bool SegmentedExport::wait_workers(void) {
+            bool success = true;
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(m_pids_mtx);
+                    if (m_pids.empty()) {
+                        break;
+                    }
+                }
+                int status = 0;
+                pid_t pid = waitpid(-1, &status, 0);
+                if (pid < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    AKLOG_ERROR("waitpid() failed, ret={}", std::strerror(errno));
+                    return false;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_pids_mtx);
+                    m_pids.erase(std::remove(m_pids.begin(), m_pids.end(), pid), m_pids.end());
+                }
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    AKLOG_ERROR("Worker failed, pid={}, status={}", pid, status);
+                    // the output is useless without any of the parts
+                    if (success) {
+                        success = false;
+                        this->terminate_workers();
+                    }
+                }
+            }
+            return success;
+        }
+
+        void SegmentedExport::terminate_workers(void) {
+            std::lock_guard<std::mutex> lock(m_pids_mtx);
+            for (const auto pid : m_pids) {
+                kill(pid, SIGTERM);
+            }
+        }
+
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <libakcore/rational.h>
+#include <libakcore/config.h>
+
+#include <sys/types.h>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace akashi {
+    namespace encoder {
+
+        /**
+         * Segmented export
+         *
+         * When `AK_ENCODE_SEGMENTS` is set to N > 1, the encoder process becomes a coordinator,
+         * which spawns N workers encoding the consecutive parts of the video, and another one
+         * encoding the whole audio. Each worker has its own evaluator and GL context. The parts
+         * are split at the GOP boundaries and begin with a keyframe, so that they are
+         * concatenated into the output without being reencoded.
+         *
+         * The workers are the same executable, told their part by `AK_ENCODE_SEGMENT`.
+         */
+
+        struct EncodeSegment;
+
+        enum class WorkerKind { NONE = -1, VIDEO = 0, AUDIO };
+
+        struct WorkerSpec {
+            WorkerKind kind = WorkerKind::NONE;
+            int index = 0;
+            int count = 1;
+        };
+
+        // NONE unless the process is a worker
+        WorkerSpec worker_spec(void);
+
+        // 1 unless the segmented export is requested
+        int nb_encode_segments(void);
+
+        /**
+         * The range of the frames in the segment, [begin, end)
+         *
+         * The boundaries are aligned to the GOP size, when given by the `g` codec option, or to
+         * one second.
+         */
+        void segment_range(core::Rational* begin, core::Rational* end,
+                           const EncodeSegment& segment, const core::Rational& duration,
+                           const core::Rational& fps, const std::string& codec_opts);
+
+        struct SegmentedExportContext {
+            std::string exec_name;
+            std::string akconf_str;
+            std::string conf_path;
+            core::EncodeConf encode_conf;
+            int nb_segments = 1;
+        };
+
+        class SegmentedExport final {
+          public:
+            explicit SegmentedExport(){};
+
+            virtual ~SegmentedExport() = default;
+
+            void close_and_wait() {
+                if (m_th) {
+                    m_should_close = true;
+                    this->terminate_workers();
+                    m_th->join();
+                    delete m_th;
+                    m_th = nullptr;
+                }
+            };
+
+            void run(SegmentedExportContext ctx) {
+                m_th = new std::thread(&SegmentedExport::export_thread, ctx, this);
+            };
+
+            // true when the output has been written
+            bool finished() const { return m_finished; }
+
+          private:
+            static void export_thread(SegmentedExportContext ctx, SegmentedExport* exp);
+
+            bool spawn_worker(const SegmentedExportContext& ctx, const std::string& spec,
+                              const std::string& out_fname);
+
+            // returns false when any of the workers failed
+            bool wait_workers(void);
+
+            void terminate_workers(void);
+
+          private:
+            std::thread* m_th = nullptr;
+            std::atomic<bool> m_should_close = false;
+            std::atomic<bool> m_finished = false;
+
+            std::mutex m_pids_mtx;
+            std::vector<pid_t> m_pids;
+        };
+
+    }
+}
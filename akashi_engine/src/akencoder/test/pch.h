@@ -0,0 +1,7 @@
+#pragma once
+
+#ifdef __GNUC__
+#include <bits/stdc++.h>
+#endif
+
+#include <catch.hpp>
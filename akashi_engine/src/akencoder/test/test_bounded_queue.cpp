@@ -0,0 +1,117 @@
+#include <catch.hpp>
+
+#include "../bounded_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace akashi {
+    namespace encoder {
+
+        // long enough for a blocked thread to be observed as blocked
+        static void wait_a_bit(void) { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }
+
+        // the assertions of Catch are not thread-safe, so the other threads only record results
+
+        TEST_CASE("bounded queue order", "[akencoder]") {
+            BoundedQueue<std::unique_ptr<int>> queue{4};
+            std::atomic<int> nb_pushed = 0;
+            std::thread producer([&] {
+                for (int i = 0; i < 1000; i++) {
+                    nb_pushed += queue.push(std::make_unique<int>(i));
+                }
+                queue.close();
+            });
+
+            std::unique_ptr<int> item;
+            int expected = 0;
+            while (queue.pop(item)) {
+                REQUIRE(*item == expected);
+                expected++;
+            }
+            producer.join();
+            REQUIRE(nb_pushed == 1000);
+            REQUIRE(expected == 1000);
+        }
+
+        TEST_CASE("bounded queue blocks", "[akencoder]") {
+            BoundedQueue<int> queue{1};
+            REQUIRE(queue.push(1));
+
+            // the producer waits for room
+            std::atomic<bool> pushed = false;
+            std::thread producer([&] {
+                queue.push(2);
+                pushed = true;
+            });
+            wait_a_bit();
+            REQUIRE(!pushed);
+
+            int item = 0;
+            REQUIRE(queue.pop(item));
+            REQUIRE(item == 1);
+            producer.join();
+            REQUIRE(pushed);
+            REQUIRE(queue.pop(item));
+            REQUIRE(item == 2);
+
+            // the consumer waits for an item
+            std::atomic<bool> popped = false;
+            std::thread consumer([&] {
+                int consumed = 0;
+                queue.pop(consumed);
+                popped = consumed == 3;
+            });
+            wait_a_bit();
+            REQUIRE(!popped);
+            REQUIRE(queue.push(3));
+            consumer.join();
+            REQUIRE(popped);
+        }
+
+        TEST_CASE("bounded queue close", "[akencoder]") {
+            SECTION("wakes up a blocked producer") {
+                BoundedQueue<int> queue{1};
+                REQUIRE(queue.push(1));
+                std::atomic<int> res = -1;
+                std::thread producer([&] { res = queue.push(2); });
+                wait_a_bit();
+                REQUIRE(res == -1);
+                queue.close();
+                producer.join();
+                REQUIRE(res == 0);
+
+                // the items pushed before are still popped
+                int item = 0;
+                REQUIRE(queue.pop(item));
+                REQUIRE(item == 1);
+                REQUIRE(!queue.pop(item));
+            }
+
+            SECTION("wakes up a blocked consumer") {
+                BoundedQueue<int> queue{1};
+                std::atomic<int> res = -1;
+                std::thread consumer([&] {
+                    int item = 0;
+                    res = queue.pop(item);
+                });
+                wait_a_bit();
+                REQUIRE(res == -1);
+                queue.close();
+                consumer.join();
+                REQUIRE(res == 0);
+            }
+
+            SECTION("rejects pushes after being closed") {
+                BoundedQueue<int> queue{2};
+                queue.close();
+                REQUIRE(!queue.push(1));
+                int item = 0;
+                REQUIRE(!queue.pop(item));
+            }
+        }
+
+    }
+}
@@ -0,0 +1,72 @@
+#include <catch.hpp>
+
+#include "../segmented_export.h"
+#include "../encode_loop.h"
+
+#include <libakcore/rational.h>
+
+#include <vector>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        static std::vector<std::pair<Rational, Rational>> all_ranges(int count,
+                                                                     const Rational& duration,
+                                                                     const Rational& fps,
+                                                                     const std::string& opts) {
+            std::vector<std::pair<Rational, Rational>> ranges;
+            for (int i = 0; i < count; i++) {
+                Rational begin, end;
+                segment_range(&begin, &end, {i, count}, duration, fps, opts);
+                ranges.push_back({begin, end});
+            }
+            return ranges;
+        }
+
+        TEST_CASE("segment range", "[akencoder]") {
+            // 300 frames in the GOPs of one second
+            const auto ranges = all_ranges(4, Rational(10, 1), Rational(30, 1), "");
+            REQUIRE(ranges[0] == std::make_pair(Rational(0, 1), Rational(2, 1)));
+            REQUIRE(ranges[1] == std::make_pair(Rational(2, 1), Rational(5, 1)));
+            REQUIRE(ranges[2] == std::make_pair(Rational(5, 1), Rational(7, 1)));
+            REQUIRE(ranges[3] == std::make_pair(Rational(7, 1), Rational(10, 1)));
+        }
+
+        TEST_CASE("segment range gop", "[akencoder]") {
+            const Rational fps(30000, 1001);
+            // 301 frames, the last GOP of which is cut short
+            const Rational duration = Rational(301, 1) / fps;
+            const auto ranges = all_ranges(3, duration, fps, "preset=fast g=12 bf=2");
+
+            REQUIRE(ranges.front().first == Rational(0, 1));
+            REQUIRE(ranges.back().second == duration);
+            for (size_t i = 0; i < ranges.size(); i++) {
+                const auto& [begin, end] = ranges[i];
+                REQUIRE(begin < end);
+                // each segment starts with a new GOP
+                REQUIRE((begin * fps / Rational(12, 1)).den() == 1);
+                if (i + 1 < ranges.size()) {
+                    REQUIRE(end == ranges[i + 1].first);
+                }
+            }
+        }
+
+        TEST_CASE("segment range more segments than gops", "[akencoder]") {
+            const auto ranges = all_ranges(4, Rational(3, 2), Rational(24, 1), "");
+            // 2 GOPs for 4 segments, which leaves the others empty
+            Rational covered(0, 1);
+            size_t nb_empty = 0;
+            for (const auto& [begin, end] : ranges) {
+                REQUIRE(begin == covered);
+                REQUIRE(begin <= end);
+                nb_empty += begin == end;
+                covered = end;
+            }
+            REQUIRE(covered == Rational(3, 2));
+            REQUIRE(nb_empty == 2);
+        }
+
+    }
+}
@@ -0,0 +1,49 @@
+#include "./window.h"
+
+#include <libakcore/logger.h>
+
+#include <EGL/egl.h>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        static bool use_headless(void) {
+            if (const char* env = std::getenv("AK_HEADLESS")) {
+                return std::strcmp(env, "0") != 0;
+            }
+            return !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY");
+        }
+
+        core::owned_ptr<Window> Window::create(int msaa) {
+            if (use_headless()) {
+                auto window = make_owned<HeadlessWindow>();
+                if (!window->initialized()) {
+                    return nullptr;
+                }
+                AKLOG_INFON("Using a headless EGL context");
+                return window;
+            }
+
+            auto window = make_owned<GLFWWindow>(msaa);
+            if (!window->initialized()) {
+                return nullptr;
+            }
+            return window;
+        }
+
+        static void* egl_get_proc_address_impl(const char* name) {
+            // [TODO] add checks for validity of egl?
+            return reinterpret_cast<void*>(eglGetProcAddress(name));
+        }
+
+        graphics::EGLGetProcAddress Window::egl_get_proc_address(void) const {
+            return {egl_get_proc_address_impl};
+        }
+
+    }
+}
@@ -1,24 +1,67 @@
 #pragma once
 
 #include <libakcore/memory.h>
+#include <libakgraphics/item.h>
 
 namespace akashi {
     namespace encoder {
 
+        /**
+         * Owns the GL context of the encoder, and makes it current on the calling thread.
+         */
+        class Window {
+          public:
+            /**
+             * Creates a headless window when `AK_HEADLESS` is set to other than `0`, or when no
+             * display server is available. Otherwise, creates a hidden GLFW window.
+             *
+             * Returns nullptr when no context could be created.
+             */
+            static core::owned_ptr<Window> create(int msaa);
+
+            virtual ~Window() = default;
+
+            virtual graphics::GetProcAddress get_proc_address(void) const = 0;
+
+            graphics::EGLGetProcAddress egl_get_proc_address(void) const;
+        };
+
         struct PrivWindow;
 
-        class Window final {
+        class GLFWWindow final : public Window {
           public:
-            explicit Window(int msaa);
-            virtual ~Window();
+            explicit GLFWWindow(int msaa);
+            virtual ~GLFWWindow();
 
-          public:
-            static void* get_proc_address(const char* name);
-            static void* egl_get_proc_address(const char* name);
+            graphics::GetProcAddress get_proc_address(void) const override;
+
+            bool initialized(void) const;
 
           private:
             core::owned_ptr<PrivWindow> m_window;
         };
 
+        struct PrivHeadlessWindow;
+
+        /**
+         * Renders without a display server, by an EGL surfaceless context, or by a pbuffer
+         * surface when EGL_KHR_surfaceless_context is not supported.
+         *
+         * The scene is always rendered to FBOs, so the samples of the default framebuffer are not
+         * relevant here.
+         */
+        class HeadlessWindow final : public Window {
+          public:
+            explicit HeadlessWindow(void);
+            virtual ~HeadlessWindow();
+
+            graphics::GetProcAddress get_proc_address(void) const override;
+
+            bool initialized(void) const;
+
+          private:
+            core::owned_ptr<PrivHeadlessWindow> m_window;
+        };
+
     }
 }
@@ -0,0 +1,160 @@
+#include "./window.h"
+
+#include <libakcore/memory.h>
+#include <libakcore/logger.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace encoder {
+
+        struct PrivHeadlessWindow {
+            EGLDisplay display = EGL_NO_DISPLAY;
+            EGLContext context = EGL_NO_CONTEXT;
+            EGLSurface surface = EGL_NO_SURFACE;
+        };
+
+        static bool has_extension(const char* extensions, const char* name) {
+            if (!extensions) {
+                return false;
+            }
+            const size_t len = std::strlen(name);
+            for (const char* p = extensions; (p = std::strstr(p, name)); p += len) {
+                if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static EGLDisplay get_display(void) {
+            const char* client_exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+            if (has_extension(client_exts, "EGL_MESA_platform_surfaceless")) {
+                auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+                if (get_platform_display) {
+                    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                              EGL_DEFAULT_DISPLAY, nullptr);
+                    if (display != EGL_NO_DISPLAY) {
+                        return display;
+                    }
+                }
+            }
+            return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        HeadlessWindow::HeadlessWindow(void) {
+            m_window = make_owned<PrivHeadlessWindow>();
+
+            m_window->display = get_display();
+            if (m_window->display == EGL_NO_DISPLAY) {
+                AKLOG_ERRORN("Failed to get an EGL display");
+                return;
+            }
+            EGLint major, minor;
+            if (!eglInitialize(m_window->display, &major, &minor)) {
+                AKLOG_ERROR("Failed to initialize EGL: 0x{:x}", eglGetError());
+                m_window->display = EGL_NO_DISPLAY;
+                return;
+            }
+            AKLOG_INFO("EGL {}.{}, vendor: {}", major, minor,
+                       eglQueryString(m_window->display, EGL_VENDOR));
+
+            if (!eglBindAPI(EGL_OPENGL_API)) {
+                AKLOG_ERRORN("Failed to bind OpenGL API");
+                return;
+            }
+
+            const bool surfaceless = has_extension(
+                eglQueryString(m_window->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+            // clang-format off
+            const EGLint config_attrs[] = {
+                EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_ALPHA_SIZE, 8,
+                EGL_NONE
+            };
+            // clang-format on
+            EGLConfig config;
+            EGLint nb_configs = 0;
+            if (!eglChooseConfig(m_window->display, config_attrs, &config, 1, &nb_configs) ||
+                nb_configs < 1) {
+                AKLOG_ERRORN("No EGL config found");
+                return;
+            }
+
+            // clang-format off
+            const EGLint context_attrs[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 4,
+                EGL_CONTEXT_MINOR_VERSION, 2,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_CONTEXT_OPENGL_DEBUG, std::getenv("AK_OGL_DEBUG_OUT") ? EGL_TRUE : EGL_FALSE,
+                EGL_NONE
+            };
+            // clang-format on
+            m_window->context =
+                eglCreateContext(m_window->display, config, EGL_NO_CONTEXT, context_attrs);
+            if (m_window->context == EGL_NO_CONTEXT) {
+                AKLOG_ERROR("Failed to create an EGL context: 0x{:x}", eglGetError());
+                return;
+            }
+
+            if (!surfaceless) {
+                const EGLint pbuffer_attrs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+                m_window->surface =
+                    eglCreatePbufferSurface(m_window->display, config, pbuffer_attrs);
+                if (m_window->surface == EGL_NO_SURFACE) {
+                    AKLOG_ERROR("Failed to create a pbuffer surface: 0x{:x}", eglGetError());
+                    eglDestroyContext(m_window->display, m_window->context);
+                    m_window->context = EGL_NO_CONTEXT;
+                    return;
+                }
+            }
+
+            if (!eglMakeCurrent(m_window->display, m_window->surface, m_window->surface,
+                                m_window->context)) {
+                AKLOG_ERROR("Failed to make the EGL context current: 0x{:x}", eglGetError());
+                eglDestroyContext(m_window->display, m_window->context);
+                m_window->context = EGL_NO_CONTEXT;
+            }
+        }
+
+        HeadlessWindow::~HeadlessWindow() {
+            if (!m_window || m_window->display == EGL_NO_DISPLAY) {
+                return;
+            }
+            eglMakeCurrent(m_window->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (m_window->surface != EGL_NO_SURFACE) {
+                eglDestroySurface(m_window->display, m_window->surface);
+            }
+            if (m_window->context != EGL_NO_CONTEXT) {
+                eglDestroyContext(m_window->display, m_window->context);
+            }
+            eglTerminate(m_window->display);
+        }
+
+        static void* headless_get_proc_address(const char* name) {
+            // core functions are also returned by EGL 1.5 or EGL_KHR_get_all_proc_addresses
+            return reinterpret_cast<void*>(eglGetProcAddress(name));
+        }
+
+        graphics::GetProcAddress HeadlessWindow::get_proc_address(void) const {
+            return {headless_get_proc_address};
+        }
+
+        bool HeadlessWindow::initialized(void) const {
+            return m_window && m_window->context != EGL_NO_CONTEXT;
+        }
+
+    }
+}
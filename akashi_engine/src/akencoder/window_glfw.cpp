@@ -10,8 +10,6 @@
 #define GLFW_EXPOSE_NATIVE_EGL
 #include <GLFW/glfw3native.h>
 
-#include <EGL/egl.h>
-
 using namespace akashi::core;
 
 namespace akashi {
@@ -21,8 +19,11 @@ namespace akashi {
             GLFWwindow* window = nullptr;
         };
 
-        Window::Window(int msaa) {
-            glfwInit();
+        GLFWWindow::GLFWWindow(int msaa) {
+            if (!glfwInit()) {
+                AKLOG_ERRORN("Failed to initialize GLFW");
+                return;
+            }
             glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
             glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
             glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -47,25 +48,31 @@ namespace akashi {
             m_window = make_owned<PrivWindow>();
 
             m_window->window = glfwCreateWindow(640, 480, "", NULL, NULL);
+            if (!m_window->window) {
+                AKLOG_ERRORN("Failed to create a GLFW window");
+                glfwTerminate();
+                return;
+            }
 
             glfwMakeContextCurrent(m_window->window);
         }
 
-        Window::~Window() {
+        GLFWWindow::~GLFWWindow() {
             if (this->m_window && this->m_window->window) {
                 glfwDestroyWindow(this->m_window->window);
                 glfwTerminate();
             }
         }
 
-        void* Window::get_proc_address(const char* name) {
+        static void* glfw_get_proc_address(const char* name) {
             return reinterpret_cast<void*>(glfwGetProcAddress(name));
         }
 
-        void* Window::egl_get_proc_address(const char* name) {
-            // [TODO] add checks for validity of egl?
-            return reinterpret_cast<void*>(eglGetProcAddress(name));
+        graphics::GetProcAddress GLFWWindow::get_proc_address(void) const {
+            return {glfw_get_proc_address};
         }
 
+        bool GLFWWindow::initialized(void) const { return m_window && m_window->window; }
+
     }
 }
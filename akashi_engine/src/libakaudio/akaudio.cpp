@@ -1,6 +1,8 @@
 #include "./akaudio.h"
 #include "./context.h"
 #include "./backend/pulseaudio.h"
+#include "./backend/null.h"
+#include "./backend/wav.h"
 
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/audio_queue.h>
@@ -9,15 +11,41 @@
 #include <libakcore/memory.h>
 #include <libakcore/logger.h>
 
+#include <cstdlib>
+#include <string>
+
 using namespace akashi::core;
 
 namespace akashi {
     namespace audio {
 
+        // The backend can be switched by `AK_AUDIO_BACKEND` (pulseaudio, null, wav).
+        // For the wav backend, the output path is specified by `AK_AUDIO_WAV_PATH`.
+        static core::owned_ptr<AudioContext>
+        create_audio_context(core::borrowed_ptr<state::AKState> state,
+                             core::borrowed_ptr<buffer::AVBuffer> buffer,
+                             core::borrowed_ptr<event::AKEvent> event) {
+            const char* env_backend = std::getenv("AK_AUDIO_BACKEND");
+            const std::string backend = env_backend ? env_backend : "pulseaudio";
+
+            if (backend == "null") {
+                AKLOG_INFON("Using null audio backend");
+                return make_owned<NullAudioContext>(state, buffer, event);
+            } else if (backend == "wav") {
+                const char* env_path = std::getenv("AK_AUDIO_WAV_PATH");
+                AKLOG_INFON("Using wav audio backend");
+                return make_owned<WavAudioContext>(state, buffer, event,
+                                                   env_path ? env_path : "akashi_audio.wav");
+            } else if (backend != "pulseaudio") {
+                AKLOG_WARN("Invalid AK_AUDIO_BACKEND found: {}", backend.c_str());
+            }
+            return make_owned<PulseAudioContext>(state, buffer, event);
+        }
+
         AKAudio::AKAudio(core::borrowed_ptr<state::AKState> state,
                          core::borrowed_ptr<buffer::AVBuffer> buffer,
                          core::borrowed_ptr<event::AKEvent> event) {
-            m_audio_ctx = make_owned<PulseAudioContext>(state, buffer, event);
+            m_audio_ctx = create_audio_context(state, buffer, event);
         }
 
         AKAudio::~AKAudio() {}
@@ -0,0 +1,128 @@
+#include "./context.h"
+#include "../../callback.h"
+
+#include <libakstate/akstate.h>
+#include <libakbuffer/avbuffer.h>
+#include <libakcore/logger.h>
+#include <libakcore/memory.h>
+#include <libakcore/rational.h>
+
+#include <algorithm>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        NullAudioContext::NullAudioContext(core::borrowed_ptr<state::AKState> state,
+                                           core::borrowed_ptr<buffer::AVBuffer> buffer,
+                                           core::borrowed_ptr<event::AKEvent> event)
+            : AudioContext(state, buffer, event), m_state(state), m_clock(state) {
+            m_audio_spec = m_state->m_atomic_state.audio_spec.load();
+            m_bytes_per_second = core::bytes_per_second(m_audio_spec);
+
+            const size_t frame_size = core::size_table(m_audio_spec.format) * m_audio_spec.channels;
+            m_period_bytes = std::min<size_t>(m_bytes_per_second * PERIOD.count() / 1000,
+                                              MAX_AUDIO_BUFFER_SIZE);
+            m_period_bytes -= frame_size > 0 ? m_period_bytes % frame_size : 0;
+            m_buf = std::make_unique<uint8_t[]>(MAX_AUDIO_BUFFER_SIZE);
+
+            m_cb_ctx = new CallbackContext(core::borrowed_ptr<AudioContext>(this), state, buffer,
+                                           event);
+        }
+
+        NullAudioContext::~NullAudioContext() { this->destroy(); }
+
+        void NullAudioContext::destroy(void) {
+            if (m_exited) {
+                return;
+            }
+            this->stop();
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_should_close = true;
+            }
+            m_cv.notify_all();
+            if (m_th) {
+                m_th->join();
+                delete m_th;
+                m_th = nullptr;
+            }
+            if (m_cb_ctx) {
+                delete m_cb_ctx;
+                m_cb_ctx = nullptr;
+            }
+            m_exited = true;
+            AKLOG_INFON("NullAudioContext::destroy(): Successfully exited");
+        }
+
+        void NullAudioContext::play(void) {
+            // [XXX] the clock thread starts here, since it calls write() of the derived classes
+            if (!m_th) {
+                m_th = new std::thread(&NullAudioContext::clock_thread, this);
+            }
+            this->set_play_state(state::PlayState::PLAYING);
+        }
+
+        void NullAudioContext::pause(void) { this->set_play_state(state::PlayState::PAUSED); }
+
+        void NullAudioContext::stop(void) { this->set_play_state(state::PlayState::STOPPED); }
+
+        core::Rational NullAudioContext::current_time(void) const {
+            return m_clock.current_time();
+        }
+
+        void NullAudioContext::set_play_state(state::PlayState play_state) {
+            if (m_state->m_atomic_state.audio_play_state != play_state) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    m_state->m_atomic_state.audio_play_state.store(play_state);
+                }
+                m_cv.notify_all();
+            }
+        }
+
+        void NullAudioContext::clock_thread(NullAudioContext* ctx) {
+            using clock = std::chrono::steady_clock;
+
+            if (ctx->m_period_bytes == 0) {
+                AKLOG_ERRORN("NullAudioContext::clock_thread(): invalid audio spec");
+                return;
+            }
+
+            // the deadlines are derived from the total bytes, so that they never drift
+            auto origin = clock::now();
+            int64_t bytes_written = 0;
+
+            auto is_playing = [ctx] {
+                return ctx->m_state->m_atomic_state.audio_play_state == state::PlayState::PLAYING;
+            };
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(ctx->m_mtx);
+                    if (!ctx->m_should_close && !is_playing()) {
+                        ctx->m_cv.wait(lock, [&] { return ctx->m_should_close || is_playing(); });
+                        origin = clock::now();
+                        bytes_written = 0;
+                    }
+                    if (ctx->m_should_close) {
+                        break;
+                    }
+                }
+
+                fill_audio_buffer(ctx->m_cb_ctx, ctx->m_buf.get(), ctx->m_period_bytes);
+                ctx->write(ctx->m_buf.get(), ctx->m_period_bytes);
+                // the buffer just written is played during the next period
+                ctx->m_clock.update(ctx->m_period_bytes);
+
+                bytes_written += ctx->m_period_bytes;
+                std::chrono::duration<double> elapsed(static_cast<double>(bytes_written) /
+                                                      ctx->m_bytes_per_second);
+                std::this_thread::sleep_until(
+                    origin + std::chrono::duration_cast<clock::duration>(elapsed));
+            }
+        }
+
+    }
+}
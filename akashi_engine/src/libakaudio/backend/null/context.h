@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../../context.h"
+#include "../../clock.h"
+
+#include <libakcore/audio.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace akashi {
+    namespace core {
+        class Rational;
+    }
+    namespace buffer {
+        class AVBuffer;
+    }
+    namespace event {
+        class AKEvent;
+    }
+    namespace state {
+        class AKState;
+        enum class PlayState;
+    }
+    namespace audio {
+
+        class CallbackContext;
+
+        /**
+         * A backend which requires no sound server.
+         *
+         * A clock thread pulls the mixed audio through fill_audio_buffer() at a fixed period, just
+         * like the sound server does, and hands it to write(), which discards it here.
+         */
+        class NullAudioContext : public AudioContext {
+          public:
+            // the period of the clock thread
+            static constexpr const std::chrono::milliseconds PERIOD{10};
+
+          public:
+            explicit NullAudioContext(core::borrowed_ptr<state::AKState> state,
+                                      core::borrowed_ptr<buffer::AVBuffer> buffer,
+                                      core::borrowed_ptr<event::AKEvent> event);
+            virtual ~NullAudioContext();
+
+            void destroy(void) override;
+
+            void play(void) override;
+
+            void pause(void) override;
+
+            void stop(void) override;
+
+            core::Rational current_time(void) const override;
+
+          protected:
+            // called from the clock thread
+            virtual void write(const uint8_t*, size_t){};
+
+            const core::AKAudioSpec& audio_spec(void) const { return m_audio_spec; }
+
+          private:
+            static void clock_thread(NullAudioContext* ctx);
+
+            void set_play_state(state::PlayState play_state);
+
+          private:
+            core::borrowed_ptr<state::AKState> m_state;
+            core::AKAudioSpec m_audio_spec;
+            size_t m_bytes_per_second = 0;
+            size_t m_period_bytes = 0;
+            std::unique_ptr<uint8_t[]> m_buf = nullptr;
+
+            CallbackContext* m_cb_ctx = nullptr;
+
+            AudioClock m_clock;
+
+            std::thread* m_th = nullptr;
+            std::mutex m_mtx;
+            std::condition_variable m_cv;
+            bool m_should_close = false;
+
+            bool m_exited = false;
+        };
+
+    }
+}
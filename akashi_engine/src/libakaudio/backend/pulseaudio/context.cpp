@@ -1,8 +1,8 @@
 #include "./context.h"
-#include "./callback.h"
 #include "./stream.h"
 #include "./util.h"
 #include "./etc.h"
+#include "../../callback.h"
 
 #include <libakstate/akstate.h>
 #include <libakbuffer/avbuffer.h>
@@ -20,7 +20,7 @@ namespace akashi {
         PulseAudioContext::PulseAudioContext(core::borrowed_ptr<state::AKState> state,
                                              core::borrowed_ptr<buffer::AVBuffer> buffer,
                                              core::borrowed_ptr<event::AKEvent> event)
-            : AudioContext(state, buffer, event), m_state(state), m_buffer(buffer) {
+            : AudioContext(state, buffer, event), m_state(state), m_buffer(buffer), m_clock(state) {
             m_mainloop = pa_threaded_mainloop_new();
             assert(m_mainloop);
             {
@@ -32,7 +32,8 @@ namespace akashi {
                 pa_context_set_state_callback(m_context, PulseAudioContext::context_state_cb,
                                               m_mainloop);
 
-                m_cb_ctx = new CallbackContext(core::borrowed_ptr(this), state, buffer, event);
+                m_cb_ctx = new CallbackContext(core::borrowed_ptr<AudioContext>(this), state,
+                                               buffer, event);
                 m_stream = new AudioStream(core::borrowed_ptr(this), m_mainloop, m_context);
 
                 pa_threaded_mainloop_start(m_mainloop);
@@ -120,8 +121,7 @@ namespace akashi {
         };
 
         core::Rational PulseAudioContext::current_time(void) const {
-            return m_state->m_atomic_state.start_time.load() +
-                   this->to_pts(m_state->m_atomic_state.bytes_played.load());
+            return m_clock.current_time();
         };
 
         core::AKAudioSpec PulseAudioContext::audio_spec(void) const {
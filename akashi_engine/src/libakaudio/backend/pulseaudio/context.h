@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../../context.h"
+#include "../../clock.h"
 
 #include <atomic>
 #include <vector>
@@ -59,6 +60,8 @@ namespace akashi {
 
             CallbackContext* cb_ctx(void) const { return m_cb_ctx; }
 
+            AudioClock& clock(void) { return m_clock; }
+
           private:
             static void context_state_cb(pa_context* context, void* mainloop);
 
@@ -68,6 +71,8 @@ namespace akashi {
 
             CallbackContext* m_cb_ctx = nullptr;
 
+            AudioClock m_clock;
+
             AudioStream* m_stream = nullptr;
 
             pa_threaded_mainloop* m_mainloop = nullptr;
@@ -1,8 +1,8 @@
 #include "./stream.h"
-#include "./callback.h"
 #include "./context.h"
 #include "./util.h"
 #include "./etc.h"
+#include "../../callback.h"
 
 #include <libakcore/audio.h>
 #include <libakcore/logger.h>
@@ -14,6 +14,29 @@ using namespace akashi::core;
 namespace akashi {
     namespace audio {
 
+        // [TODO] is it guaranteed that the sample size does not surpass the value of
+        // MAX_AUDIO_BUFFER_SIZE?
+        static uint8_t s_mask_buf[MAX_AUDIO_BUFFER_SIZE] = {0};
+
+        static void stream_write_cb(pa_stream* stream, size_t requested_bytes, void* userdata) {
+            auto audio_ctx = (PulseAudioContext*)userdata;
+            fill_audio_buffer(audio_ctx->cb_ctx(), s_mask_buf, requested_bytes);
+            if (pa_stream_write(stream, s_mask_buf, requested_bytes, NULL, 0, PA_SEEK_RELATIVE) <
+                0) {
+                AKLOG_ERROR("stream_write_cb() failed: {}", audio_ctx->get_pa_error());
+            }
+
+            // the timing info is interpolated by PulseAudio (PA_STREAM_INTERPOLATE_TIMING)
+            pa_usec_t latency = 0;
+            int negative = 0;
+            int64_t latency_bytes = -1;
+            if (pa_stream_get_latency(stream, &latency, &negative) >= 0) {
+                latency_bytes =
+                    negative ? 0 : (audio_ctx->bytes_per_second() * latency) / PA_USEC_PER_SEC;
+            }
+            audio_ctx->clock().update(latency_bytes);
+        }
+
         AudioStream::AudioStream(core::borrowed_ptr<PulseAudioContext> audio_ctx,
                                  pa_threaded_mainloop* mainloop, pa_context* context)
             : m_audio_ctx(audio_ctx) {
@@ -35,7 +58,7 @@ namespace akashi {
             m_stream =
                 pa_stream_new(m_context, AudioStream::STREAM_NAME, &sample_specifications, &map);
             pa_stream_set_state_callback(m_stream, AudioStream::stream_state_cb, m_mainloop);
-            pa_stream_set_write_callback(m_stream, stream_write_cb, m_audio_ctx->cb_ctx());
+            pa_stream_set_write_callback(m_stream, stream_write_cb, &(*m_audio_ctx));
 
             pa_buffer_attr buffer_attr;
             // buffer_attr.maxlength = (uint32_t)-1;
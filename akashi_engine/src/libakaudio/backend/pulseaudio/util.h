@@ -9,11 +9,6 @@ namespace akashi {
     }
     namespace audio {
 
-        constexpr static unsigned int MAX_AUDIO_BUFFER_SIZE = 1024 * 10; // 10kb
-
-        // [TODO] playback status should be judged from the playable times instead
-        const static unsigned int MIN_PLAYABLE_QUEUE_SIZE = 1024 * 10; // 10kb
-
         template <class T>
         struct PAOpContext {
             T data;
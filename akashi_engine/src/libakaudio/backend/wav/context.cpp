@@ -0,0 +1,107 @@
+#include "./context.h"
+
+#include <libakcore/audio.h>
+#include <libakcore/logger.h>
+
+#include <cstring>
+#include <limits>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        static constexpr const uint16_t WAVE_FORMAT_PCM = 0x0001;
+        static constexpr const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+        static constexpr const size_t WAVE_HEADER_SIZE = 44;
+
+        static void put_le16(uint8_t* buf, uint16_t v) {
+            buf[0] = v & 0xff;
+            buf[1] = (v >> 8) & 0xff;
+        }
+
+        static void put_le32(uint8_t* buf, uint32_t v) {
+            put_le16(buf, v & 0xffff);
+            put_le16(buf + 2, (v >> 16) & 0xffff);
+        }
+
+        WavAudioContext::WavAudioContext(core::borrowed_ptr<state::AKState> state,
+                                         core::borrowed_ptr<buffer::AVBuffer> buffer,
+                                         core::borrowed_ptr<event::AKEvent> event,
+                                         const std::string& out_path)
+            : NullAudioContext(state, buffer, event), m_out_path(out_path) {
+            m_file = fopen(m_out_path.c_str(), "wb");
+            if (!m_file) {
+                AKLOG_ERROR("WavAudioContext: failed to open {}", m_out_path.c_str());
+                return;
+            }
+            if (!this->write_header()) {
+                AKLOG_ERROR("WavAudioContext: failed to write the header to {}",
+                            m_out_path.c_str());
+            }
+            AKLOG_INFO("WavAudioContext: recording to {}", m_out_path.c_str());
+        }
+
+        WavAudioContext::~WavAudioContext() { this->destroy(); }
+
+        void WavAudioContext::destroy(void) {
+            // stop the clock thread first, so that write() is no longer called
+            NullAudioContext::destroy();
+
+            if (m_file) {
+                if (!this->write_header()) {
+                    AKLOG_ERROR("WavAudioContext: failed to finalize {}", m_out_path.c_str());
+                }
+                fclose(m_file);
+                m_file = nullptr;
+            }
+        }
+
+        void WavAudioContext::write(const uint8_t* buf, size_t buf_size) {
+            if (!m_file) {
+                return;
+            }
+            // the data chunk of WAV cannot exceed 4GB
+            if (buf_size > std::numeric_limits<uint32_t>::max() - WAVE_HEADER_SIZE - m_data_size) {
+                return;
+            }
+            m_data_size += fwrite(buf, 1, buf_size, m_file);
+        }
+
+        bool WavAudioContext::write_header(void) {
+            const auto& spec = this->audio_spec();
+            const uint16_t bytes_per_sample = core::size_table(spec.format);
+            const uint16_t block_align = bytes_per_sample * spec.channels;
+            const bool is_float = spec.format == AKAudioSampleFormat::FLT ||
+                                  spec.format == AKAudioSampleFormat::DBL;
+
+            uint8_t header[WAVE_HEADER_SIZE] = {0};
+            memcpy(&header[0], "RIFF", 4);
+            put_le32(&header[4], WAVE_HEADER_SIZE - 8 + m_data_size);
+            memcpy(&header[8], "WAVE", 4);
+
+            memcpy(&header[12], "fmt ", 4);
+            put_le32(&header[16], 16);
+            put_le16(&header[20], is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+            put_le16(&header[22], spec.channels);
+            put_le32(&header[24], spec.sample_rate);
+            put_le32(&header[28], spec.sample_rate * block_align);
+            put_le16(&header[32], block_align);
+            put_le16(&header[34], bytes_per_sample * 8);
+
+            memcpy(&header[36], "data", 4);
+            put_le32(&header[40], m_data_size);
+
+            const auto pos = ftell(m_file);
+            if (fseek(m_file, 0, SEEK_SET) != 0) {
+                return false;
+            }
+            auto written = fwrite(header, 1, WAVE_HEADER_SIZE, m_file);
+            if (pos > 0) {
+                fseek(m_file, pos, SEEK_SET);
+            }
+            return written == WAVE_HEADER_SIZE;
+        }
+
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../null/context.h"
+
+#include <cstdio>
+#include <string>
+
+namespace akashi {
+    namespace buffer {
+        class AVBuffer;
+    }
+    namespace event {
+        class AKEvent;
+    }
+    namespace state {
+        class AKState;
+    }
+    namespace audio {
+
+        /**
+         * A clock-driven backend which records the played audio to a WAV file.
+         * The header is fixed up when the context is destroyed.
+         */
+        class WavAudioContext : public NullAudioContext {
+          public:
+            explicit WavAudioContext(core::borrowed_ptr<state::AKState> state,
+                                     core::borrowed_ptr<buffer::AVBuffer> buffer,
+                                     core::borrowed_ptr<event::AKEvent> event,
+                                     const std::string& out_path);
+            virtual ~WavAudioContext();
+
+            void destroy(void) override;
+
+          protected:
+            void write(const uint8_t* buf, size_t buf_size) override;
+
+          private:
+            bool write_header(void);
+
+          private:
+            std::string m_out_path;
+            FILE* m_file = nullptr;
+            uint32_t m_data_size = 0;
+        };
+
+    }
+}
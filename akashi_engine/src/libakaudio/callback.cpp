@@ -0,0 +1,185 @@
+#include "./callback.h"
+#include "./mixer.h"
+
+#include <libakbuffer/avbuffer.h>
+#include <libakbuffer/audio_queue.h>
+
+#include <libakstate/akstate.h>
+#include <libakcore/logger.h>
+#include <libakcore/rational.h>
+#include <libakcore/audio_snapshot.h>
+
+#include <cmath>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        bool find_segment(WBSegment* segment, bool* is_play_over, const AudioProfile& prof,
+                          uint8_t* mask_buf, size_t requested_bytes) {
+            const int64_t from = prof.current_bytes;
+            if (from < 0 || from >= prof.duration) {
+                AKLOG_ERROR("current position ({} bytes) is out of range", from);
+                return false;
+            }
+
+            const int64_t next = from + static_cast<int64_t>(requested_bytes);
+            const int64_t to = next > prof.duration ? prof.duration : next;
+
+            WBSegment seg;
+            seg.from = from;
+            seg.to = to;
+            seg.buf = mask_buf;
+            seg.buf_size = to - from;
+            if (prof.frame_size > 0) {
+                seg.buf_size -= seg.buf_size % prof.frame_size;
+            }
+
+            *segment = seg;
+            *is_play_over = next > prof.duration;
+
+            return true;
+        }
+
+        static bool segment_has_overlap(const WBSegment& segment,
+                                        const core::AudioLayerEntry& layer) {
+            return layer.from <= segment.to && layer.to >= segment.from;
+        }
+
+        static bool layer_has_audio(core::borrowed_ptr<buffer::AudioQueue> aq,
+                                    const core::AudioLayerEntry& layer) {
+            return !aq->empty(layer.uuid);
+        }
+
+        void segment_fill(const WBSegmentSlice& slice, core::borrowed_ptr<buffer::AudioQueue> aq,
+                          const core::AudioLayerEntry& layer) {
+            uint8_t* buf = slice.buf;
+            size_t buf_size = slice.buf_size;
+
+            auto rbuf = aq->queue(layer.uuid);
+            if (!rbuf) {
+                return;
+            }
+
+            while (buf_size > 0) {
+                if (rbuf->buf.empty()) {
+                    return;
+                }
+
+                size_t aq_buf_size = 0;
+                const auto& buf_data = *rbuf->buf.front();
+
+                if (rbuf->on_process) {
+                    aq_buf_size = buf_data.prop().data_size - rbuf->buf_offset;
+                } else {
+                    aq_buf_size = buf_data.prop().data_size;
+                }
+
+                //  [XXX]
+                //  Sample format for `buf_data.prop().audio_data` should always be interleaved
+                //  format in this case. So, we can assume that all sample data exists in the
+                //  first element of buffer.
+                auto aq_buf = &buf_data.prop().audio_data[0][rbuf->buf_offset];
+                auto bytes_to_fill = buf_size <= aq_buf_size ? buf_size : aq_buf_size;
+
+                mix_layer(buf, bytes_to_fill, aq_buf, layer.gain);
+
+                if (buf_size >= aq_buf_size) {
+                    rbuf->buf_offset = 0;
+                    rbuf->on_process = false;
+                    aq->pop_front(*rbuf);
+                } else {
+                    rbuf->buf_offset += bytes_to_fill;
+                    rbuf->on_process = true;
+                }
+
+                buf = &buf[bytes_to_fill];
+                buf_size -= bytes_to_fill;
+            }
+        }
+
+        // [XXX] this runs on the realtime thread of the backend, so no heap allocation nor lock
+        // should be done here in the steady state. The audio queue is read lock-free, and the
+        // consumed buffers are deleted on the decode thread
+        void fill_audio_buffer(CallbackContext* cb_ctx, uint8_t* buf, size_t requested_bytes) {
+            memset(buf, 0, requested_bytes);
+
+            WBSegment segment;
+            bool is_play_over = false;
+            const core::AudioLayerSnapshot* layers = nullptr;
+
+            if ((cb_ctx->state() != state::PlayState::PLAYING)) {
+                goto exit;
+            }
+
+            if (cb_ctx->audio_play_over()) {
+                if (cb_ctx->video_play_over()) {
+                    cb_ctx->player_pause();
+                }
+                goto exit;
+            }
+
+            layers = cb_ctx->acquire_audio_layers();
+            if (!layers) {
+                AKLOG_ERRORN("No audio layers published");
+                goto exit;
+            }
+
+            // 1. segmentation
+            {
+                AudioProfile audio_prof;
+                audio_prof.current_bytes = cb_ctx->current_bytes();
+                audio_prof.frame_size = layers->frame_size;
+                audio_prof.duration = layers->duration;
+                auto r = find_segment(&segment, &is_play_over, audio_prof, buf, requested_bytes);
+                if (!r) {
+                    AKLOG_ERRORN("find_segment() failed");
+                    goto exit;
+                }
+            }
+
+            // 2. fill
+            {
+                auto aq = cb_ctx->aq();
+                if (!aq->begin_read()) {
+                    // seek() or clear() is in progress, so this period is left silent
+                    goto exit;
+                }
+                for (const auto& cur_layer : layers->layers) {
+                    if (layer_has_audio(aq, cur_layer) && segment_has_overlap(segment, cur_layer)) {
+                        segment_fill({.buf = segment.buf, .buf_size = segment.buf_size}, aq,
+                                     cur_layer);
+                        cb_ctx->check_audio_play_ready();
+                    }
+                }
+                aq->end_read();
+            }
+
+            // 3. postproc
+            {
+                double rms = adjust_volume(buf, requested_bytes, cb_ctx->volume());
+                if (std::isnan(rms)) {
+                    AKLOG_ERRORN("RMS is nan");
+                    memset(buf, 0, requested_bytes);
+                }
+            }
+
+            // 4. update
+            {
+                cb_ctx->incr_bytes_played(segment.buf_size);
+                if (is_play_over) {
+                    cb_ctx->set_audio_play_over(true);
+                }
+            }
+
+        exit:
+            if (layers) {
+                cb_ctx->release_audio_layers();
+            }
+        }
+
+    }
+
+}
@@ -5,14 +5,10 @@
 
 #include <vector>
 
-typedef struct pa_stream pa_stream;
-typedef struct pa_threaded_mainloop pa_threaded_mainloop;
-typedef struct pa_context pa_context;
-
 namespace akashi {
     namespace core {
-        struct AtomProfile;
-        struct LayerProfile;
+        struct AudioLayerEntry;
+        struct AudioLayerSnapshot;
     }
     namespace buffer {
         class AVBuffer;
@@ -29,25 +25,26 @@ namespace akashi {
     }
     namespace audio {
 
-        class PulseAudioContext;
+        constexpr static unsigned int MAX_AUDIO_BUFFER_SIZE = 1024 * 10; // 10kb
+
+        // [TODO] playback status should be judged from the playable times instead
+        const static unsigned int MIN_PLAYABLE_QUEUE_SIZE = 1024 * 10; // 10kb
+
+        class AudioContext;
         class CallbackContext {
           public:
-            // [TODO] event is used only for pa's player_pause. can it be deleted?
-            explicit CallbackContext(core::borrowed_ptr<PulseAudioContext> audio_ctx,
+            // [TODO] event is used only for player_pause. can it be deleted?
+            explicit CallbackContext(core::borrowed_ptr<AudioContext> audio_ctx,
                                      core::borrowed_ptr<state::AKState> state,
                                      core::borrowed_ptr<buffer::AVBuffer> buffer,
                                      core::borrowed_ptr<event::AKEvent> event)
                 : m_audio_ctx(audio_ctx), m_state(state), m_buffer(buffer), m_event(event){};
 
-            // [XXX] all the resources in this class should be managed by PulseAudioContext
+            // [XXX] all the resources in this class should be managed by the AudioContext
             virtual ~CallbackContext() = default;
 
             core::Rational current_time(void) const;
 
-            const char* get_pa_error(void) const;
-
-            size_t bytes_per_second(void) const;
-
             void set_loop_cnt(size_t cnt);
 
             size_t loop_cnt(void) const;
@@ -62,7 +59,12 @@ namespace akashi {
 
             bool video_play_over(void);
 
-            const std::vector<core::AtomProfile>& atom_profiles(void) const;
+            // must be paired with release_audio_layers()
+            const core::AudioLayerSnapshot* acquire_audio_layers(void);
+
+            void release_audio_layers(void);
+
+            int64_t current_bytes(void) const;
 
             state::PlayState state(void) const;
 
@@ -79,17 +81,21 @@ namespace akashi {
             void player_pause(void);
 
           private:
-            core::borrowed_ptr<PulseAudioContext> m_audio_ctx;
+            core::borrowed_ptr<AudioContext> m_audio_ctx;
             core::borrowed_ptr<state::AKState> m_state;
             core::borrowed_ptr<buffer::AVBuffer> m_buffer;
             core::borrowed_ptr<event::AKEvent> m_event;
+
+            // only accessed from the callback thread
+            bool m_audio_play_ready = false;
         };
 
+        // all the positions are in bytes
         struct WBSegment {
             uint8_t* buf = nullptr;
             size_t buf_size = 0;
-            core::Rational from_pts = core::Rational(0l);
-            core::Rational to_pts = core::Rational(0l);
+            int64_t from = 0;
+            int64_t to = 0;
         };
 
         struct WBSegmentSlice {
@@ -98,22 +104,24 @@ namespace akashi {
         };
 
         struct AudioProfile {
-            core::Rational current_time = core::Rational(0l);
-            size_t bytes_per_second = 0;
-            core::Rational duration = core::Rational(0l);
+            int64_t current_bytes = 0;
+            int64_t frame_size = 0;
+            int64_t duration = 0;
         };
 
-        size_t dur_to_bytes(const size_t& bytes_per_second, const core::Rational& duration);
-
-        core::Rational bytes_to_dur(const size_t& bytes_per_second, const size_t& bytes);
-
         bool find_segment(WBSegment* segment, bool* is_play_over, const AudioProfile& prof,
                           uint8_t* mask_buf, size_t requested_bytes);
 
         void segment_fill(const WBSegmentSlice& slice, core::borrowed_ptr<buffer::AudioQueue> aq,
-                          const core::LayerProfile& layer);
-
-        void stream_write_cb(pa_stream* stream, size_t requested_bytes, void* userdata);
+                          const core::AudioLayerEntry& layer);
+
+        /**
+         * Fills `buf` with `requested_bytes` of the mixed audio at the current position.
+         *
+         * This is the pull model shared by all the backends, and is called from their realtime
+         * threads. `requested_bytes` must not be greater than MAX_AUDIO_BUFFER_SIZE.
+         */
+        void fill_audio_buffer(CallbackContext* cb_ctx, uint8_t* buf, size_t requested_bytes);
 
     }
 }
@@ -1,6 +1,5 @@
 #include "./callback.h"
 #include "./context.h"
-#include "./util.h"
 
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/audio_queue.h>
@@ -19,14 +18,6 @@ namespace akashi {
             return m_audio_ctx->current_time();
         };
 
-        const char* CallbackContext::get_pa_error(void) const {
-            return m_audio_ctx->get_pa_error();
-        };
-
-        size_t CallbackContext::bytes_per_second(void) const {
-            return m_audio_ctx->bytes_per_second();
-        };
-
         void CallbackContext::incr_bytes_played(int64_t bytes) {
             m_state->m_atomic_state.bytes_played.fetch_add(bytes);
         }
@@ -44,16 +35,23 @@ namespace akashi {
         }
 
         bool CallbackContext::video_play_over(void) {
-            // [TODO] lock free?
+            // called only after the audio is over, so the lock is not taken in the steady state
+            // m_atomic_state.video_play_over is not reliable after seeks (see AKPlayer::play())
             return !m_state->get_play_ready();
+        }
 
-            // return m_state->m_atomic_state.video_play_over.load();
+        const core::AudioLayerSnapshot* CallbackContext::acquire_audio_layers(void) {
+            return m_state->m_atomic_state.audio_layers.acquire();
         }
 
-        const std::vector<core::AtomProfile>& CallbackContext::atom_profiles(void) const {
-            // [TODO] lock?
-            return m_state->m_prop.render_prof.atom_profiles;
-        };
+        void CallbackContext::release_audio_layers(void) {
+            m_state->m_atomic_state.audio_layers.release();
+        }
+
+        int64_t CallbackContext::current_bytes(void) const {
+            return m_state->m_atomic_state.start_bytes.load() +
+                   m_state->m_atomic_state.bytes_played.load();
+        }
 
         core::borrowed_ptr<buffer::AudioQueue> CallbackContext::aq(void) {
             return core::borrowed_ptr(m_buffer->aq);
@@ -77,7 +75,11 @@ namespace akashi {
             auto queue_size = m_buffer->aq->total_queue_size();
             bool can_play = queue_size >= MIN_PLAYABLE_QUEUE_SIZE;
 
-            m_state->set_audio_play_ready(can_play);
+            // the state (and its lock) is touched only when the readiness changes
+            if (can_play != m_audio_play_ready) {
+                m_audio_play_ready = can_play;
+                m_state->set_audio_play_ready(can_play);
+            }
             if (!can_play) {
                 this->player_pause();
             }
@@ -0,0 +1,117 @@
+#include "./clock.h"
+
+#include <libakstate/akstate.h>
+#include <libakcore/audio.h>
+#include <libakcore/rational.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        // corrections smaller than this are smoothed out instead of being applied at once
+        static constexpr const int64_t SLEW_LIMIT_MS = 5;
+        static constexpr const int64_t SLEW_DIVISOR = 8;
+
+        static int64_t monotonic_ns(void) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        static int64_t elapsed_bytes(int64_t from_ns, int64_t to_ns, int64_t bytes_per_second) {
+            if (to_ns <= from_ns) {
+                return 0;
+            }
+            return static_cast<int64_t>(static_cast<double>(to_ns - from_ns) * bytes_per_second /
+                                        1000000000.0);
+        }
+
+        AudioClock::AudioClock(core::borrowed_ptr<state::AKState> state) : m_state(state) {}
+
+        void AudioClock::update(int64_t latency_bytes) {
+            if (m_state->m_atomic_state.audio_play_state != state::PlayState::PLAYING) {
+                return;
+            }
+            const auto bps = this->bytes_per_second();
+            const auto prev = this->load_anchor();
+
+            Anchor anchor;
+            anchor.bytes = m_state->m_atomic_state.bytes_played.load();
+            anchor.latency = latency_bytes >= 0 ? latency_bytes : prev.latency;
+            anchor.mono_ns = monotonic_ns();
+
+            // smooth out the jitter of the reported latency
+            if (prev.mono_ns > 0 && anchor.bytes >= prev.bytes && bps > 0) {
+                auto predicted =
+                    prev.bytes - prev.latency + elapsed_bytes(prev.mono_ns, anchor.mono_ns, bps);
+                auto measured = anchor.bytes - anchor.latency;
+                auto diff = measured - predicted;
+                if (std::abs(diff) < (bps * SLEW_LIMIT_MS) / 1000) {
+                    measured = predicted + (diff / SLEW_DIVISOR);
+                    anchor.latency = anchor.bytes - measured;
+                }
+            }
+
+            this->store_anchor(anchor);
+        }
+
+        core::Rational AudioClock::current_time(void) const {
+            const auto start_time = m_state->m_atomic_state.start_time.load();
+            const auto bytes_played = m_state->m_atomic_state.bytes_played.load();
+            const auto bps = this->bytes_per_second();
+            if (bps <= 0) {
+                return start_time;
+            }
+
+            const auto anchor = this->load_anchor();
+            // the anchor is stale after seeks, which reset `bytes_played`
+            if (anchor.mono_ns == 0 || bytes_played < anchor.bytes) {
+                return start_time + Rational(bytes_played, bps);
+            }
+
+            int64_t pos = anchor.bytes - anchor.latency;
+            if (m_state->m_atomic_state.audio_play_state == state::PlayState::PLAYING) {
+                pos += elapsed_bytes(anchor.mono_ns, monotonic_ns(), bps);
+            }
+            pos = std::clamp(pos, static_cast<int64_t>(0), bytes_played);
+
+            return start_time + Rational(pos, bps);
+        }
+
+        AudioClock::Anchor AudioClock::load_anchor(void) const {
+            Anchor anchor;
+            while (true) {
+                auto seq = m_seq.load(std::memory_order_acquire);
+                if (seq & 1) {
+                    continue;
+                }
+                anchor.bytes = m_bytes.load(std::memory_order_relaxed);
+                anchor.latency = m_latency.load(std::memory_order_relaxed);
+                anchor.mono_ns = m_mono_ns.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_seq.load(std::memory_order_relaxed) == seq) {
+                    return anchor;
+                }
+            }
+        }
+
+        void AudioClock::store_anchor(const Anchor& anchor) {
+            m_seq.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bytes.store(anchor.bytes, std::memory_order_relaxed);
+            m_latency.store(anchor.latency, std::memory_order_relaxed);
+            m_mono_ns.store(anchor.mono_ns, std::memory_order_relaxed);
+            m_seq.fetch_add(1, std::memory_order_release);
+        }
+
+        int64_t AudioClock::bytes_per_second(void) const {
+            return core::bytes_per_second(m_state->m_atomic_state.audio_spec.load());
+        }
+
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <libakcore/memory.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace akashi {
+    namespace core {
+        class Rational;
+    }
+    namespace state {
+        class AKState;
+    }
+    namespace audio {
+
+        /**
+         * The master clock of the playback.
+         *
+         * `bytes_played` in AtomicState counts the bytes handed to the backend, so it advances
+         * only at the callback granularity, and runs ahead of what is actually audible by the
+         * output latency. This class anchors the audible position at every callback, and
+         * interpolates it with the monotonic clock in between.
+         *
+         * update() is called only from the realtime thread of the backend, while
+         * current_time() can be called from any thread. Neither of them locks nor allocates.
+         */
+        class AudioClock final {
+          public:
+            explicit AudioClock(core::borrowed_ptr<state::AKState> state);
+            virtual ~AudioClock() = default;
+
+            /**
+             * Re-anchors the clock right after the backend wrote its buffer.
+             *
+             * @params (latency_bytes) the bytes written but not played yet, or a negative value
+             * when the latency is unknown. In the latter case, the last one is used.
+             */
+            void update(int64_t latency_bytes);
+
+            core::Rational current_time(void) const;
+
+          private:
+            struct Anchor {
+                int64_t bytes = 0;   // `bytes_played` at the anchor
+                int64_t latency = 0; // in bytes
+                int64_t mono_ns = 0; // 0 if not anchored yet
+            };
+
+            Anchor load_anchor(void) const;
+
+            void store_anchor(const Anchor& anchor);
+
+            int64_t bytes_per_second(void) const;
+
+          private:
+            core::borrowed_ptr<state::AKState> m_state;
+
+            // seqlock: odd while the anchor is being written
+            std::atomic<uint64_t> m_seq = 0;
+            std::atomic<int64_t> m_bytes = 0;
+            std::atomic<int64_t> m_latency = 0;
+            std::atomic<int64_t> m_mono_ns = 0;
+        };
+
+    }
+}
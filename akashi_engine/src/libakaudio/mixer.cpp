@@ -0,0 +1,26 @@
+#include "./mixer.h"
+
+#include <libakcore/logger.h>
+#include <libakcore/audio_kernel.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        // [XXX] `buffer` and `audio_data` are assumed to be interleaved float samples
+        // (see to_pl_sample_format()). The kernels accept unaligned pointers.
+        void mix_layer(uint8_t* buffer, const size_t bytes_to_fill, const uint8_t* audio_data,
+                       const float gain) {
+            core::audio_kernel().mix_gain(reinterpret_cast<float*>(buffer),
+                                          reinterpret_cast<const float*>(audio_data),
+                                          bytes_to_fill / sizeof(float), gain);
+        }
+
+        double adjust_volume(uint8_t* buffer, const size_t buf_size, const double volume) {
+            return core::audio_kernel().scale_rms(reinterpret_cast<float*>(buffer),
+                                                  buf_size / sizeof(float), volume);
+        }
+
+    }
+}
@@ -1,6 +1,6 @@
 #include <catch.hpp>
 
-#include "../../../backend/pulseaudio/callback.h"
+#include "../../../callback.h"
 #include "../../../backend/pulseaudio/util.h"
 #include "../../../backend/pulseaudio/etc.h"
 
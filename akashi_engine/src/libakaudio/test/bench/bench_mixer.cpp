@@ -0,0 +1,52 @@
+#include <catch.hpp>
+
+#include <libakcore/audio_kernel.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        // same as MAX_AUDIO_BUFFER_SIZE in callback.h, and a larger one for offline mixing
+        TEST_CASE("mixer kernels", "[akaudio/bench]") {
+            for (size_t nb_samples : {(1024 * 10) / 4, 1024 * 1024}) {
+                std::vector<float> src(nb_samples);
+                std::vector<float> dst(nb_samples);
+                for (size_t i = 0; i < nb_samples; i++) {
+                    src[i] = std::sin(i * 0.01f);
+                    dst[i] = std::cos(i * 0.01f);
+                }
+
+                for (auto isa :
+                     {AudioKernelISA::SCALAR, AudioKernelISA::SSE, AudioKernelISA::AVX2}) {
+                    if (!audio_kernel_supported(isa)) {
+                        WARN(audio_kernel_isa_name(isa) << " is not supported on this cpu");
+                        continue;
+                    }
+                    const auto& kernel = audio_kernel(isa);
+                    const auto suffix = std::string(audio_kernel_isa_name(isa)) + " (" +
+                                        std::to_string(nb_samples) + ")";
+
+                    BENCHMARK("mix_gain " + suffix) {
+                        kernel.mix_gain(dst.data(), src.data(), nb_samples, 0.5f);
+                        return dst[0];
+                    };
+
+                    BENCHMARK("scale " + suffix) {
+                        kernel.scale(dst.data(), nb_samples, 1.0f);
+                        return dst[0];
+                    };
+
+                    BENCHMARK("scale_rms " + suffix) {
+                        return kernel.scale_rms(dst.data(), nb_samples, 1.0f);
+                    };
+                }
+            }
+        }
+
+    }
+}
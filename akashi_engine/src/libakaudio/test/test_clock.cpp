@@ -0,0 +1,80 @@
+#include <catch.hpp>
+
+#include "../clock.h"
+
+#include <libakcore/audio.h>
+#include <libakcore/config.h>
+#include <libakcore/memory.h>
+#include <libakcore/rational.h>
+#include <libakstate/akstate.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace audio {
+
+        static owned_ptr<state::AKState> make_state(void) {
+            auto state = make_owned<state::AKState>(core::AKConf{}, "");
+            state->m_atomic_state.audio_spec.store(
+                {AKAudioSampleFormat::FLT, 48000, 2, AKAudioChannelLayout::STEREO});
+            state->m_atomic_state.start_time.store(Rational(10, 1));
+            return state;
+        }
+
+        TEST_CASE("audio clock", "[akaudio]") {
+            auto state = make_state();
+            const auto bps = bytes_per_second(state->m_atomic_state.audio_spec.load());
+            AudioClock clock{borrowed_ptr(state)};
+
+            // not anchored yet, or not playing
+            state->m_atomic_state.bytes_played.store(bps);
+            clock.update(bps / 2);
+            REQUIRE(clock.current_time() == Rational(11, 1));
+
+            // the audible position is behind by the latency
+            state->m_atomic_state.audio_play_state.store(state::PlayState::PLAYING);
+            clock.update(bps / 2);
+            auto time = clock.current_time().to_decimal();
+            REQUIRE(time >= 10.5);
+            REQUIRE(time < 10.6);
+
+            // a seek resets `bytes_played`, which makes the anchor stale
+            state->m_atomic_state.bytes_played.store(bps / 4);
+            REQUIRE(clock.current_time() == Rational(10, 1) + Rational(1, 4));
+        }
+
+        TEST_CASE("audio clock concurrent", "[akaudio]") {
+            auto state = make_state();
+            const auto bps = bytes_per_second(state->m_atomic_state.audio_spec.load());
+            const auto chunk = bps / 100;
+            AudioClock clock{borrowed_ptr(state)};
+            state->m_atomic_state.audio_play_state.store(state::PlayState::PLAYING);
+
+            std::atomic<bool> done = false;
+            std::thread callback_th([&] {
+                for (int i = 0; i < 100000; i++) {
+                    state->m_atomic_state.bytes_played.fetch_add(chunk);
+                    clock.update(chunk);
+                }
+                done = true;
+            });
+
+            // never ahead of the bytes handed to the backend, nor behind the start
+            size_t out_of_range = 0;
+            while (!done) {
+                const auto time = clock.current_time();
+                const auto bytes_played = state->m_atomic_state.bytes_played.load();
+                const auto limit = Rational(10, 1) + Rational(bytes_played, bps);
+                if (time < Rational(10, 1) || time > limit) {
+                    out_of_range++;
+                }
+            }
+            callback_th.join();
+            REQUIRE(out_of_range == 0);
+        }
+
+    }
+}
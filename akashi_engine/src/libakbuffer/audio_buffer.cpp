@@ -4,7 +4,9 @@
 #include <libakcore/rational.h>
 #include <libakcore/audio.h>
 #include <libakcore/logger.h>
+#include <libakcore/audio_kernel.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstdint>
 #include <memory>
@@ -146,18 +148,36 @@ namespace akashi {
 
             void mix_layer(const size_t write_idx, const uint8_t* w_buf, const size_t w_buf_length,
                            double gain) {
+                const auto& kernel = core::audio_kernel();
+                const size_t w_idx = write_idx % m_buf_length;
+
+                // the region to be mixed is split into two contiguous spans at the end of the
+                // ring buffer
+                const size_t head_length = std::min(w_buf_length, m_buf_length - w_idx);
+                const size_t head_samples = head_length / sizeof(float);
+                kernel.mix_gain(reinterpret_cast<float*>(&m_buffer[w_idx]),
+                                reinterpret_cast<const float*>(w_buf), head_samples, gain);
+
+                size_t i = head_samples * sizeof(float);
+                if (i == head_length && i < w_buf_length) {
+                    kernel.mix_gain(reinterpret_cast<float*>(&m_buffer[0]),
+                                    reinterpret_cast<const float*>(&w_buf[i]),
+                                    (w_buf_length - i) / sizeof(float), gain);
+                    i += ((w_buf_length - i) / sizeof(float)) * sizeof(float);
+                }
+
+                // a sample which straddles the end of the ring buffer
                 alignas(float) uint8_t temp_buf[sizeof(float)] = {0};
-                for (size_t i = 0; i < w_buf_length; i += sizeof(float)) {
+                for (; i < w_buf_length; i += sizeof(float)) {
                     for (size_t d = 0; d < sizeof(float); d++) {
-                        temp_buf[d] = m_buffer[(i + d + write_idx) % m_buf_length];
+                        temp_buf[d] = m_buffer[(i + d + w_idx) % m_buf_length];
                     }
                     float old_v = parse_float(temp_buf);
                     float new_v = parse_float(&w_buf[i]) * gain;
-                    float mix_gain = 1.0;
-                    float res = old_v + (mix_gain * new_v);
+                    float res = old_v + new_v;
 
                     for (size_t j = 0; j < sizeof(float); j++) {
-                        m_buffer[((i + write_idx) + j) % m_buf_length] = ((uint8_t*)&res)[j];
+                        m_buffer[((i + w_idx) + j) % m_buf_length] = ((uint8_t*)&res)[j];
                     }
                 }
             }
@@ -211,6 +231,15 @@ namespace akashi {
             return AudioBuffer::Result::OK;
         }
 
+        AudioBuffer::Result AudioBuffer::flush() {
+            if (!m_back_buffer) {
+                return AudioBuffer::Result::OK;
+            }
+            auto back_buffer = std::move(m_back_buffer);
+            m_back_buffer = nullptr;
+            return this->enqueue(std::move(back_buffer));
+        }
+
         AudioBuffer::Result AudioBuffer::dequeue(uint8_t* buf, const size_t len,
                                                  const core::Rational& r_pts) {
             auto nb_channels = m_buffers.size();
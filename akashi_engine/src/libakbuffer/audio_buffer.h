@@ -34,6 +34,10 @@ namespace akashi {
             // precondition: write_ready() returns true
             AudioBuffer::Result enqueue(core::owned_ptr<AVBufferData> buf_data);
 
+            // writes the back buffer, if any
+            // precondition: write_ready() returns true
+            AudioBuffer::Result flush();
+
             /**
              *
              * @params (buf) a 1-D planar audio buffer
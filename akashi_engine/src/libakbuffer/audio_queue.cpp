@@ -9,9 +9,9 @@
 #include <libakstate/akstate.h>
 
 #include <cstdint>
-#include <deque>
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 using namespace akashi::core;
@@ -27,71 +27,83 @@ namespace akashi {
             }
         }
 
-        AudioQueue::~AudioQueue() {}
-
-        size_t AudioQueue::enqueue(uuid_t layer_uuid, std::unique_ptr<AVBufferData> buf_data) {
-            m_queue_size.fetch_add(buf_data->prop().data_size);
-
-            auto last_item_pts = buf_data->prop().pts;
-            auto last_item_rpts = buf_data->prop().rpts;
+        AudioQueue::~AudioQueue() {
+            for (auto&& [k, v] : m_qmap) {
+                while (!v->buf.empty()) {
+                    delete v->buf.front();
+                    v->buf.pop();
+                }
+                while (!v->reclaim.empty()) {
+                    delete v->reclaim.front();
+                    v->reclaim.pop();
+                }
+            }
+        }
 
-            m_qmap[layer_uuid].buf.push_back(std::move(buf_data));
+        namespace {
+            enum ConsumerOwner : int { FREE = 0, AUDIO_CALLBACK, CONTROL };
+        }
 
-            AKLOG_INFO("Audio buffer enqueued {}, {}, id: {}, rpts: {}",
-                       m_qmap.at(layer_uuid).buf.size(), last_item_pts.to_decimal(),
-                       layer_uuid.c_str(), last_item_rpts.to_decimal());
+        size_t AudioQueue::enqueue(const uuid_t& layer_uuid,
+                                   std::unique_ptr<AVBufferData> buf_data) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            this->reclaim();
+
+            auto& data = this->layer(layer_uuid);
+            const auto data_size = buf_data->prop().data_size;
+
+            // added in advance, so that the consumer never sees the size going below zero
+            m_queue_size.fetch_add(data_size);
+            if (data.buf.push(buf_data.get())) {
+                buf_data.release();
+            } else {
+                m_queue_size.fetch_sub(data_size);
+                AKLOG_ERROR("Audio queue of layer {} is full, the buffer at {} is dropped",
+                            layer_uuid.c_str(), buf_data->prop().pts.to_decimal());
+            }
 
             size_t queue_size = m_queue_size.load();
 
-            bool not_full = m_queue_size <= m_max_queue_size;
-            m_state->set_audio_decode_ready(not_full);
+            bool ready = this->decode_ready();
+            m_state->update_audio_decode_ready([ready] { return ready; });
 
             return queue_size;
         };
 
-        bool AudioQueue::empty(uuid_t layer_uuid) {
-            bool contains = m_qmap.find(layer_uuid) != m_qmap.end();
-            return !contains || m_qmap[layer_uuid].buf.empty();
-        };
-
-        const static DummyBufferData dummy_buf_data{};
-
-        const AVBufferData& AudioQueue::front(uuid_t layer_uuid, bool check_empty) {
-            if (check_empty) {
-                if (this->empty(layer_uuid)) {
-                    // [TODO] error handling?
-                    AKLOG_ERRORN("AudioContext::front_buf(): failed to get audio buffer");
-                    return dummy_buf_data;
-                }
+        bool AudioQueue::begin_read(void) {
+            int expected = ConsumerOwner::FREE;
+            if (!m_consumer.compare_exchange_strong(expected, ConsumerOwner::AUDIO_CALLBACK)) {
+                return false;
             }
-            return *m_qmap[layer_uuid].buf.front();
-        };
-
-        AudioQueueData& AudioQueue::queue(uuid_t layer_uuid) { return m_qmap[layer_uuid]; };
+            m_table = m_table_cell.acquire();
+            return true;
+        }
 
-        size_t AudioQueue::pop_front(uuid_t layer_uuid) {
-            // should not be called when the queue is empty
+        void AudioQueue::end_read(void) {
+            m_table = nullptr;
+            m_table_cell.release();
+            m_consumer.store(ConsumerOwner::FREE);
+        }
 
-            bool contains = m_qmap.find(layer_uuid) != m_qmap.end();
-            if (contains && !m_qmap[layer_uuid].buf.empty()) {
-                auto res = std::move(m_qmap[layer_uuid].buf.front());
-                m_queue_size.fetch_sub(res->prop().data_size);
-                auto pop_pts = res->prop().pts.to_decimal();
-                m_qmap[layer_uuid].buf.pop_front();
-                AKLOG_INFO("audio buffer dequeued {}, {}, id: {}", m_qmap[layer_uuid].buf.size(),
-                           pop_pts, layer_uuid.c_str());
+        AudioQueueData* AudioQueue::queue(const uuid_t& layer_uuid) {
+            if (!m_table) {
+                return nullptr;
             }
+            auto it = m_table->layers.find(layer_uuid);
+            return it != m_table->layers.end() ? it->second : nullptr;
+        };
 
-            size_t queue_size = m_queue_size.load();
-
-            bool not_full = queue_size <= m_queue_size;
-            m_state->set_audio_decode_ready(not_full);
-
-            return queue_size;
+        bool AudioQueue::empty(const uuid_t& layer_uuid) {
+            auto data = this->queue(layer_uuid);
+            return !data || data->buf.empty();
+        };
 
-            // if (!can_play) {
-            //     this->player_pause();
-            // }
+        void AudioQueue::pop_front(AudioQueueData& data) {
+            auto buf_data = data.buf.front();
+            data.buf.pop();
+            m_queue_size.fetch_sub(buf_data->prop().data_size);
+            // deleted by the decode thread, see `AudioQueueData::reclaim`
+            data.reclaim.push(buf_data);
         };
 
         static bool validate_layer_uuid(const std::vector<std::string>& layer_uuids,
@@ -130,19 +142,18 @@ namespace akashi {
                 }
             }
 
-            for (auto iter = m_qmap.begin(), end = m_qmap.end(); iter != end; ++iter) {
-                const auto& target = *iter;
-
-                if (!validate_layer_uuid(layer_uuids, target.first)) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            this->acquire_consumer();
+            for (auto&& [layer_uuid, data] : m_qmap) {
+                if (!validate_layer_uuid(layer_uuids, layer_uuid)) {
                     continue;
                 }
-                auto layer_uuid = target.first;
                 bool initial_seek = true;
-                while (!m_qmap[layer_uuid].buf.empty()) {
-                    const auto& buf_data = m_qmap[layer_uuid].buf.front();
+                while (!data->buf.empty()) {
+                    const auto buf_data = data->buf.front();
                     auto buf_from = buf_data->prop().pts;
                     if (initial_seek) {
-                        buf_from += to_pts(m_qmap[layer_uuid].buf_offset, m_state);
+                        buf_from += to_pts(data->buf_offset, m_state);
                         initial_seek = false;
                     }
                     const auto buf_to =
@@ -151,8 +162,8 @@ namespace akashi {
                     if (buf_from <= seek_pts && seek_pts <= buf_to) {
                         const auto offset_pts = seek_pts - buf_from;
                         size_t offset_bytes = (offset_pts * bytes_per_second(m_state)).to_decimal();
-                        m_qmap[layer_uuid].on_process = offset_bytes > 0;
-                        m_qmap[layer_uuid].buf_offset = offset_bytes;
+                        data->on_process = offset_bytes > 0;
+                        data->buf_offset = offset_bytes;
 
                         AKLOG_INFO(
                             "AudioQueue::seek():  from: {}, to: {}, seek_pts: {}, offset_pts: {}, offset_bytes: {}",
@@ -161,42 +172,118 @@ namespace akashi {
                         res = true;
                         break;
                     }
-                    this->pop_front(layer_uuid);
+                    this->pop_front(*data);
                 }
             }
+            this->release_consumer();
+            this->reclaim();
+
+            bool ready = this->decode_ready();
+            m_state->update_audio_decode_ready([ready] { return ready; });
             return res;
         }
 
-        // [TODO] thread-unsafe
         void AudioQueue::clear(bool notify) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            this->acquire_consumer();
             for (auto&& [k, v] : m_qmap) {
-                v.buf.clear();
-                v.buf_offset = 0;
-                v.on_process = false;
+                while (!v->buf.empty()) {
+                    this->pop_front(*v);
+                }
+                v->buf_offset = 0;
+                v->on_process = false;
             }
             m_queue_size.store(0);
+            this->release_consumer();
+            this->reclaim();
 
             if (notify) {
                 m_state->set_audio_decode_ready(true);
             }
         };
 
-        void AudioQueue::clear_by_id(uuid_t layer_uuid) {
-            bool contains = m_qmap.find(layer_uuid) != m_qmap.end();
-            while (contains && !m_qmap[layer_uuid].buf.empty()) {
-                auto res = std::move(m_qmap[layer_uuid].buf.front());
-                m_queue_size.fetch_sub(res->prop().data_size);
-                m_qmap[layer_uuid].buf.pop_front();
+        void AudioQueue::clear_by_id(const uuid_t& layer_uuid) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            auto it = m_qmap.find(layer_uuid);
+            if (it != m_qmap.end()) {
+                this->acquire_consumer();
+                while (!it->second->buf.empty()) {
+                    this->pop_front(*it->second);
+                }
+                this->release_consumer();
+                this->reclaim();
             }
 
-            size_t queue_size = m_queue_size.load();
-
-            bool not_full = queue_size <= m_queue_size;
-            m_state->set_audio_decode_ready(not_full);
+            bool ready = this->decode_ready();
+            m_state->update_audio_decode_ready([ready] { return ready; });
         }
 
         size_t AudioQueue::total_queue_size(void) { return m_queue_size.load(); }
 
+        bool AudioQueue::update_decode_ready(void) {
+            bool ready = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                this->reclaim();
+                ready = this->decode_ready();
+            }
+            m_state->update_audio_decode_ready([ready] { return ready; });
+            return ready;
+        }
+
+        AudioQueueData& AudioQueue::layer(const uuid_t& layer_uuid) {
+            auto it = m_qmap.find(layer_uuid);
+            if (it != m_qmap.end()) {
+                return *it->second;
+            }
+
+            auto& data = m_qmap[layer_uuid];
+            data = std::make_unique<AudioQueueData>(AUDIO_QUEUE_LAYER_CAPACITY);
+
+            // the audio callback finds the layers through a snapshot, since m_qmap is not
+            // safe to be read while it is being modified here
+            auto table = make_owned<AudioQueueTable>();
+            for (auto&& [k, v] : m_qmap) {
+                table->layers.emplace(k, v.get());
+            }
+            m_table_cell.publish(std::move(table));
+
+            return *data;
+        }
+
+        void AudioQueue::reclaim(void) {
+            for (auto&& [k, v] : m_qmap) {
+                while (!v->reclaim.empty()) {
+                    delete v->reclaim.front();
+                    v->reclaim.pop();
+                }
+            }
+        }
+
+        bool AudioQueue::decode_ready(void) {
+            if (m_queue_size.load() > m_max_queue_size) {
+                return false;
+            }
+            for (auto&& [k, v] : m_qmap) {
+                if (v->buf.full()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void AudioQueue::acquire_consumer(void) {
+            // the audio callback holds the consumer side only for a period, and never waits
+            // for this side
+            int expected = ConsumerOwner::FREE;
+            while (!m_consumer.compare_exchange_weak(expected, ConsumerOwner::CONTROL)) {
+                expected = ConsumerOwner::FREE;
+                std::this_thread::yield();
+            }
+        }
+
+        void AudioQueue::release_consumer(void) { m_consumer.store(ConsumerOwner::FREE); }
+
         static void save_pcm(uint8_t* buf, size_t buf_size, const char* fname) {
             auto f = fopen(fname, "ab");
             fwrite(buf, 1, static_cast<size_t>(buf_size), f);
@@ -204,16 +291,19 @@ namespace akashi {
         };
 
         void AudioQueue::dump_all(void) {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            this->acquire_consumer();
             for (auto&& [k, v] : m_qmap) {
                 auto fname = std::string(k + ".buf");
                 remove(fname.c_str());
-                for (size_t i = 0; i < v.buf.size(); i++) {
-                    auto buf_size = v.buf[i]->prop().data_size;
-                    auto buf_ptr = v.buf[i]->prop().audio_data[0];
+                for (size_t i = 0; i < v->buf.size(); i++) {
+                    auto buf_size = v->buf[i]->prop().data_size;
+                    auto buf_ptr = v->buf[i]->prop().audio_data[0];
                     save_pcm(buf_ptr, buf_size, fname.c_str());
                 }
                 AKLOG_WARN("Dumped pcm file: {}", fname.c_str());
             }
+            this->release_consumer();
         }
 
     }
@@ -3,14 +3,14 @@
 #include <libakcore/rational.h>
 #include <libakcore/audio.h>
 #include <libakcore/memory.h>
+#include <libakcore/snapshot.h>
+#include <libakcore/spsc_ring.h>
 
 #include <cstdint>
-#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <mutex>
-#include <condition_variable>
 #include <atomic>
 
 namespace akashi {
@@ -22,8 +22,19 @@ namespace akashi {
 
         class AVBufferData;
 
+        // the number of buffers which can be queued for a layer
+        const static size_t AUDIO_QUEUE_LAYER_CAPACITY = 4096;
+
         struct AudioQueueData {
-            std::deque<std::unique_ptr<AVBufferData>> buf;
+            explicit AudioQueueData(size_t capacity) : buf(capacity), reclaim(capacity + 1) {}
+
+            // from the decode thread to the audio callback
+            core::SpscRing<AVBufferData*> buf;
+
+            // the buffers consumed by the audio callback, which are deleted on the decode thread.
+            // enqueue() empties this before pushing a buffer to `buf`, so it never gets full
+            core::SpscRing<AVBufferData*> reclaim;
+
             size_t buf_offset = 0;
 
             // if true, when dequeuing for audio processing,
@@ -31,6 +42,17 @@ namespace akashi {
             bool on_process = false;
         };
 
+        struct AudioQueueTable {
+            std::unordered_map<std::string, AudioQueueData*> layers;
+        };
+
+        /**
+         * The decode thread is the producer, and the audio callback is the consumer.
+         *
+         * The consumer side (begin_read() to end_read()) neither allocates, locks, nor logs, so
+         * it can be run on the realtime thread of the audio backend. seek(), clear() and
+         * clear_by_id() take over the consumer side, during which begin_read() fails.
+         */
         class AudioQueue final {
           public:
             using uuid_t = std::string;
@@ -39,30 +61,60 @@ namespace akashi {
             explicit AudioQueue(core::borrowed_ptr<state::AKState> state);
             virtual ~AudioQueue();
 
-            size_t enqueue(uuid_t layer_uuid, std::unique_ptr<AVBufferData> buf_data);
+            size_t enqueue(const uuid_t& layer_uuid, std::unique_ptr<AVBufferData> buf_data);
 
-            bool empty(uuid_t layer_uuid);
+            // returns false when the consumer side is taken over, and must be paired with
+            // end_read() otherwise
+            bool begin_read(void);
 
-            const AVBufferData& front(uuid_t layer_uuid, bool check_empty);
+            void end_read(void);
 
-            bool seek(const core::Rational& seek_pts);
+            // nullptr when no buffer has been enqueued for the layer yet
+            AudioQueueData* queue(const uuid_t& layer_uuid);
 
-            AudioQueueData& queue(uuid_t layer_uuid);
+            bool empty(const uuid_t& layer_uuid);
 
-            size_t pop_front(uuid_t layer_uuid);
+            // should not be called when the queue is empty
+            void pop_front(AudioQueueData& data);
+
+            bool seek(const core::Rational& seek_pts);
 
             void clear(bool notify = true);
 
-            void clear_by_id(uuid_t layer_uuid);
+            void clear_by_id(const uuid_t& layer_uuid);
 
             size_t total_queue_size(void);
 
+            // the audio callback only lowers the queue size without touching the state, so the
+            // decode thread re-checks the readiness with this, which also deletes the consumed
+            // buffers
+            bool update_decode_ready(void);
+
             // just for debugging
             void dump_all();
 
+          private:
+            AudioQueueData& layer(const uuid_t& layer_uuid);
+
+            void reclaim(void);
+
+            bool decode_ready(void);
+
+            void acquire_consumer(void);
+
+            void release_consumer(void);
+
           private:
             core::borrowed_ptr<state::AKState> m_state;
-            std::unordered_map<std::string, AudioQueueData> m_qmap;
+
+            // guards the producer side, and is never taken by the audio callback
+            std::mutex m_mtx;
+            std::unordered_map<std::string, std::unique_ptr<AudioQueueData>> m_qmap;
+
+            core::SnapshotCell<AudioQueueTable> m_table_cell;
+            const AudioQueueTable* m_table = nullptr;
+            std::atomic<int> m_consumer{0};
+
             std::atomic<size_t> m_queue_size{0};
             unsigned int m_max_queue_size = 0;
         };
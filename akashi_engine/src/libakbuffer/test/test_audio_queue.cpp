@@ -0,0 +1,142 @@
+#include <catch.hpp>
+
+#include "../audio_queue.h"
+#include "../avbuffer.h"
+
+#include <libakcore/config.h>
+#include <libakcore/memory.h>
+#include <libakstate/akstate.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace buffer {
+
+        namespace {
+            class TestBufferData final : public AVBufferData {
+              public:
+                static inline std::atomic<int> live = 0;
+
+                explicit TestBufferData(size_t data_size) {
+                    m_prop.media_type = AVBufferType::AUDIO;
+                    m_prop.pts = Rational(0, 1);
+                    m_prop.rpts = Rational(0, 1);
+                    m_prop.data_size = data_size;
+                    live++;
+                }
+                ~TestBufferData() { live--; }
+            };
+        }
+
+        TEST_CASE("audio queue decode ready", "[akbuffer]") {
+            static constexpr const size_t BUF_SIZE = 1024;
+            static constexpr const size_t NB_BUFS = 32;
+
+            state::AKState state(core::AKConf{}, "");
+            state.m_prop.audio_max_queue_size = BUF_SIZE * NB_BUFS;
+            AudioQueue queue{borrowed_ptr<state::AKState>(&state)};
+
+            // the decode thread enqueues into one layer while the audio callback pops from the
+            // other, so that the size crosses the limit back and forth
+            for (size_t iter = 0; iter < 100; iter++) {
+                queue.clear();
+                for (size_t i = 0; i < NB_BUFS; i++) {
+                    queue.enqueue("pop", std::make_unique<TestBufferData>(BUF_SIZE));
+                }
+                // ends up over the limit in the odd iterations
+                const size_t nb_pops = NB_BUFS - (iter % 2) * 2;
+
+                std::thread decode_th([&queue] {
+                    for (size_t i = 0; i < NB_BUFS; i++) {
+                        queue.enqueue("push", std::make_unique<TestBufferData>(BUF_SIZE));
+                    }
+                });
+                std::thread callback_th([&queue, nb_pops] {
+                    for (size_t i = 0; i < nb_pops;) {
+                        if (!queue.begin_read()) {
+                            continue;
+                        }
+                        auto data = queue.queue("pop");
+                        queue.pop_front(*data);
+                        queue.end_read();
+                        i++;
+                    }
+                });
+                decode_th.join();
+                callback_th.join();
+
+                // the readiness is re-checked by the decode thread
+                const bool not_full = queue.total_queue_size() <= BUF_SIZE * NB_BUFS;
+                REQUIRE(not_full == (iter % 2 == 0));
+                REQUIRE(queue.update_decode_ready() == not_full);
+                REQUIRE(state.get_audio_decode_ready() == not_full);
+            }
+        }
+
+        TEST_CASE("audio queue reclaim", "[akbuffer]") {
+            state::AKState state(core::AKConf{}, "");
+            {
+                AudioQueue queue{borrowed_ptr<state::AKState>(&state)};
+
+                REQUIRE(queue.begin_read());
+                REQUIRE(queue.queue("layer") == nullptr);
+                queue.end_read();
+
+                for (int i = 0; i < 4; i++) {
+                    queue.enqueue("layer", std::make_unique<TestBufferData>(1024));
+                }
+
+                // the consumed buffers are left to the decode thread
+                REQUIRE(queue.begin_read());
+                REQUIRE(!queue.begin_read());
+                auto data = queue.queue("layer");
+                REQUIRE(data);
+                queue.pop_front(*data);
+                queue.pop_front(*data);
+                queue.end_read();
+                REQUIRE(TestBufferData::live == 4);
+                REQUIRE(queue.total_queue_size() == 2048);
+
+                queue.update_decode_ready();
+                REQUIRE(TestBufferData::live == 2);
+
+                queue.clear();
+                REQUIRE(TestBufferData::live == 0);
+                REQUIRE(queue.total_queue_size() == 0);
+
+                queue.enqueue("layer", std::make_unique<TestBufferData>(1024));
+            }
+            REQUIRE(TestBufferData::live == 0);
+        }
+
+        TEST_CASE("audio queue layer capacity", "[akbuffer]") {
+            state::AKState state(core::AKConf{}, "");
+            // only the ring limits the queue
+            state.m_prop.audio_max_queue_size = AUDIO_QUEUE_LAYER_CAPACITY * 2;
+            AudioQueue queue{borrowed_ptr<state::AKState>(&state)};
+
+            for (size_t i = 0; i < AUDIO_QUEUE_LAYER_CAPACITY; i++) {
+                queue.enqueue("layer", std::make_unique<TestBufferData>(1));
+            }
+            REQUIRE(!queue.update_decode_ready());
+
+            // does not fit in the ring, and is dropped
+            queue.enqueue("layer", std::make_unique<TestBufferData>(1));
+            REQUIRE(queue.total_queue_size() == AUDIO_QUEUE_LAYER_CAPACITY);
+            REQUIRE(TestBufferData::live == static_cast<int>(AUDIO_QUEUE_LAYER_CAPACITY));
+
+            REQUIRE(queue.begin_read());
+            queue.pop_front(*queue.queue("layer"));
+            queue.end_read();
+            REQUIRE(queue.update_decode_ready());
+
+            queue.clear();
+            REQUIRE(TestBufferData::live == 0);
+        }
+
+    }
+}
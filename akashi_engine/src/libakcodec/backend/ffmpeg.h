@@ -2,3 +2,4 @@
 
 #include "./ffmpeg/source.h"
 #include "./ffmpeg/sink.h"
+#include "./ffmpeg/concat.h"
@@ -0,0 +1,294 @@
+#include "./async_io.h"
+
+#include "./error.h"
+
+#include <libakcore/logger.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+#include <libavutil/mem.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace akashi {
+    namespace codec::priv {
+
+        // the buffer of the AVIOContext, which is flushed into the blocks
+        static constexpr const int AVIO_BUFFER_SIZE = 256 * 1024;
+        static constexpr const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+        static constexpr const size_t MAX_BLOCKS = 8;
+        // for O_DIRECT
+        static constexpr const size_t BLOCK_ALIGN = 4096;
+
+        static bool env_enabled(const char* name, bool default_value) {
+            const char* env = std::getenv(name);
+            return env ? std::atoi(env) != 0 : default_value;
+        }
+
+        bool AsyncFileIO::enabled(void) { return env_enabled("AK_ASYNC_IO", true); }
+
+        bool AsyncFileIO::supports(const AVOutputFormat* oformat) {
+            // the mov muxers read the file after flushing, to move the moov atom to the front
+            static constexpr const char* mov_formats[] = {"mov",  "mp4", "3gp", "3g2", "psp",
+                                                          "ipod", "ismv", "f4v", "avif"};
+            for (const auto name : mov_formats) {
+                if (std::strcmp(oformat->name, name) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool AsyncFileIO::open(const std::string& fname) {
+            m_fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (m_fd < 0) {
+                AKLOG_ERROR("open() failed for {}, ret={}", fname.c_str(), std::strerror(errno));
+                return false;
+            }
+            if (env_enabled("AK_DIRECT_IO", false)) {
+                m_direct_fd = ::open(fname.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+                if (m_direct_fd < 0) {
+                    AKLOG_WARN("O_DIRECT is not available for {}, ret={}", fname.c_str(),
+                               std::strerror(errno));
+                }
+            }
+            if (const char* env = std::getenv("AK_PREALLOC_MB"); env && std::atoll(env) > 0) {
+                const off_t len = static_cast<off_t>(std::atoll(env)) * 1024 * 1024;
+                // the size of the file is kept, so that the muxers see where they wrote to
+                if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, len) != 0) {
+                    AKLOG_WARN("fallocate() failed, ret={}", std::strerror(errno));
+                } else {
+                    m_preallocated = true;
+                }
+            }
+
+            auto buffer = static_cast<uint8_t*>(av_malloc(AVIO_BUFFER_SIZE));
+            if (!buffer) {
+                AKLOG_ERRORN("av_malloc() failed");
+                return false;
+            }
+            m_avio = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 1, this, nullptr,
+                                        &AsyncFileIO::write_packet, &AsyncFileIO::seek);
+            if (!m_avio) {
+                AKLOG_ERRORN("avio_alloc_context() failed");
+                av_free(buffer);
+                return false;
+            }
+
+            m_th = new std::thread(&AsyncFileIO::writer_thread, this);
+            return true;
+        }
+
+        bool AsyncFileIO::close(void) {
+            if (m_fd < 0) {
+                return m_err == 0;
+            }
+            if (m_th) {
+                avio_flush(m_avio);
+                this->submit_block();
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    m_closing = true;
+                }
+                m_cv.notify_all();
+                m_th->join();
+                delete m_th;
+                m_th = nullptr;
+            }
+            if (m_avio) {
+                av_freep(&m_avio->buffer);
+                avio_context_free(&m_avio);
+            }
+            // releases the space reserved beyond the end
+            if (m_fd >= 0 && m_preallocated && ftruncate(m_fd, m_size) != 0) {
+                AKLOG_WARN("ftruncate() failed, ret={}", std::strerror(errno));
+            }
+            if (m_direct_fd >= 0) {
+                ::close(m_direct_fd);
+                m_direct_fd = -1;
+            }
+            if (m_fd >= 0) {
+                if (::close(m_fd) != 0 && m_err == 0) {
+                    m_err = errno;
+                }
+                m_fd = -1;
+            }
+            for (auto data : m_free_blocks) {
+                std::free(data);
+            }
+            m_free_blocks.clear();
+
+            if (m_err != 0) {
+                AKLOG_ERROR("Failed to write the output, ret={}", std::strerror(m_err));
+                return false;
+            }
+            return true;
+        }
+
+        int AsyncFileIO::write_packet(void* opaque, uint8_t* buf, int buf_size) {
+            auto io = static_cast<AsyncFileIO*>(opaque);
+            int written = 0;
+            while (written < buf_size) {
+                if (io->m_err != 0) {
+                    return AVERROR(io->m_err);
+                }
+                if (!io->m_block.data && !io->acquire_block()) {
+                    return AVERROR(ENOMEM);
+                }
+                auto& block = io->m_block;
+                const auto len = std::min(BLOCK_SIZE - block.size,
+                                          static_cast<size_t>(buf_size - written));
+                std::memcpy(block.data + block.size, buf + written, len);
+                block.size += len;
+                written += static_cast<int>(len);
+                io->m_pos += len;
+                io->m_size = std::max(io->m_size, io->m_pos);
+
+                if (block.size == BLOCK_SIZE) {
+                    io->submit_block();
+                }
+            }
+            return buf_size;
+        }
+
+        int64_t AsyncFileIO::seek(void* opaque, int64_t offset, int whence) {
+            auto io = static_cast<AsyncFileIO*>(opaque);
+            if (whence == AVSEEK_SIZE) {
+                return io->m_size;
+            }
+            int64_t pos = 0;
+            switch (whence & ~AVSEEK_FORCE) {
+                case SEEK_SET: {
+                    pos = offset;
+                    break;
+                }
+                case SEEK_CUR: {
+                    pos = io->m_pos + offset;
+                    break;
+                }
+                case SEEK_END: {
+                    pos = io->m_size + offset;
+                    break;
+                }
+                default: {
+                    return AVERROR(EINVAL);
+                }
+            }
+            if (pos < 0) {
+                return AVERROR(EINVAL);
+            }
+            // the blocks are written in order, so that the later writes win
+            if (pos != io->m_pos) {
+                io->submit_block();
+                io->drain();
+                io->m_pos = pos;
+            }
+            return pos;
+        }
+
+        void AsyncFileIO::writer_thread(AsyncFileIO* io) {
+            while (true) {
+                Block block;
+                {
+                    std::unique_lock<std::mutex> lock(io->m_mtx);
+                    io->m_cv.wait(lock, [io] { return io->m_closing || !io->m_queue.empty(); });
+                    if (io->m_queue.empty()) {
+                        break;
+                    }
+                    block = io->m_queue.front();
+                    io->m_queue.pop_front();
+                    io->m_writing = true;
+                }
+                // the rest is discarded after an error
+                if (io->m_err == 0 && !io->write_block(block)) {
+                    io->m_err = errno != 0 ? errno : EIO;
+                    AKLOG_ERROR("Failed to write {} bytes at {}, ret={}", block.size, block.offset,
+                                std::strerror(io->m_err));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(io->m_mtx);
+                    io->m_free_blocks.push_back(block.data);
+                    io->m_writing = false;
+                }
+                io->m_cv.notify_all();
+            }
+        }
+
+        bool AsyncFileIO::acquire_block(void) {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, [this] {
+                return m_err != 0 || !m_free_blocks.empty() || m_nb_blocks < MAX_BLOCKS;
+            });
+            if (m_err != 0) {
+                return false;
+            }
+            if (!m_free_blocks.empty()) {
+                m_block.data = m_free_blocks.back();
+                m_free_blocks.pop_back();
+            } else {
+                m_block.data = static_cast<uint8_t*>(std::aligned_alloc(BLOCK_ALIGN, BLOCK_SIZE));
+                if (!m_block.data) {
+                    AKLOG_ERRORN("aligned_alloc() failed");
+                    return false;
+                }
+                m_nb_blocks += 1;
+            }
+            m_block.size = 0;
+            m_block.offset = m_pos;
+            return true;
+        }
+
+        void AsyncFileIO::submit_block(void) {
+            if (!m_block.data) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                if (m_block.size > 0) {
+                    m_queue.push_back(m_block);
+                } else {
+                    m_free_blocks.push_back(m_block.data);
+                }
+            }
+            m_cv.notify_all();
+            m_block = {};
+        }
+
+        void AsyncFileIO::drain(void) {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, [this] { return m_queue.empty() && !m_writing; });
+        }
+
+        bool AsyncFileIO::write_block(const Block& block) {
+            const bool aligned = block.offset % BLOCK_ALIGN == 0 && block.size % BLOCK_ALIGN == 0;
+            const int fd = m_direct_fd >= 0 && aligned ? m_direct_fd : m_fd;
+            size_t written = 0;
+            while (written < block.size) {
+                auto ret = pwrite(fd, block.data + written, block.size - written,
+                                  block.offset + written);
+                if (ret < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                written += ret;
+                // the rest is not aligned any longer
+                if (fd == m_direct_fd && written < block.size) {
+                    return this->write_block({block.data + written, block.size - written,
+                                              block.offset + static_cast<int64_t>(written)});
+                }
+            }
+            return true;
+        }
+
+    }
+}
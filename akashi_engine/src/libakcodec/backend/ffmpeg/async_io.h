@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AVIOContext;
+struct AVOutputFormat;
+
+namespace akashi {
+    namespace codec::priv {
+
+        /**
+         * An AVIOContext which writes into a file on its own thread
+         *
+         * The output of the muxer is gathered into large aligned blocks, and the writer thread
+         * writes them out at their offsets. The encoder is stalled by a slow disk only when all
+         * the blocks are waiting to be written. A seek, which the muxers do to fill in the
+         * headers, closes the current block and waits for the blocks to be written, so that
+         * the file is up to date when the muxer reads it after the seek.
+         *
+         * avio_flush() cannot be waited for, so the muxers which read the file back after
+         * flushing, such as mov/mp4 for the faststart, are not supported.
+         *
+         * Disabled when `AK_ASYNC_IO` is set to 0. With `AK_DIRECT_IO=1`, the blocks at aligned
+         * offsets bypass the page cache. `AK_PREALLOC_MB` reserves the space of the file
+         * beforehand.
+         */
+        class AsyncFileIO final {
+          public:
+            explicit AsyncFileIO() = default;
+
+            virtual ~AsyncFileIO() { this->close(); }
+
+            static bool enabled(void);
+
+            // false for the muxers which may read the file back
+            static bool supports(const AVOutputFormat* oformat);
+
+            bool open(const std::string& fname);
+
+            // writes out all the blocks, and returns false when any of the writes failed
+            bool close(void);
+
+            AVIOContext* avio(void) const { return m_avio; }
+
+          private:
+            struct Block {
+                uint8_t* data = nullptr;
+                size_t size = 0;
+                int64_t offset = 0;
+            };
+
+            static int write_packet(void* opaque, uint8_t* buf, int buf_size);
+
+            static int64_t seek(void* opaque, int64_t offset, int whence);
+
+            static void writer_thread(AsyncFileIO* io);
+
+            // blocks while all the blocks are in flight
+            bool acquire_block(void);
+
+            void submit_block(void);
+
+            // blocks until all the blocks submitted are written
+            void drain(void);
+
+            bool write_block(const Block& block);
+
+          private:
+            AVIOContext* m_avio = nullptr;
+            int m_fd = -1;
+            // O_DIRECT, or -1
+            int m_direct_fd = -1;
+            bool m_preallocated = false;
+
+            // the block being filled, on the muxer thread
+            Block m_block;
+            int64_t m_pos = 0;
+            int64_t m_size = 0;
+
+            std::thread* m_th = nullptr;
+            std::mutex m_mtx;
+            std::condition_variable m_cv;
+            std::deque<Block> m_queue;
+            std::vector<uint8_t*> m_free_blocks;
+            size_t m_nb_blocks = 0;
+            // a block is being written by the writer thread
+            bool m_writing = false;
+            bool m_closing = false;
+            // errno of the failed write, or 0
+            std::atomic<int> m_err = 0;
+        };
+
+    }
+}
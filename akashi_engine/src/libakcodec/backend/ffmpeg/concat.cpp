@@ -0,0 +1,211 @@
+#include "./concat.h"
+
+#include "./error.h"
+#include "./option.h"
+#include "./input_stream.h"
+#include "./stream_copy.h"
+#include "../../encode_item.h"
+
+#include <libakcore/error.h>
+#include <libakcore/logger.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+}
+
+#include <algorithm>
+#include <string>
+
+namespace akashi {
+    namespace codec::priv {
+
+        class SegmentMuxer final {
+          public:
+            explicit SegmentMuxer() = default;
+
+            virtual ~SegmentMuxer() {
+                if (m_pkt) {
+                    av_packet_free(&m_pkt);
+                }
+                if (m_ofmt_ctx) {
+                    if (m_ofmt_ctx->pb) {
+                        if (auto err = avio_closep(&m_ofmt_ctx->pb); err < 0) {
+                            AKLOG_WARN("avio_close failed, ret={}", av_err2str(err));
+                        }
+                    }
+                    avformat_free_context(m_ofmt_ctx);
+                    m_ofmt_ctx = nullptr;
+                }
+            }
+
+            bool mux(const ConcatArg& concat_arg) {
+                if (concat_arg.video_fnames.empty()) {
+                    AKLOG_ERRORN("No segments found");
+                    return false;
+                }
+                m_pkt = av_packet_alloc();
+                if (!m_pkt) {
+                    AKLOG_ERRORN("av_packet_alloc() failed");
+                    return false;
+                }
+                if (auto err = avformat_alloc_output_context2(&m_ofmt_ctx, nullptr, nullptr,
+                                                              concat_arg.out_fname.c_str());
+                    err < 0) {
+                    AKLOG_ERROR("avformat_alloc_output_context2() failed, ret={}",
+                                av_err2str(err));
+                    return false;
+                }
+
+                // the segments share the parameters of the first one
+                {
+                    InputStream video;
+                    if (!video.open(concat_arg.video_fnames[0], AVMEDIA_TYPE_VIDEO)) {
+                        return false;
+                    }
+                    CHECK_AK_ERROR2(this->add_stream(&m_video_stream, video.stream()));
+                }
+                InputStream audio;
+                if (concat_arg.audio_fname != "") {
+                    if (!audio.open(concat_arg.audio_fname, AVMEDIA_TYPE_AUDIO)) {
+                        return false;
+                    }
+                    CHECK_AK_ERROR2(this->add_stream(&m_audio_stream, audio.stream()));
+                }
+
+                if (auto err =
+                        avio_open(&m_ofmt_ctx->pb, concat_arg.out_fname.c_str(), AVIO_FLAG_WRITE);
+                    err < 0) {
+                    AKLOG_ERROR("avio_open() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                {
+                    FFOption format_opts;
+                    if (!format_opts.parse(concat_arg.format_opts)) {
+                        return false;
+                    }
+                    if (auto err = avformat_write_header(m_ofmt_ctx, format_opts.addr());
+                        err < 0) {
+                        AKLOG_ERROR("avformat_write_header() failed, ret={}", av_err2str(err));
+                        return false;
+                    }
+                    format_opts.validate();
+                }
+
+                // the audio is read along with the video, so that the muxer does not have to
+                // buffer either of them
+                AVPacket* apkt = av_packet_alloc();
+                bool has_apkt = m_audio_stream && apkt && audio.read(apkt);
+                bool success = true;
+
+                const auto video_time_base = m_video_stream->time_base;
+                for (const auto& fname : concat_arg.video_fnames) {
+                    InputStream video;
+                    if (!video.open(fname, AVMEDIA_TYPE_VIDEO)) {
+                        success = false;
+                        break;
+                    }
+                    // each segment starts where the previous one ends, whatever timestamps it
+                    // was encoded with
+                    m_video_ts.start_run(m_video_ts.end());
+                    const auto frame_duration = this->frame_duration(video.stream());
+                    while (success && video.read(m_pkt)) {
+                        av_packet_rescale_ts(m_pkt, video.stream()->time_base, video_time_base);
+                        m_video_ts.shift(m_pkt, frame_duration);
+                        while (has_apkt && av_compare_ts(packet_ts(apkt), audio.stream()->time_base,
+                                                         packet_ts(m_pkt), video_time_base) <= 0) {
+                            success =
+                                this->write(apkt, audio.stream()->time_base, m_audio_stream);
+                            has_apkt = success && audio.read(apkt);
+                        }
+                        success = success && this->write(m_pkt, video_time_base, m_video_stream);
+                    }
+                    if (!success) {
+                        break;
+                    }
+                }
+                while (success && has_apkt) {
+                    success = this->write(apkt, audio.stream()->time_base, m_audio_stream);
+                    has_apkt = success && audio.read(apkt);
+                }
+                av_packet_free(&apkt);
+                CHECK_AK_ERROR2(success);
+
+                if (auto err = av_write_trailer(m_ofmt_ctx); err < 0) {
+                    AKLOG_ERROR("av_write_trailer() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                return true;
+            }
+
+          private:
+            static int64_t packet_ts(const AVPacket* pkt) {
+                return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+            }
+
+            bool add_stream(AVStream** ostream, const AVStream* istream) {
+                *ostream = avformat_new_stream(m_ofmt_ctx, nullptr);
+                if (!*ostream) {
+                    AKLOG_ERRORN("avformat_new_stream() failed");
+                    return false;
+                }
+                if (auto err = avcodec_parameters_copy((*ostream)->codecpar, istream->codecpar);
+                    err < 0) {
+                    AKLOG_ERROR("avcodec_parameters_copy() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                // the tag of the intermediate container may be invalid for the output one
+                (*ostream)->codecpar->codec_tag = 0;
+                (*ostream)->time_base = istream->time_base;
+                return true;
+            }
+
+            // in the time base of the output stream
+            int64_t frame_duration(const AVStream* istream) const {
+                auto frame_rate = istream->avg_frame_rate;
+                if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+                    frame_rate = istream->r_frame_rate;
+                }
+                if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+                    return 1;
+                }
+                return std::max<int64_t>(
+                    av_rescale_q(1, av_inv_q(frame_rate), m_video_stream->time_base), 1);
+            }
+
+            bool write(AVPacket* pkt, const AVRational& time_base, AVStream* ostream) {
+                av_packet_rescale_ts(pkt, time_base, ostream->time_base);
+                pkt->stream_index = ostream->index;
+                pkt->pos = -1;
+
+                if (auto err = av_interleaved_write_frame(m_ofmt_ctx, pkt); err < 0) {
+                    AKLOG_ERROR("av_interleaved_write_frame() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                return true;
+            }
+
+          private:
+            AVFormatContext* m_ofmt_ctx = nullptr;
+            AVStream* m_video_stream = nullptr;
+            AVStream* m_audio_stream = nullptr;
+            AVPacket* m_pkt = nullptr;
+            // in the time base of the output video stream
+            RunTimestamps m_video_ts;
+        };
+
+    }
+
+    namespace codec {
+
+        bool ff_concat_segments(const ConcatArg& concat_arg) {
+            AKLOG_INFO("Concatenating {} segments into {}", concat_arg.video_fnames.size(),
+                       concat_arg.out_fname.c_str());
+            priv::SegmentMuxer muxer;
+            return muxer.mux(concat_arg);
+        }
+
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace akashi {
+    namespace codec {
+
+        struct ConcatArg;
+
+        bool ff_concat_segments(const ConcatArg& concat_arg);
+
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "./error.h"
+
+#include <libakcore/logger.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <string>
+
+namespace akashi {
+    namespace codec::priv {
+
+        // reads the packets of the first stream of a type
+        class InputStream final {
+          public:
+            explicit InputStream() = default;
+
+            virtual ~InputStream() {
+                if (m_ifmt_ctx) {
+                    avformat_close_input(&m_ifmt_ctx);
+                    m_ifmt_ctx = nullptr;
+                }
+            }
+
+            bool open(const std::string& fname, AVMediaType type) {
+                if (auto err = avformat_open_input(&m_ifmt_ctx, fname.c_str(), nullptr, nullptr);
+                    err < 0) {
+                    AKLOG_ERROR("avformat_open_input() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                if (auto err = avformat_find_stream_info(m_ifmt_ctx, nullptr); err < 0) {
+                    AKLOG_ERROR("avformat_find_stream_info() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                m_stream_index = av_find_best_stream(m_ifmt_ctx, type, -1, -1, nullptr, 0);
+                if (m_stream_index < 0) {
+                    AKLOG_ERROR("No {} stream found in {}", av_get_media_type_string(type),
+                                fname.c_str());
+                    return false;
+                }
+                return true;
+            }
+
+            // moves to the keyframe at or before `ts`, in the time base of the stream
+            bool seek(int64_t ts) {
+                if (auto err =
+                        av_seek_frame(m_ifmt_ctx, m_stream_index, ts, AVSEEK_FLAG_BACKWARD);
+                    err < 0) {
+                    AKLOG_ERROR("av_seek_frame() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                return true;
+            }
+
+            // returns false at the end of the stream
+            bool read(AVPacket* pkt) {
+                while (av_read_frame(m_ifmt_ctx, pkt) >= 0) {
+                    if (pkt->stream_index == m_stream_index) {
+                        return true;
+                    }
+                    av_packet_unref(pkt);
+                }
+                return false;
+            }
+
+            AVStream* stream() const { return m_ifmt_ctx->streams[m_stream_index]; }
+
+            // the start time of the input, in the time base of the stream
+            int64_t start_ts() const {
+                if (m_ifmt_ctx->start_time == AV_NOPTS_VALUE) {
+                    return 0;
+                }
+                return av_rescale_q(m_ifmt_ctx->start_time, AV_TIME_BASE_Q,
+                                    this->stream()->time_base);
+            }
+
+          private:
+            AVFormatContext* m_ifmt_ctx = nullptr;
+            int m_stream_index = -1;
+        };
+
+    }
+}
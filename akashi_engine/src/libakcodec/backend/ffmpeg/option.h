@@ -0,0 +1,59 @@
+#pragma once
+
+#include "./error.h"
+
+#include <libakcore/logger.h>
+
+extern "C" {
+#include <libavutil/dict.h>
+}
+
+#include <string>
+
+namespace akashi {
+    namespace codec::priv {
+
+        class FFOption final {
+          public:
+            explicit FFOption() = default;
+
+            virtual ~FFOption() {
+                if (m_opts) {
+                    av_dict_free(&m_opts);
+                    m_opts = nullptr;
+                }
+            }
+
+            bool parse(const std::string& option_str) {
+                if (auto err = av_dict_parse_string(&m_opts, option_str.c_str(), "=", " ", 0);
+                    err < 0) {
+                    AKLOG_ERROR("av_dict_parse_string() failed, ret={}", av_err2str(err));
+                    return false;
+                }
+                return true;
+            }
+
+            void validate() {
+                if (m_opts && av_dict_count(m_opts) > 0) {
+                    char* format_bufstr = nullptr;
+                    if (av_dict_get_string(m_opts, &format_bufstr, '=', ',') >= 0) {
+                        AKLOG_WARN("Not handled format options found => {}\n", format_bufstr);
+                    }
+                    av_free(format_bufstr);
+                }
+            }
+
+            AVDictionary** addr() {
+                if (m_opts) {
+                    return &m_opts;
+                } else {
+                    return nullptr;
+                }
+            }
+
+          private:
+            AVDictionary* m_opts = nullptr;
+        };
+
+    }
+}
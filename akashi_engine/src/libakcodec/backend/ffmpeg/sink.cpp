@@ -3,8 +3,13 @@
 #include "./error.h"
 #include "./utils.h"
 #include "./hwaccel.h"
+#include "./option.h"
+#include "./async_io.h"
+#include "./input_stream.h"
+#include "./stream_copy.h"
 #include "../../encode_item.h"
 
+#include <libakcore/error.h>
 #include <libakcore/logger.h>
 #include <libakstate/akstate.h>
 #include <libakbuffer/hwframe.h>
@@ -12,6 +17,7 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
 #include <libavformat/avformat.h>
 #include <libavutil/avutil.h>
 #include <libavutil/imgutils.h>
@@ -23,6 +29,9 @@ extern "C" {
 
 #include <va/va_str.h>
 
+#include <cstdlib>
+#include <cstring>
+
 using namespace akashi::core;
 
 namespace akashi {
@@ -74,65 +83,33 @@ namespace akashi {
 
     }
 
-    namespace codec::priv {
-
-        class FFOption final {
-          public:
-            explicit FFOption() = default;
-
-            virtual ~FFOption() {
-                if (m_opts) {
-                    av_dict_free(&m_opts);
-                    m_opts = nullptr;
-                }
-            }
-
-            bool parse(const std::string& option_str) {
-                if (auto err = av_dict_parse_string(&m_opts, option_str.c_str(), "=", " ", 0);
-                    err < 0) {
-                    AKLOG_ERROR("av_dict_parse_string() failed, ret={}", av_err2str(err));
-                    return false;
-                }
-                return true;
-            }
-
-            void validate() {
-                if (m_opts && av_dict_count(m_opts) > 0) {
-                    char* format_bufstr = nullptr;
-                    if (av_dict_get_string(m_opts, &format_bufstr, '=', ',') >= 0) {
-                        AKLOG_WARN("Not handled format options found => {}\n", format_bufstr);
-                    }
-                    av_free(format_bufstr);
-                }
-            }
+    namespace codec {
 
-            AVDictionary** addr() {
-                if (m_opts) {
-                    return &m_opts;
-                } else {
-                    return nullptr;
-                }
+        FFFrameSink::FFFrameSink(core::borrowed_ptr<state::AKState> state)
+            : FrameSink(state), m_state(state), m_encode_conf(state->m_encode_conf) {
+            m_encode_method = m_encode_conf.encode_method;
+            {
+                std::lock_guard<std::mutex> lock(m_state->m_prop_mtx);
+                m_src_width = m_state->m_prop.video_width;
+                m_src_height = m_state->m_prop.video_height;
             }
-
-          private:
-            AVDictionary* m_opts = nullptr;
+            m_width = m_src_width;
+            m_height = m_src_height;
         };
 
-    }
-
-    namespace codec {
-
-        FFFrameSink::FFFrameSink(core::borrowed_ptr<state::AKState> state)
-            : FrameSink(state), m_state(state) {
-            m_encode_method = m_state->m_encode_conf.encode_method;
+        FFFrameSink::FFFrameSink(core::borrowed_ptr<state::AKState> state,
+                                 const core::EncodeConf& encode_conf, int width, int height)
+            : FFFrameSink(state) {
+            m_encode_conf = encode_conf;
+            m_encode_method = m_encode_conf.encode_method;
+            m_width = width;
+            m_height = height;
         };
 
         FFFrameSink::~FFFrameSink() {
             // video stream
             if (m_video_stream.enc_ctx) {
-                if (!m_encoder_flushed) {
-                    this->flush_encoder(buffer::AVBufferType::VIDEO);
-                }
+                this->flush_encoder(buffer::AVBufferType::VIDEO);
                 if (m_video_stream.sws_ctx) {
                     sws_freeContext(m_video_stream.sws_ctx);
                     m_video_stream.sws_ctx = nullptr;
@@ -143,16 +120,17 @@ namespace akashi {
             }
             // audio stream
             if (m_audio_stream.enc_ctx) {
-                if (!m_encoder_flushed) {
-                    this->flush_encoder(buffer::AVBufferType::AUDIO);
-                }
+                this->flush_encoder(buffer::AVBufferType::AUDIO);
                 avcodec_free_context(&m_audio_stream.enc_ctx);
                 m_audio_stream.enc_ctx = nullptr;
                 m_audio_stream.enc_stream = nullptr;
             }
-            m_encoder_flushed = true;
             // ofmt
             if (m_ofmt_ctx) {
+                // owned by m_async_io
+                if (m_async_io) {
+                    m_ofmt_ctx->pb = nullptr;
+                }
                 if (m_ofmt_ctx->pb) {
                     if (auto err = avio_closep(&m_ofmt_ctx->pb); err < 0) {
                         AKLOG_WARN("avio_close failed, ret={}", av_err2str(err));
@@ -161,6 +139,7 @@ namespace akashi {
                 avformat_close_input(&m_ofmt_ctx);
                 m_ofmt_ctx = nullptr;
             }
+            m_async_io.reset();
             if (m_hw_device_ctx != nullptr) {
                 av_buffer_unref(&m_hw_device_ctx);
                 m_hw_device_ctx = nullptr;
@@ -170,7 +149,7 @@ namespace akashi {
         bool FFFrameSink::open(void) {
             // av_log_set_level(AV_LOG_VERBOSE);
 
-            auto out_fname = m_state->m_encode_conf.out_fname;
+            auto out_fname = m_encode_conf.out_fname;
             if (auto err = avformat_alloc_output_context2(&m_ofmt_ctx, nullptr, nullptr,
                                                           out_fname.c_str());
                 err < 0) {
@@ -186,23 +165,35 @@ namespace akashi {
             show_hwdevice_info(m_hw_device_ctx, hwaccel::safe_map(m_encode_method));
 
             // init streams
-            if (m_state->m_encode_conf.video_codec != "" && !this->init_video_stream()) {
+            if (m_encode_conf.video_codec != "" && !this->init_video_stream()) {
                 return false;
             }
-            if (m_state->m_encode_conf.audio_codec != "" && !this->init_audio_stream()) {
+            if (m_encode_conf.audio_codec != "" && !this->init_audio_stream()) {
                 return false;
             }
 
             // init io
-            if (auto err = avio_open(&m_ofmt_ctx->pb, out_fname.c_str(), AVIO_FLAG_WRITE);
-                err < 0) {
+            // the local files are written on another thread, so that the encoder does not wait
+            // for the disk, unless the muxer reads the file back
+            const char* protocol = avio_find_protocol_name(out_fname.c_str());
+            if (priv::AsyncFileIO::enabled() && protocol && std::strcmp(protocol, "file") == 0 &&
+                !(m_ofmt_ctx->oformat->flags & AVFMT_NOFILE) &&
+                priv::AsyncFileIO::supports(m_ofmt_ctx->oformat)) {
+                m_async_io = make_owned<priv::AsyncFileIO>();
+                if (!m_async_io->open(out_fname)) {
+                    return false;
+                }
+                m_ofmt_ctx->pb = m_async_io->avio();
+                m_ofmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            } else if (auto err = avio_open(&m_ofmt_ctx->pb, out_fname.c_str(), AVIO_FLAG_WRITE);
+                       err < 0) {
                 AKLOG_ERROR("avio_open() failed, ret={}", av_err2str(err));
                 return false;
             }
 
             {
                 priv::FFOption format_opts;
-                if (!format_opts.parse(m_state->m_encode_conf.ffmpeg_format_opts)) {
+                if (!format_opts.parse(m_encode_conf.ffmpeg_format_opts)) {
                     return false;
                 }
 
@@ -217,21 +208,37 @@ namespace akashi {
         }
 
         bool FFFrameSink::close(void) {
-            if (m_video_stream.enc_ctx && !m_encoder_flushed) {
-                this->flush_encoder(buffer::AVBufferType::VIDEO);
-            }
-            if (m_audio_stream.enc_ctx && !m_encoder_flushed) {
-                this->flush_encoder(buffer::AVBufferType::AUDIO);
-            }
-            m_encoder_flushed = true;
-            m_can_flush = false;
+            this->flush_encoder(buffer::AVBufferType::VIDEO);
+            this->flush_encoder(buffer::AVBufferType::AUDIO);
             if (m_ofmt_ctx) {
                 av_write_trailer(m_ofmt_ctx);
             }
+            if (m_async_io) {
+                m_ofmt_ctx->pb = nullptr;
+                if (!m_async_io->close()) {
+                    return false;
+                }
+            }
             return true;
         }
 
         EncodeResultCode FFFrameSink::send(const EncodeArg& encode_arg) {
+            if (auto stream = this->encode_stream(encode_arg.type); stream) {
+                if (stream->state == EncodeState::DRAINING ||
+                    stream->state == EncodeState::DRAINED) {
+                    AKLOG_ERROR("Frame (type: {}) sent to the flushed encoder", encode_arg.type);
+                    return EncodeResultCode::ERROR;
+                }
+                // the previous encoder has been flushed before the copied packets
+                if (stream->state == EncodeState::COPYING) {
+                    avcodec_free_context(&m_video_stream.enc_ctx);
+                    if (!this->open_video_encoder()) {
+                        return EncodeResultCode::ERROR;
+                    }
+                    stream->state = EncodeState::IDLE;
+                }
+            }
+
             // init avframe
             AVFrame* frame = nullptr;
             AVCodecContext* enc_ctx = nullptr;
@@ -327,7 +334,10 @@ namespace akashi {
 
             // send_frame
             if (auto err = avcodec_send_frame(enc_ctx, proxy_frame); err < 0) {
-                av_frame_free(&frame);
+                // the frame of a hwframe is kept for the retry
+                if (!encode_arg.hwframe) {
+                    av_frame_free(&proxy_frame);
+                }
                 if (err == AVERROR(EAGAIN)) {
                     return EncodeResultCode::SEND_EAGAIN;
                 } else {
@@ -335,7 +345,7 @@ namespace akashi {
                     return EncodeResultCode::ERROR;
                 }
             }
-            m_can_flush = true;
+            this->encode_stream(encode_arg.type)->state = EncodeState::ENCODING;
 
             if (proxy_frame) {
                 av_frame_free(&proxy_frame);
@@ -347,26 +357,17 @@ namespace akashi {
         EncodeWriteResult FFFrameSink::write(const EncodeWriteArg& write_arg) {
             AVPacket* pkt = av_packet_alloc();
             EncodeResultCode result = EncodeResultCode::NONE;
+            EncodeStream* stream = this->encode_stream(write_arg.type);
             AVCodecContext* enc_ctx = nullptr;
             AVStream* enc_stream = nullptr;
 
-            switch (write_arg.type) {
-                case buffer::AVBufferType::VIDEO: {
-                    enc_ctx = m_video_stream.enc_ctx;
-                    enc_stream = m_video_stream.enc_stream;
-                    break;
-                }
-                case buffer::AVBufferType::AUDIO: {
-                    enc_ctx = m_audio_stream.enc_ctx;
-                    enc_stream = m_audio_stream.enc_stream;
-                    break;
-                }
-                default: {
-                    AKLOG_ERROR("Invalid type found, {}", write_arg.type);
-                    result = EncodeResultCode::ERROR;
-                    goto exit;
-                }
+            if (!stream) {
+                AKLOG_ERROR("Invalid type found, {}", write_arg.type);
+                result = EncodeResultCode::ERROR;
+                goto exit;
             }
+            enc_ctx = stream->enc_ctx;
+            enc_stream = stream->enc_stream;
 
             // recv pkt and write it to file
             {
@@ -375,6 +376,7 @@ namespace akashi {
                     result = EncodeResultCode::RECV_EAGAIN;
                     goto exit;
                 } else if (err == AVERROR_EOF) {
+                    stream->state = EncodeState::DRAINED;
                     result = EncodeResultCode::RECV_EOF;
                     goto exit;
                 } else if (err < 0) {
@@ -383,16 +385,18 @@ namespace akashi {
                     goto exit;
                 }
 
-                pkt->stream_index = enc_stream->index;
                 av_packet_rescale_ts(pkt, enc_ctx->time_base, enc_stream->time_base);
 
                 auto pkt_pts = Rational(pkt->pts) * to_rational(enc_stream->time_base);
 
-                if (auto err = av_interleaved_write_frame(m_ofmt_ctx, pkt); err < 0) {
-                    AKLOG_ERROR("av_interleaved_write_frame() failed, ret={}", av_err2str(err));
-                    // break or return?
+                if (stream->needs_param_sets && (pkt->flags & AV_PKT_FLAG_KEY)) {
+                    prepend_to_packet(pkt, enc_ctx->extradata, enc_ctx->extradata_size);
+                    stream->needs_param_sets = false;
                 }
 
+                // break or return?
+                this->write_packet(pkt, *stream);
+
                 AKLOG_WARN("Frame (type: {}, pts: {}) written", write_arg.type,
                            pkt_pts.to_decimal());
 
@@ -409,6 +413,11 @@ namespace akashi {
             return {.result = result};
         }
 
+        bool FFFrameSink::has_stream(const buffer::AVBufferType& type) {
+            auto stream = this->encode_stream(type);
+            return stream && stream->enc_ctx;
+        }
+
         size_t FFFrameSink::nb_samples_per_frame(void) {
             if (m_audio_stream.enc_ctx) {
                 return m_audio_stream.enc_ctx->frame_size;
@@ -438,10 +447,10 @@ namespace akashi {
         core::AKAudioSampleFormat
         FFFrameSink::validate_audio_format(const core::AKAudioSampleFormat& sample_format) {
             // find codec
-            auto codec = avcodec_find_encoder_by_name(m_state->m_encode_conf.audio_codec.c_str());
+            auto codec = avcodec_find_encoder_by_name(m_encode_conf.audio_codec.c_str());
             if (!codec) {
                 AKLOG_ERROR("avcodec_find_encoder_by_name() failed, codec_name: {}",
-                            m_state->m_encode_conf.audio_codec.c_str());
+                            m_encode_conf.audio_codec.c_str());
                 return core::AKAudioSampleFormat::NONE;
             }
 
@@ -520,11 +529,40 @@ namespace akashi {
         }
 
         bool FFFrameSink::init_video_stream() {
+            if (!this->open_video_encoder()) {
+                return false;
+            }
+            auto enc_ctx = m_video_stream.enc_ctx;
+
+            // init stream
+            m_video_stream.enc_stream = avformat_new_stream(m_ofmt_ctx, enc_ctx->codec);
+            if (!m_video_stream.enc_stream) {
+                AKLOG_ERRORN("avformat_new_stream() failed");
+                return false;
+            }
+
+            if (auto err =
+                    avcodec_parameters_from_context(m_video_stream.enc_stream->codecpar, enc_ctx);
+                err < 0) {
+                AKLOG_ERROR("avcodec_parameters_from_context() failed, ret={}", av_err2str(err));
+                return false;
+            }
+
+            if (m_encode_method != VideoEncodeMethod::VAAPI) {
+                if (!this->init_sws_context(AV_PIX_FMT_RGB24)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool FFFrameSink::open_video_encoder() {
             // find codec
-            auto codec = avcodec_find_encoder_by_name(m_state->m_encode_conf.video_codec.c_str());
+            auto codec = avcodec_find_encoder_by_name(m_encode_conf.video_codec.c_str());
             if (!codec) {
                 AKLOG_ERROR("avcodec_find_encoder_by_name() failed, codec_name: {}",
-                            m_state->m_encode_conf.video_codec.c_str());
+                            m_encode_conf.video_codec.c_str());
                 return false;
             }
 
@@ -539,8 +577,8 @@ namespace akashi {
             // codec ctx settings
             {
                 std::lock_guard<std::mutex> lock(m_state->m_prop_mtx);
-                enc_ctx->width = m_state->m_prop.video_width;
-                enc_ctx->height = m_state->m_prop.video_height;
+                enc_ctx->width = m_width;
+                enc_ctx->height = m_height;
                 enc_ctx->time_base = to_av_rational(Rational(1l) / m_state->m_prop.fps);
                 enc_ctx->framerate = to_av_rational(m_state->m_prop.fps);
                 enc_ctx->colorspace = AVColorSpace::AVCOL_SPC_BT709;
@@ -614,7 +652,7 @@ namespace akashi {
 
             {
                 priv::FFOption codec_opts;
-                if (!codec_opts.parse(m_state->m_encode_conf.video_ffmpeg_codec_opts)) {
+                if (!codec_opts.parse(m_encode_conf.video_ffmpeg_codec_opts)) {
                     return false;
                 }
 
@@ -626,61 +664,74 @@ namespace akashi {
                 codec_opts.validate();
             }
 
-            // init stream
-            m_video_stream.enc_stream = avformat_new_stream(m_ofmt_ctx, codec);
-            if (!m_video_stream.enc_stream) {
-                AKLOG_ERRORN("avformat_new_stream() failed");
+            return true;
+        }
+
+        int FFFrameSink::video_frame_pixfmt() const {
+            return m_encode_method == VideoEncodeMethod::VAAPI_COPY
+                       ? AV_PIX_FMT_NV12
+                       : m_video_stream.enc_ctx->pix_fmt;
+        }
+
+        bool FFFrameSink::init_sws_context(int src_pixfmt) {
+            auto enc_ctx = m_video_stream.enc_ctx;
+
+            // reuses the current context when the parameters are the same
+            // clang-format off
+            m_video_stream.sws_ctx = sws_getCachedContext(m_video_stream.sws_ctx,
+                // src
+                m_src_width, m_src_height, (AVPixelFormat)src_pixfmt,
+                // dst
+                enc_ctx->width, enc_ctx->height, (AVPixelFormat)this->video_frame_pixfmt(),
+                // flags
+                SWS_BICUBIC | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, // SWS_LANCZOS | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND,
+                // options
+                nullptr, nullptr, nullptr
+            );
+            // clang-format on
+            if (!m_video_stream.sws_ctx) {
+                AKLOG_ERRORN("sws_getCashedContext() failed");
                 return false;
             }
+            m_video_stream.sws_src_pixfmt = src_pixfmt;
 
-            if (auto err =
-                    avcodec_parameters_from_context(m_video_stream.enc_stream->codecpar, enc_ctx);
+            // NB: This operation is really important for handling colorspace issues properly
+            // The frames in NV12 are already in BT.709 limited range
+            const bool src_is_rgb = src_pixfmt == AV_PIX_FMT_RGB24;
+            if (auto err = sws_setColorspaceDetails(
+                    m_video_stream.sws_ctx,
+                    sws_getCoefficients(src_is_rgb ? SWS_CS_DEFAULT : SWS_CS_ITU709),
+                    src_is_rgb ? 1 : 0, sws_getCoefficients(SWS_CS_ITU709), 0, 0, (1 << 16),
+                    (1 << 16));
                 err < 0) {
-                AKLOG_ERROR("avcodec_parameters_from_context() failed, ret={}", av_err2str(err));
-                return false;
+                AKLOG_ERRORN("sws_setColorspaceDetails() failed");
             }
+            return true;
+        }
 
-            if (m_encode_method != VideoEncodeMethod::VAAPI) {
-                auto dst_pixfmt = m_encode_method == VideoEncodeMethod::VAAPI_COPY
-                                      ? AV_PIX_FMT_NV12
-                                      : enc_ctx->pix_fmt;
-
-                // init sws ctx
-                // clang-format off
-                m_video_stream.sws_ctx = sws_getCachedContext(nullptr,
-                    // src
-                    enc_ctx->width, enc_ctx->height, AV_PIX_FMT_RGB24,
-                    // dst
-                    enc_ctx->width, enc_ctx->height, dst_pixfmt,
-                    // flags
-                    SWS_BICUBIC | SWS_FULL_CHR_H_INP | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND, // SWS_LANCZOS | SWS_FULL_CHR_H_INT | SWS_ACCURATE_RND,
-                    // options
-                    nullptr, nullptr, nullptr
-                );
-                // clang-format on
-                if (!m_video_stream.sws_ctx) {
-                    AKLOG_ERRORN("sws_getCashedContext() failed");
-                    return false;
-                }
-
-                // NB: This operation is really important for handling colorspace issues properly
-                if (auto err = sws_setColorspaceDetails(
-                        m_video_stream.sws_ctx, sws_getCoefficients(SWS_CS_DEFAULT), 1,
-                        sws_getCoefficients(SWS_CS_ITU709), 0, 0, (1 << 16), (1 << 16));
-                    err < 0) {
-                    AKLOG_ERRORN("sws_setColorspaceDetails() failed");
-                }
+        core::VideoBufferFormat FFFrameSink::video_buffer_format(void) {
+            if (!m_video_stream.enc_ctx || m_encode_method == VideoEncodeMethod::VAAPI) {
+                return core::VideoBufferFormat::NONE;
             }
-
-            return true;
+            const char* env = std::getenv("AK_GPU_YUV");
+            if (env && std::strcmp(env, "0") == 0) {
+                return core::VideoBufferFormat::RGB24;
+            }
+            // the chroma planes are subsampled by 2x2 blocks on the GPU
+            const auto pixfmt = this->video_frame_pixfmt();
+            if ((pixfmt == AV_PIX_FMT_YUV420P || pixfmt == AV_PIX_FMT_NV12) &&
+                m_src_width % 2 == 0 && m_src_height % 2 == 0) {
+                return core::VideoBufferFormat::NV12;
+            }
+            return core::VideoBufferFormat::RGB24;
         }
 
         bool FFFrameSink::init_audio_stream() {
             // find codec
-            auto codec = avcodec_find_encoder_by_name(m_state->m_encode_conf.audio_codec.c_str());
+            auto codec = avcodec_find_encoder_by_name(m_encode_conf.audio_codec.c_str());
             if (!codec) {
                 AKLOG_ERROR("avcodec_find_encoder_by_name() failed, codec_name: {}",
-                            m_state->m_encode_conf.audio_codec.c_str());
+                            m_encode_conf.audio_codec.c_str());
                 return false;
             }
 
@@ -712,7 +763,7 @@ namespace akashi {
 
             {
                 priv::FFOption codec_opts;
-                if (!codec_opts.parse(m_state->m_encode_conf.audio_ffmpeg_codec_opts)) {
+                if (!codec_opts.parse(m_encode_conf.audio_ffmpeg_codec_opts)) {
                     return false;
                 }
 
@@ -803,13 +854,37 @@ namespace akashi {
         }
 
         bool FFFrameSink::populate_video_frame(AVFrame* frame, const EncodeArg& encode_arg) {
+            const int width = m_src_width;
+            const int height = m_src_height;
             uint8_t* src_slice[4] = {encode_arg.buffer.get(), 0, 0, 0};
-            int src_linesize[4] = {
-                av_image_get_linesize(AV_PIX_FMT_RGB24, m_video_stream.enc_ctx->width, 0), 0, 0, 0};
+            int src_linesize[4] = {0, 0, 0, 0};
+
+            int src_pixfmt = AV_PIX_FMT_RGB24;
+            if (encode_arg.video_format == core::VideoBufferFormat::NV12) {
+                src_pixfmt = AV_PIX_FMT_NV12;
+                src_slice[1] = encode_arg.buffer.get() + static_cast<size_t>(width) * height;
+                src_linesize[0] = width;
+                src_linesize[1] = width;
+            } else {
+                src_linesize[0] = av_image_get_linesize(AV_PIX_FMT_RGB24, width, 0);
+            }
+
+            if (src_pixfmt == this->video_frame_pixfmt() && width == m_width &&
+                height == m_height) {
+                av_image_copy(frame->data, frame->linesize, const_cast<const uint8_t**>(src_slice),
+                              src_linesize, (AVPixelFormat)src_pixfmt, width, height);
+                return true;
+            }
+
+            if (m_video_stream.sws_src_pixfmt != src_pixfmt) {
+                if (!this->init_sws_context(src_pixfmt)) {
+                    return false;
+                }
+            }
             // clang-format off
             sws_scale(m_video_stream.sws_ctx, 
               // src
-              src_slice, src_linesize, 0, m_video_stream.enc_ctx->height, 
+              src_slice, src_linesize, 0, height, 
               // dst
               frame->data, frame->linesize 
             );
@@ -828,53 +903,204 @@ namespace akashi {
             return true;
         }
 
+        EncodeStream* FFFrameSink::encode_stream(const buffer::AVBufferType& type) {
+            switch (type) {
+                case buffer::AVBufferType::VIDEO: {
+                    return &m_video_stream;
+                }
+                case buffer::AVBufferType::AUDIO: {
+                    return &m_audio_stream;
+                }
+                default: {
+                    return nullptr;
+                }
+            }
+        }
+
         void FFFrameSink::flush_encoder(const buffer::AVBufferType& type) {
-            if (!m_can_flush) {
-                AKLOG_INFON("flush skipped");
+            auto stream = this->encode_stream(type);
+            if (!stream || !stream->enc_ctx) {
                 return;
             }
 
-            AVCodecContext* enc_ctx;
-            switch (type) {
-                case buffer::AVBufferType::VIDEO: {
-                    enc_ctx = m_video_stream.enc_ctx;
+            switch (stream->state) {
+                case EncodeState::IDLE: {
+                    AKLOG_INFON("flush skipped");
+                    stream->state = EncodeState::DRAINED;
+                    return;
+                }
+                case EncodeState::ENCODING: {
+                    if (auto err = avcodec_send_frame(stream->enc_ctx, nullptr); err < 0) {
+                        AKLOG_ERROR("avcodec_send_frame() failed, ret={}", av_err2str(err));
+                        stream->state = EncodeState::DRAINED;
+                        return;
+                    }
+                    stream->state = EncodeState::DRAINING;
                     break;
                 }
-                case buffer::AVBufferType::AUDIO: {
-                    enc_ctx = m_audio_stream.enc_ctx;
+                case EncodeState::DRAINING: {
                     break;
                 }
-                default: {
-                    AKLOG_ERROR("Invalid type found, {}", type);
+                case EncodeState::DRAINED: {
+                    return;
+                }
+                case EncodeState::COPYING: {
+                    stream->state = EncodeState::DRAINED;
                     return;
                 }
             }
 
-            if (!enc_ctx) {
-                return;
+            // every packet left is returned without EAGAIN while draining
+            while (stream->state == EncodeState::DRAINING) {
+                auto write_result = this->write({type});
+                if (write_result.result == codec::EncodeResultCode::ERROR) {
+                    AKLOG_ERRORN("Encode error while flushing");
+                    stream->state = EncodeState::DRAINED;
+                    return;
+                }
             }
+            AKLOG_INFON("Successfully flushed the encoder");
+        }
 
-            if (auto err = avcodec_send_frame(enc_ctx, nullptr); err < 0) {
-                AKLOG_ERROR("avcodec_send_frame() failed, ret={}", av_err2str(err));
-                return;
+        bool FFFrameSink::write_packet(AVPacket* pkt, EncodeStream& stream) {
+            pkt->stream_index = stream.enc_stream->index;
+            if (auto err = av_interleaved_write_frame(m_ofmt_ctx, pkt); err < 0) {
+                AKLOG_ERROR("av_interleaved_write_frame() failed, ret={}", av_err2str(err));
+                return false;
             }
+            return true;
+        }
 
-            while (true) {
-                auto write_result = this->write({type});
-                switch (write_result.result) {
-                    case codec::EncodeResultCode::ERROR: {
-                        AKLOG_ERRORN("Encode error while flushing");
-                        return;
-                    }
-                    case codec::EncodeResultCode::RECV_EOF: {
-                        AKLOG_INFON("Successfully flushed the encoder");
-                        return;
+        std::vector<core::Rational> FFFrameSink::stream_copy_keyframes(const std::string& src) {
+            if (!m_video_stream.enc_ctx || m_encode_method != VideoEncodeMethod::SW) {
+                return {};
+            }
+            if (!allows_inband_param_sets(m_ofmt_ctx->oformat->name,
+                                          m_video_stream.enc_stream->codecpar->codec_tag)) {
+                AKLOG_INFO("The parameter sets of {} cannot be copied into {}", src.c_str(),
+                           m_ofmt_ctx->oformat->name);
+                return {};
+            }
+            return probe_stream_copy(src, m_video_stream.enc_ctx);
+        }
+
+        bool FFFrameSink::copy_packets(const StreamCopyArg& copy_arg) {
+            if (!m_video_stream.enc_ctx) {
+                AKLOG_ERRORN("AVCodecContext for video streams is null");
+                return false;
+            }
+            this->flush_encoder(buffer::AVBufferType::VIDEO);
+            m_video_stream.state = EncodeState::COPYING;
+
+            priv::InputStream input;
+            if (!input.open(copy_arg.src, AVMEDIA_TYPE_VIDEO)) {
+                return false;
+            }
+            const auto istream = input.stream();
+            const auto par = istream->codecpar;
+            const auto time_base = istream->time_base;
+            const auto out_time_base = m_video_stream.enc_stream->time_base;
+
+            const auto to_ts = [](const Rational& time, const AVRational& tb) {
+                return av_rescale_q(time.num(), {1, static_cast<int>(time.den())}, tb);
+            };
+            const int64_t begin_ts = input.start_ts() + to_ts(copy_arg.src_begin, time_base);
+            const int64_t end_ts = input.start_ts() + to_ts(copy_arg.src_end, time_base);
+            const int64_t half_frame =
+                av_rescale_q(1, av_inv_q(m_video_stream.enc_ctx->framerate), time_base) / 2;
+            const int64_t out_frame =
+                av_rescale_q(1, av_inv_q(m_video_stream.enc_ctx->framerate), out_time_base);
+            CHECK_AK_ERROR2(input.seek(begin_ts));
+
+            // the packets in mp4-like containers are converted to the Annex B format, with the
+            // parameter sets before the keyframes
+            AVBSFContext* bsf_ctx = nullptr;
+            const bool needs_bsf = par->extradata_size > 0 &&
+                                   !is_annexb(par->extradata, par->extradata_size);
+            if (needs_bsf) {
+                auto bsf = av_bsf_get_by_name(par->codec_id == AV_CODEC_ID_H264
+                                                  ? "h264_mp4toannexb"
+                                                  : "hevc_mp4toannexb");
+                if (!bsf || av_bsf_alloc(bsf, &bsf_ctx) < 0 ||
+                    avcodec_parameters_copy(bsf_ctx->par_in, par) < 0) {
+                    AKLOG_ERRORN("Failed to create a bitstream filter");
+                    av_bsf_free(&bsf_ctx);
+                    return false;
+                }
+                bsf_ctx->time_base_in = time_base;
+                if (auto err = av_bsf_init(bsf_ctx); err < 0) {
+                    AKLOG_ERROR("av_bsf_init() failed, ret={}", av_err2str(err));
+                    av_bsf_free(&bsf_ctx);
+                    return false;
+                }
+            }
+
+            // the copied packets are presented from the keyframe at the pts of the window
+            RunTimestamps run_ts;
+            run_ts.start_run(to_ts(copy_arg.pts, out_time_base));
+
+            // the pts of the first keyframe
+            int64_t first_ts = AV_NOPTS_VALUE;
+            size_t nb_packets = 0;
+            bool success = true;
+            const auto write_copied = [&](AVPacket* pkt) {
+                if (nb_packets++ == 0 && !needs_bsf &&
+                    !prepend_to_packet(pkt, par->extradata, par->extradata_size)) {
+                    return false;
+                }
+                av_packet_rescale_ts(pkt, time_base, out_time_base);
+                run_ts.shift(pkt, out_frame);
+                pkt->pos = -1;
+                return this->write_packet(pkt, m_video_stream);
+            };
+
+            AVPacket* pkt = av_packet_alloc();
+            while (success && pkt && input.read(pkt)) {
+                const bool is_key = pkt->flags & AV_PKT_FLAG_KEY;
+                // from the keyframe at the beginning in the decode order
+                if (first_ts == AV_NOPTS_VALUE) {
+                    if (!is_key || pkt->pts < begin_ts - half_frame) {
+                        av_packet_unref(pkt);
+                        continue;
                     }
-                    default: {
+                    if (pkt->pts > begin_ts + half_frame) {
+                        AKLOG_ERROR("Keyframe not found at {} in {}",
+                                    copy_arg.src_begin.to_decimal(), copy_arg.src.c_str());
+                        success = false;
                         break;
                     }
+                    first_ts = pkt->pts;
+                } else if (is_key && pkt->pts >= end_ts - half_frame) {
+                    // to right before the next keyframe
+                    av_packet_unref(pkt);
+                    break;
                 }
+
+                if (!bsf_ctx) {
+                    success = write_copied(pkt);
+                    continue;
+                }
+                if (auto err = av_bsf_send_packet(bsf_ctx, pkt); err < 0) {
+                    AKLOG_ERROR("av_bsf_send_packet() failed, ret={}", av_err2str(err));
+                    success = false;
+                    break;
+                }
+                while (success && av_bsf_receive_packet(bsf_ctx, pkt) == 0) {
+                    success = write_copied(pkt);
+                }
+            }
+            if (pkt) {
+                av_packet_free(&pkt);
+            }
+            av_bsf_free(&bsf_ctx);
+            CHECK_AK_ERROR2(success);
+
+            if (nb_packets == 0) {
+                AKLOG_ERROR("No packets copied from {}", copy_arg.src.c_str());
+                return false;
             }
+            m_video_stream.needs_param_sets = true;
+            return true;
         }
 
     }
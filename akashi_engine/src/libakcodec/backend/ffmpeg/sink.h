@@ -5,11 +5,15 @@
 
 #include <libakcore/memory.h>
 #include <libakcore/hw_accel.h>
+#include <libakcore/config.h>
+
+#include <cstdint>
 
 struct AVFormatContext;
 struct AVCodecContext;
 struct AVStream;
 struct AVFrame;
+struct AVPacket;
 struct AVBufferRef;
 struct SwsContext;
 struct SwrContext;
@@ -18,18 +22,38 @@ namespace akashi {
     namespace state {
         class AKState;
     }
+    namespace codec::priv {
+        class AsyncFileIO;
+    }
     namespace codec {
 
+        /**
+         * IDLE -> ENCODING on the first frame sent, ENCODING -> DRAINING on flush, and
+         * DRAINING -> DRAINED when the encoder has returned its last packet
+         *
+         * The video stream moves to COPYING when packets are copied into it after the flush,
+         * and back to IDLE with a new encoder on the next frame sent.
+         */
+        enum class EncodeState { IDLE = 0, ENCODING, DRAINING, DRAINED, COPYING };
+
         struct EncodeStream {
+            EncodeState state = EncodeState::IDLE;
             AVCodecContext* enc_ctx = nullptr;
             AVStream* enc_stream = nullptr;
             struct SwsContext* sws_ctx = nullptr;
+            int sws_src_pixfmt = -1;
+            // the parameter sets of the encoder are put before the next keyframe, since the
+            // copied packets may have overwritten them
+            bool needs_param_sets = false;
         };
 
         struct EncodeArg;
         class FFFrameSink : public FrameSink {
           public:
             explicit FFFrameSink(core::borrowed_ptr<state::AKState> state);
+            // an output of its own settings, scaled from the frames of the video
+            explicit FFFrameSink(core::borrowed_ptr<state::AKState> state,
+                                 const core::EncodeConf& encode_conf, int width, int height);
             virtual ~FFFrameSink();
 
             virtual bool open(void) override;
@@ -40,6 +64,8 @@ namespace akashi {
 
             virtual EncodeWriteResult write(const EncodeWriteArg& write_arg) override;
 
+            virtual bool has_stream(const buffer::AVBufferType& type) override;
+
             virtual size_t nb_samples_per_frame(void) override;
 
             virtual core::AKAudioSampleFormat
@@ -47,9 +73,23 @@ namespace akashi {
 
             virtual std::unique_ptr<buffer::HWFrame> create_hwframe(void) override;
 
+            virtual core::VideoBufferFormat video_buffer_format(void) override;
+
+            virtual std::vector<core::Rational>
+            stream_copy_keyframes(const std::string& src) override;
+
+            virtual bool copy_packets(const StreamCopyArg& copy_arg) override;
+
           private:
             bool init_video_stream();
 
+            bool open_video_encoder();
+
+            // the pixel format of the frames sent to the video encoder
+            int video_frame_pixfmt() const;
+
+            bool init_sws_context(int src_pixfmt);
+
             bool init_audio_stream();
 
             bool init_video_frame(AVFrame** frame, const EncodeArg& encode_arg);
@@ -60,20 +100,31 @@ namespace akashi {
 
             bool populate_audio_frame(AVFrame* frame, const EncodeArg& encode_arg);
 
+            EncodeStream* encode_stream(const buffer::AVBufferType& type);
+
             void flush_encoder(const buffer::AVBufferType& type);
 
+            bool write_packet(AVPacket* pkt, EncodeStream& stream);
+
           private:
             core::borrowed_ptr<state::AKState> m_state;
+            core::EncodeConf m_encode_conf;
             AVFormatContext* m_ofmt_ctx = nullptr;
+            // the output written on another thread, or null for the default I/O
+            core::owned_ptr<priv::AsyncFileIO> m_async_io;
+
+            // the size of the frames sent
+            int m_src_width = 0;
+            int m_src_height = 0;
+            // the size of the output
+            int m_width = 0;
+            int m_height = 0;
 
             AVBufferRef* m_hw_device_ctx = nullptr;
 
             EncodeStream m_video_stream;
             EncodeStream m_audio_stream;
 
-            bool m_encoder_flushed = false;
-            bool m_can_flush = false;
-
             core::VideoEncodeMethod m_encode_method = core::VideoEncodeMethod::NONE;
         };
     }
@@ -190,10 +190,17 @@ namespace akashi {
                 return core::Rational(0, 1);
             }
             core::Rational res_dts = core::Rational(INT32_MAX, 1);
+            core::Rational res_active_dts = core::Rational(INT32_MAX, 1);
+            bool has_active_stream = false;
             for (const auto& dec_stream : m_input_src.dec_streams) {
                 res_dts = std::min(dec_stream.cur_decode_pts, res_dts);
+                // inactive streams never advance, so they should not hold back the dts
+                if (dec_stream.is_active) {
+                    res_active_dts = std::min(dec_stream.cur_decode_pts, res_active_dts);
+                    has_active_stream = true;
+                }
             }
-            return res_dts;
+            return has_active_stream ? res_active_dts : res_dts;
         }
 
         const core::LayerProfile& FFLayerSource::layer_profile() const {
@@ -304,6 +311,11 @@ namespace akashi {
                             continue;
                         }
                     }
+                    if (media_type == AVMediaType::AVMEDIA_TYPE_AUDIO &&
+                        init_decode_arg.skip_audio) {
+                        m_input_src.dec_streams[i].is_active = false;
+                        continue;
+                    }
 
                     AVCodecID codec_id = format_ctx->streams[i]->codecpar->codec_id;
                     auto av_codec = avcodec_find_decoder(codec_id);
@@ -0,0 +1,236 @@
+#include "./stream_copy.h"
+
+#include "./error.h"
+#include "./utils.h"
+#include "./input_stream.h"
+
+#include <libakcore/logger.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+}
+
+#include <algorithm>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace codec {
+
+        bool is_annexb(const uint8_t* data, int size) {
+            return (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) ||
+                   (size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+        }
+
+        bool prepend_to_packet(AVPacket* pkt, const uint8_t* data, int size) {
+            if (size <= 0) {
+                return true;
+            }
+            const int pkt_size = pkt->size;
+            if (auto err = av_packet_make_writable(pkt); err < 0) {
+                AKLOG_ERROR("av_packet_make_writable() failed, ret={}", av_err2str(err));
+                return false;
+            }
+            if (auto err = av_grow_packet(pkt, size); err < 0) {
+                AKLOG_ERROR("av_grow_packet() failed, ret={}", av_err2str(err));
+                return false;
+            }
+            std::memmove(pkt->data + size, pkt->data, pkt_size);
+            std::memcpy(pkt->data, data, size);
+            return true;
+        }
+
+        static constexpr uint32_t fourcc(const char (&tag)[5]) {
+            return static_cast<uint32_t>(tag[0]) | (static_cast<uint32_t>(tag[1]) << 8) |
+                   (static_cast<uint32_t>(tag[2]) << 16) | (static_cast<uint32_t>(tag[3]) << 24);
+        }
+
+        bool allows_inband_param_sets(const std::string& format_name, uint32_t codec_tag) {
+            if (codec_tag == fourcc("avc3") || codec_tag == fourcc("hev1")) {
+                return true;
+            }
+            for (const auto name : {"matroska", "mpegts", "h264", "hevc"}) {
+                if (format_name == name) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int nal_length_size(const uint8_t* extradata, int size, bool hevc) {
+            // configurationVersion is 1 in both of avcC and hvcC
+            if (size < 7 || extradata[0] != 1) {
+                return 0;
+            }
+            if (!hevc) {
+                return (extradata[4] & 0x3) + 1;
+            }
+            return size >= 23 ? (extradata[21] & 0x3) + 1 : 0;
+        }
+
+        bool is_idr_packet(const uint8_t* data, int size, bool hevc, int nal_length_size) {
+            int pos = 0;
+            while (pos < size) {
+                // the range of the next NAL unit
+                int begin = 0;
+                int end = 0;
+                if (nal_length_size > 0) {
+                    if (pos + nal_length_size > size) {
+                        return false;
+                    }
+                    int64_t len = 0;
+                    for (int i = 0; i < nal_length_size; i++) {
+                        len = (len << 8) | data[pos + i];
+                    }
+                    begin = pos + nal_length_size;
+                    if (len > size - begin) {
+                        return false;
+                    }
+                    end = begin + static_cast<int>(len);
+                } else {
+                    while (pos + 3 <= size && !(data[pos] == 0 && data[pos + 1] == 0 &&
+                                                data[pos + 2] == 1)) {
+                        pos++;
+                    }
+                    if (pos + 3 > size) {
+                        return false;
+                    }
+                    begin = pos + 3;
+                    end = begin;
+                    while (end + 3 <= size &&
+                           !(data[end] == 0 && data[end + 1] == 0 && data[end + 2] <= 1)) {
+                        end++;
+                    }
+                    if (end + 3 > size) {
+                        end = size;
+                    }
+                }
+                pos = end;
+                if (begin >= end) {
+                    continue;
+                }
+
+                // decided by the first picture in the packet
+                if (!hevc) {
+                    const int type = data[begin] & 0x1f;
+                    if (1 <= type && type <= 5) {
+                        return type == 5;
+                    }
+                } else {
+                    const int type = (data[begin] >> 1) & 0x3f;
+                    if (type < 32) {
+                        return type == 19 || type == 20;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // the tags unspecified by the encoder are taken as BT.709, in which the frames are
+        // converted
+        template <class T>
+        static bool same_color_tag(T src, T out, T unspecified, T bt709) {
+            return src == (out == unspecified ? bt709 : out);
+        }
+
+        static bool same_color(const AVCodecParameters* par, const AVCodecContext* enc_ctx) {
+            return same_color_tag(par->color_primaries, enc_ctx->color_primaries,
+                                  AVCOL_PRI_UNSPECIFIED, AVCOL_PRI_BT709) &&
+                   same_color_tag(par->color_trc, enc_ctx->color_trc, AVCOL_TRC_UNSPECIFIED,
+                                  AVCOL_TRC_BT709) &&
+                   same_color_tag(par->color_space, enc_ctx->colorspace, AVCOL_SPC_UNSPECIFIED,
+                                  AVCOL_SPC_BT709) &&
+                   same_color_tag(par->color_range, enc_ctx->color_range, AVCOL_RANGE_UNSPECIFIED,
+                                  AVCOL_RANGE_MPEG);
+        }
+
+        void RunTimestamps::shift(AVPacket* pkt, int64_t default_duration) {
+            this->shift(&pkt->pts, &pkt->dts,
+                        pkt->duration > 0 ? pkt->duration : default_duration);
+        }
+
+        std::vector<core::Rational> probe_stream_copy(const std::string& src,
+                                                      const AVCodecContext* enc_ctx) {
+            // the parameter sets are put in the stream at the joints, which needs the Annex B
+            // format on the output
+            if ((enc_ctx->codec_id != AV_CODEC_ID_H264 && enc_ctx->codec_id != AV_CODEC_ID_HEVC) ||
+                (enc_ctx->extradata_size > 0 &&
+                 !is_annexb(enc_ctx->extradata, enc_ctx->extradata_size))) {
+                return {};
+            }
+
+            priv::InputStream input;
+            if (!input.open(src, AVMEDIA_TYPE_VIDEO)) {
+                return {};
+            }
+            const auto istream = input.stream();
+            const auto par = istream->codecpar;
+            if (par->codec_id != enc_ctx->codec_id || par->width != enc_ctx->width ||
+                par->height != enc_ctx->height || par->format != enc_ctx->pix_fmt ||
+                av_cmp_q(istream->avg_frame_rate, enc_ctx->framerate) != 0 ||
+                av_cmp_q(istream->r_frame_rate, enc_ctx->framerate) != 0) {
+                AKLOG_INFO("The format of {} differs from the output", src.c_str());
+                return {};
+            }
+            if (!same_color(par, enc_ctx)) {
+                AKLOG_INFO("The colors of {} differ from the output", src.c_str());
+                return {};
+            }
+            // the runs are shifted as they are, which keeps the dts increasing at the joints only
+            // when the frames are reordered as much as the encoder does
+            if (par->video_delay != enc_ctx->has_b_frames) {
+                AKLOG_INFO("The reorder depth of {} differs from the output", src.c_str());
+                return {};
+            }
+
+            std::vector<core::Rational> keyframes;
+            int64_t end_ts = AV_NOPTS_VALUE;
+            const auto start_ts = input.start_ts();
+            const auto time_base = to_rational(istream->time_base);
+            const bool hevc = par->codec_id == AV_CODEC_ID_HEVC;
+            const int length_size = nal_length_size(par->extradata, par->extradata_size, hevc);
+            // the pts of the last IDR picture in the decode order
+            int64_t idr_pts = AV_NOPTS_VALUE;
+
+            AVPacket* pkt = av_packet_alloc();
+            if (!pkt) {
+                AKLOG_ERRORN("av_packet_alloc() failed");
+                return {};
+            }
+            // the windows start and end at the IDR pictures, and no frame after one of them in
+            // the decode order may be shown before it, since the copy starts and stops there
+            bool closed = true;
+            while (closed && input.read(pkt)) {
+                if (pkt->pts != AV_NOPTS_VALUE) {
+                    if ((pkt->flags & AV_PKT_FLAG_KEY) &&
+                        is_idr_packet(pkt->data, pkt->size, hevc, length_size)) {
+                        keyframes.push_back(Rational(pkt->pts - start_ts, 1) * time_base);
+                        idr_pts = pkt->pts;
+                    } else if (idr_pts != AV_NOPTS_VALUE && pkt->pts < idr_pts) {
+                        closed = false;
+                    }
+                    end_ts = std::max(end_ts, pkt->pts + pkt->duration);
+                }
+                av_packet_unref(pkt);
+            }
+            av_packet_free(&pkt);
+
+            if (!closed) {
+                AKLOG_INFO("Frames of {} are shown before the IDR picture they follow",
+                           src.c_str());
+                return {};
+            }
+
+            if (keyframes.empty()) {
+                return {};
+            }
+            std::sort(keyframes.begin(), keyframes.end());
+            keyframes.push_back(Rational(end_ts - start_ts, 1) * time_base);
+            return keyframes;
+        }
+
+    }
+}
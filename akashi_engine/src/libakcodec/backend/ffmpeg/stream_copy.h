@@ -0,0 +1,105 @@
+#pragma once
+
+#include <libakcore/rational.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AVPacket;
+struct AVCodecContext;
+
+namespace akashi {
+    namespace codec {
+
+        // true when the data starts with a start code of the Annex B byte stream format
+        bool is_annexb(const uint8_t* data, int size);
+
+        // puts `data` before the payload of the packet
+        bool prepend_to_packet(AVPacket* pkt, const uint8_t* data, int size);
+
+        /**
+         * true when the parameter sets may change within the stream in the output, as the copied
+         * packets carry the ones of their sources
+         *
+         * The avc1/hvc1 tracks of mov/mp4 have to keep them in the sample entry, while avc3/hev1
+         * and the byte stream formats allow them in-band.
+         */
+        bool allows_inband_param_sets(const std::string& format_name, uint32_t codec_tag);
+
+        /**
+         * The size of the length prefix of the NAL units, as in the avcC or hvcC `extradata`, or
+         * 0 when the packets are in the Annex B format
+         */
+        int nal_length_size(const uint8_t* extradata, int size, bool hevc);
+
+        /**
+         * true when the packet is an IDR picture of H.264 (nal_unit_type 5), or of HEVC
+         * (IDR_W_RADL or IDR_N_LP), after which no frame refers to the ones before
+         *
+         * The other keyframes, such as the recovery points of H.264 or the CRA pictures of HEVC,
+         * may be followed by the frames which refer to the previous GOP.
+         */
+        bool is_idr_packet(const uint8_t* data, int size, bool hevc, int nal_length_size);
+
+        /**
+         * Shifts the packets of a run, such as a segment or a copied range, by one offset, so
+         * that the first packet of the run is presented at the beginning of the run.
+         *
+         * The pts and the dts are moved together, which keeps the order of the frames in the
+         * run. The timestamps are in one time base, and INT64_MIN (AV_NOPTS_VALUE) is left as is.
+         */
+        class RunTimestamps final {
+          public:
+            static constexpr const int64_t NO_TS = INT64_MIN;
+
+            // the following packets are shifted to start at `begin`
+            void start_run(int64_t begin) {
+                m_begin = begin;
+                m_offset = NO_TS;
+            }
+
+            // `duration` of the packet extends the end of the run
+            void shift(int64_t* pts, int64_t* dts, int64_t duration) {
+                if (m_offset == NO_TS) {
+                    const auto first = *pts != NO_TS ? *pts : *dts;
+                    if (first == NO_TS) {
+                        return;
+                    }
+                    m_offset = m_begin - first;
+                }
+                if (*pts != NO_TS) {
+                    *pts += m_offset;
+                    m_end = std::max(m_end, *pts + duration);
+                }
+                if (*dts != NO_TS) {
+                    *dts += m_offset;
+                }
+            }
+
+            // the packets without the duration last for `default_duration`
+            void shift(AVPacket* pkt, int64_t default_duration);
+
+            // where the shifted packets end, or the beginning of the run before any packets
+            int64_t end(void) const { return m_end != NO_TS ? m_end : m_begin; }
+
+          private:
+            int64_t m_begin = 0;
+            int64_t m_offset = NO_TS;
+            int64_t m_end = NO_TS;
+        };
+
+        /**
+         * The times of the keyframes of the video in `src` relative to its start, followed by
+         * its end, when its packets can be copied into the output of `enc_ctx`. Otherwise,
+         * empty.
+         *
+         * The source has to be in the format, the colors and the reorder depth of the output,
+         * so that the copied packets join the encoded ones without being modified.
+         */
+        std::vector<core::Rational> probe_stream_copy(const std::string& src,
+                                                      const AVCodecContext* enc_ctx);
+
+    }
+}
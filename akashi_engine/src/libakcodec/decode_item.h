@@ -21,6 +21,7 @@ namespace akashi {
             core::VideoDecodeMethod preferred_decode_method;
             size_t video_max_queue_count;
             std::string vaapi_device;
+            bool skip_audio = false; // if true, audio streams are not to be decoded
         };
 
         enum class DecodeResultCode {
@@ -1,25 +1,40 @@
 #pragma once
 
 #include <libakcore/rational.h>
+#include <libakcore/hw_accel.h>
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/hwframe.h>
 
 #include <memory.h>
+#include <string>
+#include <vector>
 
 namespace akashi {
     namespace buffer {
         class HWFrame;
     }
     namespace codec {
+        // the packets of a video copied into the output as they are
+        struct StreamCopyArg {
+            std::string src;
+            // the range in the source, from a keyframe to right before another one
+            core::Rational src_begin = core::Rational(0, 1);
+            core::Rational src_end = core::Rational(0, 1);
+            // the pts of the first frame in the output
+            core::Rational pts = core::Rational(0, 1);
+        };
+
         struct EncodeArg {
             core::Rational pts = core::Rational(-1, 1);
             std::unique_ptr<uint8_t[]> buffer = nullptr;
+            core::VideoBufferFormat video_format = core::VideoBufferFormat::RGB24;
             std::unique_ptr<float[]> abuffer = nullptr;
             int buf_size = 0;
             size_t nb_samples = 0;
             size_t abuffer_len = 0;
             buffer::AVBufferType type = buffer::AVBufferType::UNKNOWN;
             std::unique_ptr<buffer::HWFrame> hwframe;
+            std::unique_ptr<StreamCopyArg> stream_copy;
         };
 
         struct EncodeWriteArg {
@@ -49,5 +64,14 @@ namespace akashi {
             EncodeResultCode result = EncodeResultCode::NONE;
         };
 
+        struct ConcatArg {
+            // the files holding the consecutive parts of the video, in order
+            std::vector<std::string> video_fnames;
+            // the file holding the whole audio, or empty
+            std::string audio_fname;
+            std::string out_fname;
+            std::string format_opts;
+        };
+
     }
 }
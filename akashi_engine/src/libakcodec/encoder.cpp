@@ -5,45 +5,199 @@
 #include <libakbuffer/hwframe.h>
 #include <libakcore/logger.h>
 #include <libakcore/memory.h>
+#include <libakcore/config.h>
+#include <libakstate/akstate.h>
 
 using namespace akashi::core;
 
 namespace akashi {
     namespace codec {
 
-        AKEncoder::AKEncoder(core::borrowed_ptr<state::AKState> state) {
-            m_frame_sink = make_owned<FFFrameSink>(state);
+        static core::EncodeConf rendition_encode_conf(const core::EncodeConf& encode_conf,
+                                                      const core::RenditionConf& rendition) {
+            core::EncodeConf conf = encode_conf;
+            conf.out_fname = rendition.out_fname;
+            conf.video_codec = rendition.video_codec;
+            conf.audio_codec = rendition.audio_codec;
+            conf.ffmpeg_format_opts = rendition.ffmpeg_format_opts;
+            conf.video_ffmpeg_codec_opts = rendition.video_ffmpeg_codec_opts;
+            conf.audio_ffmpeg_codec_opts = rendition.audio_ffmpeg_codec_opts;
+            // the frames are scaled by swscale
+            conf.encode_method = core::VideoEncodeMethod::SW;
+            conf.renditions.clear();
+            return conf;
+        }
+
+        AKEncoder::AKEncoder(core::borrowed_ptr<state::AKState> state) : m_state(state) {
+            m_frame_sinks.push_back(make_owned<FFFrameSink>(state));
+
+            int video_width = 0;
+            int video_height = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_state->m_prop_mtx);
+                video_width = m_state->m_prop.video_width;
+                video_height = m_state->m_prop.video_height;
+            }
+            for (const auto& rendition : m_state->m_encode_conf.renditions) {
+                auto [width, height] = rendition.resolution;
+                if (width <= 0 || height <= 0) {
+                    width = video_width;
+                    height = video_height;
+                }
+                m_frame_sinks.push_back(make_owned<FFFrameSink>(
+                    state, rendition_encode_conf(m_state->m_encode_conf, rendition), width,
+                    height));
+            }
         }
 
         AKEncoder::~AKEncoder() {}
 
-        bool AKEncoder::open(void) { return m_frame_sink->open(); }
+        bool AKEncoder::open(void) {
+            if (m_frame_sinks.size() > 1 &&
+                m_state->m_encode_conf.encode_method == core::VideoEncodeMethod::VAAPI) {
+                AKLOG_ERRORN("Renditions are not supported with the VAAPI encode method");
+                return false;
+            }
+            for (auto&& frame_sink : m_frame_sinks) {
+                if (!frame_sink->open()) {
+                    return false;
+                }
+            }
+
+            const auto& main_sink = m_frame_sinks[0];
+            for (size_t i = 1; i < m_frame_sinks.size(); i++) {
+                const auto& out_fname = m_state->m_encode_conf.renditions[i - 1].out_fname;
+                for (const auto type : {buffer::AVBufferType::VIDEO, buffer::AVBufferType::AUDIO}) {
+                    if (m_frame_sinks[i]->has_stream(type) && !main_sink->has_stream(type)) {
+                        AKLOG_ERROR("The stream (type: {}) of {} is not in the main output", type,
+                                    out_fname.c_str());
+                        return false;
+                    }
+                }
+                // the mixed audio is split by the frame size of the main output
+                if (m_frame_sinks[i]->has_stream(buffer::AVBufferType::AUDIO)) {
+                    const auto nb_samples = m_frame_sinks[i]->nb_samples_per_frame();
+                    if (nb_samples != 0 && nb_samples != main_sink->nb_samples_per_frame()) {
+                        AKLOG_ERROR("The audio frame size of {} differs from the main output",
+                                    out_fname.c_str());
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
 
         bool AKEncoder::close(void) {
             AKLOG_INFON("Now closing encoder...");
-            return m_frame_sink->close();
+            bool success = true;
+            for (auto&& frame_sink : m_frame_sinks) {
+                success = frame_sink->close() && success;
+            }
             AKLOG_INFON("Successfully closed");
+            return success;
         }
 
         EncodeResultCode AKEncoder::send(const EncodeArg& encode_arg) {
-            return m_frame_sink->send(encode_arg);
+            for (; m_send_idx < m_frame_sinks.size(); m_send_idx++) {
+                const auto& frame_sink = m_frame_sinks[m_send_idx];
+                if (m_send_idx > 0 && !frame_sink->has_stream(encode_arg.type)) {
+                    continue;
+                }
+                auto result = frame_sink->send(encode_arg);
+                if (result == EncodeResultCode::SEND_EAGAIN) {
+                    return result;
+                }
+                if (result != EncodeResultCode::OK) {
+                    m_send_idx = 0;
+                    return result;
+                }
+            }
+            m_send_idx = 0;
+            return EncodeResultCode::OK;
         }
 
         EncodeWriteResult AKEncoder::write(const EncodeWriteArg& write_arg) {
-            return m_frame_sink->write(write_arg);
+            bool ended = true;
+            for (size_t i = 0; i < m_frame_sinks.size(); i++) {
+                if (i > 0 && !m_frame_sinks[i]->has_stream(write_arg.type)) {
+                    continue;
+                }
+                auto write_result = m_frame_sinks[i]->write(write_arg);
+                switch (write_result.result) {
+                    case EncodeResultCode::RECV_EAGAIN: {
+                        ended = false;
+                        break;
+                    }
+                    case EncodeResultCode::RECV_EOF: {
+                        break;
+                    }
+                    default: {
+                        return write_result;
+                    }
+                }
+            }
+            return {.result = ended ? EncodeResultCode::RECV_EOF : EncodeResultCode::RECV_EAGAIN};
         }
 
         size_t AKEncoder::nb_samples_per_frame(void) {
-            return m_frame_sink->nb_samples_per_frame();
+            return m_frame_sinks[0]->nb_samples_per_frame();
         }
 
         core::AKAudioSampleFormat
         AKEncoder::validate_audio_format(const core::AKAudioSampleFormat& sample_format) {
-            return m_frame_sink->validate_audio_format(sample_format);
+            auto format = m_frame_sinks[0]->validate_audio_format(sample_format);
+            if (format == core::AKAudioSampleFormat::NONE) {
+                return format;
+            }
+            for (size_t i = 1; i < m_frame_sinks.size(); i++) {
+                const auto& rendition = m_state->m_encode_conf.renditions[i - 1];
+                if (rendition.audio_codec == "") {
+                    continue;
+                }
+                // the audio is mixed once in the format
+                if (m_frame_sinks[i]->validate_audio_format(format) != format) {
+                    AKLOG_ERROR("The sample format of the main output is not supported in {}",
+                                rendition.out_fname.c_str());
+                    return core::AKAudioSampleFormat::NONE;
+                }
+            }
+            return format;
         }
 
         std::unique_ptr<buffer::HWFrame> AKEncoder::create_hwframe(void) {
-            return m_frame_sink->create_hwframe();
+            return m_frame_sinks[0]->create_hwframe();
+        }
+
+        core::VideoBufferFormat AKEncoder::video_buffer_format(void) {
+            return m_frame_sinks[0]->video_buffer_format();
+        }
+
+        std::vector<core::Rational> AKEncoder::stream_copy_keyframes(const std::string& src) {
+            auto keyframes = m_frame_sinks[0]->stream_copy_keyframes(src);
+            // copied only when all the outputs can take the same packets
+            for (size_t i = 1; !keyframes.empty() && i < m_frame_sinks.size(); i++) {
+                if (m_frame_sinks[i]->has_stream(buffer::AVBufferType::VIDEO) &&
+                    m_frame_sinks[i]->stream_copy_keyframes(src) != keyframes) {
+                    return {};
+                }
+            }
+            return keyframes;
+        }
+
+        bool AKEncoder::copy_packets(const StreamCopyArg& copy_arg) {
+            for (size_t i = 0; i < m_frame_sinks.size(); i++) {
+                if (i > 0 && !m_frame_sinks[i]->has_stream(buffer::AVBufferType::VIDEO)) {
+                    continue;
+                }
+                if (!m_frame_sinks[i]->copy_packets(copy_arg)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool concat_segments(const ConcatArg& concat_arg) {
+            return ff_concat_segments(concat_arg);
         }
 
     }
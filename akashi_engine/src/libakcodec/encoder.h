@@ -5,6 +5,8 @@
 
 #include <libakcore/memory.h>
 
+#include <vector>
+
 namespace akashi {
     namespace state {
         class AKState;
@@ -15,6 +17,13 @@ namespace akashi {
     namespace codec {
 
         class FrameSink;
+        /**
+         * Encodes the frames into the output, and into each of the renditions in EncodeConf
+         *
+         * The renditions are fed with the same frames and audio, and have their own codecs and
+         * resolutions. They take the sample format and the frame size of the audio of the main
+         * output, and cannot have the streams the main output does not have.
+         */
         class AKEncoder final {
           public:
             explicit AKEncoder(core::borrowed_ptr<state::AKState> state);
@@ -24,8 +33,15 @@ namespace akashi {
 
             bool close(void);
 
+            /*
+             * SEND_EAGAIN when any of the outputs is full, in which case the same frame must be
+             * sent again after receiving the packets, and goes on from that output
+             */
             EncodeResultCode send(const EncodeArg& encode_arg);
 
+            /*
+             * writes out a packet of any of the outputs
+             */
             EncodeWriteResult write(const EncodeWriteArg& write_arg);
 
             /*
@@ -38,9 +54,37 @@ namespace akashi {
 
             std::unique_ptr<buffer::HWFrame> create_hwframe(void);
 
+            /*
+             * layout of the video frames preferred by the encoder, or NONE for the hardware ones
+             */
+            core::VideoBufferFormat video_buffer_format(void);
+
+            /*
+             * times of the keyframes of `src` followed by its end, if its video can be copied
+             * into the output as it is, or empty
+             */
+            std::vector<core::Rational> stream_copy_keyframes(const std::string& src);
+
+            /*
+             * writes out the frames encoded so far, and copies the packets into the video stream
+             */
+            bool copy_packets(const StreamCopyArg& copy_arg);
+
           private:
-            core::owned_ptr<FrameSink> m_frame_sink;
+            core::borrowed_ptr<state::AKState> m_state;
+            // the main output comes first
+            std::vector<core::owned_ptr<FrameSink>> m_frame_sinks;
+            // the output to which the frame is sent next
+            size_t m_send_idx = 0;
         };
 
+        /*
+         * remuxes the video segments and the audio into one file without reencoding them
+         *
+         * Each segment must begin with a keyframe, and the timestamps must be continuous across
+         * the segments.
+         */
+        bool concat_segments(const ConcatArg& concat_arg);
+
     }
 }
@@ -21,10 +21,14 @@ namespace akashi {
             virtual bool close(void) = 0;
             virtual EncodeResultCode send(const EncodeArg& encode_arg) = 0;
             virtual EncodeWriteResult write(const EncodeWriteArg& write_arg) = 0;
+            virtual bool has_stream(const buffer::AVBufferType& type) = 0;
             virtual size_t nb_samples_per_frame(void) = 0;
             virtual core::AKAudioSampleFormat
             validate_audio_format(const core::AKAudioSampleFormat& sample_format) = 0;
             virtual std::unique_ptr<buffer::HWFrame> create_hwframe(void) = 0;
+            virtual core::VideoBufferFormat video_buffer_format(void) = 0;
+            virtual std::vector<core::Rational> stream_copy_keyframes(const std::string& src) = 0;
+            virtual bool copy_packets(const StreamCopyArg& copy_arg) = 0;
         };
 
     }
@@ -0,0 +1,112 @@
+#include <catch.hpp>
+
+#include "../../../backend/ffmpeg/async_io.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+}
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace akashi {
+    namespace codec {
+
+        static std::vector<uint8_t> test_data(size_t size) {
+            std::vector<uint8_t> data(size);
+            for (size_t i = 0; i < size; i++) {
+                data[i] = static_cast<uint8_t>(i * 31 % 251);
+            }
+            return data;
+        }
+
+        static std::vector<uint8_t> read_file(const std::string& fname) {
+            std::ifstream ifs(fname, std::ios::binary);
+            return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+        }
+
+        static std::string temp_fname(const std::string& name) {
+            return (std::filesystem::temp_directory_path() / name).string();
+        }
+
+        // writes the data across a few blocks, and fills in the parts before, as the muxers do
+        // for the headers
+        static void write_with_seeks(AVIOContext* pb) {
+            const auto data = test_data(9 * 1024 * 1024 + 123);
+            avio_write(pb, data.data(), 4096);
+            avio_write(pb, data.data(), static_cast<int>(data.size()));
+            const int64_t end = 4096 + static_cast<int64_t>(data.size());
+
+            avio_seek(pb, 8, SEEK_SET);
+            avio_wb32(pb, 0xdeadbeef);
+            avio_seek(pb, end, SEEK_SET);
+            avio_write(pb, data.data() + 1000, 5000);
+
+            // across the boundary of the blocks
+            avio_seek(pb, 4 * 1024 * 1024 - 100, SEEK_SET);
+            avio_write(pb, data.data(), 300);
+            avio_seek(pb, -50, SEEK_CUR);
+            avio_wb64(pb, 0x0123456789abcdef);
+
+            avio_seek(pb, end + 5000, SEEK_SET);
+            avio_wb32(pb, 42);
+            avio_flush(pb);
+        }
+
+        TEST_CASE("async file io", "[akcodec]") {
+            for (const char* direct_io : {"0", "1"}) {
+                setenv("AK_DIRECT_IO", direct_io, 1);
+                const auto async_fname = temp_fname("akashi_test_async_io.bin");
+                const auto sync_fname = temp_fname("akashi_test_sync_io.bin");
+
+                priv::AsyncFileIO async_io;
+                REQUIRE(async_io.open(async_fname));
+                write_with_seeks(async_io.avio());
+                REQUIRE(async_io.close());
+
+                AVIOContext* pb = nullptr;
+                REQUIRE(avio_open(&pb, sync_fname.c_str(), AVIO_FLAG_WRITE) >= 0);
+                write_with_seeks(pb);
+                REQUIRE(avio_closep(&pb) >= 0);
+
+                const auto async_data = read_file(async_fname);
+                REQUIRE(async_data.size() == 4096 + 9 * 1024 * 1024 + 123 + 5000 + 4);
+                REQUIRE((async_data == read_file(sync_fname)));
+
+                std::filesystem::remove(async_fname);
+                std::filesystem::remove(sync_fname);
+            }
+            unsetenv("AK_DIRECT_IO");
+        }
+
+        TEST_CASE("async file io seek", "[akcodec]") {
+            const auto fname = temp_fname("akashi_test_async_io_seek.bin");
+            const auto data = test_data(1024 * 1024);
+
+            priv::AsyncFileIO async_io;
+            REQUIRE(async_io.open(fname));
+            auto pb = async_io.avio();
+            avio_write(pb, data.data(), static_cast<int>(data.size()));
+
+            // the muxers read the file after seeking to the front
+            avio_seek(pb, 0, SEEK_SET);
+            REQUIRE((read_file(fname) == data));
+
+            avio_wb32(pb, 0);
+            REQUIRE(async_io.close());
+        }
+
+        TEST_CASE("async file io formats", "[akcodec]") {
+            REQUIRE(priv::AsyncFileIO::supports(av_guess_format("matroska", nullptr, nullptr)));
+            REQUIRE(!priv::AsyncFileIO::supports(av_guess_format("mp4", nullptr, nullptr)));
+            REQUIRE(!priv::AsyncFileIO::supports(av_guess_format("mov", nullptr, nullptr)));
+        }
+
+    }
+}
@@ -0,0 +1,128 @@
+#include <catch.hpp>
+
+#include "../../../backend/ffmpeg/stream_copy.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace akashi {
+    namespace codec {
+
+        struct Packet {
+            int64_t pts;
+            int64_t dts;
+        };
+
+        // a GOP of IPBB with the reorder delay of 2 frames, which starts at `begin`
+        static std::vector<Packet> reordered_gop(int64_t begin, int64_t frame) {
+            return {{begin, begin - 2 * frame},
+                    {begin + 3 * frame, begin - frame},
+                    {begin + frame, begin},
+                    {begin + 2 * frame, begin + frame}};
+        }
+
+        static std::vector<Packet> shift_run(RunTimestamps& ts, std::vector<Packet> pkts,
+                                             int64_t frame) {
+            ts.start_run(ts.end());
+            for (auto& pkt : pkts) {
+                ts.shift(&pkt.pts, &pkt.dts, frame);
+            }
+            return pkts;
+        }
+
+        TEST_CASE("run timestamps", "[akcodec]") {
+            const int64_t frame = 512;
+            RunTimestamps ts;
+            REQUIRE(ts.end() == 0);
+
+            // the segments encoded at their own times, at 0 and from the middle of the video
+            const auto seg0 = shift_run(ts, reordered_gop(0, frame), frame);
+            REQUIRE(ts.end() == 4 * frame);
+            const auto seg1 = shift_run(ts, reordered_gop(100 * frame, frame), frame);
+            REQUIRE(ts.end() == 8 * frame);
+
+            std::vector<Packet> pkts = seg0;
+            pkts.insert(pkts.end(), seg1.begin(), seg1.end());
+            const auto expected0 = reordered_gop(0, frame);
+            const auto expected1 = reordered_gop(4 * frame, frame);
+            for (size_t i = 0; i < 4; i++) {
+                REQUIRE(seg0[i].pts == expected0[i].pts);
+                REQUIRE(seg0[i].dts == expected0[i].dts);
+                REQUIRE(seg1[i].pts == expected1[i].pts);
+                REQUIRE(seg1[i].dts == expected1[i].dts);
+            }
+            for (size_t i = 1; i < pkts.size(); i++) {
+                REQUIRE(pkts[i - 1].dts < pkts[i].dts);
+                REQUIRE(pkts[i].dts <= pkts[i].pts);
+            }
+        }
+
+        TEST_CASE("run timestamps without pts", "[akcodec]") {
+            RunTimestamps ts;
+            ts.start_run(1000);
+
+            // the offset is taken from the dts, when the first packet has no pts
+            int64_t pts = RunTimestamps::NO_TS;
+            int64_t dts = 40;
+            ts.shift(&pts, &dts, 10);
+            REQUIRE(pts == RunTimestamps::NO_TS);
+            REQUIRE(dts == 1000);
+            REQUIRE(ts.end() == 1000);
+
+            pts = 60;
+            dts = 50;
+            ts.shift(&pts, &dts, 10);
+            REQUIRE(pts == 1020);
+            REQUIRE(dts == 1010);
+            REQUIRE(ts.end() == 1030);
+        }
+
+        TEST_CASE("idr packets", "[akcodec]") {
+            // SEI, and then the IDR slice of H.264, in the Annex B format
+            const std::vector<uint8_t> h264_idr = {0, 0, 0, 1, 0x06, 0x05, 0x01, 0x80,
+                                                   0, 0, 1,    0x65, 0x88, 0x84};
+            REQUIRE(is_idr_packet(h264_idr.data(), h264_idr.size(), false, 0));
+            // a non-IDR I slice, which is marked as a keyframe by the recovery point SEI
+            const std::vector<uint8_t> h264_i = {0, 0, 0, 1, 0x06, 0x06, 0x01, 0x80,
+                                                 0, 0, 1,    0x41, 0x9a, 0x02};
+            REQUIRE(!is_idr_packet(h264_i.data(), h264_i.size(), false, 0));
+
+            // avcC with the length of 4 bytes
+            const std::vector<uint8_t> avcc = {1, 0x64, 0, 0x28, 0xff, 0xe1, 0};
+            const int length_size = nal_length_size(avcc.data(), avcc.size(), false);
+            REQUIRE(length_size == 4);
+            const std::vector<uint8_t> h264_idr_avcc = {0, 0, 0, 2, 0x09, 0xf0,
+                                                        0, 0, 0, 3, 0x65, 0x88, 0x84};
+            REQUIRE(is_idr_packet(h264_idr_avcc.data(), h264_idr_avcc.size(), false, length_size));
+
+            // IDR_W_RADL, IDR_N_LP and CRA of HEVC
+            const std::vector<uint8_t> hevc_idr = {0, 0, 1, 0x26, 0x01, 0xaf};
+            const std::vector<uint8_t> hevc_idr_n_lp = {0, 0, 1, 0x28, 0x01, 0xaf};
+            const std::vector<uint8_t> hevc_cra = {0, 0, 1, 0x2a, 0x01, 0xaf};
+            REQUIRE(is_idr_packet(hevc_idr.data(), hevc_idr.size(), true, 0));
+            REQUIRE(is_idr_packet(hevc_idr_n_lp.data(), hevc_idr_n_lp.size(), true, 0));
+            REQUIRE(!is_idr_packet(hevc_cra.data(), hevc_cra.size(), true, 0));
+
+            // broken lengths
+            const std::vector<uint8_t> broken = {0, 0, 0, 9, 0x65, 0x88};
+            REQUIRE(!is_idr_packet(broken.data(), broken.size(), false, 4));
+            REQUIRE(nal_length_size(h264_idr.data(), h264_idr.size(), false) == 0);
+        }
+
+        TEST_CASE("inband parameter sets", "[akcodec]") {
+            const auto tag = [](const char* s) {
+                return static_cast<uint32_t>(s[0]) | (static_cast<uint32_t>(s[1]) << 8) |
+                       (static_cast<uint32_t>(s[2]) << 16) | (static_cast<uint32_t>(s[3]) << 24);
+            };
+            REQUIRE(allows_inband_param_sets("matroska", 0));
+            REQUIRE(allows_inband_param_sets("mpegts", 0x1b));
+            REQUIRE(!allows_inband_param_sets("mp4", 0x21));
+            REQUIRE(!allows_inband_param_sets("mov", tag("avc1")));
+            REQUIRE(!allows_inband_param_sets("mp4", tag("hvc1")));
+            REQUIRE(allows_inband_param_sets("mp4", tag("avc3")));
+            REQUIRE(allows_inband_param_sets("mov", tag("hev1")));
+            REQUIRE(!allows_inband_param_sets("flv", 0));
+        }
+
+    }
+}
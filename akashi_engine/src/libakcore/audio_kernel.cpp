@@ -0,0 +1,261 @@
+#include "./audio_kernel.h"
+
+#include "./logger.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AK_AUDIO_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace akashi {
+    namespace core {
+
+        namespace scalar {
+
+            static void mix_gain(float* dst, const float* src, size_t len, float gain) {
+                for (size_t i = 0; i < len; i++) {
+                    dst[i] += src[i] * gain;
+                }
+            }
+
+            static void scale(float* buf, size_t len, float volume) {
+                for (size_t i = 0; i < len; i++) {
+                    buf[i] *= volume;
+                }
+            }
+
+            static float scale_rms(float* buf, size_t len, float volume) {
+                if (len == 0) {
+                    return 0.0f;
+                }
+                float sum = 0.0f;
+                for (size_t i = 0; i < len; i++) {
+                    sum += buf[i] * buf[i];
+                    buf[i] *= volume;
+                }
+                return std::sqrt(sum / len);
+            }
+
+        }
+
+#ifdef AK_AUDIO_KERNEL_X86
+
+        namespace sse {
+
+            __attribute__((target("sse2"))) static void mix_gain(float* dst, const float* src,
+                                                                 size_t len, float gain) {
+                const __m128 v_gain = _mm_set1_ps(gain);
+                size_t i = 0;
+                for (; i + 8 <= len; i += 8) {
+                    __m128 d0 = _mm_loadu_ps(&dst[i]);
+                    __m128 d1 = _mm_loadu_ps(&dst[i + 4]);
+                    __m128 s0 = _mm_loadu_ps(&src[i]);
+                    __m128 s1 = _mm_loadu_ps(&src[i + 4]);
+                    d0 = _mm_add_ps(d0, _mm_mul_ps(s0, v_gain));
+                    d1 = _mm_add_ps(d1, _mm_mul_ps(s1, v_gain));
+                    _mm_storeu_ps(&dst[i], d0);
+                    _mm_storeu_ps(&dst[i + 4], d1);
+                }
+                scalar::mix_gain(&dst[i], &src[i], len - i, gain);
+            }
+
+            __attribute__((target("sse2"))) static void scale(float* buf, size_t len,
+                                                              float volume) {
+                const __m128 v_volume = _mm_set1_ps(volume);
+                size_t i = 0;
+                for (; i + 4 <= len; i += 4) {
+                    _mm_storeu_ps(&buf[i], _mm_mul_ps(_mm_loadu_ps(&buf[i]), v_volume));
+                }
+                scalar::scale(&buf[i], len - i, volume);
+            }
+
+            __attribute__((target("sse2"))) static float scale_rms(float* buf, size_t len,
+                                                                   float volume) {
+                if (len == 0) {
+                    return 0.0f;
+                }
+                const __m128 v_volume = _mm_set1_ps(volume);
+                __m128 v_sum = _mm_setzero_ps();
+                size_t i = 0;
+                for (; i + 4 <= len; i += 4) {
+                    __m128 v = _mm_loadu_ps(&buf[i]);
+                    v_sum = _mm_add_ps(v_sum, _mm_mul_ps(v, v));
+                    _mm_storeu_ps(&buf[i], _mm_mul_ps(v, v_volume));
+                }
+                alignas(16) float lanes[4];
+                _mm_store_ps(lanes, v_sum);
+                float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+                for (; i < len; i++) {
+                    sum += buf[i] * buf[i];
+                    buf[i] *= volume;
+                }
+                return std::sqrt(sum / len);
+            }
+
+        }
+
+        namespace avx2 {
+
+            __attribute__((target("avx2,fma"))) static void mix_gain(float* dst, const float* src,
+                                                                     size_t len, float gain) {
+                const __m256 v_gain = _mm256_set1_ps(gain);
+                size_t i = 0;
+                for (; i + 16 <= len; i += 16) {
+                    __m256 d0 = _mm256_loadu_ps(&dst[i]);
+                    __m256 d1 = _mm256_loadu_ps(&dst[i + 8]);
+                    d0 = _mm256_fmadd_ps(_mm256_loadu_ps(&src[i]), v_gain, d0);
+                    d1 = _mm256_fmadd_ps(_mm256_loadu_ps(&src[i + 8]), v_gain, d1);
+                    _mm256_storeu_ps(&dst[i], d0);
+                    _mm256_storeu_ps(&dst[i + 8], d1);
+                }
+                for (; i + 8 <= len; i += 8) {
+                    __m256 d = _mm256_loadu_ps(&dst[i]);
+                    d = _mm256_fmadd_ps(_mm256_loadu_ps(&src[i]), v_gain, d);
+                    _mm256_storeu_ps(&dst[i], d);
+                }
+                scalar::mix_gain(&dst[i], &src[i], len - i, gain);
+            }
+
+            __attribute__((target("avx2,fma"))) static void scale(float* buf, size_t len,
+                                                                  float volume) {
+                const __m256 v_volume = _mm256_set1_ps(volume);
+                size_t i = 0;
+                for (; i + 8 <= len; i += 8) {
+                    _mm256_storeu_ps(&buf[i], _mm256_mul_ps(_mm256_loadu_ps(&buf[i]), v_volume));
+                }
+                scalar::scale(&buf[i], len - i, volume);
+            }
+
+            __attribute__((target("avx2,fma"))) static float scale_rms(float* buf, size_t len,
+                                                                       float volume) {
+                if (len == 0) {
+                    return 0.0f;
+                }
+                const __m256 v_volume = _mm256_set1_ps(volume);
+                __m256 v_sum = _mm256_setzero_ps();
+                size_t i = 0;
+                for (; i + 8 <= len; i += 8) {
+                    __m256 v = _mm256_loadu_ps(&buf[i]);
+                    v_sum = _mm256_fmadd_ps(v, v, v_sum);
+                    _mm256_storeu_ps(&buf[i], _mm256_mul_ps(v, v_volume));
+                }
+                alignas(32) float lanes[8];
+                _mm256_store_ps(lanes, v_sum);
+                float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+                            ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+                for (; i < len; i++) {
+                    sum += buf[i] * buf[i];
+                    buf[i] *= volume;
+                }
+                return std::sqrt(sum / len);
+            }
+
+        }
+
+#endif
+
+        static const AudioKernel s_scalar_kernel = {AudioKernelISA::SCALAR, scalar::mix_gain,
+                                                    scalar::scale, scalar::scale_rms};
+
+#ifdef AK_AUDIO_KERNEL_X86
+        static const AudioKernel s_sse_kernel = {AudioKernelISA::SSE, sse::mix_gain, sse::scale,
+                                                 sse::scale_rms};
+
+        static const AudioKernel s_avx2_kernel = {AudioKernelISA::AVX2, avx2::mix_gain,
+                                                  avx2::scale, avx2::scale_rms};
+#endif
+
+        static AudioKernelISA isa_from_env(void) {
+            const char* env = std::getenv("AK_AUDIO_KERNEL");
+            if (!env) {
+                return AudioKernelISA::NONE;
+            }
+            if (strcmp(env, "scalar") == 0) {
+                return AudioKernelISA::SCALAR;
+            } else if (strcmp(env, "sse") == 0) {
+                return AudioKernelISA::SSE;
+            } else if (strcmp(env, "avx2") == 0) {
+                return AudioKernelISA::AVX2;
+            }
+            AKLOG_WARN("Invalid AK_AUDIO_KERNEL found: {}", env);
+            return AudioKernelISA::NONE;
+        }
+
+        bool audio_kernel_supported(AudioKernelISA isa) {
+            switch (isa) {
+                case AudioKernelISA::SCALAR:
+                    return true;
+#ifdef AK_AUDIO_KERNEL_X86
+                case AudioKernelISA::SSE:
+                    return __builtin_cpu_supports("sse2");
+                case AudioKernelISA::AVX2:
+                    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+                default:
+                    return false;
+            }
+        }
+
+        const AudioKernel& audio_kernel(AudioKernelISA isa) {
+            if (!audio_kernel_supported(isa)) {
+                return s_scalar_kernel;
+            }
+            switch (isa) {
+#ifdef AK_AUDIO_KERNEL_X86
+                case AudioKernelISA::SSE:
+                    return s_sse_kernel;
+                case AudioKernelISA::AVX2:
+                    return s_avx2_kernel;
+#endif
+                default:
+                    return s_scalar_kernel;
+            }
+        }
+
+        const char* audio_kernel_isa_name(AudioKernelISA isa) {
+            switch (isa) {
+                case AudioKernelISA::SCALAR:
+                    return "scalar";
+                case AudioKernelISA::SSE:
+                    return "sse";
+                case AudioKernelISA::AVX2:
+                    return "avx2";
+                default:
+                    return "none";
+            }
+        }
+
+        static AudioKernelISA select_audio_kernel_isa(void) {
+            auto env_isa = isa_from_env();
+            if (env_isa != AudioKernelISA::NONE) {
+                if (!audio_kernel_supported(env_isa)) {
+                    AKLOG_WARN("AK_AUDIO_KERNEL={} is not supported on this cpu",
+                               audio_kernel_isa_name(env_isa));
+                }
+                return env_isa;
+            }
+            for (auto isa : {AudioKernelISA::AVX2, AudioKernelISA::SSE}) {
+                if (audio_kernel_supported(isa)) {
+                    return isa;
+                }
+            }
+            return AudioKernelISA::SCALAR;
+        }
+
+        static const AudioKernel& select_audio_kernel(void) {
+            const auto& kernel = audio_kernel(select_audio_kernel_isa());
+            AKLOG_INFO("Audio kernel: {}", audio_kernel_isa_name(kernel.isa));
+            return kernel;
+        }
+
+        const AudioKernel& audio_kernel(void) {
+            static const AudioKernel& kernel = select_audio_kernel();
+            return kernel;
+        }
+
+    }
+}
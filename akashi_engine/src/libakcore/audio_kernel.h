@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+namespace akashi {
+    namespace core {
+
+        enum class AudioKernelISA { NONE = -1, SCALAR = 0, SSE, AVX2 };
+
+        /**
+         * A set of float32 sample kernels shared by the realtime mixer (libakaudio) and the
+         * offline mixer (libakbuffer).
+         *
+         * All the pointers are allowed to be unaligned, and `len` is in samples, not in bytes.
+         */
+        struct AudioKernel {
+            AudioKernelISA isa = AudioKernelISA::NONE;
+
+            // dst[i] += src[i] * gain
+            void (*mix_gain)(float* dst, const float* src, size_t len, float gain) = nullptr;
+
+            // buf[i] *= volume
+            void (*scale)(float* buf, size_t len, float volume) = nullptr;
+
+            // buf[i] *= volume, and returns the rms of the samples before scaling
+            float (*scale_rms)(float* buf, size_t len, float volume) = nullptr;
+        };
+
+        /**
+         * Returns the best kernel set for the running cpu.
+         * The selection is done only once, and can be overridden by `AK_AUDIO_KERNEL`
+         * (scalar, sse, avx2).
+         */
+        const AudioKernel& audio_kernel(void);
+
+        /**
+         * Returns the kernel set for the specified isa.
+         * If the isa is not supported by the running cpu, the scalar one is returned instead.
+         */
+        const AudioKernel& audio_kernel(AudioKernelISA isa);
+
+        bool audio_kernel_supported(AudioKernelISA isa);
+
+        // the name accepted by `AK_AUDIO_KERNEL`
+        const char* audio_kernel_isa_name(AudioKernelISA isa);
+
+    }
+}
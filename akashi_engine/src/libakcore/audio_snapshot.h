@@ -0,0 +1,67 @@
+#pragma once
+
+#include "./audio.h"
+#include "./element.h"
+#include "./rational.h"
+#include "./memory.h"
+
+#include <string>
+#include <vector>
+
+namespace akashi {
+    namespace core {
+
+        /**
+         * A flattened view of the audio layers in an atom, used by the realtime audio callback.
+         * All the positions are in bytes, and aligned to the sample frame.
+         */
+        struct AudioLayerEntry {
+            std::string uuid;
+            int64_t from = 0;
+            int64_t to = 0;
+            float gain = 1.0f;
+        };
+
+        struct AudioLayerSnapshot {
+            int64_t bytes_per_second = 0;
+            int64_t frame_size = 0;
+            int64_t duration = 0;
+            std::vector<AudioLayerEntry> layers;
+        };
+
+        inline int64_t to_frame_bytes(const Rational& pts, const int64_t bytes_per_second,
+                                      const int64_t frame_size) {
+            auto bytes = pts * Rational(bytes_per_second, 1);
+            auto res = bytes.num() / bytes.den();
+            return frame_size > 0 ? res - (res % frame_size) : res;
+        }
+
+        inline owned_ptr<AudioLayerSnapshot>
+        make_audio_layer_snapshot(const RenderProfile& render_prof, const AKAudioSpec& spec) {
+            auto snapshot = make_owned<AudioLayerSnapshot>();
+            snapshot->bytes_per_second = core::bytes_per_second(spec);
+            snapshot->frame_size = size_table(spec.format) * spec.channels;
+
+            // only the first atom is played for now
+            if (render_prof.atom_profiles.empty()) {
+                return snapshot;
+            }
+            const auto& atom_prof = render_prof.atom_profiles[0];
+            snapshot->duration = to_frame_bytes(atom_prof.duration, snapshot->bytes_per_second,
+                                                snapshot->frame_size);
+            // [XXX] video layers may also have audio streams, so all the av layers are kept here
+            for (const auto& layer : atom_prof.av_layers) {
+                AudioLayerEntry entry;
+                entry.uuid = layer.uuid;
+                entry.from =
+                    to_frame_bytes(layer.from, snapshot->bytes_per_second, snapshot->frame_size);
+                entry.to =
+                    to_frame_bytes(layer.to, snapshot->bytes_per_second, snapshot->frame_size);
+                entry.gain = layer.gain;
+                snapshot->layers.push_back(std::move(entry));
+            }
+            return snapshot;
+        }
+
+    }
+}
@@ -23,10 +23,13 @@ namespace akashi {
                                            video_max_queue_count, audio_max_queue_size);
         NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(UIConf, resolution, window_mode, smart_immersive,
                                            frameless_window);
+        NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RenditionConf, out_fname, resolution, video_codec,
+                                           audio_codec, ffmpeg_format_opts,
+                                           video_ffmpeg_codec_opts, audio_ffmpeg_codec_opts);
         NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EncodeConf, out_fname, video_codec, audio_codec,
                                            ffmpeg_format_opts, video_ffmpeg_codec_opts,
                                            audio_ffmpeg_codec_opts, encode_max_queue_count,
-                                           encode_method);
+                                           encode_method, renditions);
         NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(AKConf, general, video, audio, playback, ui, encode);
 
         // clang-format off
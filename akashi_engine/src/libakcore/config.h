@@ -48,6 +48,18 @@ namespace akashi {
             bool frameless_window;
         };
 
+        // another output encoded from the same frames and audio
+        struct RenditionConf {
+            std::string out_fname;
+            // {0, 0} for the resolution of the video
+            std::pair<int, int> resolution;
+            std::string video_codec;
+            std::string audio_codec;
+            std::string ffmpeg_format_opts;
+            std::string video_ffmpeg_codec_opts;
+            std::string audio_ffmpeg_codec_opts;
+        };
+
         struct EncodeConf {
             std::string out_fname;
             std::string video_codec;
@@ -57,6 +69,7 @@ namespace akashi {
             std::string audio_ffmpeg_codec_opts;
             size_t encode_max_queue_count;
             VideoEncodeMethod encode_method;
+            std::vector<RenditionConf> renditions;
         };
 
         struct AKConf {
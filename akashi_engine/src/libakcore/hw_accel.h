@@ -1,10 +1,26 @@
 #pragma once
 
+#include <cstddef>
+
 namespace akashi {
     namespace core {
         enum class VideoDecodeMethod { NONE = -1, SW = 0, VAAPI, VAAPI_COPY };
         enum class VideoEncodeMethod { NONE = -1, SW = 0, VAAPI, VAAPI_COPY };
 
+        // the layout of the frames handed to the software encoders
+        enum class VideoBufferFormat { NONE = -1, RGB24 = 0, NV12 };
+
+        inline size_t video_buffer_size(VideoBufferFormat format, int width, int height) {
+            switch (format) {
+                case VideoBufferFormat::RGB24:
+                    return static_cast<size_t>(width) * height * 3;
+                case VideoBufferFormat::NV12:
+                    return static_cast<size_t>(width) * height * 3 / 2;
+                default:
+                    return 0;
+            }
+        }
+
         namespace hwaccel {
             inline VideoDecodeMethod safe_map(VideoEncodeMethod method) {
                 return static_cast<VideoDecodeMethod>(static_cast<int>(method));
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "./memory.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace akashi {
+    namespace core {
+
+        /**
+         * A RCU-style holder of an immutable snapshot, which is shared by any number of writers
+         * and exactly one reader.
+         *
+         * The reader side (acquire()/release()) neither allocates nor locks, so it can be used
+         * on a realtime thread. A published snapshot is retired when it is replaced, and is
+         * deleted by a later publish() once the reader no longer refers to it.
+         */
+        template <class T>
+        class SnapshotCell final {
+          public:
+            explicit SnapshotCell() = default;
+            SnapshotCell(const SnapshotCell&) = delete;
+            SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+            ~SnapshotCell() {
+                delete m_current.load();
+                for (auto retired : m_retired) {
+                    delete retired;
+                }
+            }
+
+            void publish(owned_ptr<T> snapshot) {
+                std::lock_guard<std::mutex> lock(m_writer_mtx);
+                auto old = m_current.exchange(snapshot.release());
+                if (old) {
+                    m_retired.push_back(old);
+                }
+                this->reclaim();
+            }
+
+            // must be paired with release()
+            const T* acquire() {
+                const T* ptr = m_current.load();
+                while (true) {
+                    m_hazard.store(ptr);
+                    // make sure that the snapshot was not retired before the hazard was set
+                    const T* cur = m_current.load();
+                    if (cur == ptr) {
+                        return ptr;
+                    }
+                    ptr = cur;
+                }
+            }
+
+            void release() { m_hazard.store(nullptr); }
+
+          private:
+            void reclaim() {
+                const T* hazard = m_hazard.load();
+                for (auto it = m_retired.begin(); it != m_retired.end();) {
+                    if (*it == hazard) {
+                        ++it;
+                        continue;
+                    }
+                    delete *it;
+                    it = m_retired.erase(it);
+                }
+            }
+
+          private:
+            std::atomic<T*> m_current{nullptr};
+            std::atomic<const T*> m_hazard{nullptr};
+
+            std::mutex m_writer_mtx;
+            std::vector<T*> m_retired;
+        };
+
+    }
+}
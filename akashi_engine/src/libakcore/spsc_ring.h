@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace akashi {
+    namespace core {
+
+        /**
+         * A bounded FIFO shared by exactly one producer and exactly one consumer.
+         *
+         * Slots are allocated at construction, so neither side allocates nor locks afterwards,
+         * and either side can be run on a realtime thread.
+         */
+        template <class T>
+        class SpscRing final {
+          public:
+            explicit SpscRing(size_t capacity) : m_slots(capacity + 1) {}
+            SpscRing(const SpscRing&) = delete;
+            SpscRing& operator=(const SpscRing&) = delete;
+
+            size_t capacity() const { return m_slots.size() - 1; }
+
+            // producer side, returns false when the ring is full
+            bool push(T value) {
+                const size_t tail = m_tail.load();
+                const size_t next = this->next(tail);
+                if (next == m_head.load()) {
+                    return false;
+                }
+                m_slots[tail] = std::move(value);
+                m_tail.store(next);
+                return true;
+            }
+
+            // consumer side, front() and pop() must not be called when the ring is empty
+            bool empty() const { return m_head.load() == m_tail.load(); }
+
+            T& front() { return m_slots[m_head.load()]; }
+
+            void pop() { m_head.store(this->next(m_head.load())); }
+
+            // the `index`-th element from the front
+            T& operator[](size_t index) {
+                const size_t slot = m_head.load() + index;
+                return m_slots[slot < m_slots.size() ? slot : slot - m_slots.size()];
+            }
+
+            // either side, only a hint for the other one
+            size_t size() const {
+                const size_t head = m_head.load();
+                const size_t tail = m_tail.load();
+                return tail >= head ? tail - head : tail + m_slots.size() - head;
+            }
+
+            bool full() const { return this->size() == this->capacity(); }
+
+          private:
+            size_t next(size_t index) const { return index + 1 == m_slots.size() ? 0 : index + 1; }
+
+          private:
+            std::vector<T> m_slots;
+            std::atomic<size_t> m_head{0};
+            std::atomic<size_t> m_tail{0};
+        };
+
+    }
+}
@@ -1,6 +1,14 @@
 #include <catch.hpp>
 #include "../rational.h"
 #include "../time.h"
+#include "../audio_kernel.h"
+#include "../snapshot.h"
+#include "../spsc_ring.h"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 using namespace akashi::core;
 
@@ -20,6 +28,163 @@ namespace akashi {
                     "00:01:18.129");
         }
 
+        TEST_CASE("audio kernel test", "[akcore]") {
+            const auto& ref_kernel = audio_kernel(AudioKernelISA::SCALAR);
+            for (auto isa : {AudioKernelISA::SCALAR, AudioKernelISA::SSE, AudioKernelISA::AVX2}) {
+                if (!audio_kernel_supported(isa)) {
+                    continue;
+                }
+                const auto& kernel = audio_kernel(isa);
+                REQUIRE(kernel.isa == isa);
+
+                // odd lengths to cover the scalar tails
+                for (size_t len : {0, 1, 7, 17, 1027}) {
+                    std::vector<float> src(len + 1);
+                    std::vector<float> dst(len + 1);
+                    for (size_t i = 0; i < len + 1; i++) {
+                        src[i] = std::sin(i * 0.1f);
+                        dst[i] = std::cos(i * 0.3f);
+                    }
+                    auto ref_dst = dst;
+                    // unaligned
+                    kernel.mix_gain(&dst[1], &src[1], len, 0.7f);
+                    ref_kernel.mix_gain(&ref_dst[1], &src[1], len, 0.7f);
+                    for (size_t i = 0; i < len + 1; i++) {
+                        REQUIRE(dst[i] == Approx(ref_dst[i]).margin(1e-6));
+                    }
+
+                    auto rms = kernel.scale_rms(&dst[1], len, 0.5f);
+                    auto ref_rms = ref_kernel.scale_rms(&ref_dst[1], len, 0.5f);
+                    REQUIRE(rms == Approx(ref_rms).epsilon(1e-4));
+                    for (size_t i = 0; i < len + 1; i++) {
+                        REQUIRE(dst[i] == Approx(ref_dst[i]).margin(1e-6));
+                    }
+                }
+            }
+        }
+
+        namespace {
+            // counts the live instances, and keeps two copies of a value which must agree
+            struct Counted {
+                static inline std::atomic<int> live = 0;
+                int a;
+                int b;
+                explicit Counted(int v) : a(v), b(v) { live++; }
+                ~Counted() { live--; }
+            };
+        }
+
+        TEST_CASE("snapshot cell test", "[akcore]") {
+            {
+                SnapshotCell<Counted> cell;
+                REQUIRE(cell.acquire() == nullptr);
+                cell.release();
+
+                cell.publish(make_owned<Counted>(1));
+                const auto first = cell.acquire();
+                REQUIRE(first->a == 1);
+
+                // the held one is kept, and the rest are reclaimed on the next publish
+                cell.publish(make_owned<Counted>(2));
+                cell.publish(make_owned<Counted>(3));
+                REQUIRE(first->a == 1);
+                REQUIRE(Counted::live == 2);
+                cell.release();
+
+                REQUIRE(cell.acquire()->a == 3);
+                cell.release();
+                cell.publish(make_owned<Counted>(4));
+                REQUIRE(Counted::live == 1);
+            }
+            REQUIRE(Counted::live == 0);
+
+            {
+                SnapshotCell<Counted> cell;
+                cell.publish(make_owned<Counted>(0));
+                std::atomic<bool> done = false;
+                std::atomic<int> torn = 0;
+
+                std::thread reader([&] {
+                    while (!done) {
+                        const auto snapshot = cell.acquire();
+                        if (snapshot->a != snapshot->b) {
+                            torn++;
+                        }
+                        cell.release();
+                    }
+                });
+                std::vector<std::thread> writers;
+                for (int i = 0; i < 2; i++) {
+                    writers.emplace_back([&cell, i] {
+                        for (int j = 0; j < 10000; j++) {
+                            cell.publish(make_owned<Counted>(i * 10000 + j));
+                        }
+                    });
+                }
+                for (auto& writer : writers) {
+                    writer.join();
+                }
+                done = true;
+                reader.join();
+                REQUIRE(torn == 0);
+            }
+            REQUIRE(Counted::live == 0);
+        }
+
+        TEST_CASE("spsc ring test", "[akcore]") {
+            {
+                SpscRing<int> ring(3);
+                REQUIRE(ring.empty());
+                REQUIRE(ring.push(1));
+                REQUIRE(ring.push(2));
+                REQUIRE(ring.push(3));
+                REQUIRE(ring.full());
+                REQUIRE(!ring.push(4));
+                REQUIRE(ring[2] == 3);
+
+                // wraps around
+                ring.pop();
+                REQUIRE(ring.push(4));
+                REQUIRE(ring.size() == 3);
+                for (int i = 2; i <= 4; i++) {
+                    REQUIRE(ring.front() == i);
+                    ring.pop();
+                }
+                REQUIRE(ring.empty());
+            }
+
+            {
+                static constexpr const int NB_ITEMS = 100000;
+                SpscRing<int> ring(16);
+                std::atomic<int> out_of_order = 0;
+
+                std::thread consumer([&ring, &out_of_order] {
+                    int expected = 0;
+                    while (expected < NB_ITEMS) {
+                        if (ring.empty()) {
+                            std::this_thread::yield();
+                            continue;
+                        }
+                        if (ring.front() != expected) {
+                            out_of_order++;
+                        }
+                        ring.pop();
+                        expected++;
+                    }
+                });
+                for (int i = 0; i < NB_ITEMS;) {
+                    if (ring.push(i)) {
+                        i++;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                consumer.join();
+                REQUIRE(out_of_order == 0);
+                REQUIRE(ring.empty());
+            }
+        }
+
         // TEST_CASE("benchmark", "[akcore/bench]") {
         //     BENCHMARK("Fibonacci 20") { return Rational(1, 2); };
         // }
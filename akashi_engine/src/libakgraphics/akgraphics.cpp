@@ -36,5 +36,9 @@ namespace akashi {
             m_gfx_ctx->encode_render(params, frame_ctx);
         }
 
+        void AKGraphics::encode_flush(EncodeRenderParams& params) {
+            m_gfx_ctx->encode_flush(params);
+        }
+
     }
 }
@@ -34,6 +34,12 @@ namespace akashi {
 
             void encode_render(EncodeRenderParams& params, const core::FrameContext& frame_ctx);
 
+            /**
+             * Takes out a frame still being read back after the last encode_render().
+             * `params.filled` is false when no frame is left.
+             */
+            void encode_flush(EncodeRenderParams& params);
+
           private:
             core::owned_ptr<GraphicsContext> m_gfx_ctx;
         };
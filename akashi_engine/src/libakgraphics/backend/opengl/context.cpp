@@ -4,11 +4,13 @@
 #include "./osc/osc_root.h"
 
 #include "./core/glc.h"
+#include "./core/gl_state.h"
 #include "./core/eglc.h"
 #include "./core/texture.h"
 #include "./render_context.h"
 #include "./stage.h"
 #include "./fbo.h"
+#include "./frame_readback.h"
 
 #include "./hwaccel/hwaccel.h"
 #include "./hwaccel/vaapi_encode.h"
@@ -30,7 +32,12 @@ namespace akashi {
             m_stage = core::make_owned<Stage>();
         };
 
-        OGLGraphicsContext::~OGLGraphicsContext(){};
+        OGLGraphicsContext::~OGLGraphicsContext() {
+            if (m_readback) {
+                m_readback->destroy();
+            }
+            log_gl_state_stats();
+        };
 
         bool OGLGraphicsContext::load_api(const GetProcAddress& get_proc_address,
                                           const EGLGetProcAddress& egl_get_proc_address) {
@@ -38,6 +45,7 @@ namespace akashi {
                 AKLOG_ERRORN("Failed to initialize OpenGL context");
                 return false;
             }
+            install_gl_state_cache();
             if (!load_egl_functions(egl_get_proc_address)) {
                 AKLOG_ERRORN("Failed to initialize EGL context");
                 return false;
@@ -52,12 +60,15 @@ namespace akashi {
             }
 
             m_encode_fbo = core::make_owned<VAAPIHWEncodeFBO>(*m_render_ctx);
+            m_readback = core::make_owned<FrameReadback>();
 
             return m_stage->create(*m_render_ctx);
         }
 
         void OGLGraphicsContext::render(const RenderParams& params,
                                         const core::FrameContext& frame_ctx) {
+            // the state may have been changed by the host or the OSC since the last frame
+            invalidate_gl_state_cache();
             if (!m_render_ctx->fbo().initilized()) {
                 m_render_ctx->load_fbo(false);
             }
@@ -69,6 +80,9 @@ namespace akashi {
             if (!m_stage) {
                 return;
             }
+            invalidate_gl_state_cache();
+            // frames must be complete, even if it takes time to load them
+            m_render_ctx->set_async_loads(false);
 
             if (params.hwframe) {
                 if (!m_render_ctx->fbo().initilized()) {
@@ -88,45 +102,23 @@ namespace akashi {
                 }
 
                 m_stage->encode_render(*m_render_ctx, frame_ctx);
-                params.width = m_render_ctx->fbo().info().width;
-                params.height = m_render_ctx->fbo().info().height;
-
-                GLuint dst_fbo;
-                m_render_ctx->fbo().dst_fbo(&dst_fbo);
-
-                glBindFramebuffer(GL_FRAMEBUFFER, dst_fbo);
-
-                glPixelStorei(GL_PACK_ALIGNMENT, 1);
-                // glReadBuffer(GL_COLOR_ATTACHMENT0);
-                glReadPixels(0, 0, params.width, params.height, GL_RGB, GL_UNSIGNED_BYTE,
-                             params.buffer);
-
-                glPixelStorei(GL_PACK_ALIGNMENT, 4); // reset to the initial value;
-
-                // another way without glReadPixels
-                // OGLTexture fbo_tex;
-                // m_render_ctx->fbo().texture(fbo_tex);
-                // glBindTexture(GL_TEXTURE_2D, fbo_tex.buffer);
-                // glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, params.buffer);
-
-                // rgbrgbrgbrgb... [line0]
-                // rgbrgbrgbrgb... [line1]
-                // ...
-                // rgbrgbrgbrgb... [line height/2]
-                // ...
-                // ... [line height - 1]
-                // where row length = width * 3
-
-                // [TODO] maybe we should render upside down in advance?
-                // flip the buffer vertically
-                for (int line = 0; line < params.height / 2; line++) {
-                    std::swap_ranges(params.buffer + 3 * params.width * line,
-                                     params.buffer + 3 * params.width * (line + 1),
-                                     params.buffer + 3 * params.width * (params.height - line - 1));
+
+                OGLTexture rgb_tex;
+                m_render_ctx->fbo().texture(rgb_tex);
+
+                if (!m_readback->push(params, rgb_tex, frame_ctx.pts)) {
+                    AKLOG_ERRORN("Failed to read back the frame");
                 }
             }
         }
 
+        void OGLGraphicsContext::encode_flush(EncodeRenderParams& params) {
+            params.filled = false;
+            if (m_readback && !m_readback->pop(params)) {
+                AKLOG_ERRORN("Failed to read back the frame");
+            }
+        }
+
         OGLOSCContext::OGLOSCContext(core::borrowed_ptr<state::AKState> state)
             : OSCContext(state), m_state(state){};
 
@@ -171,6 +163,7 @@ namespace akashi {
                 AKLOG_ERRORN("m_root is null");
                 return;
             }
+            invalidate_gl_state_cache();
 
             if (!m_root->update(params)) {
                 AKLOG_DEBUGN("No update needed");
@@ -185,6 +178,7 @@ namespace akashi {
                 AKLOG_ERRORN("m_root is null");
                 return;
             }
+            invalidate_gl_state_cache();
             m_root->resize(params);
         }
 
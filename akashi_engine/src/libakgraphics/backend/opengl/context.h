@@ -31,6 +31,7 @@ namespace akashi {
         class OGLRenderContext;
         class Stage;
         class HWEncodeFBO;
+        class FrameReadback;
         class OGLGraphicsContext : public GraphicsContext {
           public:
             explicit OGLGraphicsContext(core::borrowed_ptr<state::AKState> state,
@@ -45,10 +46,13 @@ namespace akashi {
             void encode_render(EncodeRenderParams& params,
                                const core::FrameContext& frame_ctx) override;
 
+            void encode_flush(EncodeRenderParams& params) override;
+
           private:
             core::owned_ptr<OGLRenderContext> m_render_ctx;
             core::owned_ptr<Stage> m_stage;
             core::owned_ptr<HWEncodeFBO> m_encode_fbo;
+            core::owned_ptr<FrameReadback> m_readback;
         };
 
         class OSCRoot;
@@ -0,0 +1,536 @@
+#include "./gl_state.h"
+
+#include <libakcore/logger.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+#ifndef AK_GL_CUSTOM_LOADER
+
+        namespace priv {
+
+            enum GLStateFn {
+                USE_PROGRAM = 0,
+                ACTIVE_TEXTURE,
+                BIND_TEXTURE,
+                BIND_FRAMEBUFFER,
+                BIND_VERTEX_ARRAY,
+                BIND_BUFFER,
+                ENABLE,
+                DISABLE,
+                BLEND_FUNC,
+                PIXEL_STORE,
+                VIEWPORT,
+                SCISSOR,
+                CLEAR_COLOR,
+                UNIFORM,
+                LENGTH
+            };
+
+            static constexpr const char* FN_NAMES[GLStateFn::LENGTH] = {
+                "glUseProgram", "glActiveTexture", "glBindTexture", "glBindFramebuffer",
+                "glBindVertexArray", "glBindBuffer", "glEnable", "glDisable", "glBlendFunc",
+                "glPixelStorei", "glViewport", "glScissor", "glClearColor", "glUniform*"};
+
+            struct Counter {
+                std::atomic<uint64_t> calls{0};
+                std::atomic<uint64_t> elided{0};
+            };
+            static std::array<Counter, GLStateFn::LENGTH> counters;
+
+            // returns `unchanged`
+            static bool count(GLStateFn fn, bool unchanged) {
+                counters[fn].calls.fetch_add(1, std::memory_order_relaxed);
+                if (unchanged) {
+                    counters[fn].elided.fetch_add(1, std::memory_order_relaxed);
+                }
+                return unchanged;
+            }
+
+            struct UniformValue {
+                int kind = -1;
+                std::vector<uint8_t> bytes;
+            };
+
+            struct GLState {
+                std::optional<GLuint> program;
+                std::optional<GLenum> active_texture;
+                // keyed by (texture unit, target)
+                std::unordered_map<uint64_t, GLuint> textures;
+                std::optional<GLuint> read_fbo;
+                std::optional<GLuint> draw_fbo;
+                std::optional<GLuint> vao;
+                std::unordered_map<GLenum, GLuint> buffers;
+                std::unordered_map<GLenum, bool> caps;
+                std::optional<std::array<GLenum, 2>> blend_func;
+                std::unordered_map<GLenum, GLint> pixel_store;
+                std::optional<std::array<GLint, 4>> viewport;
+                std::optional<std::array<GLint, 4>> scissor;
+                std::optional<std::array<GLfloat, 4>> clear_color;
+
+                // per program, dropped when the program is relinked or deleted
+                std::unordered_map<GLuint, std::unordered_map<GLint, UniformValue>> uniforms;
+
+                // the uniforms are forgotten as well, since the calls which are not hooked
+                // (glProgramUniform*, glUniform*iv, ...) can change them
+                void invalidate() { *this = GLState{}; }
+            };
+            static thread_local GLState state;
+
+            struct GLFunctions {
+                decltype(glad_glUseProgram) use_program = nullptr;
+                decltype(glad_glActiveTexture) active_texture = nullptr;
+                decltype(glad_glBindTexture) bind_texture = nullptr;
+                decltype(glad_glBindFramebuffer) bind_framebuffer = nullptr;
+                decltype(glad_glBindVertexArray) bind_vertex_array = nullptr;
+                decltype(glad_glBindBuffer) bind_buffer = nullptr;
+                decltype(glad_glBindBufferBase) bind_buffer_base = nullptr;
+                decltype(glad_glEnable) enable = nullptr;
+                decltype(glad_glDisable) disable = nullptr;
+                decltype(glad_glBlendFunc) blend_func = nullptr;
+                decltype(glad_glPixelStorei) pixel_store = nullptr;
+                decltype(glad_glViewport) viewport = nullptr;
+                decltype(glad_glScissor) scissor = nullptr;
+                decltype(glad_glClearColor) clear_color = nullptr;
+                decltype(glad_glUniform1f) uniform1f = nullptr;
+                decltype(glad_glUniform2f) uniform2f = nullptr;
+                decltype(glad_glUniform3f) uniform3f = nullptr;
+                decltype(glad_glUniform4f) uniform4f = nullptr;
+                decltype(glad_glUniform1i) uniform1i = nullptr;
+                decltype(glad_glUniform2i) uniform2i = nullptr;
+                decltype(glad_glUniform1ui) uniform1ui = nullptr;
+                decltype(glad_glUniform2fv) uniform2fv = nullptr;
+                decltype(glad_glUniform4fv) uniform4fv = nullptr;
+                decltype(glad_glUniformMatrix2fv) uniform_matrix2fv = nullptr;
+                decltype(glad_glUniformMatrix3fv) uniform_matrix3fv = nullptr;
+                decltype(glad_glUniformMatrix4fv) uniform_matrix4fv = nullptr;
+                decltype(glad_glLinkProgram) link_program = nullptr;
+                decltype(glad_glProgramBinary) program_binary = nullptr;
+                decltype(glad_glDeleteProgram) delete_program = nullptr;
+                decltype(glad_glDeleteTextures) delete_textures = nullptr;
+                decltype(glad_glDeleteFramebuffers) delete_framebuffers = nullptr;
+                decltype(glad_glDeleteVertexArrays) delete_vertex_arrays = nullptr;
+                decltype(glad_glDeleteBuffers) delete_buffers = nullptr;
+            };
+            static GLFunctions orig;
+
+            static bool is_tracked_cap(GLenum cap) {
+                return cap == GL_BLEND || cap == GL_SCISSOR_TEST || cap == GL_DEPTH_TEST ||
+                       cap == GL_CULL_FACE || cap == GL_MULTISAMPLE;
+            }
+
+            // the element array buffer is the state of the vertex arrays, and is not tracked
+            static bool is_tracked_buffer(GLenum target) {
+                return target == GL_ARRAY_BUFFER || target == GL_UNIFORM_BUFFER ||
+                       target == GL_PIXEL_UNPACK_BUFFER || target == GL_PIXEL_PACK_BUFFER;
+            }
+
+            static bool same_uniform(GLint location, int kind, const void* data, size_t size) {
+                if (!state.program || location < 0) {
+                    return false;
+                }
+                auto& value = state.uniforms[*state.program][location];
+                if (value.kind == kind && value.bytes.size() == size &&
+                    std::memcmp(value.bytes.data(), data, size) == 0) {
+                    return true;
+                }
+                const auto bytes = static_cast<const uint8_t*>(data);
+                value.kind = kind;
+                value.bytes.assign(bytes, bytes + size);
+                return false;
+            }
+
+            static void APIENTRY use_program(GLuint program) {
+                if (count(USE_PROGRAM, state.program == program)) {
+                    return;
+                }
+                state.program = program;
+                orig.use_program(program);
+            }
+
+            static void APIENTRY active_texture(GLenum texture) {
+                if (count(ACTIVE_TEXTURE, state.active_texture == texture)) {
+                    return;
+                }
+                state.active_texture = texture;
+                orig.active_texture(texture);
+            }
+
+            static void APIENTRY bind_texture(GLenum target, GLuint texture) {
+                if (!state.active_texture) {
+                    count(BIND_TEXTURE, false);
+                    orig.bind_texture(target, texture);
+                    return;
+                }
+                const uint64_t key = (static_cast<uint64_t>(*state.active_texture) << 32) | target;
+                auto it = state.textures.find(key);
+                if (count(BIND_TEXTURE, it != state.textures.end() && it->second == texture)) {
+                    return;
+                }
+                state.textures[key] = texture;
+                orig.bind_texture(target, texture);
+            }
+
+            static void APIENTRY bind_framebuffer(GLenum target, GLuint framebuffer) {
+                const bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+                const bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+                if (count(BIND_FRAMEBUFFER, (!read || state.read_fbo == framebuffer) &&
+                                                (!draw || state.draw_fbo == framebuffer))) {
+                    return;
+                }
+                if (read) {
+                    state.read_fbo = framebuffer;
+                }
+                if (draw) {
+                    state.draw_fbo = framebuffer;
+                }
+                orig.bind_framebuffer(target, framebuffer);
+            }
+
+            static void APIENTRY bind_vertex_array(GLuint array) {
+                if (count(BIND_VERTEX_ARRAY, state.vao == array)) {
+                    return;
+                }
+                state.vao = array;
+                orig.bind_vertex_array(array);
+            }
+
+            static void APIENTRY bind_buffer(GLenum target, GLuint buffer) {
+                if (!is_tracked_buffer(target)) {
+                    orig.bind_buffer(target, buffer);
+                    return;
+                }
+                auto it = state.buffers.find(target);
+                if (count(BIND_BUFFER, it != state.buffers.end() && it->second == buffer)) {
+                    return;
+                }
+                state.buffers[target] = buffer;
+                orig.bind_buffer(target, buffer);
+            }
+
+            // also binds the buffer to the generic binding point
+            static void APIENTRY bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+                if (is_tracked_buffer(target)) {
+                    state.buffers[target] = buffer;
+                }
+                orig.bind_buffer_base(target, index, buffer);
+            }
+
+            static void APIENTRY enable(GLenum cap) {
+                if (!is_tracked_cap(cap)) {
+                    orig.enable(cap);
+                    return;
+                }
+                auto it = state.caps.find(cap);
+                if (count(ENABLE, it != state.caps.end() && it->second)) {
+                    return;
+                }
+                state.caps[cap] = true;
+                orig.enable(cap);
+            }
+
+            static void APIENTRY disable(GLenum cap) {
+                if (!is_tracked_cap(cap)) {
+                    orig.disable(cap);
+                    return;
+                }
+                auto it = state.caps.find(cap);
+                if (count(DISABLE, it != state.caps.end() && !it->second)) {
+                    return;
+                }
+                state.caps[cap] = false;
+                orig.disable(cap);
+            }
+
+            static void APIENTRY blend_func(GLenum sfactor, GLenum dfactor) {
+                const std::array<GLenum, 2> value = {sfactor, dfactor};
+                if (count(BLEND_FUNC, state.blend_func == value)) {
+                    return;
+                }
+                state.blend_func = value;
+                orig.blend_func(sfactor, dfactor);
+            }
+
+            static void APIENTRY pixel_store(GLenum pname, GLint param) {
+                auto it = state.pixel_store.find(pname);
+                if (count(PIXEL_STORE, it != state.pixel_store.end() && it->second == param)) {
+                    return;
+                }
+                state.pixel_store[pname] = param;
+                orig.pixel_store(pname, param);
+            }
+
+            static void APIENTRY viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+                const std::array<GLint, 4> value = {x, y, width, height};
+                if (count(VIEWPORT, state.viewport == value)) {
+                    return;
+                }
+                state.viewport = value;
+                orig.viewport(x, y, width, height);
+            }
+
+            static void APIENTRY scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+                const std::array<GLint, 4> value = {x, y, width, height};
+                if (count(SCISSOR, state.scissor == value)) {
+                    return;
+                }
+                state.scissor = value;
+                orig.scissor(x, y, width, height);
+            }
+
+            static void APIENTRY clear_color(GLfloat red, GLfloat green, GLfloat blue,
+                                             GLfloat alpha) {
+                const std::array<GLfloat, 4> value = {red, green, blue, alpha};
+                if (count(CLEAR_COLOR, state.clear_color == value)) {
+                    return;
+                }
+                state.clear_color = value;
+                orig.clear_color(red, green, blue, alpha);
+            }
+
+            static void APIENTRY uniform1f(GLint location, GLfloat v0) {
+                const GLfloat value[] = {v0};
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(value)))) {
+                    orig.uniform1f(location, v0);
+                }
+            }
+
+            static void APIENTRY uniform2f(GLint location, GLfloat v0, GLfloat v1) {
+                const GLfloat value[] = {v0, v1};
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(value)))) {
+                    orig.uniform2f(location, v0, v1);
+                }
+            }
+
+            static void APIENTRY uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+                const GLfloat value[] = {v0, v1, v2};
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(value)))) {
+                    orig.uniform3f(location, v0, v1, v2);
+                }
+            }
+
+            static void APIENTRY uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2,
+                                           GLfloat v3) {
+                const GLfloat value[] = {v0, v1, v2, v3};
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(value)))) {
+                    orig.uniform4f(location, v0, v1, v2, v3);
+                }
+            }
+
+            static void APIENTRY uniform1i(GLint location, GLint v0) {
+                const GLint value[] = {v0};
+                if (!count(UNIFORM, same_uniform(location, 1, value, sizeof(value)))) {
+                    orig.uniform1i(location, v0);
+                }
+            }
+
+            static void APIENTRY uniform2i(GLint location, GLint v0, GLint v1) {
+                const GLint value[] = {v0, v1};
+                if (!count(UNIFORM, same_uniform(location, 1, value, sizeof(value)))) {
+                    orig.uniform2i(location, v0, v1);
+                }
+            }
+
+            static void APIENTRY uniform1ui(GLint location, GLuint v0) {
+                const GLuint value[] = {v0};
+                if (!count(UNIFORM, same_uniform(location, 2, value, sizeof(value)))) {
+                    orig.uniform1ui(location, v0);
+                }
+            }
+
+            static void APIENTRY uniform2fv(GLint location, GLsizei cnt, const GLfloat* value) {
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(GLfloat) * 2 * cnt))) {
+                    orig.uniform2fv(location, cnt, value);
+                }
+            }
+
+            static void APIENTRY uniform4fv(GLint location, GLsizei cnt, const GLfloat* value) {
+                if (!count(UNIFORM, same_uniform(location, 0, value, sizeof(GLfloat) * 4 * cnt))) {
+                    orig.uniform4fv(location, cnt, value);
+                }
+            }
+
+            // transposed matrices are cached by a separate kind
+            static void APIENTRY uniform_matrix2fv(GLint location, GLsizei cnt,
+                                                   GLboolean transpose, const GLfloat* value) {
+                if (!count(UNIFORM, same_uniform(location, 3 + transpose, value,
+                                                 sizeof(GLfloat) * 4 * cnt))) {
+                    orig.uniform_matrix2fv(location, cnt, transpose, value);
+                }
+            }
+
+            static void APIENTRY uniform_matrix3fv(GLint location, GLsizei cnt,
+                                                   GLboolean transpose, const GLfloat* value) {
+                if (!count(UNIFORM, same_uniform(location, 3 + transpose, value,
+                                                 sizeof(GLfloat) * 9 * cnt))) {
+                    orig.uniform_matrix3fv(location, cnt, transpose, value);
+                }
+            }
+
+            static void APIENTRY uniform_matrix4fv(GLint location, GLsizei cnt,
+                                                   GLboolean transpose, const GLfloat* value) {
+                if (!count(UNIFORM, same_uniform(location, 3 + transpose, value,
+                                                 sizeof(GLfloat) * 16 * cnt))) {
+                    orig.uniform_matrix4fv(location, cnt, transpose, value);
+                }
+            }
+
+            // linking resets the uniforms
+            static void APIENTRY link_program(GLuint program) {
+                state.uniforms.erase(program);
+                orig.link_program(program);
+            }
+
+            static void APIENTRY program_binary(GLuint program, GLenum format, const void* binary,
+                                                GLsizei length) {
+                state.uniforms.erase(program);
+                orig.program_binary(program, format, binary, length);
+            }
+
+            static void APIENTRY delete_program(GLuint program) {
+                state.uniforms.erase(program);
+                orig.delete_program(program);
+            }
+
+            // deleting the bound objects reverts the bindings to 0
+            static void APIENTRY delete_textures(GLsizei n, const GLuint* textures) {
+                for (GLsizei i = 0; i < n; i++) {
+                    for (auto&& [key, texture] : state.textures) {
+                        texture = texture == textures[i] ? 0 : texture;
+                    }
+                }
+                orig.delete_textures(n, textures);
+            }
+
+            static void APIENTRY delete_framebuffers(GLsizei n, const GLuint* framebuffers) {
+                for (GLsizei i = 0; i < n; i++) {
+                    if (state.read_fbo == framebuffers[i]) {
+                        state.read_fbo = 0;
+                    }
+                    if (state.draw_fbo == framebuffers[i]) {
+                        state.draw_fbo = 0;
+                    }
+                }
+                orig.delete_framebuffers(n, framebuffers);
+            }
+
+            static void APIENTRY delete_vertex_arrays(GLsizei n, const GLuint* arrays) {
+                for (GLsizei i = 0; i < n; i++) {
+                    if (state.vao == arrays[i]) {
+                        state.vao = 0;
+                    }
+                }
+                orig.delete_vertex_arrays(n, arrays);
+            }
+
+            static void APIENTRY delete_buffers(GLsizei n, const GLuint* buffers) {
+                for (GLsizei i = 0; i < n; i++) {
+                    for (auto&& [target, buffer] : state.buffers) {
+                        buffer = buffer == buffers[i] ? 0 : buffer;
+                    }
+                }
+                orig.delete_buffers(n, buffers);
+            }
+
+        }
+
+#define AK_INSTALL_GL_HOOK(gl_func, hook)                                                          \
+    do {                                                                                           \
+        priv::orig.hook = glad_##gl_func;                                                          \
+        glad_##gl_func = priv::hook;                                                               \
+    } while (0)
+
+        void install_gl_state_cache(void) {
+            const char* env = std::getenv("AK_GL_STATE_CACHE");
+            if (env && std::strcmp(env, "0") == 0) {
+                AKLOG_INFON("GL state cache disabled");
+                return;
+            }
+            // glad may be reloaded, which restores the original functions
+            if (glad_glUseProgram != priv::use_program) {
+                AK_INSTALL_GL_HOOK(glUseProgram, use_program);
+                AK_INSTALL_GL_HOOK(glActiveTexture, active_texture);
+                AK_INSTALL_GL_HOOK(glBindTexture, bind_texture);
+                AK_INSTALL_GL_HOOK(glBindFramebuffer, bind_framebuffer);
+                AK_INSTALL_GL_HOOK(glBindVertexArray, bind_vertex_array);
+                AK_INSTALL_GL_HOOK(glBindBuffer, bind_buffer);
+                AK_INSTALL_GL_HOOK(glBindBufferBase, bind_buffer_base);
+                AK_INSTALL_GL_HOOK(glEnable, enable);
+                AK_INSTALL_GL_HOOK(glDisable, disable);
+                AK_INSTALL_GL_HOOK(glBlendFunc, blend_func);
+                AK_INSTALL_GL_HOOK(glPixelStorei, pixel_store);
+                AK_INSTALL_GL_HOOK(glViewport, viewport);
+                AK_INSTALL_GL_HOOK(glScissor, scissor);
+                AK_INSTALL_GL_HOOK(glClearColor, clear_color);
+                AK_INSTALL_GL_HOOK(glUniform1f, uniform1f);
+                AK_INSTALL_GL_HOOK(glUniform2f, uniform2f);
+                AK_INSTALL_GL_HOOK(glUniform3f, uniform3f);
+                AK_INSTALL_GL_HOOK(glUniform4f, uniform4f);
+                AK_INSTALL_GL_HOOK(glUniform1i, uniform1i);
+                AK_INSTALL_GL_HOOK(glUniform2i, uniform2i);
+                AK_INSTALL_GL_HOOK(glUniform1ui, uniform1ui);
+                AK_INSTALL_GL_HOOK(glUniform2fv, uniform2fv);
+                AK_INSTALL_GL_HOOK(glUniform4fv, uniform4fv);
+                AK_INSTALL_GL_HOOK(glUniformMatrix2fv, uniform_matrix2fv);
+                AK_INSTALL_GL_HOOK(glUniformMatrix3fv, uniform_matrix3fv);
+                AK_INSTALL_GL_HOOK(glUniformMatrix4fv, uniform_matrix4fv);
+                AK_INSTALL_GL_HOOK(glLinkProgram, link_program);
+                AK_INSTALL_GL_HOOK(glProgramBinary, program_binary);
+                AK_INSTALL_GL_HOOK(glDeleteProgram, delete_program);
+                AK_INSTALL_GL_HOOK(glDeleteTextures, delete_textures);
+                AK_INSTALL_GL_HOOK(glDeleteFramebuffers, delete_framebuffers);
+                AK_INSTALL_GL_HOOK(glDeleteVertexArrays, delete_vertex_arrays);
+                AK_INSTALL_GL_HOOK(glDeleteBuffers, delete_buffers);
+            }
+            priv::state = priv::GLState{};
+        }
+
+#undef AK_INSTALL_GL_HOOK
+
+        void invalidate_gl_state_cache(void) { priv::state.invalidate(); }
+
+        GLStateStats gl_state_stats(void) {
+            GLStateStats stats;
+            for (const auto& counter : priv::counters) {
+                stats.calls += counter.calls.load(std::memory_order_relaxed);
+                stats.elided += counter.elided.load(std::memory_order_relaxed);
+            }
+            return stats;
+        }
+
+        void log_gl_state_stats(void) {
+            for (size_t i = 0; i < priv::counters.size(); i++) {
+                const auto calls = priv::counters[i].calls.load(std::memory_order_relaxed);
+                if (calls > 0) {
+                    AKLOG_INFO("{}: {} of {} calls elided", priv::FN_NAMES[i],
+                               priv::counters[i].elided.load(std::memory_order_relaxed), calls);
+                }
+            }
+        }
+
+#else
+
+        // the hooks replace the function pointers of glad, which the custom loader does not use
+
+        void install_gl_state_cache(void) {}
+
+        void invalidate_gl_state_cache(void) {}
+
+        GLStateStats gl_state_stats(void) { return {}; }
+
+        void log_gl_state_stats(void) {}
+
+#endif
+
+    }
+}
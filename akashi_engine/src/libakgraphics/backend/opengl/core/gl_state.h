@@ -0,0 +1,43 @@
+#pragma once
+
+#include "./glc.h"
+
+#include <cstdint>
+
+namespace akashi {
+    namespace graphics {
+
+        /**
+         * A cache of the GL state in front of the functions loaded by glad.
+         *
+         * Once installed, binds, capability toggles, blend functions, pixel store parameters,
+         * viewports and uniform updates which would not change the state are skipped. The calls
+         * are counted per function, along with the ones skipped.
+         *
+         * The cached state, including the uniforms, is forgotten on invalidate_gl_state_cache(),
+         * which must be called whenever other code may have used the context, e.g. at the
+         * beginning of each frame. The uniforms of a program are also forgotten when it is
+         * relinked or deleted.
+         *
+         * Setting `AK_GL_STATE_CACHE` to `0` disables it.
+         */
+
+        /**
+         * Must be called right after gladLoadGLLoader(), from the thread which owns the context.
+         */
+        void install_gl_state_cache(void);
+
+        void invalidate_gl_state_cache(void);
+
+        struct GLStateStats {
+            uint64_t calls = 0;
+            uint64_t elided = 0;
+        };
+
+        // the sum over all the tracked functions
+        GLStateStats gl_state_stats(void);
+
+        void log_gl_state_stats(void);
+
+    }
+}
@@ -0,0 +1,309 @@
+#include "./program_cache.h"
+#include "./shader.h"
+
+#include <libakcore/logger.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static constexpr const char BINARY_MAGIC[4] = {'A', 'K', 'P', 'B'};
+        static constexpr const uint32_t BINARY_VERSION = 2;
+
+        // followed by the key of the program, and then the binary
+        struct BinaryHeader {
+            char magic[4];
+            uint32_t version;
+            uint64_t driver_hash;
+            uint64_t hash;
+            uint32_t format;
+            uint32_t length;
+            uint32_t key_length;
+            uint32_t reserved;
+        };
+        static_assert(sizeof(BinaryHeader) == 40);
+
+        // FNV-1a
+        static uint64_t hash_bytes(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325) {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) {
+                h ^= bytes[i];
+                h *= 0x100000001b3;
+            }
+            return h;
+        }
+
+        static uint64_t hash_str(const std::string& str, uint64_t h = 0xcbf29ce484222325) {
+            return hash_bytes(str.data(), str.size(), h);
+        }
+
+        static std::string gl_string(GLenum name) {
+            auto str = glGetString(name);
+            return str ? reinterpret_cast<const char*>(str) : "";
+        }
+
+        static std::string program_key(const std::vector<ShaderStage>& stages) {
+            std::string key;
+            for (const auto& stage : stages) {
+                key += std::to_string(stage.type);
+                key += ':';
+                key += *stage.source;
+                key += '\0';
+            }
+            return key;
+        }
+
+        static std::string default_cache_dir(void) {
+            if (const char* env = std::getenv("AK_SHADER_CACHE_DIR")) {
+                return env;
+            }
+            if (const char* env = std::getenv("XDG_CACHE_HOME"); env && env[0] != '\0') {
+                return std::string(env) + "/akashi/shaders";
+            }
+            if (const char* env = std::getenv("HOME"); env && env[0] != '\0') {
+                return std::string(env) + "/.cache/akashi/shaders";
+            }
+            return "";
+        }
+
+        GLuint ProgramCache::acquire(const std::vector<ShaderStage>& stages) {
+            if (!m_initialized) {
+                this->init();
+            }
+
+            auto key = program_key(stages);
+            if (auto it = m_entries.find(key); it != m_entries.end()) {
+                it->second.ref_count += 1;
+                it->second.last_used = ++m_tick;
+                return it->second.prog;
+            }
+
+            const auto hash = hash_str(key);
+            GLuint prog = this->load_binary(key, hash);
+            if (prog == 0) {
+                prog = this->compile(stages, key, hash);
+                if (prog == 0) {
+                    return 0;
+                }
+            }
+
+            m_prog_keys.insert({prog, key});
+            m_entries.insert({std::move(key), {prog, 1, ++m_tick}});
+            return prog;
+        }
+
+        void ProgramCache::release(GLuint prog) {
+            auto key_it = m_prog_keys.find(prog);
+            if (key_it == m_prog_keys.end()) {
+                AKLOG_WARN("ProgramCache::release(): unknown program {}", prog);
+                return;
+            }
+            auto& entry = m_entries.at(key_it->second);
+            if (entry.ref_count > 0) {
+                entry.ref_count -= 1;
+            }
+            if (entry.ref_count == 0) {
+                this->evict_idle();
+            }
+        }
+
+        void ProgramCache::destroy(void) {
+            for (const auto& [key, entry] : m_entries) {
+                if (entry.ref_count > 0) {
+                    AKLOG_WARN("ProgramCache::destroy(): program {} is still in use", entry.prog);
+                }
+                glDeleteProgram(entry.prog);
+            }
+            m_entries.clear();
+            m_prog_keys.clear();
+        }
+
+        void ProgramCache::init(void) {
+            m_initialized = true;
+
+            GLint num_formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+            if (num_formats <= 0) {
+                AKLOG_INFON("ProgramCache: program binaries are not supported by the driver");
+                return;
+            }
+
+            auto cache_dir = default_cache_dir();
+            if (cache_dir.empty()) {
+                return;
+            }
+            std::error_code ec;
+            std::filesystem::create_directories(cache_dir, ec);
+            if (ec) {
+                AKLOG_WARN("ProgramCache: failed to create {}: {}", cache_dir.c_str(),
+                           ec.message().c_str());
+                return;
+            }
+
+            // binaries are only valid for the exact same driver
+            m_driver_hash = hash_str(gl_string(GL_VENDOR));
+            m_driver_hash = hash_str(gl_string(GL_RENDERER), m_driver_hash);
+            m_driver_hash = hash_str(gl_string(GL_VERSION), m_driver_hash);
+            m_cache_dir = cache_dir;
+        }
+
+        GLuint ProgramCache::compile(const std::vector<ShaderStage>& stages, const std::string& key,
+                                     uint64_t hash) {
+            GLuint prog = glCreateProgram();
+            if (!m_cache_dir.empty()) {
+                glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+
+            for (const auto& stage : stages) {
+                if (!compile_attach_shader(prog, stage.type, stage.source->c_str())) {
+                    glDeleteProgram(prog);
+                    return 0;
+                }
+            }
+            if (!link_shader(prog)) {
+                glDeleteProgram(prog);
+                return 0;
+            }
+
+            this->save_binary(prog, key, hash);
+            return prog;
+        }
+
+        GLuint ProgramCache::load_binary(const std::string& key, uint64_t hash) const {
+            if (m_cache_dir.empty()) {
+                return 0;
+            }
+            std::ifstream ifs(this->binary_path(hash), std::ios::binary);
+            if (!ifs) {
+                return 0;
+            }
+
+            BinaryHeader header;
+            if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+                std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 ||
+                header.version != BINARY_VERSION || header.driver_hash != m_driver_hash ||
+                header.hash != hash || header.key_length != key.size()) {
+                return 0;
+            }
+            // the hash of the sources can collide, so the whole key is compared
+            std::string stored_key(header.key_length, '\0');
+            if (!ifs.read(stored_key.data(), stored_key.size()) || stored_key != key) {
+                return 0;
+            }
+            std::vector<char> binary(header.length);
+            if (!ifs.read(binary.data(), binary.size())) {
+                return 0;
+            }
+
+            GLuint prog = glCreateProgram();
+            glProgramBinary(prog, header.format, binary.data(), binary.size());
+
+            // the driver may reject the binary, e.g. after it has been updated
+            GLint link_status = 0;
+            glGetProgramiv(prog, GL_LINK_STATUS, &link_status);
+            if (!link_status) {
+                AKLOG_INFO("ProgramCache: stale program binary {:016x}", hash);
+                glDeleteProgram(prog);
+                return 0;
+            }
+            return prog;
+        }
+
+        void ProgramCache::save_binary(GLuint prog, const std::string& key, uint64_t hash) const {
+            if (m_cache_dir.empty()) {
+                return;
+            }
+            GLint length = 0;
+            glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0) {
+                return;
+            }
+
+            std::vector<char> binary(length);
+            GLenum format = 0;
+            glGetProgramBinary(prog, length, nullptr, &format, binary.data());
+
+            BinaryHeader header;
+            std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+            header.version = BINARY_VERSION;
+            header.driver_hash = m_driver_hash;
+            header.hash = hash;
+            header.format = format;
+            header.length = static_cast<uint32_t>(length);
+            header.key_length = static_cast<uint32_t>(key.size());
+            header.reserved = 0;
+
+            // write to a temporary file first, so that other processes never see partial ones.
+            // The name is unique, since the workers of a segmented export compile the same
+            // programs at the same time.
+            const auto path = this->binary_path(hash);
+            auto tmp_path = path + ".XXXXXX";
+            const int fd = mkstemp(tmp_path.data());
+            if (fd < 0) {
+                AKLOG_WARN("ProgramCache: failed to create {}: {}", tmp_path.c_str(),
+                           std::strerror(errno));
+                return;
+            }
+            std::FILE* fp = fdopen(fd, "wb");
+            if (!fp) {
+                ::close(fd);
+            }
+            bool written = fp && std::fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                           std::fwrite(key.data(), 1, key.size(), fp) == key.size() &&
+                           std::fwrite(binary.data(), 1, binary.size(), fp) == binary.size();
+            if (fp && std::fclose(fp) != 0) {
+                written = false;
+            }
+            if (!written) {
+                AKLOG_WARN("ProgramCache: failed to write {}", tmp_path.c_str());
+                std::remove(tmp_path.c_str());
+                return;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp_path, path, ec);
+            if (ec) {
+                AKLOG_WARN("ProgramCache: failed to write {}: {}", path.c_str(),
+                           ec.message().c_str());
+                std::remove(tmp_path.c_str());
+            }
+        }
+
+        std::string ProgramCache::binary_path(uint64_t hash) const {
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+            return m_cache_dir + "/" + name;
+        }
+
+        void ProgramCache::evict_idle(void) {
+            size_t nb_idle = 0;
+            for (const auto& [key, entry] : m_entries) {
+                nb_idle += entry.ref_count == 0 ? 1 : 0;
+            }
+            while (nb_idle > MAX_IDLE_PROGRAMS) {
+                auto oldest = m_entries.end();
+                for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
+                    if (it->second.ref_count == 0 &&
+                        (oldest == m_entries.end() ||
+                         it->second.last_used < oldest->second.last_used)) {
+                        oldest = it;
+                    }
+                }
+                glDeleteProgram(oldest->second.prog);
+                m_prog_keys.erase(oldest->second.prog);
+                m_entries.erase(oldest);
+                nb_idle -= 1;
+            }
+        }
+
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "./glc.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        struct ShaderStage {
+            GLenum type;
+            const std::string* source;
+        };
+
+        /**
+         * Shares the linked programs among the objects which have the same shader sources.
+         *
+         * Programs are keyed by their final sources, and are refcounted. A few programs no longer
+         * in use are kept alive, so that recreating layers on atom changes or hot reloads does not
+         * hit the compiler again.
+         *
+         * When the driver supports program binaries, the linked programs are also persisted under
+         * `AK_SHADER_CACHE_DIR` (`$XDG_CACHE_HOME/akashi/shaders` by default), so that warm starts
+         * skip the compilation entirely. Setting `AK_SHADER_CACHE_DIR` to an empty string disables
+         * it.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class ProgramCache final {
+          public:
+            // the number of unused programs kept alive
+            static constexpr const size_t MAX_IDLE_PROGRAMS = 32;
+
+          public:
+            explicit ProgramCache() = default;
+            virtual ~ProgramCache() = default;
+
+            /**
+             * Returns the program linked from `stages`, or 0 on failure.
+             * The returned program must be released with release().
+             */
+            GLuint acquire(const std::vector<ShaderStage>& stages);
+
+            void release(GLuint prog);
+
+            void destroy(void);
+
+          private:
+            struct Entry {
+                GLuint prog = 0;
+                size_t ref_count = 0;
+                uint64_t last_used = 0;
+            };
+
+            void init(void);
+
+            GLuint compile(const std::vector<ShaderStage>& stages, const std::string& key,
+                           uint64_t hash);
+
+            // `hash` names the file, and `key` is stored in it to be compared on load
+            GLuint load_binary(const std::string& key, uint64_t hash) const;
+
+            void save_binary(GLuint prog, const std::string& key, uint64_t hash) const;
+
+            std::string binary_path(uint64_t hash) const;
+
+            void evict_idle(void);
+
+          private:
+            std::unordered_map<std::string, Entry> m_entries;
+            std::unordered_map<GLuint, std::string> m_prog_keys;
+            uint64_t m_tick = 0;
+
+            bool m_initialized = false;
+            // empty when the disk cache is disabled
+            std::string m_cache_dir;
+            // identifies the driver which produced the binaries
+            uint64_t m_driver_hash = 0;
+        };
+
+    }
+}
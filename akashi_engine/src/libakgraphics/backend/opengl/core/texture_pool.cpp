@@ -0,0 +1,54 @@
+#include "./texture_pool.h"
+#include "./texture.h"
+
+#include <libakcore/logger.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        void TexturePool::acquire(OGLTexture& tex) {
+            for (auto it = m_idle.begin(); it != m_idle.end(); it++) {
+                if (it->width == tex.width && it->height == tex.height &&
+                    it->internal_format == tex.internal_format) {
+                    tex.buffer = it->buffer;
+                    m_idle.erase(it);
+                    return;
+                }
+            }
+
+            glGenTextures(1, &tex.buffer);
+            glBindTexture(GL_TEXTURE_2D, tex.buffer);
+            glTexStorage2D(GL_TEXTURE_2D, 1, tex.internal_format, tex.width, tex.height);
+
+            // [XXX] make sure to explicity setup when not using mimap
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        void TexturePool::release(OGLTexture& tex) {
+            if (tex.buffer == 0) {
+                return;
+            }
+            m_idle.push_back({tex.buffer, tex.width, tex.height, tex.internal_format});
+            tex.buffer = 0;
+
+            while (m_idle.size() > MAX_IDLE_TEXTURES) {
+                glDeleteTextures(1, &m_idle.front().buffer);
+                m_idle.erase(m_idle.begin());
+            }
+        }
+
+        void TexturePool::destroy(void) {
+            for (auto&& entry : m_idle) {
+                glDeleteTextures(1, &entry.buffer);
+            }
+            m_idle.clear();
+        }
+
+    }
+}
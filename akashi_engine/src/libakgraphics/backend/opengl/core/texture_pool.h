@@ -0,0 +1,56 @@
+#pragma once
+
+#include "./glc.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        struct OGLTexture;
+
+        /**
+         * Recycles immutable 2D textures with a single level.
+         *
+         * Textures are keyed by their size and internal format. Layers borrow them when their
+         * storages are allocated and return them on destruction, and a few returned ones are kept
+         * alive, so that recreating layers on atom changes does not reallocate them.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class TexturePool final {
+          public:
+            // the number of unused textures kept alive
+            static constexpr const size_t MAX_IDLE_TEXTURES = 16;
+
+          public:
+            explicit TexturePool(void) = default;
+            virtual ~TexturePool(void) = default;
+
+            /**
+             * Sets `tex.buffer` with a texture of `tex.width`x`tex.height` in
+             * `tex.internal_format`. Its contents are undefined, and it must be returned with
+             * release().
+             */
+            void acquire(OGLTexture& tex);
+
+            void release(OGLTexture& tex);
+
+            void destroy(void);
+
+          private:
+            struct Entry {
+                GLuint buffer = 0;
+                int width = 0;
+                int height = 0;
+                GLenum internal_format = 0;
+            };
+
+          private:
+            // in the order of release
+            std::vector<Entry> m_idle;
+        };
+
+    }
+}
@@ -0,0 +1,117 @@
+#include "./upload_ring.h"
+
+#include <libakcore/logger.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static constexpr const GLuint64 FENCE_TIMEOUT_NS = 1000 * 1000 * 1000;
+
+        bool UploadRing::create(size_t slot_size, size_t nb_slots) {
+            if (m_buffer != 0) {
+                this->destroy();
+            }
+            m_slot_size = slot_size;
+            m_next_slot = 0;
+            m_fences.assign(nb_slots, nullptr);
+
+            const auto size = static_cast<GLsizeiptr>(slot_size * nb_slots);
+            glGenBuffers(1, &m_buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+            m_persistent = GLAD_GL_ARB_buffer_storage;
+            if (m_persistent) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                                         GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+                m_mapped =
+                    static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+                if (!m_mapped) {
+                    AKLOG_ERRORN("UploadRing::create(): failed to map the buffer");
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    this->destroy();
+                    return false;
+                }
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            }
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return true;
+        }
+
+        void UploadRing::destroy(void) {
+            for (auto&& fence : m_fences) {
+                if (fence) {
+                    glDeleteSync(fence);
+                    fence = nullptr;
+                }
+            }
+            if (m_buffer != 0) {
+                if (m_mapped) {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+                glDeleteBuffers(1, &m_buffer);
+            }
+            m_buffer = 0;
+            m_mapped = nullptr;
+            m_slot_size = 0;
+        }
+
+        bool UploadRing::begin(Slot& slot) {
+            slot.index = m_next_slot;
+            slot.offset = slot.index * m_slot_size;
+            m_next_slot = (m_next_slot + 1) % m_fences.size();
+
+            // usually signaled long ago, unless the GPU is behind by the whole ring
+            if (auto& fence = m_fences[slot.index]; fence) {
+                GLenum res;
+                while ((res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                               FENCE_TIMEOUT_NS)) == GL_TIMEOUT_EXPIRED) {
+                    AKLOG_WARNN("UploadRing::begin(): waiting for the GPU");
+                }
+                glDeleteSync(fence);
+                fence = nullptr;
+                if (res == GL_WAIT_FAILED) {
+                    AKLOG_ERRORN("UploadRing::begin(): glClientWaitSync() failed");
+                    return false;
+                }
+            }
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+            if (m_persistent) {
+                slot.ptr = m_mapped + slot.offset;
+            } else {
+                // the fence above guarantees that the range is no longer read
+                slot.ptr = static_cast<uint8_t*>(glMapBufferRange(
+                    GL_PIXEL_UNPACK_BUFFER, slot.offset, m_slot_size,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+            }
+            if (!slot.ptr) {
+                AKLOG_ERRORN("UploadRing::begin(): failed to map the slot");
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return false;
+            }
+            return true;
+        }
+
+        bool UploadRing::end(const Slot& /*slot*/) {
+            if (!m_persistent && !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+                AKLOG_ERRORN("UploadRing::end(): the slot got corrupted");
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return false;
+            }
+            return true;
+        }
+
+        void UploadRing::fence(const Slot& slot) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            m_fences[slot.index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+    }
+}
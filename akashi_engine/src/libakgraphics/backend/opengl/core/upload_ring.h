@@ -0,0 +1,76 @@
+#pragma once
+
+#include "./glc.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        /**
+         * A ring of pixel unpack buffer slots, for streaming pixels to textures without stalls.
+         *
+         * With ARB_buffer_storage, the buffer is allocated once and mapped persistently, so that
+         * writing a slot is a plain memcpy, and the copy to the textures runs asynchronously on
+         * the GPU. Otherwise, each slot is mapped unsynchronized on begin().
+         * Each slot is fenced after use, and is not written again until the GPU is done with it.
+         *
+         * Usage:
+         *   begin(slot) -> write to slot.ptr -> end(slot) -> glTexSubImage*(slot.offset) ->
+         *   fence(slot)
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class UploadRing final {
+          public:
+            struct Slot {
+                size_t index = 0;
+                // the offset in the buffer, to be passed to glTexSubImage*() as the pointer
+                size_t offset = 0;
+                uint8_t* ptr = nullptr;
+            };
+
+            static constexpr const size_t DEFAULT_SLOTS = 3;
+
+          public:
+            explicit UploadRing(void) = default;
+            virtual ~UploadRing(void) = default;
+
+            bool create(size_t slot_size, size_t nb_slots = DEFAULT_SLOTS);
+
+            void destroy(void);
+
+            bool created(void) const { return m_buffer != 0; }
+
+            size_t slot_size(void) const { return m_slot_size; }
+
+            /**
+             * Waits until the GPU is done with the next slot, and makes it writable.
+             * The buffer is left bound to GL_PIXEL_UNPACK_BUFFER.
+             */
+            bool begin(Slot& slot);
+
+            /**
+             * Makes the written slot visible to the GPU.
+             * The buffer is left bound to GL_PIXEL_UNPACK_BUFFER.
+             */
+            bool end(const Slot& slot);
+
+            /**
+             * Marks the slot as in use by the commands issued so far, and unbinds the buffer.
+             */
+            void fence(const Slot& slot);
+
+          private:
+            GLuint m_buffer = 0;
+            uint8_t* m_mapped = nullptr;
+            bool m_persistent = false;
+            size_t m_slot_size = 0;
+            size_t m_next_slot = 0;
+            std::vector<GLsync> m_fences;
+        };
+
+    }
+}
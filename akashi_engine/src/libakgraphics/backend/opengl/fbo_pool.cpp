@@ -0,0 +1,73 @@
+#include "./fbo_pool.h"
+#include "./fbo.h"
+
+#include <libakcore/logger.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        FBO* FBOPool::acquire(int width, int height, int msaa, bool enable_alpha) {
+            const std::array<int, 4> key = {width, height, msaa, enable_alpha ? 1 : 0};
+            for (auto&& entry : m_entries) {
+                if (!entry.in_use && entry.key == key) {
+                    entry.in_use = true;
+                    entry.last_used = ++m_tick;
+                    return entry.fbo.get();
+                }
+            }
+
+            auto fbo = core::make_owned<FBO>();
+            if (!fbo->create(width, height, msaa, enable_alpha)) {
+                AKLOG_ERROR("FBOPool::acquire(): failed to create a {}x{} FBO", width, height);
+                fbo->destroy();
+                return nullptr;
+            }
+            m_entries.push_back({std::move(fbo), key, true, ++m_tick});
+            return m_entries.back().fbo.get();
+        }
+
+        void FBOPool::release(FBO* fbo) {
+            for (auto&& entry : m_entries) {
+                if (entry.fbo.get() == fbo) {
+                    entry.in_use = false;
+                    entry.last_used = ++m_tick;
+                    this->evict_idle();
+                    return;
+                }
+            }
+            AKLOG_WARNN("FBOPool::release(): unknown FBO");
+        }
+
+        void FBOPool::destroy(void) {
+            for (auto&& entry : m_entries) {
+                if (entry.in_use) {
+                    AKLOG_WARN("FBOPool::destroy(): FBO {} is still in use", entry.fbo->info().fbo);
+                }
+                entry.fbo->destroy();
+            }
+            m_entries.clear();
+        }
+
+        void FBOPool::evict_idle(void) {
+            size_t nb_idle = 0;
+            for (const auto& entry : m_entries) {
+                nb_idle += entry.in_use ? 0 : 1;
+            }
+            while (nb_idle > MAX_IDLE_FBOS) {
+                auto oldest = m_entries.end();
+                for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
+                    if (!it->in_use &&
+                        (oldest == m_entries.end() || it->last_used < oldest->last_used)) {
+                        oldest = it;
+                    }
+                }
+                oldest->fbo->destroy();
+                m_entries.erase(oldest);
+                nb_idle -= 1;
+            }
+        }
+
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <libakcore/memory.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        class FBO;
+
+        /**
+         * Recycles the framebuffers of the render planes.
+         *
+         * Framebuffers are keyed by their size and format. Planes borrow them on creation and
+         * return them on destruction, and a few returned ones are kept alive, so that atom
+         * changes and units coming and going do not reallocate the MSAA attachments.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class FBOPool final {
+          public:
+            // the number of unused framebuffers kept alive
+            static constexpr const size_t MAX_IDLE_FBOS = 8;
+
+          public:
+            explicit FBOPool(void) = default;
+            virtual ~FBOPool(void) = default;
+
+            /**
+             * Returns a framebuffer which is not in use, or nullptr on failure.
+             * Its contents are undefined, and it must be returned with release().
+             */
+            FBO* acquire(int width, int height, int msaa, bool enable_alpha = true);
+
+            void release(FBO* fbo);
+
+            void destroy(void);
+
+          private:
+            struct Entry {
+                core::owned_ptr<FBO> fbo;
+                std::array<int, 4> key;
+                bool in_use = false;
+                uint64_t last_used = 0;
+            };
+
+            void evict_idle(void);
+
+          private:
+            std::vector<Entry> m_entries;
+            uint64_t m_tick = 0;
+        };
+
+    }
+}
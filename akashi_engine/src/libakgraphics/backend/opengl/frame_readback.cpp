@@ -0,0 +1,289 @@
+#include "./frame_readback.h"
+
+#include "../../item.h"
+#include "./core/texture.h"
+#include "./core/shader.h"
+
+#include <libakcore/error.h>
+#include <libakcore/logger.h>
+
+#include <cstring>
+#include <string>
+
+using namespace akashi::core;
+
+static constexpr const char* vshader_src = u8R"(
+    #version 420 core
+
+    // a triangle covering the viewport
+    void main(void){
+        vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+static constexpr const char* fshader_src = u8R"(
+    layout(binding=0) uniform sampler2D u_rgb_tex;
+
+    #ifdef AK_NV12
+    layout(rg8, binding=1) writeonly uniform image2D u_uv_img;
+    #endif
+
+    out vec4 frag_color;
+
+    // the frame is upside down in the texture
+    vec3 fetch_rgb(ivec2 pos){
+        ivec2 size = textureSize(u_rgb_tex, 0);
+        return texelFetch(u_rgb_tex, ivec2(pos.x, (size.y - 1) - pos.y), 0).rgb;
+    }
+
+    const mat3 mat_yuv_bt709 = mat3(
+         0.2126,     0.7152,    0.0722,
+        -0.114572,  -0.385428,  0.5,
+         0.5,       -0.454153, -0.045847
+    );
+
+    // BT.709, limited range
+    vec3 to_yuv_bt709(vec3 rgb){
+        // transpose
+        vec3 yuv = rgb * mat_yuv_bt709;
+        return vec3(yuv.x * (219.0 / 255.0) + (16.0 / 255.0),
+                    yuv.yz * (224.0 / 255.0) + (128.0 / 255.0));
+    }
+
+    void main(void){
+        ivec2 pos = ivec2(gl_FragCoord.xy);
+
+    #ifdef AK_NV12
+        frag_color = vec4(to_yuv_bt709(fetch_rgb(pos)).x, 0.0, 0.0, 1.0);
+
+        if (pos.x % 2 == 0 && pos.y % 2 == 0) {
+            vec3 rgb = fetch_rgb(pos) + fetch_rgb(pos + ivec2(1, 0)) +
+                       fetch_rgb(pos + ivec2(0, 1)) + fetch_rgb(pos + ivec2(1, 1));
+            imageStore(u_uv_img, pos / 2, vec4(to_yuv_bt709(rgb * 0.25).yz, 0.0, 0.0));
+        }
+    #else
+        frag_color = vec4(fetch_rgb(pos), 1.0);
+    #endif
+    }
+)";
+
+namespace akashi {
+    namespace graphics {
+
+        bool FrameReadback::push(EncodeRenderParams& params, const OGLTexture& rgb_tex,
+                                 const core::Rational& pts) {
+            params.filled = false;
+
+            // the previous frames stay in their buffers
+            if (m_format != params.format || m_width != rgb_tex.width ||
+                m_height != rgb_tex.height) {
+                CHECK_AK_ERROR2(this->load_planes(params.format, rgb_tex.width, rgb_tex.height));
+            }
+
+            this->convert(rgb_tex);
+
+            auto& slot = m_slots[(m_head + m_nb_pending) % m_slots.size()];
+            slot.pts = pts;
+            this->read_planes(slot);
+            m_nb_pending += 1;
+
+            if (m_nb_pending > MAX_LATENCY) {
+                CHECK_AK_ERROR2(this->pop(params));
+            }
+            return true;
+        }
+
+        bool FrameReadback::pop(EncodeRenderParams& params) {
+            params.filled = false;
+            if (m_nb_pending == 0) {
+                return true;
+            }
+            auto& slot = m_slots[m_head];
+            m_head = (m_head + 1) % m_slots.size();
+            m_nb_pending -= 1;
+
+            // usually returns immediately, since the frame was issued a few frames ago
+            GLenum status;
+            do {
+                status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            if (status == GL_WAIT_FAILED) {
+                AKLOG_ERRORN("glClientWaitSync() failed");
+                return false;
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            auto data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+            if (!data) {
+                AKLOG_ERRORN("glMapBufferRange() failed");
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                return false;
+            }
+            std::memcpy(params.buffer, data, slot.size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            params.filled = true;
+            params.pts = slot.pts;
+            params.width = m_width;
+            params.height = m_height;
+            return true;
+        }
+
+        void FrameReadback::destroy(void) {
+            for (auto&& slot : m_slots) {
+                if (slot.fence) {
+                    glDeleteSync(slot.fence);
+                }
+                if (slot.pbo != 0) {
+                    glDeleteBuffers(1, &slot.pbo);
+                }
+                slot = {};
+            }
+            m_head = 0;
+            m_nb_pending = 0;
+
+            glDeleteTextures(m_planes.size(), m_planes.data());
+            m_planes = {0, 0};
+            if (m_fbo != 0) {
+                glDeleteFramebuffers(1, &m_fbo);
+            }
+            m_fbo = 0;
+            if (m_prog != 0) {
+                glDeleteProgram(m_prog);
+            }
+            m_prog = 0;
+            if (m_vao != 0) {
+                glDeleteVertexArrays(1, &m_vao);
+            }
+            m_vao = 0;
+            m_format = core::VideoBufferFormat::NONE;
+        }
+
+        bool FrameReadback::load_pass(core::VideoBufferFormat format) {
+            if (m_prog != 0) {
+                glDeleteProgram(m_prog);
+            }
+            m_prog = glCreateProgram();
+
+            std::string fshader = "#version 420 core\n";
+            if (format == core::VideoBufferFormat::NV12) {
+                fshader += "#define AK_NV12\n";
+            }
+            fshader += fshader_src;
+
+            CHECK_AK_ERROR2(compile_attach_shader(m_prog, GL_VERTEX_SHADER, vshader_src));
+            CHECK_AK_ERROR2(compile_attach_shader(m_prog, GL_FRAGMENT_SHADER, fshader.c_str()));
+            CHECK_AK_ERROR2(link_shader(m_prog));
+
+            if (m_vao == 0) {
+                glGenVertexArrays(1, &m_vao);
+            }
+            return true;
+        }
+
+        bool FrameReadback::load_planes(core::VideoBufferFormat format, int width, int height) {
+            if (format == core::VideoBufferFormat::NV12 && (width % 2 != 0 || height % 2 != 0)) {
+                AKLOG_ERROR("NV12 requires an even resolution, got {}x{}", width, height);
+                return false;
+            }
+            if (format != m_format) {
+                CHECK_AK_ERROR2(this->load_pass(format));
+            }
+
+            glDeleteTextures(m_planes.size(), m_planes.data());
+            m_planes = {0, 0};
+            glGenTextures(format == core::VideoBufferFormat::NV12 ? 2 : 1, m_planes.data());
+
+            if (format == core::VideoBufferFormat::NV12) {
+                glBindTexture(GL_TEXTURE_2D, m_planes[0]);
+                glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, width, height);
+                glBindTexture(GL_TEXTURE_2D, m_planes[1]);
+                glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG8, width / 2, height / 2);
+            } else {
+                glBindTexture(GL_TEXTURE_2D, m_planes[0]);
+                glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            if (m_fbo == 0) {
+                glGenFramebuffers(1, &m_fbo);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   m_planes[0], 0);
+            auto err = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (err != GL_FRAMEBUFFER_COMPLETE) {
+                AKLOG_ERROR("Failed to create FBO: 0x{:x}, {}", err, gl_err_to_str(err));
+                return false;
+            }
+
+            m_format = format;
+            m_width = width;
+            m_height = height;
+            return true;
+        }
+
+        void FrameReadback::convert(const OGLTexture& rgb_tex) {
+            const bool blend = glIsEnabled(GL_BLEND);
+            glDisable(GL_BLEND);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+            glViewport(0, 0, m_width, m_height);
+            glUseProgram(m_prog);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, rgb_tex.buffer);
+            if (m_format == core::VideoBufferFormat::NV12) {
+                glBindImageTexture(1, m_planes[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG8);
+            }
+
+            glBindVertexArray(m_vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            // makes the stores to the chroma plane visible to the transfers
+            glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+            if (blend) {
+                glEnable(GL_BLEND);
+            }
+        }
+
+        void FrameReadback::read_planes(Slot& slot) {
+            const size_t size = core::video_buffer_size(m_format, m_width, m_height);
+            if (slot.pbo == 0) {
+                glGenBuffers(1, &slot.pbo);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            if (slot.size != size) {
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+                slot.size = size;
+            }
+
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            if (m_format == core::VideoBufferFormat::NV12) {
+                const size_t luma_size = static_cast<size_t>(m_width) * m_height;
+                glBindTexture(GL_TEXTURE_2D, m_planes[0]);
+                glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+                glBindTexture(GL_TEXTURE_2D, m_planes[1]);
+                glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_UNSIGNED_BYTE,
+                              reinterpret_cast<void*>(luma_size));
+            } else {
+                glBindTexture(GL_TEXTURE_2D, m_planes[0]);
+                glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4); // reset to the initial value;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+    }
+}
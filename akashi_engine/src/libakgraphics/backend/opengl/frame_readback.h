@@ -0,0 +1,84 @@
+#pragma once
+
+#include "./core/glc.h"
+
+#include <libakcore/rational.h>
+#include <libakcore/hw_accel.h>
+
+#include <array>
+#include <cstddef>
+
+namespace akashi {
+    namespace graphics {
+
+        struct EncodeRenderParams;
+        struct OGLTexture;
+
+        /**
+         * Reads the rendered frames back for the software encoders.
+         *
+         * A final pass converts the frame into the requested layout on the GPU, flipping it
+         * upright, and the result is copied into a ring of pixel pack buffers guarded by fences.
+         * So the transfer of a frame overlaps with the rendering of the next ones, and the frames
+         * come out MAX_LATENCY frames late.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class FrameReadback final {
+          public:
+            // the number of frames in flight, after which push() returns the oldest one
+            static constexpr const size_t MAX_LATENCY = 2;
+
+          public:
+            explicit FrameReadback(void) = default;
+            virtual ~FrameReadback(void) = default;
+
+            /**
+             * Starts reading back `rgb_tex`, and copies the oldest frame into `params` when more
+             * than MAX_LATENCY frames are in flight.
+             */
+            bool push(EncodeRenderParams& params, const OGLTexture& rgb_tex,
+                      const core::Rational& pts);
+
+            /**
+             * Copies the oldest frame in flight into `params`, if any.
+             */
+            bool pop(EncodeRenderParams& params);
+
+            void destroy(void);
+
+          private:
+            struct Slot {
+                GLuint pbo = 0;
+                size_t size = 0;
+                GLsync fence = nullptr;
+                core::Rational pts = core::Rational(-1, 1);
+            };
+
+            bool load_pass(core::VideoBufferFormat format);
+
+            bool load_planes(core::VideoBufferFormat format, int width, int height);
+
+            void convert(const OGLTexture& rgb_tex);
+
+            void read_planes(Slot& slot);
+
+          private:
+            std::array<Slot, MAX_LATENCY + 1> m_slots;
+            size_t m_head = 0;
+            size_t m_nb_pending = 0;
+
+            core::VideoBufferFormat m_format = core::VideoBufferFormat::NONE;
+            int m_width = 0;
+            int m_height = 0;
+            // rgba for RGB24, or luma and chroma for NV12
+            std::array<GLuint, 2> m_planes = {0, 0};
+            // renders to the first plane
+            GLuint m_fbo = 0;
+
+            GLuint m_prog = 0;
+            GLuint m_vao = 0;
+        };
+
+    }
+}
@@ -0,0 +1,57 @@
+#include "./layer_batch.h"
+#include "./layer_object.h"
+
+#include <libakcore/error.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static_assert(sizeof(layer::BatchParams) == 160, "must match the std140 layout");
+
+        LayerBatch::LayerBatch(void) {
+            const char* env = std::getenv("AK_LAYER_BATCH");
+            m_enabled = !env || std::strcmp(env, "0") != 0;
+        }
+
+        bool LayerBatch::render(OGLRenderContext& ctx, const std::vector<LayerObject*>& layers,
+                                const Camera& camera) {
+            if (m_ubo == 0) {
+                glGenBuffers(1, &m_ubo);
+            }
+
+            for (size_t begin = 0; begin < layers.size(); begin += MAX_LAYERS) {
+                const size_t nb_layers = std::min(layers.size() - begin, MAX_LAYERS);
+                m_params.resize(nb_layers);
+                for (size_t i = 0; i < nb_layers; i++) {
+                    layers[begin + i]->batch_params(m_params[i], camera);
+                }
+
+                // orphans the previous chunk, which may be still in use by the GPU
+                glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+                glBufferData(GL_UNIFORM_BUFFER, sizeof(layer::BatchParams) * MAX_LAYERS, nullptr,
+                             GL_STREAM_DRAW);
+                glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(layer::BatchParams) * nb_layers,
+                                m_params.data());
+                glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_ubo);
+
+                CHECK_AK_ERROR2(layers[begin]->render_instances(ctx, nb_layers));
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            return true;
+        }
+
+        void LayerBatch::destroy(void) {
+            if (m_ubo != 0) {
+                glDeleteBuffers(1, &m_ubo);
+            }
+            m_ubo = 0;
+        }
+
+    }
+}
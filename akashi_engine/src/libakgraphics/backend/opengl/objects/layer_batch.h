@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../core/glc.h"
+#include "./layer_commons.h"
+
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        class OGLRenderContext;
+        class LayerObject;
+        class Camera;
+
+        /**
+         * Draws consecutive layers of the same layer::BatchKey by instances.
+         *
+         * The per-layer parameters are streamed to a uniform block, and each chunk of layers is
+         * drawn by a single draw call, with the mesh and the textures of the first layer.
+         * Setting `AK_LAYER_BATCH` to `0` disables it.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class LayerBatch final {
+          public:
+            // fits in the minimum GL_MAX_UNIFORM_BLOCK_SIZE (16KB)
+            static constexpr const size_t MAX_LAYERS = 64;
+
+          public:
+            explicit LayerBatch(void);
+            virtual ~LayerBatch(void) = default;
+
+            bool enabled(void) const { return m_enabled; }
+
+            /**
+             * Draws `layers` in order. Every layer must have the same key.
+             */
+            bool render(OGLRenderContext& ctx, const std::vector<LayerObject*>& layers,
+                        const Camera& camera);
+
+            void destroy(void);
+
+          private:
+            GLuint m_ubo = 0;
+            std::vector<layer::BatchParams> m_params;
+            bool m_enabled = true;
+        };
+
+    }
+}
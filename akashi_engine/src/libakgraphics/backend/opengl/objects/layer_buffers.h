@@ -3,6 +3,8 @@
 #include "./layer_commons.h"
 #include "./layer_shaders.h"
 #include "./layer_video_texture.h"
+#include "./layer_image_texture.h"
+#include "./layer_shape_texture.h"
 #include "../meshes/quad.h"
 #include "../core/texture.h"
 
@@ -14,14 +16,20 @@
 #include <libakcore/rational.h>
 #include <libakcore/error.h>
 #include <libakcore/logger.h>
+#include <libakcore/color.h>
 
 #include <SDL.h>
-#include "../resource/image.h"
 #include "../resource/font.h"
+#include "../text/text_renderer.h"
 
 #include <libakvgfx/akvgfx.h>
 #include <libakvgfx/item.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
 namespace akashi {
     namespace graphics::layer {
 
@@ -59,95 +67,59 @@ namespace akashi {
             return detail::get_mesh_size(safe_ctx.layer_size, orig_size);
         }
 
-        inline bool load_image_texture(layer::Texture* tex, OGLRenderContext& ctx,
-                                       const core::LayerContext& layer_ctx) {
-            const auto& srcs = layer_ctx.t_image->srcs;
-            if (srcs.empty()) {
-                AKLOG_ERRORN("Failed to getSurface. `srcs` is null");
-                return false;
+        /**
+         * Returns the smallest size the image needs to have in order not to be magnified,
+         * or negative values when it is unknown.
+         */
+        inline std::array<int, 2> get_image_min_size(const core::LayerContext& layer_ctx) {
+            if (!layer_ctx.t_transform) {
+                return {-1, -1};
             }
-
-            auto num_sprites = srcs.size();
-            std::vector<SDL_Surface*> surfaces(num_sprites, nullptr);
-
-            auto image_bits = 0;
-            for (size_t i = 0; i < surfaces.size(); i++) {
-                const auto& image_path = srcs[i];
-                if (ImageLoader::GetInstance().getSurface(surfaces[i], image_path.c_str()) !=
-                    core::ErrorType::OK) {
-                    AKLOG_ERROR("Failed to getSurface: {}", image_path.c_str());
-                    return false;
-                }
-
-                auto cur_image_bits = surfaces[i]->format->BytesPerPixel;
-                if (i == 0) {
-                    image_bits = cur_image_bits;
-                } else {
-                    if (image_bits != cur_image_bits) {
-                        const auto& first_path = srcs[0];
-                        AKLOG_ERROR("Image channel mismatch found: `{}`(bits={}) != `{}`(bits={})",
-                                    first_path.c_str(), image_bits, image_path.c_str(),
-                                    cur_image_bits);
-                        for (auto&& surface : surfaces) {
-                            SDL_FreeSurface(surface);
-                        }
-                        return false;
-                    }
+            const auto& layer_size = layer_ctx.t_transform->layer_size;
+            const auto& scale = layer_ctx.t_transform->scale;
+            std::array<int, 2> min_size = {-1, -1};
+            for (size_t i = 0; i < min_size.size(); i++) {
+                if (layer_size[i] > 0) {
+                    min_size[i] = std::ceil(layer_size[i] * std::max(1.0, std::abs(scale[i])));
                 }
             }
+            return min_size;
+        }
 
-            tex->basic = new OGLTexture;
-            tex->main_tex_loc = UniformLocation::image_textures;
-
-            tex->basic->width = surfaces[0]->w;
-            tex->basic->height = surfaces[0]->h;
-            tex->basic->effective_width = surfaces[0]->w;
-            tex->basic->effective_height = surfaces[0]->h;
-            tex->basic->format = (surfaces[0]->format->BytesPerPixel == 3) ? GL_RGB : GL_RGBA;
-            tex->basic->internal_format =
-                (surfaces[0]->format->BytesPerPixel == 3) ? GL_RGB8 : GL_RGBA8;
-            tex->basic->target = GL_TEXTURE_2D_ARRAY;
-
-            glGenTextures(1, &tex->basic->buffer);
-
-            glBindTexture(GL_TEXTURE_2D_ARRAY, tex->basic->buffer);
-
-            // 1. below GL4.2
-            // GET_GLFUNC(ctx, glTexImage3D)
-            // (GL_TEXTURE_2D_ARRAY, 0, tex.internal_format, tex.width, tex.height,
-            // m_surfaces.size(),
-            //  0, tex.format, GL_UNSIGNED_BYTE, nullptr);
-
-            // 2. GL4.2+
-            glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, tex->basic->internal_format, tex->basic->width,
-                           tex->basic->height, surfaces.size());
-
-            // GET_GLFUNC(ctx, glGenerateMipmap)(GL_TEXTURE_2D_ARRAY);
-
-            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            for (size_t i = 0; i < surfaces.size(); i++) {
-                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, tex->basic->width,
-                                tex->basic->height, 1, tex->basic->format, GL_UNSIGNED_BYTE,
-                                surfaces[i]->pixels);
+        /**
+         * Loads the buffers of image layers without blocking, unless `ctx.async_loads()` is
+         * false. `ready` is set to false while the images are still being decoded.
+         * The texture must be released with ImageTextureCache::release().
+         */
+        inline bool load_image_buffers(layer::Texture* tex, layer::Mesh* mesh, bool* ready,
+                                       OGLRenderContext& ctx,
+                                       const layer::SafeLayerContext& safe_ctx,
+                                       const std::vector<std::string>& srcs,
+                                       const std::array<int, 2>& min_size) {
+            ImageTexture image;
+            auto status =
+                ctx.image_textures()->acquire(image, srcs, min_size, !ctx.async_loads());
+            *ready = status == ImageCache::Status::READY;
+            if (status == ImageCache::Status::FAILED) {
+                return false;
             }
-
-            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
-
-            for (auto&& surface : surfaces) {
-                SDL_FreeSurface(surface);
+            if (!*ready) {
+                return true;
             }
 
+            tex->basic = new OGLTexture(image.tex);
+            tex->main_tex_loc = UniformLocation::image_textures;
+
+            // downscaled images are displayed at the original size
+            auto mesh_size = get_mesh_size(safe_ctx, image.source_size);
+            mesh->quad = new QuadMesh;
+            CHECK_AK_ERROR2(
+                mesh->quad->create(mesh_size, InputLocation::vertices, InputLocation::uvs));
             return true;
         }
 
         inline bool load_text_texture(layer::Texture* tex, OGLRenderContext& ctx,
                                       const core::LayerContext& layer_ctx) {
-            SDL_Surface* surface = nullptr;
-
             FontInfo info;
             info.text = layer_ctx.t_text->text;
             info.text_align = layer_ctx.t_text->text_align;
@@ -171,204 +143,163 @@ namespace akashi {
             shadow.color = hex_to_sdl(style.shadow_color);
             shadow.size = style.shadow_size;
 
-            if (!FontLoader::GetInstance().get_surface(surface, info,
-                                                       style.use_outline ? &outline : nullptr,
-                                                       style.use_shadow ? &shadow : nullptr)) {
-                AKLOG_ERRORN("Failed to getFontsSurface");
-                return false;
-            }
-
             tex->basic = new OGLTexture;
             tex->main_tex_loc = UniformLocation::text_texture0;
 
-            tex->basic->image = surface->pixels;
-            tex->basic->width = surface->w;
-            tex->basic->height = surface->h;
-            tex->basic->effective_width = tex->basic->width;
-            tex->basic->effective_height = tex->basic->height;
-            tex->basic->format = (surface->format->BytesPerPixel == 3) ? GL_RGB : GL_RGBA;
-
-            tex->basic->surface = surface;
-
-            glGenTextures(1, &tex->basic->buffer);
-
-            glBindTexture(GL_TEXTURE_2D, tex->basic->buffer);
-            glTexImage2D(GL_TEXTURE_2D, 0, tex->basic->internal_format, tex->basic->width,
-                         tex->basic->height, 0, tex->basic->format, GL_UNSIGNED_BYTE,
-                         tex->basic->image);
-
-            // glGenerateMipmap(GL_TEXTURE_2D);
-
-            // [XXX] make sure to explicity setup when not using mimap
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glBindTexture(GL_TEXTURE_2D, 0);
+            if (!ctx.text_renderer()->render(*tex->basic, info,
+                                             style.use_outline ? &outline : nullptr,
+                                             style.use_shadow ? &shadow : nullptr)) {
+                AKLOG_ERRORN("Failed to render the text");
+                return false;
+            }
 
             return true;
         }
 
-        inline bool load_shape_texture(layer::Texture* tex, const vgfx::Surface& surface) {
-            tex->basic = new OGLTexture;
-            tex->main_tex_loc = UniformLocation::shape_texture0;
-
-            tex->basic->image = surface.buffer();
-            tex->basic->width = surface.info().width;
-            tex->basic->height = surface.info().height;
-            tex->basic->effective_width = tex->basic->width;
-            tex->basic->effective_height = tex->basic->height;
-
-            tex->basic->format = surface.info().format == vgfx::SurfaceFormat::RGB24
-                                     ? (surface.info().format_swap ? GL_BGR : GL_RGB)
-                                     : (surface.info().format_swap ? GL_BGRA : GL_RGBA);
-
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-            {
-                glGenTextures(1, &tex->basic->buffer);
-
-                glBindTexture(GL_TEXTURE_2D, tex->basic->buffer);
+        inline bool use_shape_sdf(void) {
+            static const bool enabled = []() {
+                const char* env = std::getenv("AK_SHAPE_SDF");
+                return env && std::strcmp(env, "0") != 0;
+            }();
+            return enabled;
+        }
 
-                int bytes_per_pixel = surface.info().format == vgfx::SurfaceFormat::RGB24 ? 3 : 4;
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, surface.info().stride / bytes_per_pixel);
-                {
-                    glTexImage2D(GL_TEXTURE_2D, 0, tex->basic->internal_format, tex->basic->width,
-                                 tex->basic->height, 0, tex->basic->format, GL_UNSIGNED_BYTE,
-                                 tex->basic->image);
+        inline void load_shape_params(layer::ShapeParams* params, ShapeKind shape_kind,
+                                      const std::array<float, 2>& shape_size,
+                                      const vgfx::SurfaceEntry& entry,
+                                      const core::LayerContext& layer_ctx) {
+            const core::BaseShapeTField* shape_field = nullptr;
+            switch (shape_kind) {
+                case ShapeKind::RECT: {
+                    shape_field = &(*layer_ctx.t_rect);
+                    break;
+                }
+                case ShapeKind::CIRCLE: {
+                    shape_field = &(*layer_ctx.t_circle);
+                    break;
+                }
+                case ShapeKind::TRI: {
+                    shape_field = &(*layer_ctx.t_tri);
+                    // same as create_tri_surface() in libakvgfx
+                    const auto& tri = *layer_ctx.t_tri;
+                    const float top_y = shape_size[1] * std::abs(1.0 - tri.hr);
+                    float apex_x = tri.wr * tri.width;
+                    float base_x = 0;
+                    if (tri.wr < 0) {
+                        apex_x = 0;
+                        base_x = std::abs(tri.wr) * tri.width;
+                    } else if (tri.wr > 1) {
+                        apex_x = shape_size[0] - tri.width;
+                        base_x = shape_size[0] - (1 + tri.wr) * tri.width;
+                    }
+                    params->points = {apex_x, top_y, base_x, shape_size[1], base_x + tri.width,
+                                      shape_size[1]};
+                    break;
+                }
+                case ShapeKind::LINE: {
+                    shape_field = &(*layer_ctx.t_line);
+                    const auto& line = *layer_ctx.t_line;
+                    params->points = {(float)line.begin[0], (float)line.begin[1],
+                                      (float)line.end[0], (float)line.end[1], 0, 0};
+                    break;
+                }
+                default: {
+                    return;
                 }
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-
-                // [XXX] make sure to explicity setup when not using mimap
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-                glBindTexture(GL_TEXTURE_2D, 0);
             }
-            glPixelStorei(GL_UNPACK_ALIGNMENT, graphics::DEFAULT_UNPACK_ALIGNMENT);
 
-            return true;
+            params->kind = shape_kind;
+            params->frame = {shape_size[0], shape_size[1],
+                             (float)shape_field->border_size * (entry.border_padv / 2),
+                             (float)shape_field->edge_radius};
+            if (!shape_field->fill_color.empty()) {
+                params->fill_color = core::to_rgba_float(shape_field->fill_color);
+            }
+            params->border = {(float)shape_field->border_size,
+                              (float)shape_field->border_direction};
+            params->border_color = core::to_rgba_float(
+                shape_field->border_color.empty() ? "#ffffff" : shape_field->border_color);
+
+            // lines are stroked with the fill color, and have no borders
+            if (shape_kind == ShapeKind::LINE) {
+                params->frame[3] = layer_ctx.t_line->size;
+                params->border = {0, 0};
+                params->fill_color = core::to_rgba_float(
+                    shape_field->fill_color.empty() ? "#ffffff" : shape_field->fill_color);
+            }
         }
 
+        /**
+         * Shapes are rasterized by libakvgfx, and shared through ShapeTextureCache, unless
+         * `AK_SHAPE_SDF` is set. In that case, they are drawn by signed distance fields in the
+         * fragment shader without any textures.
+         */
         inline bool load_shape_buffers(layer::Texture* tex, layer::Mesh* mesh,
                                        OGLRenderContext& ctx, const core::LayerContext& layer_ctx) {
-            auto vertices_loc = InputLocation::vertices;
-            auto uvs_loc = InputLocation::uvs;
             auto shape_kind = get_shape_kind(layer_ctx);
+
+            std::array<float, 2> shape_size = {0, 0};
+            double border_size = 0;
+            int border_padv = 4;
             switch (shape_kind) {
                 case ShapeKind::RECT: {
-                    const auto& shape_params = layer_ctx.t_rect;
-                    std::array<float, 2> mesh_size = {(float)shape_params->width,
-                                                      (float)shape_params->height};
-
-                    const int border_padv = 4;
-                    const float border_pad = shape_params->border_size * border_padv;
-
-                    mesh->quad = new QuadMesh;
-
-                    CHECK_AK_ERROR2(
-                        mesh->quad->create({mesh_size[0] + border_pad, mesh_size[1] + border_pad},
-                                           vertices_loc, uvs_loc));
-
-                    auto surface = vgfx::create_surface({.width = (int)mesh_size[0],
-                                                         .height = (int)mesh_size[1],
-                                                         .format = vgfx::SurfaceFormat::ARGB32,
-                                                         .border_padv = border_padv},
-                                                        layer_ctx);
-                    CHECK_AK_ERROR2(load_shape_texture(tex, *surface));
+                    shape_size = {(float)layer_ctx.t_rect->width, (float)layer_ctx.t_rect->height};
+                    border_size = layer_ctx.t_rect->border_size;
                     break;
                 }
-
                 case ShapeKind::CIRCLE: {
                     auto layer_size = layer_ctx.t_transform->layer_size;
-                    std::array<float, 2> mesh_size = {(float)layer_size[0], (float)layer_size[1]};
-
-                    const int border_padv = 4;
-                    const float border_pad = layer_ctx.t_circle->border_size * border_padv;
-
-                    mesh->quad = new QuadMesh;
-
-                    CHECK_AK_ERROR2(
-                        mesh->quad->create({mesh_size[0] + border_pad, mesh_size[1] + border_pad},
-                                           vertices_loc, uvs_loc));
-
-                    auto surface = vgfx::create_surface({.width = (int)mesh_size[0],
-                                                         .height = (int)mesh_size[1],
-                                                         .format = vgfx::SurfaceFormat::ARGB32,
-                                                         .border_padv = border_padv},
-                                                        layer_ctx);
-                    CHECK_AK_ERROR2(load_shape_texture(tex, *surface));
-
+                    shape_size = {(float)layer_size[0], (float)layer_size[1]};
+                    border_size = layer_ctx.t_circle->border_size;
                     break;
                 }
-
                 case ShapeKind::TRI: {
                     float mesh_width = layer_ctx.t_tri->width;
                     if (layer_ctx.t_tri->wr < 0 || layer_ctx.t_tri->wr > 1) {
                         mesh_width += (2 * std::abs(layer_ctx.t_tri->wr) * layer_ctx.t_tri->width);
                     }
-                    float mesh_height = layer_ctx.t_tri->height;
-
-                    const int border_padv = 4;
-                    const float border_pad = layer_ctx.t_tri->border_size * border_padv;
-
-                    std::array<float, 2> mesh_size = {mesh_width, mesh_height};
-
-                    mesh->quad = new QuadMesh;
-
-                    CHECK_AK_ERROR2(
-                        mesh->quad->create({mesh_width + border_pad, mesh_height + border_pad},
-                                           vertices_loc, uvs_loc));
-
-                    auto surface = vgfx::create_surface({.width = (int)mesh_size[0],
-                                                         .height = (int)mesh_size[1],
-                                                         .format = vgfx::SurfaceFormat::ARGB32,
-                                                         .border_padv = border_padv},
-                                                        layer_ctx);
-                    CHECK_AK_ERROR2(load_shape_texture(tex, *surface));
+                    shape_size = {mesh_width, (float)layer_ctx.t_tri->height};
+                    border_size = layer_ctx.t_tri->border_size;
                     break;
                 }
                 case ShapeKind::LINE: {
                     auto layer_size = layer_ctx.t_transform->layer_size;
-                    std::array<float, 2> mesh_size = {(float)layer_size[0], (float)layer_size[1]};
-
-                    mesh->quad = new QuadMesh;
-                    CHECK_AK_ERROR2(mesh->quad->create(mesh_size, vertices_loc, uvs_loc));
-
-                    auto surface = vgfx::create_surface({.width = (int)mesh_size[0],
-                                                         .height = (int)mesh_size[1],
-                                                         .format = vgfx::SurfaceFormat::ARGB32,
-                                                         .border_padv = 0},
-                                                        layer_ctx);
-                    CHECK_AK_ERROR2(load_shape_texture(tex, *surface));
-
+                    shape_size = {(float)layer_size[0], (float)layer_size[1]};
+                    border_padv = 0;
                     break;
                 }
-
                 default: {
                     AKLOG_ERROR("Invalid or not implemented shape kind {} found", shape_kind);
-                    break;
+                    return true;
                 }
             }
 
-            return true;
+            const float border_pad = border_size * border_padv;
+            mesh->quad = new QuadMesh;
+            CHECK_AK_ERROR2(
+                mesh->quad->create({shape_size[0] + border_pad, shape_size[1] + border_pad},
+                                   InputLocation::vertices, InputLocation::uvs));
+
+            vgfx::SurfaceEntry entry{.width = (int)shape_size[0],
+                                     .height = (int)shape_size[1],
+                                     .format = vgfx::SurfaceFormat::ARGB32,
+                                     .border_padv = border_padv};
+
+            if (use_shape_sdf()) {
+                tex->shape = new layer::ShapeParams;
+                load_shape_params(tex->shape, shape_kind, shape_size, entry, layer_ctx);
+                return true;
+            }
+
+            tex->basic = new OGLTexture;
+            tex->main_tex_loc = UniformLocation::shape_texture0;
+            return ctx.shape_textures()->acquire(*tex->basic, entry, layer_ctx);
         }
 
         inline bool load_buffers(layer::Texture* tex, layer::Mesh* mesh, OGLRenderContext& ctx,
                                  const core::LayerContext& layer_ctx) {
             auto layer_type = layer::get_layer_type(layer_ctx);
             switch (layer_type) {
-                case LayerType::IMAGE: {
-                    CHECK_AK_ERROR2(load_image_texture(tex, ctx, layer_ctx));
-                    auto mesh_size = get_mesh_size(
-                        layer_ctx, {tex->basic->effective_width, tex->basic->effective_height});
-                    mesh->quad = new QuadMesh;
-                    CHECK_AK_ERROR2(
-                        mesh->quad->create(mesh_size, InputLocation::vertices, InputLocation::uvs));
-                    break;
-                }
                 case LayerType::TEXT: {
                     CHECK_AK_ERROR2(load_text_texture(tex, ctx, layer_ctx));
                     auto mesh_size = get_mesh_size(
@@ -5,6 +5,8 @@
 #include <libakcore/rational.h>
 #include <libakcore/element.h>
 
+#include <array>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
@@ -18,6 +20,8 @@ namespace akashi {
 
         namespace layer {
 
+            struct ShapeParams;
+
             struct Mesh {
                 QuadMesh* quad = nullptr;
             };
@@ -25,6 +29,8 @@ namespace akashi {
             struct Texture {
                 VideoTexture* video = nullptr;
                 OGLTexture* basic = nullptr;
+                // shapes drawn by signed distance fields, in place of textures
+                ShapeParams* shape = nullptr;
                 GLuint main_tex_loc = 100;
             };
 
@@ -83,6 +89,40 @@ namespace akashi {
                 }
             }
 
+            // See shape_color() in layer_shaders.h
+            struct ShapeParams {
+                ShapeKind kind = ShapeKind::LENGTH;
+                // width, height, padding for the border, edge radius (the line width for lines)
+                std::array<float, 4> frame = {0, 0, 0, 0};
+                // size, direction
+                std::array<float, 2> border = {0, 0};
+                std::array<float, 4> fill_color = {0, 0, 0, 0};
+                std::array<float, 4> border_color = {1, 1, 1, 1};
+                // the vertices of triangles, or the ends of lines
+                std::array<float, 6> points = {0, 0, 0, 0, 0, 0};
+            };
+
+            // Layers of the same key can be drawn by instances. See LayerBatch.
+            struct BatchKey {
+                GLuint prog = 0;
+                GLuint texture = 0;
+
+                bool operator==(const BatchKey& other) const {
+                    return prog == other.prog && texture == other.texture;
+                }
+            };
+
+            // The std140 layout of LayerParams in layer_shaders.h
+            struct BatchParams {
+                glm::mat4 mvp = glm::mat4(1.0f);
+                std::array<float, 4> mesh_size_uv_flip = {0, 0, 0, 0};
+                std::array<float, 4> frame = {0, 0, 0, 0};
+                std::array<float, 4> fill_color = {0, 0, 0, 0};
+                std::array<float, 4> border_color = {0, 0, 0, 0};
+                std::array<float, 4> points01 = {0, 0, 0, 0};
+                std::array<float, 4> point2_border = {0, 0, 0, 0};
+            };
+
         }
 
     }
@@ -0,0 +1,199 @@
+#include "./layer_image_texture.h"
+
+#include <libakcore/logger.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static bool env_enabled(const char* name) {
+            const char* env = std::getenv(name);
+            return !env || std::strcmp(env, "0") != 0;
+        }
+
+        static int mip_levels(int width, int height) {
+            int levels = 1;
+            for (int size = std::max(width, height); size > 1; size >>= 1) {
+                levels += 1;
+            }
+            return levels;
+        }
+
+        ImageTextureCache::ImageTextureCache(void) {
+            m_decoder = core::make_owned<ImageCache>();
+            m_downscale = env_enabled("AK_IMAGE_DOWNSCALE");
+            m_mipmaps = env_enabled("AK_IMAGE_MIPMAPS");
+        }
+
+        ImageCache::Status ImageTextureCache::acquire(ImageTexture& image,
+                                                      const std::vector<std::string>& srcs,
+                                                      const std::array<int, 2>& min_size,
+                                                      bool wait) {
+            if (srcs.empty()) {
+                AKLOG_ERRORN("Failed to load the image. `srcs` is null");
+                return ImageCache::Status::FAILED;
+            }
+            const std::array<int, 2> decode_size =
+                m_downscale ? min_size : std::array<int, 2>{-1, -1};
+
+            std::string key;
+            for (const auto& src : srcs) {
+                key += ImageCache::key(src, decode_size);
+                key += '\0';
+            }
+            if (auto it = m_entries.find(key); it != m_entries.end()) {
+                it->second.ref_count += 1;
+                it->second.last_used = ++m_tick;
+                image = it->second.image;
+                return ImageCache::Status::READY;
+            }
+
+            // every sprite is requested up front, so that they are decoded in parallel
+            std::vector<std::shared_ptr<const ImageData>> sprites(srcs.size());
+            auto status = ImageCache::Status::READY;
+            for (size_t i = 0; i < srcs.size(); i++) {
+                auto cur_status = m_decoder->request(sprites[i], srcs[i], decode_size);
+                if (cur_status == ImageCache::Status::FAILED) {
+                    return cur_status;
+                }
+                if (cur_status == ImageCache::Status::PENDING) {
+                    status = cur_status;
+                }
+            }
+            if (status == ImageCache::Status::PENDING) {
+                if (!wait) {
+                    return status;
+                }
+                for (size_t i = 0; i < srcs.size(); i++) {
+                    while (!sprites[i]) {
+                        auto cur_status =
+                            m_decoder->request(sprites[i], srcs[i], decode_size, true);
+                        if (cur_status == ImageCache::Status::FAILED) {
+                            return cur_status;
+                        }
+                    }
+                }
+            }
+
+            if (!this->upload(image, srcs, sprites)) {
+                return ImageCache::Status::FAILED;
+            }
+            m_tex_keys.insert({image.tex.buffer, key});
+            m_entries.insert({std::move(key), {image, 1, ++m_tick}});
+            return ImageCache::Status::READY;
+        }
+
+        void ImageTextureCache::release(const OGLTexture& tex) {
+            auto key_it = m_tex_keys.find(tex.buffer);
+            if (key_it == m_tex_keys.end()) {
+                AKLOG_WARN("ImageTextureCache::release(): unknown texture {}", tex.buffer);
+                return;
+            }
+            auto& entry = m_entries.at(key_it->second);
+            if (entry.ref_count > 0) {
+                entry.ref_count -= 1;
+            }
+            if (entry.ref_count == 0) {
+                this->evict_idle();
+            }
+        }
+
+        void ImageTextureCache::destroy(void) {
+            for (auto&& [key, entry] : m_entries) {
+                if (entry.ref_count > 0) {
+                    AKLOG_WARN("ImageTextureCache::destroy(): texture {} is still in use",
+                               entry.image.tex.buffer);
+                }
+                free_ogl_texture(entry.image.tex);
+            }
+            m_entries.clear();
+            m_tex_keys.clear();
+            m_decoder->close_and_wait();
+        }
+
+        bool ImageTextureCache::upload(
+            ImageTexture& image, const std::vector<std::string>& srcs,
+            const std::vector<std::shared_ptr<const ImageData>>& sprites) const {
+            const auto& first = *sprites[0];
+            for (size_t i = 1; i < sprites.size(); i++) {
+                if (sprites[i]->bytes_per_pixel != first.bytes_per_pixel) {
+                    AKLOG_ERROR("Image channel mismatch found: `{}`(bits={}) != `{}`(bits={})",
+                                srcs[0].c_str(), first.bytes_per_pixel, srcs[i].c_str(),
+                                sprites[i]->bytes_per_pixel);
+                    return false;
+                }
+                if (sprites[i]->width != first.width || sprites[i]->height != first.height) {
+                    AKLOG_ERROR("Image size mismatch found: `{}`({}x{}) != `{}`({}x{})",
+                                srcs[0].c_str(), first.width, first.height, srcs[i].c_str(),
+                                sprites[i]->width, sprites[i]->height);
+                    return false;
+                }
+            }
+
+            auto& tex = image.tex;
+            tex.width = first.width;
+            tex.height = first.height;
+            tex.effective_width = first.width;
+            tex.effective_height = first.height;
+            tex.format = first.bytes_per_pixel == 3 ? GL_RGB : GL_RGBA;
+            tex.internal_format = first.bytes_per_pixel == 3 ? GL_RGB8 : GL_RGBA8;
+            tex.target = GL_TEXTURE_2D_ARRAY;
+            image.source_size = {first.source_width, first.source_height};
+
+            glGenTextures(1, &tex.buffer);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, tex.buffer);
+
+            const int levels = m_mipmaps ? mip_levels(tex.width, tex.height) : 1;
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, tex.internal_format, tex.width,
+                           tex.height, sprites.size());
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                            levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            // rows are tightly packed
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (size_t i = 0; i < sprites.size(); i++) {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, tex.width, tex.height, 1,
+                                tex.format, GL_UNSIGNED_BYTE, sprites[i]->pixels.data());
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // reset to the initial value
+
+            if (levels > 1) {
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            return true;
+        }
+
+        void ImageTextureCache::evict_idle(void) {
+            size_t nb_idle = 0;
+            for (const auto& [key, entry] : m_entries) {
+                nb_idle += entry.ref_count == 0 ? 1 : 0;
+            }
+            while (nb_idle > MAX_IDLE_TEXTURES) {
+                auto oldest = m_entries.end();
+                for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
+                    if (it->second.ref_count == 0 &&
+                        (oldest == m_entries.end() ||
+                         it->second.last_used < oldest->second.last_used)) {
+                        oldest = it;
+                    }
+                }
+                m_tex_keys.erase(oldest->second.image.tex.buffer);
+                free_ogl_texture(oldest->second.image.tex);
+                m_entries.erase(oldest);
+                nb_idle -= 1;
+            }
+        }
+
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../core/glc.h"
+#include "../core/texture.h"
+#include "../resource/image_cache.h"
+
+#include <libakcore/memory.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        struct ImageTexture {
+            OGLTexture tex;
+            // the size of the first sprite before downscaling, for the mesh size
+            std::array<long, 2> source_size = {0, 0};
+        };
+
+        /**
+         * Shares the texture arrays of image layers, decoded by ImageCache in the background.
+         *
+         * Textures are keyed by their sources, the mtimes of them, and the displayed size, and
+         * are refcounted. A few textures no longer in use are kept alive, so that recreating
+         * layers on atom changes does not upload them again.
+         *
+         * Images are downscaled to the displayed size, and get mipmaps. Setting
+         * `AK_IMAGE_DOWNSCALE` or `AK_IMAGE_MIPMAPS` to `0` disables them.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class ImageTextureCache final {
+          public:
+            // the number of unused textures kept alive
+            static constexpr const size_t MAX_IDLE_TEXTURES = 16;
+
+          public:
+            explicit ImageTextureCache(void);
+            virtual ~ImageTextureCache(void) = default;
+
+            /**
+             * Sets `image` when all the sprites are decoded and uploaded, or returns PENDING.
+             * When `wait` is true, this blocks until the decode finishes instead.
+             * READY textures must be released with release().
+             */
+            ImageCache::Status acquire(ImageTexture& image, const std::vector<std::string>& srcs,
+                                       const std::array<int, 2>& min_size, bool wait = false);
+
+            void release(const OGLTexture& tex);
+
+            void destroy(void);
+
+          private:
+            struct Entry {
+                ImageTexture image;
+                size_t ref_count = 0;
+                uint64_t last_used = 0;
+            };
+
+            bool upload(ImageTexture& image, const std::vector<std::string>& srcs,
+                        const std::vector<std::shared_ptr<const ImageData>>& sprites) const;
+
+            void evict_idle(void);
+
+          private:
+            core::owned_ptr<ImageCache> m_decoder;
+            std::unordered_map<std::string, Entry> m_entries;
+            std::unordered_map<GLuint, std::string> m_tex_keys;
+            uint64_t m_tick = 0;
+
+            bool m_downscale = true;
+            bool m_mipmaps = true;
+        };
+
+    }
+}
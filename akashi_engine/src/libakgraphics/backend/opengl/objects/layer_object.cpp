@@ -4,9 +4,11 @@
 #include "./layer_shaders.h"
 #include "./layer_buffers.h"
 #include "./layer_video_texture.h"
+#include "./layer_image_texture.h"
+#include "./layer_batch.h"
 #include "../meshes/quad.h"
 #include "../core/texture.h"
-#include "../core/shader.h"
+#include "../core/program_cache.h"
 
 #include "../render_context.h"
 #include "../camera.h"
@@ -19,9 +21,6 @@
 #include <libakcore/logger.h>
 #include <libakbuffer/avbuffer.h>
 
-#include <SDL.h>
-#include "../resource/image.h"
-
 using namespace akashi::graphics::layer;
 
 namespace akashi {
@@ -55,39 +54,31 @@ namespace akashi {
                 m_unit_fb_size = layer_ctx.t_unit->fb_size;
             }
 
-            {
-                m_prog = glCreateProgram();
+            if (layer_ctx.t_texture) {
+                m_uv_flip_hv = {layer_ctx.t_texture->uv_flip_h, layer_ctx.t_texture->uv_flip_v};
+            }
+            if (layer_ctx.t_shader) {
+                m_user_frag_shader = layer_ctx.t_shader->frag;
+                m_user_poly_shader = layer_ctx.t_shader->poly;
+            }
+            m_uses_time = layer::uses_time(m_user_frag_shader) ||
+                          layer::uses_time(m_user_poly_shader);
 
-                CHECK_AK_ERROR2(this->load_shaders(layer_ctx));
+            {
                 CHECK_AK_ERROR2(this->load_transform(layer_ctx));
 
-                {
-                    glUseProgram(m_prog);
-                    // [XXX] There are unused textures in this layer.
-                    // If we don't set the arbitrary value for those,
-                    // GL_INVALID_OPERATION will occur in glDrawElements.
-                    glUniform1i(UniformLocation::text_texture0, 10);
-                    glUniform1i(UniformLocation::unit_texture0, 11);
-                    glUniform1i(UniformLocation::shape_texture0, 12);
-                    glUniform1i(UniformLocation::image_textures, 13);
-                    glUniform1i(UniformLocation::video_textureY, 14);
-                    glUniform1i(UniformLocation::video_textureCb, 15);
-                    glUniform1i(UniformLocation::video_textureCr, 16);
-
-                    if (layer_ctx.t_texture) {
-                        glUniform2i(layer::UniformLocation::uv_flip_hv,
-                                    layer_ctx.t_texture->uv_flip_h, layer_ctx.t_texture->uv_flip_v);
-                    }
-
-                    glUniform1f(layer::UniformLocation::main_tex_kind,
-                                static_cast<float>(layer::get_layer_type(layer_ctx)));
-                    glUniform1f(layer::UniformLocation::video_decode_method, 0);
-
-                    glUseProgram(0);
-                }
-
-                if (m_layer_type != LayerType::VIDEO) {
+                // [XXX] The program of video layers depends on the decode method, which is
+                // unknown until the first frame arrives. See render().
+                if (m_layer_type == LayerType::IMAGE) {
+                    // [XXX] Images are decoded in the background. See render().
+                    m_image_srcs = layer_ctx.t_image->srcs;
+                    m_image_min_size = layer::get_image_min_size(layer_ctx);
+                    CHECK_AK_ERROR2(this->load_shaders(ctx));
+                    CHECK_AK_ERROR2(this->load_image_buffers(ctx));
+                } else if (m_layer_type != LayerType::VIDEO) {
+                    // the buffers decide the program of SDF shapes
                     CHECK_AK_ERROR2(layer::load_buffers(&m_texture, &m_mesh, ctx, layer_ctx));
+                    CHECK_AK_ERROR2(this->load_shaders(ctx));
                     this->set_buffers_ready();
                 }
 
@@ -98,13 +89,179 @@ namespace akashi {
 
         bool LayerObject::update(OGLRenderContext& /*ctx*/, const core::LayerContext& layer_ctx,
                                  const core::Rational& /*pts*/) {
+            // the time uniforms depend on the range
+            if (m_can_display != layer_ctx.display || m_safe_ctx.from != layer_ctx.from ||
+                m_safe_ctx.to != layer_ctx.to ||
+                m_safe_ctx.layer_local_offset != layer_ctx.layer_local_offset) {
+                m_is_dirty = true;
+            }
             m_can_display = layer_ctx.display;
             parse_safe_layer_ctx(&m_safe_ctx, layer_ctx);
             return true;
         }
 
+        bool LayerObject::needs_render(const core::Rational& pts) const {
+            if (m_is_dirty) {
+                return true;
+            }
+            if (!m_can_display) {
+                return false;
+            }
+            if (m_layer_type == LayerType::IMAGE && !m_is_buffers_ready && !m_image_load_failed) {
+                return true;
+            }
+            if (m_layer_type == LayerType::VIDEO) {
+                return m_current_pts != pts && m_skipped_pts != pts;
+            }
+            if (m_uses_time) {
+                return m_current_pts != pts;
+            }
+            return false;
+        }
+
+        bool LayerObject::covers_viewport(const Camera& camera) const {
+            // user shaders may move the vertices, or change the alpha
+            if (!m_can_display || !m_is_buffers_ready || !m_user_frag_shader.empty() ||
+                !m_user_poly_shader.empty()) {
+                return false;
+            }
+            const bool is_opaque =
+                m_layer_type == LayerType::VIDEO ||
+                (m_layer_type == LayerType::IMAGE && m_texture.basic->format == GL_RGB);
+            if (!is_opaque) {
+                return false;
+            }
+
+            const auto& size = m_mesh.quad->mesh_size();
+            const glm::mat4 mvp = camera.vp_mat() * m_transform.model_mat;
+            const std::array<glm::vec2, 4> local_corners = {
+                glm::vec2(-size[0], size[1]) * 0.5f, glm::vec2(size[0], size[1]) * 0.5f,
+                glm::vec2(size[0], -size[1]) * 0.5f, glm::vec2(-size[0], -size[1]) * 0.5f};
+            std::array<glm::vec2, 4> corners;
+            for (size_t i = 0; i < corners.size(); i++) {
+                const auto pos = mvp * glm::vec4(local_corners[i], 0.0f, 1.0f);
+                if (pos.w <= 0.0f) {
+                    return false;
+                }
+                corners[i] = glm::vec2(pos) / pos.w;
+            }
+
+            // the quad is convex, so that it covers the viewport when it contains all the corners
+            // of the viewport in NDC
+            static constexpr const float EPSILON = 1e-4f;
+            for (const auto& point : {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f),
+                                      glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f)}) {
+                for (size_t i = 0; i < corners.size(); i++) {
+                    const auto edge = corners[(i + 1) % corners.size()] - corners[i];
+                    const auto to_point = point - corners[i];
+                    const float edge_len = glm::length(edge);
+                    if (edge_len <= 0.0f) {
+                        return false;
+                    }
+                    // the corners are in the clockwise order, unless mirrored
+                    const float dist = (edge.y * to_point.x - edge.x * to_point.y) / edge_len;
+                    if (dist < -EPSILON) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void LayerObject::skip(OGLRenderContext& ctx, const core::Rational& pts) {
+            if (m_layer_type == LayerType::IMAGE && m_is_program_ready && !m_is_buffers_ready &&
+                !m_image_load_failed) {
+                m_image_load_failed = !this->load_image_buffers(ctx);
+            } else if (m_layer_type == LayerType::VIDEO && m_skipped_pts != pts) {
+                ctx.dequeue(m_safe_ctx.uuid, pts);
+                m_skipped_pts = pts;
+            }
+        }
+
+        bool LayerObject::batch_key(layer::BatchKey& key) const {
+            // user shaders may depend on the per-layer uniforms
+            if (!m_can_display || !m_is_program_ready || !m_is_buffers_ready ||
+                !m_user_frag_shader.empty() || !m_user_poly_shader.empty()) {
+                return false;
+            }
+            if (m_layer_type != LayerType::TEXT && m_layer_type != LayerType::IMAGE &&
+                m_layer_type != LayerType::SHAPE) {
+                return false;
+            }
+            key.prog = m_prog;
+            key.texture = m_texture.basic ? m_texture.basic->buffer : 0;
+            return true;
+        }
+
+        void LayerObject::batch_params(layer::BatchParams& params, const Camera& camera) const {
+            params.mvp = camera.vp_mat() * m_transform.model_mat;
+            const auto& mesh_size = m_mesh.quad->mesh_size();
+            params.mesh_size_uv_flip = {mesh_size[0], mesh_size[1], (float)m_uv_flip_hv[0],
+                                        (float)m_uv_flip_hv[1]};
+            if (m_texture.shape) {
+                const auto& shape = *m_texture.shape;
+                params.frame = shape.frame;
+                params.fill_color = shape.fill_color;
+                params.border_color = shape.border_color;
+                params.points01 = {shape.points[0], shape.points[1], shape.points[2],
+                                   shape.points[3]};
+                params.point2_border = {shape.points[4], shape.points[5], shape.border[0],
+                                        shape.border[1]};
+            }
+        }
+
+        bool LayerObject::render_instances(OGLRenderContext& ctx, size_t nb_instances) {
+            if (m_batch_prog == 0) {
+                m_batch_prog = this->load_program(ctx, LayerBatch::MAX_LAYERS);
+                if (m_batch_prog == 0) {
+                    AKLOG_ERROR("Failed to load the batched program for the layer {}",
+                                m_safe_ctx.uuid.c_str());
+                    return false;
+                }
+            }
+
+            const bool has_premultiplied_alpha =
+                m_layer_type == LayerType::TEXT or m_layer_type == LayerType::SHAPE;
+            if (has_premultiplied_alpha) {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            }
+
+            glUseProgram(m_batch_prog);
+            if (m_texture.basic) {
+                use_ogl_texture(*m_texture.basic, m_texture.main_tex_loc);
+            }
+
+            glBindVertexArray(m_mesh.quad->vao());
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_mesh.quad->ibo());
+            glDrawElementsInstanced(GL_TRIANGLES, m_mesh.quad->ibo_length(), GL_UNSIGNED_SHORT, 0,
+                                    nb_instances);
+            glBindVertexArray(0);
+
+            if (has_premultiplied_alpha) {
+                glEnable(GL_BLEND);
+                ctx.use_default_blend_func();
+            }
+            return true;
+        }
+
         bool LayerObject::render(OGLRenderContext& ctx, const core::Rational& pts,
                                  const Camera& camera) {
+            if (m_layer_type == LayerType::IMAGE && m_is_program_ready && !m_is_buffers_ready) {
+                // failures are reported once, and the layer is left undisplayed, so that the
+                // other layers keep rendering
+                if (m_image_load_failed) {
+                    return true;
+                }
+                if (!this->load_image_buffers(ctx)) {
+                    m_image_load_failed = true;
+                    return true;
+                }
+                if (!m_is_buffers_ready) {
+                    AKLOG_DEBUG("Image not loaded yet: {}", m_safe_ctx.uuid.c_str());
+                    return true;
+                }
+            }
             if (m_layer_type != LayerType::VIDEO && (!m_is_program_ready || !m_is_buffers_ready)) {
                 AKLOG_WARNN("Not ready for rendering");
                 return false;
@@ -134,13 +291,9 @@ namespace akashi {
                 }
 
                 if (!m_has_video_decode_method) {
-                    {
-                        glUseProgram(m_prog);
-                        glUniform1f(layer::UniformLocation::video_decode_method,
-                                    static_cast<float>(buf_data->prop().decode_method));
-                        glUseProgram(0);
-                    }
+                    m_video_decode_method = buf_data->prop().decode_method;
                     m_has_video_decode_method = true;
+                    CHECK_AK_ERROR2(this->load_shaders(ctx));
                 }
 
                 if (!m_is_buffers_ready) {
@@ -170,6 +323,11 @@ namespace akashi {
 
                 glUseProgram(m_prog);
 
+                // [XXX] The program is shared with other layers, so that the per-layer uniforms
+                // must be set on every render.
+                glUniform2i(UniformLocation::uv_flip_hv, m_uv_flip_hv[0], m_uv_flip_hv[1]);
+                glUniform2fv(UniformLocation::mesh_size, 1, m_mesh.quad->mesh_size().data());
+
                 if (m_layer_type == LayerType::UNIT) {
                     if (OGLTexture fbo_tex; m_fbo->texture(fbo_tex)) {
                         use_ogl_texture(fbo_tex, UniformLocation::unit_texture0);
@@ -178,6 +336,14 @@ namespace akashi {
                     m_texture.video->use_textures({UniformLocation::video_textureY,
                                                    UniformLocation::video_textureCb,
                                                    UniformLocation::video_textureCr});
+                } else if (m_texture.shape) {
+                    const auto& shape = *m_texture.shape;
+                    glUniform4fv(UniformLocation::shape_frame, 1, shape.frame.data());
+                    glUniform2fv(UniformLocation::shape_border, 1, shape.border.data());
+                    glUniform4fv(UniformLocation::shape_fill_color, 1, shape.fill_color.data());
+                    glUniform4fv(UniformLocation::shape_border_color, 1,
+                                 shape.border_color.data());
+                    glUniform2fv(UniformLocation::shape_points, 3, shape.points.data());
                 } else {
                     use_ogl_texture(*m_texture.basic, m_texture.main_tex_loc);
                 }
@@ -213,60 +379,115 @@ namespace akashi {
             return true;
         }
 
-        bool LayerObject::destroy(const OGLRenderContext& /*ctx*/) {
+        bool LayerObject::destroy(const OGLRenderContext& ctx) {
             if (m_mesh.quad) {
                 m_mesh.quad->destroy();
                 delete m_mesh.quad;
             }
             if (m_texture.basic) {
-                free_ogl_texture(*m_texture.basic);
+                if (m_layer_type == LayerType::IMAGE) {
+                    ctx.image_textures()->release(*m_texture.basic);
+                } else if (m_layer_type == LayerType::SHAPE) {
+                    ctx.shape_textures()->release(*m_texture.basic);
+                } else {
+                    free_ogl_texture(*m_texture.basic);
+                }
                 delete m_texture.basic;
             }
             if (m_texture.video) {
-                m_texture.video->destroy();
+                m_texture.video->destroy(ctx);
                 delete m_texture.video;
             }
+            if (m_texture.shape) {
+                delete m_texture.shape;
+            }
             m_texture.main_tex_loc = -1;
 
-            glDeleteProgram(m_prog);
+            if (m_prog != 0) {
+                ctx.program_cache()->release(m_prog);
+                m_prog = 0;
+            }
+            if (m_batch_prog != 0) {
+                ctx.program_cache()->release(m_batch_prog);
+                m_batch_prog = 0;
+            }
             return true;
         }
 
         void LayerObject::set_fbo(const core::borrowed_ptr<FBO>& fbo_ptr) { m_fbo = fbo_ptr; }
 
-        void LayerObject::set_buffers_ready() {
-            m_is_buffers_ready = true;
-            {
-                glUseProgram(m_prog);
-                glUniform2fv(layer::UniformLocation::mesh_size, 1, m_mesh.quad->mesh_size().data());
-                glUseProgram(0);
+        void LayerObject::set_buffers_ready() { m_is_buffers_ready = true; }
+
+        bool LayerObject::load_image_buffers(OGLRenderContext& ctx) {
+            bool ready = false;
+            if (!layer::load_image_buffers(&m_texture, &m_mesh, &ready, ctx, m_safe_ctx,
+                                           m_image_srcs, m_image_min_size)) {
+                AKLOG_ERROR("Failed to load the images for the layer {}", m_safe_ctx.uuid.c_str());
+                return false;
+            }
+            if (ready) {
+                this->set_buffers_ready();
             }
+            return true;
         }
 
-        bool LayerObject::load_shaders(const core::LayerContext& layer_ctx) {
-            CHECK_AK_ERROR2(
-                compile_attach_shader(m_prog, GL_VERTEX_SHADER, layer::vshader_src.c_str()));
-            CHECK_AK_ERROR2(
-                compile_attach_shader(m_prog, GL_FRAGMENT_SHADER, layer::fshader_src.c_str()));
-
-            bool has_u_frag_shader =
-                bool(layer_ctx.t_shader) && not(layer_ctx.t_shader->frag.empty());
-            const std::string& frag_shader =
-                has_u_frag_shader ? layer_ctx.t_shader->frag : layer::default_user_fshader_src;
-            CHECK_AK_ERROR2(compile_attach_shader(m_prog, GL_FRAGMENT_SHADER, frag_shader.c_str()));
-
-            bool has_u_poly_shader =
-                bool(layer_ctx.t_shader) && not(layer_ctx.t_shader->poly.empty());
-            const std::string& poly_shader =
-                has_u_poly_shader ? layer_ctx.t_shader->poly : layer::default_user_pshader_src;
-            CHECK_AK_ERROR2(compile_attach_shader(m_prog, GL_VERTEX_SHADER, poly_shader.c_str()));
+        bool LayerObject::load_shaders(OGLRenderContext& ctx) {
+            m_prog = this->load_program(ctx, 0);
+            if (m_prog == 0) {
+                AKLOG_ERROR("Failed to load the program for the layer {}", m_safe_ctx.uuid.c_str());
+                return false;
+            }
+            return true;
+        }
 
-            CHECK_AK_ERROR2(compile_attach_shader(m_prog, GL_GEOMETRY_SHADER,
-                                                  layer::default_user_gshader_src.c_str()));
+        GLuint LayerObject::load_program(OGLRenderContext& ctx, int batch_size) const {
+            // non-video layers share the variant regardless of the decode method
+            auto decode_method = m_layer_type == LayerType::VIDEO ? m_video_decode_method
+                                                                  : core::VideoDecodeMethod::NONE;
+            const int main_tex_kind = static_cast<int>(m_layer_type);
+            const int shape_sdf_kind =
+                m_texture.shape ? static_cast<int>(m_texture.shape->kind) : -1;
+            const auto vshader =
+                layer::specialize(layer::vshader_body_, main_tex_kind,
+                                  static_cast<int>(decode_method), shape_sdf_kind, batch_size);
+            const auto fshader =
+                layer::specialize(layer::fshader_body_, main_tex_kind,
+                                  static_cast<int>(decode_method), shape_sdf_kind, batch_size);
+
+            const std::string& frag_shader = not(m_user_frag_shader.empty())
+                                                 ? m_user_frag_shader
+                                                 : layer::default_user_fshader_src;
+            const std::string& poly_shader = not(m_user_poly_shader.empty())
+                                                 ? m_user_poly_shader
+                                                 : layer::default_user_pshader_src;
+
+            GLuint prog = ctx.program_cache()->acquire({
+                {GL_VERTEX_SHADER, &vshader},
+                {GL_FRAGMENT_SHADER, &fshader},
+                {GL_FRAGMENT_SHADER, &frag_shader},
+                {GL_VERTEX_SHADER, &poly_shader},
+                {GL_GEOMETRY_SHADER, &layer::default_user_gshader_src},
+            });
+            if (prog == 0) {
+                return 0;
+            }
 
-            CHECK_AK_ERROR2(link_shader(m_prog));
+            {
+                glUseProgram(prog);
+                // [XXX] User shaders may sample the textures which this layer does not use.
+                // If we don't set the arbitrary value for those,
+                // GL_INVALID_OPERATION will occur in glDrawElements.
+                glUniform1i(UniformLocation::text_texture0, 10);
+                glUniform1i(UniformLocation::unit_texture0, 11);
+                glUniform1i(UniformLocation::shape_texture0, 12);
+                glUniform1i(UniformLocation::image_textures, 13);
+                glUniform1i(UniformLocation::video_textureY, 14);
+                glUniform1i(UniformLocation::video_textureCb, 15);
+                glUniform1i(UniformLocation::video_textureCr, 16);
+                glUseProgram(0);
+            }
 
-            return true;
+            return prog;
         }
 
         static glm::vec3 get_trans_vec(const std::array<double, 3>& layer_pos) {
@@ -7,6 +7,7 @@
 #include <libakcore/memory.h>
 
 #include <libakcore/element.h>
+#include <libakcore/hw_accel.h>
 
 namespace akashi {
     namespace core {
@@ -32,6 +33,43 @@ namespace akashi {
 
             void set_fbo(const core::borrowed_ptr<FBO>& fbo_ptr);
 
+            /**
+             * Whether the last output of this layer may be stale at `pts`, that is, when the
+             * layer is updated, or when it shows videos, pending images, or time-dependent shaders.
+             * The output of unit layers depends on their planes, which are tracked by RenderPlane.
+             */
+            bool needs_render(const core::Rational& pts) const;
+
+            void clear_dirty() { m_is_dirty = false; }
+
+            /**
+             * Whether this layer is opaque and covers the whole viewport of `camera`, so that the
+             * layers beneath it are hidden.
+             */
+            bool covers_viewport(const Camera& camera) const;
+
+            float depth() const { return m_transform.trans_vec.z; }
+
+            /**
+             * Called instead of render() when the layer is hidden by another one.
+             * Hidden video layers still consume their frames, so that the queue keeps flowing.
+             */
+            void skip(OGLRenderContext& ctx, const core::Rational& pts);
+
+            /**
+             * Sets `key` when this layer can be drawn by instances along with the other layers of
+             * the same key. See LayerBatch.
+             */
+            bool batch_key(layer::BatchKey& key) const;
+
+            void batch_params(layer::BatchParams& params, const Camera& camera) const;
+
+            /**
+             * Draws `nb_instances` instances of the mesh of this layer, with the parameters in
+             * the bound LayerBatch block.
+             */
+            bool render_instances(OGLRenderContext& ctx, size_t nb_instances);
+
             bool is_program_ready() const { return m_is_program_ready; }
             bool is_buffers_ready() const { return m_is_buffers_ready; }
 
@@ -42,25 +80,40 @@ namespace akashi {
 
           private:
             void set_buffers_ready();
-            bool load_shaders(const core::LayerContext& layer_ctx);
+            bool load_shaders(OGLRenderContext& ctx);
+            GLuint load_program(OGLRenderContext& ctx, int batch_size) const;
+            bool load_image_buffers(OGLRenderContext& ctx);
             bool load_transform(const core::LayerContext& layer_ctx);
             bool render_inner(OGLRenderContext& ctx, const core::Rational& pts,
                               const Camera& camera);
 
           private:
-            GLuint m_prog;
+            GLuint m_prog = 0;
+            // the variant drawing by instances, loaded on the first batch
+            GLuint m_batch_prog = 0;
             layer::Transform m_transform;
 
             layer::Texture m_texture;
             layer::Mesh m_mesh;
 
             core::Rational m_current_pts = core::Rational(-1, 1);
+            core::Rational m_skipped_pts = core::Rational(-1, 1);
             core::borrowed_ptr<FBO> m_fbo{nullptr};
 
             bool m_is_program_ready = false;
             bool m_is_buffers_ready = false;
 
             bool m_has_video_decode_method = false;
+            core::VideoDecodeMethod m_video_decode_method = core::VideoDecodeMethod::NONE;
+            std::array<int, 2> m_uv_flip_hv = {0, 0};
+            std::string m_user_frag_shader;
+            std::string m_user_poly_shader;
+            bool m_uses_time = false;
+            bool m_is_dirty = true;
+
+            std::vector<std::string> m_image_srcs;
+            std::array<int, 2> m_image_min_size = {-1, -1};
+            bool m_image_load_failed = false;
 
             bool m_can_display = false;
             layer::SafeLayerContext m_safe_ctx;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cctype>
 #include <string>
 
 namespace akashi {
@@ -24,8 +25,11 @@ namespace akashi {
             // private
             mvpMatrix = 200,
             uv_flip_hv,
-            main_tex_kind,
-            video_decode_method,
+            shape_frame,
+            shape_border,
+            shape_fill_color,
+            shape_border_color,
+            shape_points,
         };
 
         enum InputLocation { vertices = 0, uvs, luma_uvs, chroma_uvs };
@@ -52,11 +56,48 @@ namespace akashi {
 
     layout (location = 200) uniform mat4 mvpMatrix;
     layout (location = 201) uniform ivec2 uv_flip_hv; // [uv_flip_h, uv_flip_v]
-    layout (location = 202) uniform float main_tex_kind;
-    layout (location = 203) uniform float video_decode_method;
+    layout (location = 202) uniform vec4 shape_frame;
+    layout (location = 203) uniform vec2 shape_border;
+    layout (location = 204) uniform vec4 shape_fill_color;
+    layout (location = 205) uniform vec4 shape_border_color;
+    layout (location = 206) uniform vec2 shape_points[3];
     )";
 
-        static const std::string vshader_src = shader_header_ + uniform_decls_ + u8R"(
+        // Batched layers are drawn by instances, and read their parameters from the slot of the
+        // instance in `LayerBatch`, in place of the uniforms above. The layout must match
+        // layer::BatchParams.
+        static const std::string batch_decls_ = u8R"(
+    #if LAYER_BATCH_SIZE > 0
+    struct LayerParams {
+        mat4 mvp;
+        vec4 mesh_size_uv_flip; // [mesh_size, uv_flip_hv]
+        vec4 frame;
+        vec4 fill_color;
+        vec4 border_color;
+        vec4 points01;
+        vec4 point2_border; // [shape_points[2], shape_border]
+    };
+
+    layout (std140, binding = 0) uniform LayerBatch {
+        LayerParams layer_params[LAYER_BATCH_SIZE];
+    };
+
+    #define mvpMatrix LAYER_PARAMS.mvp
+    #define mesh_size LAYER_PARAMS.mesh_size_uv_flip.xy
+    #define uv_flip_hv ivec2(LAYER_PARAMS.mesh_size_uv_flip.zw)
+    #define shape_frame LAYER_PARAMS.frame
+    #define shape_border LAYER_PARAMS.point2_border.zw
+    #define shape_fill_color LAYER_PARAMS.fill_color
+    #define shape_border_color LAYER_PARAMS.border_color
+    #define shape_points batch_shape_points()
+    #endif
+    )";
+
+        // The main shaders are specialized by `MAIN_TEX_KIND` (LayerType),
+        // `VIDEO_DECODE_METHOD` (VideoDecodeMethod), `SHAPE_SDF_KIND` (ShapeKind, or -1 for
+        // textured shapes), and `LAYER_BATCH_SIZE` (0 unless batched) at compile time. See
+        // specialize().
+        static const std::string vshader_body_ = u8R"(
     layout (location = 0) in vec3 vertices;
     layout (location = 1) in vec2 uvs;
     layout (location = 2) in vec2 luma_uvs;
@@ -67,8 +108,11 @@ namespace akashi {
         vec2 video_chroma_uv;
         vec2 uv;
         float sprite_idx;
+        flat int layer_idx;
     } vs_out;
 
+    #define LAYER_PARAMS layer_params[gl_InstanceID]
+
     void poly_main(inout vec4 pos);
 
     vec2 get_uvs(vec2 raw_uvs){
@@ -79,52 +123,65 @@ namespace akashi {
     }
     
     void main(void){
-        if(int(main_tex_kind) == 0){
-            vs_out.video_luma_uv = get_uvs(luma_uvs);
-            vs_out.video_chroma_uv = get_uvs(chroma_uvs);
-        }else {
-            vs_out.uv = get_uvs(uvs);
-        }
+    #if MAIN_TEX_KIND == 0
+        vs_out.video_luma_uv = get_uvs(luma_uvs);
+        vs_out.video_chroma_uv = get_uvs(chroma_uvs);
+    #else
+        vs_out.uv = get_uvs(uvs);
+    #endif
         vs_out.sprite_idx = 0;
+        vs_out.layer_idx = gl_InstanceID;
+    #if LAYER_BATCH_SIZE > 0
+        // the instances share the mesh of the first layer, which is a quad centered at the origin
+        vec4 t_vertices = vec4(sign(vertices.xy) * mesh_size * 0.5, vertices.z, 1.0);
+    #else
         vec4 t_vertices = vec4(vertices, 1.0);
+    #endif
         poly_main(t_vertices);
         gl_Position = mvpMatrix * t_vertices;
     }
 )";
 
-        static const std::string fshader_src = shader_header_ + uniform_decls_ + u8R"(
+        static const std::string fshader_body_ = u8R"(
 
     in GS_OUT {
         vec2 video_luma_uv;
         vec2 video_chroma_uv;
         vec2 uv;
         float sprite_idx;
+        flat int layer_idx;
     } fs_in;
 
+    #define LAYER_PARAMS layer_params[fs_in.layer_idx]
+
+    #if LAYER_BATCH_SIZE > 0
+    vec2[3] batch_shape_points() {
+        return vec2[3](LAYER_PARAMS.points01.xy, LAYER_PARAMS.points01.zw,
+                       LAYER_PARAMS.point2_border.xy);
+    }
+    #endif
+
     out vec4 fragColor;
 
+    #if MAIN_TEX_KIND == 0
     vec3 get_yuv() {
-        switch(int(video_decode_method)){
-            // sw
-            case 0: {
-                return vec3(
-                    texture(video_textureY, fs_in.video_luma_uv).r,
-                    texture(video_textureCb, fs_in.video_chroma_uv).r,
-                    texture(video_textureCr, fs_in.video_chroma_uv).r
-                );
-            }
-            // vaapi
-            case 1: {
-                return vec3(
-                    texture(video_textureY, fs_in.video_luma_uv).r,
-                    texture(video_textureCb, fs_in.video_luma_uv).r,
-                    texture(video_textureCb, fs_in.video_luma_uv).g
-                );
-            }
-            default: {
-                return vec3(0.0);
-            }
-        }
+    // sw
+    #if VIDEO_DECODE_METHOD == 0
+        return vec3(
+            texture(video_textureY, fs_in.video_luma_uv).r,
+            texture(video_textureCb, fs_in.video_chroma_uv).r,
+            texture(video_textureCr, fs_in.video_chroma_uv).r
+        );
+    // vaapi
+    #elif VIDEO_DECODE_METHOD == 1
+        return vec3(
+            texture(video_textureY, fs_in.video_luma_uv).r,
+            texture(video_textureCb, fs_in.video_luma_uv).r,
+            texture(video_textureCb, fs_in.video_luma_uv).g
+        );
+    #else
+        return vec3(0.0);
+    #endif
     }
 
     vec4 to_rgb(){
@@ -151,30 +208,95 @@ namespace akashi {
             1
         );
     }
+    #endif
+
+    #if MAIN_TEX_KIND == 5 && SHAPE_SDF_KIND >= 0
+    // in pixels with y down, like the surfaces of libakvgfx
+    float shape_sdf(vec2 p) {
+        vec2 size = shape_frame.xy;
+    // rect
+    #if SHAPE_SDF_KIND == 0
+        float r = min(shape_frame.w, min(size.x, size.y) * 0.5);
+        vec2 q = abs(p - size * 0.5) - size * 0.5 + r;
+        return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
+    // circle, stretched to an ellipse
+    #elif SHAPE_SDF_KIND == 1
+        vec2 r = max(size * 0.5, vec2(1e-3));
+        vec2 q = p - size * 0.5;
+        float k0 = length(q / r);
+        float k1 = length(q / (r * r));
+        return k1 > 0.0 ? k0 * (k0 - 1.0) / k1 : -min(r.x, r.y);
+    // tri
+    #elif SHAPE_SDF_KIND == 2
+        vec2 e0 = shape_points[1] - shape_points[0];
+        vec2 e1 = shape_points[2] - shape_points[1];
+        vec2 e2 = shape_points[0] - shape_points[2];
+        vec2 v0 = p - shape_points[0];
+        vec2 v1 = p - shape_points[1];
+        vec2 v2 = p - shape_points[2];
+        vec2 pq0 = v0 - e0 * clamp(dot(v0, e0) / dot(e0, e0), 0.0, 1.0);
+        vec2 pq1 = v1 - e1 * clamp(dot(v1, e1) / dot(e1, e1), 0.0, 1.0);
+        vec2 pq2 = v2 - e2 * clamp(dot(v2, e2) / dot(e2, e2), 0.0, 1.0);
+        float s = sign(e0.x * e2.y - e0.y * e2.x);
+        vec2 d = min(min(vec2(dot(pq0, pq0), s * (v0.x * e0.y - v0.y * e0.x)),
+                         vec2(dot(pq1, pq1), s * (v1.x * e1.y - v1.y * e1.x))),
+                     vec2(dot(pq2, pq2), s * (v2.x * e2.y - v2.y * e2.x)));
+        return -sqrt(d.x) * sign(d.y);
+    // line, with butt caps
+    #else
+        vec2 ba = shape_points[1] - shape_points[0];
+        float len = length(ba);
+        vec2 dir = len > 0.0 ? ba / len : vec2(1.0, 0.0);
+        vec2 q = p - shape_points[0];
+        vec2 local = vec2(dot(q, dir), dot(q, vec2(-dir.y, dir.x)));
+        vec2 e = abs(local - vec2(len * 0.5, 0.0)) - vec2(len * 0.5, shape_frame.w * 0.5);
+        return length(max(e, 0.0)) + min(max(e.x, e.y), 0.0);
+    #endif
+    }
+
+    float shape_coverage(float d) {
+        return clamp(0.5 - d / max(fwidth(d), 1e-4), 0.0, 1.0);
+    }
+
+    // premultiplied, like the surfaces of libakvgfx
+    vec4 shape_color() {
+        vec2 p = fs_in.uv * mesh_size - vec2(shape_frame.z);
+        float d = shape_sdf(p);
+
+        vec4 fill = vec4(shape_fill_color.rgb * shape_fill_color.a, shape_fill_color.a);
+        if (shape_border.x <= 0.0) {
+            return fill * shape_coverage(d);
+        }
+        vec4 border = vec4(shape_border_color.rgb * shape_border_color.a, shape_border_color.a);
+
+        // the border covers [lo, hi]: inside the edge, outside the edge, or centered on it
+        float half_size = shape_border.x * 0.5;
+        float lo = shape_border.y == 1.0 ? 0.0 : -half_size;
+        float hi = shape_border.y == 0.0 ? 0.0 : half_size;
+        float fill_coverage = shape_coverage(d - lo);
+        return fill * fill_coverage + border * (shape_coverage(d - hi) - fill_coverage);
+    }
+    #endif
 
     void frag_main(inout vec4 rv);
 
     vec4 get_color() {
-        switch(int(main_tex_kind)){
-            // video
-            case 0: {
-                return to_rgb();
-            }
-            case 2: {
-                return texture(text_texture0, fs_in.uv);
-            }
-            case 3: {
-                return texture(image_textures, vec3(fs_in.uv, fs_in.sprite_idx));
-            }
-            case 4: {
-                return texture(unit_texture0, fs_in.uv);
-            }
-            case 5: {
-                return texture(shape_texture0, fs_in.uv);
-            }
-            default:
-                return vec4(0.0);
-        }
+    // video
+    #if MAIN_TEX_KIND == 0
+        return to_rgb();
+    #elif MAIN_TEX_KIND == 2
+        return texture(text_texture0, fs_in.uv);
+    #elif MAIN_TEX_KIND == 3
+        return texture(image_textures, vec3(fs_in.uv, fs_in.sprite_idx));
+    #elif MAIN_TEX_KIND == 4
+        return texture(unit_texture0, fs_in.uv);
+    #elif MAIN_TEX_KIND == 5 && SHAPE_SDF_KIND >= 0
+        return shape_color();
+    #elif MAIN_TEX_KIND == 5
+        return texture(shape_texture0, fs_in.uv);
+    #else
+        return vec4(0.0);
+    #endif
     }
 
     void main(void){
@@ -184,6 +306,33 @@ namespace akashi {
     }
 )";
 
+        inline std::string specialize(const std::string& body, int main_tex_kind,
+                                      int video_decode_method, int shape_sdf_kind = -1,
+                                      int batch_size = 0) {
+            return shader_header_ + "#define MAIN_TEX_KIND " + std::to_string(main_tex_kind) +
+                   "\n#define VIDEO_DECODE_METHOD " + std::to_string(video_decode_method) +
+                   "\n#define SHAPE_SDF_KIND " + std::to_string(shape_sdf_kind) +
+                   "\n#define LAYER_BATCH_SIZE " + std::to_string(batch_size) + "\n" +
+                   uniform_decls_ + batch_decls_ + body;
+        }
+
+        // Whether the user shader refers to the uniforms which change on every frame. Mentions in
+        // comments count as well, which only costs a redundant redraw.
+        inline bool uses_time(const std::string& src) {
+            const auto is_ident = [](char c) { return std::isalnum(c) || c == '_'; };
+            for (const std::string name : {"time", "global_time"}) {
+                for (auto pos = src.find(name); pos != std::string::npos;
+                     pos = src.find(name, pos + 1)) {
+                    const auto end = pos + name.size();
+                    if ((pos == 0 || !is_ident(src[pos - 1])) &&
+                        (end == src.size() || !is_ident(src[end]))) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
         static const std::string default_user_pshader_src = shader_header_ + uniform_decls_ + u8R"(
     void poly_main(inout vec4 position){
     }
@@ -204,6 +353,7 @@ namespace akashi {
         vec2 video_chroma_uv;
         vec2 uv;
         float sprite_idx;
+        flat int layer_idx;
     } gs_in[];
 
     out GS_OUT {
@@ -211,6 +361,7 @@ namespace akashi {
         vec2 video_chroma_uv;
         vec2 uv;
         float sprite_idx;
+        flat int layer_idx;
     } gs_out;
 
     void main() {
@@ -219,6 +370,7 @@ namespace akashi {
             gs_out.video_chroma_uv = gs_in[i].video_chroma_uv;
             gs_out.uv = gs_in[i].uv;
             gs_out.sprite_idx = gs_in[i].sprite_idx;
+            gs_out.layer_idx = gs_in[i].layer_idx;
             gl_Position = gl_in[i].gl_Position;
             EmitVertex();
         }
@@ -0,0 +1,130 @@
+#include "./layer_shape_texture.h"
+
+#include <libakcore/logger.h>
+#include <libakcore/element.h>
+
+#include <libakvgfx/akvgfx.h>
+#include <libakvgfx/item.h>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static bool upload_surface(OGLTexture& tex, const vgfx::Surface& surface) {
+            const auto& info = surface.info();
+            tex.width = info.width;
+            tex.height = info.height;
+            tex.effective_width = tex.width;
+            tex.effective_height = tex.height;
+
+            tex.format = info.format == vgfx::SurfaceFormat::RGB24
+                             ? (info.format_swap ? GL_BGR : GL_RGB)
+                             : (info.format_swap ? GL_BGRA : GL_RGBA);
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            {
+                glGenTextures(1, &tex.buffer);
+
+                glBindTexture(GL_TEXTURE_2D, tex.buffer);
+
+                int bytes_per_pixel = info.format == vgfx::SurfaceFormat::RGB24 ? 3 : 4;
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, info.stride / bytes_per_pixel);
+                {
+                    glTexImage2D(GL_TEXTURE_2D, 0, tex.internal_format, tex.width, tex.height, 0,
+                                 tex.format, GL_UNSIGNED_BYTE, surface.buffer());
+                }
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+                // [XXX] make sure to explicity setup when not using mimap
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, DEFAULT_UNPACK_ALIGNMENT);
+
+            return true;
+        }
+
+        bool ShapeTextureCache::acquire(OGLTexture& tex, const vgfx::SurfaceEntry& entry,
+                                        const core::LayerContext& layer_ctx) {
+            auto key = vgfx::surface_key(entry, layer_ctx);
+            if (key.empty()) {
+                AKLOG_ERRORN("ShapeTextureCache::acquire(): not a shape layer");
+                return false;
+            }
+            if (auto it = m_entries.find(key); it != m_entries.end()) {
+                it->second.ref_count += 1;
+                it->second.last_used = ++m_tick;
+                tex = it->second.tex;
+                return true;
+            }
+
+            auto surface = vgfx::create_surface(entry, layer_ctx);
+            if (!surface) {
+                AKLOG_ERRORN("Failed to create the shape surface");
+                return false;
+            }
+            tex = OGLTexture{};
+            if (!upload_surface(tex, *surface)) {
+                return false;
+            }
+
+            m_tex_keys.insert({tex.buffer, key});
+            m_entries.insert({std::move(key), {tex, 1, ++m_tick}});
+            return true;
+        }
+
+        void ShapeTextureCache::release(const OGLTexture& tex) {
+            auto key_it = m_tex_keys.find(tex.buffer);
+            if (key_it == m_tex_keys.end()) {
+                AKLOG_WARN("ShapeTextureCache::release(): unknown texture {}", tex.buffer);
+                return;
+            }
+            auto& entry = m_entries.at(key_it->second);
+            if (entry.ref_count > 0) {
+                entry.ref_count -= 1;
+            }
+            if (entry.ref_count == 0) {
+                this->evict_idle();
+            }
+        }
+
+        void ShapeTextureCache::destroy(void) {
+            for (auto&& [key, entry] : m_entries) {
+                if (entry.ref_count > 0) {
+                    AKLOG_WARN("ShapeTextureCache::destroy(): texture {} is still in use",
+                               entry.tex.buffer);
+                }
+                free_ogl_texture(entry.tex);
+            }
+            m_entries.clear();
+            m_tex_keys.clear();
+        }
+
+        void ShapeTextureCache::evict_idle(void) {
+            size_t nb_idle = 0;
+            for (const auto& [key, entry] : m_entries) {
+                nb_idle += entry.ref_count == 0 ? 1 : 0;
+            }
+            while (nb_idle > MAX_IDLE_TEXTURES) {
+                auto oldest = m_entries.end();
+                for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
+                    if (it->second.ref_count == 0 &&
+                        (oldest == m_entries.end() ||
+                         it->second.last_used < oldest->second.last_used)) {
+                        oldest = it;
+                    }
+                }
+                m_tex_keys.erase(oldest->second.tex.buffer);
+                free_ogl_texture(oldest->second.tex);
+                m_entries.erase(oldest);
+                nb_idle -= 1;
+            }
+        }
+
+    }
+}
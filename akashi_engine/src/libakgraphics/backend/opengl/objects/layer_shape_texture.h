@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../core/glc.h"
+#include "../core/texture.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace akashi {
+    namespace core {
+        struct LayerContext;
+    }
+    namespace vgfx {
+        struct SurfaceEntry;
+    }
+    namespace graphics {
+
+        /**
+         * Shares the rasterized textures of shape layers.
+         *
+         * Textures are keyed by vgfx::surface_key(), so that shapes with identical parameters are
+         * rasterized and uploaded only once, and are refcounted. A few textures no longer in use
+         * are kept alive, so that recreating layers on atom changes does not rasterize them again.
+         *
+         * All the methods must be called from the thread which owns the GL context.
+         */
+        class ShapeTextureCache final {
+          public:
+            // the number of unused textures kept alive
+            static constexpr const size_t MAX_IDLE_TEXTURES = 16;
+
+          public:
+            explicit ShapeTextureCache(void) = default;
+            virtual ~ShapeTextureCache(void) = default;
+
+            /**
+             * Sets `tex` with the shape rasterized by vgfx::create_surface().
+             * The texture must be released with release().
+             */
+            bool acquire(OGLTexture& tex, const vgfx::SurfaceEntry& entry,
+                         const core::LayerContext& layer_ctx);
+
+            void release(const OGLTexture& tex);
+
+            void destroy(void);
+
+          private:
+            struct Entry {
+                OGLTexture tex;
+                size_t ref_count = 0;
+                uint64_t last_used = 0;
+            };
+
+            void evict_idle(void);
+
+          private:
+            std::unordered_map<std::string, Entry> m_entries;
+            std::unordered_map<GLuint, std::string> m_tex_keys;
+            uint64_t m_tick = 0;
+        };
+
+    }
+}
@@ -3,6 +3,7 @@
 #include "../render_context.h"
 #include "../fbo.h"
 #include "../core/texture.h"
+#include "../core/texture_pool.h"
 #include "../core/eglc.h"
 
 #include <libakcore/logger.h>
@@ -15,6 +16,8 @@
 #include <va/va_drmcommon.h>
 #include <unistd.h>
 
+#include <cstring>
+
 using namespace akashi::core;
 
 namespace akashi {
@@ -52,10 +55,16 @@ namespace akashi {
             return this->create_inner(m_decode_method, ctx, *m_buf_data);
         }
 
-        bool VideoTexture::destroy() {
-            for (auto&& tex : m_textures) {
-                free_ogl_texture(tex);
+        bool VideoTexture::destroy(const OGLRenderContext& ctx) {
+            for (size_t i = 0; i < m_textures.size(); i++) {
+                if (m_storages[i].internal_format != 0) {
+                    ctx.texture_pool()->release(m_textures[i]);
+                } else {
+                    free_ogl_texture(m_textures[i]);
+                }
             }
+            m_storages = {};
+            m_ring.destroy();
             if (m_hwctx->needs_free) {
                 this->free_vaapi_context();
             }
@@ -106,10 +115,8 @@ namespace akashi {
 
         bool VideoTexture::create_inner_sw(const OGLRenderContext& ctx,
                                            const buffer::AVBufferData& buf_data) {
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             for (size_t i = 0; i < m_textures.size(); i++) {
                 auto& tex = m_textures[i];
-                tex.image = buf_data.prop().video_data[i].buf;
                 tex.width = i == 0 ? buf_data.prop().width : buf_data.prop().chroma_width;
                 tex.height = i == 0 ? buf_data.prop().height : buf_data.prop().chroma_height;
                 tex.effective_width = tex.width;
@@ -120,28 +127,8 @@ namespace akashi {
 
                 // [TODO] could this be duplicate with the other indices
                 tex.index = i;
-
-                glBindTexture(GL_TEXTURE_2D, tex.buffer);
-
-                int bytes_per_pixel = 1;
-                glPixelStorei(GL_UNPACK_ROW_LENGTH,
-                              buf_data.prop().video_data[i].stride / bytes_per_pixel);
-
-                glTexImage2D(GL_TEXTURE_2D, 0, tex.internal_format, tex.width, tex.height, 0,
-                             tex.format, GL_UNSIGNED_BYTE, tex.image);
-
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-
-                // [XXX] make sure to explicity setup when not using mimap
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-                glBindTexture(GL_TEXTURE_2D, 0);
             }
-            glPixelStorei(GL_UNPACK_ALIGNMENT, graphics::DEFAULT_UNPACK_ALIGNMENT);
-            return true;
+            return this->upload_planes(ctx, buf_data, m_textures.size());
         }
 
         bool VideoTexture::create_inner_vaapi(const OGLRenderContext& ctx,
@@ -259,10 +246,8 @@ namespace akashi {
 
         bool VideoTexture::create_inner_vaapi_copy(const OGLRenderContext& ctx,
                                                    const buffer::AVBufferData& buf_data) {
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
             for (size_t i = 0; i < 2; i++) {
                 auto& tex = m_textures[i];
-                tex.image = buf_data.prop().video_data[i].buf;
                 tex.width = i == 0 ? buf_data.prop().width : buf_data.prop().chroma_width;
                 tex.height = i == 0 ? buf_data.prop().height : buf_data.prop().chroma_height;
                 tex.effective_width = tex.width;
@@ -273,28 +258,93 @@ namespace akashi {
 
                 // [TODO] could this be duplicate with the other indices
                 tex.index = i;
+            }
+            return this->upload_planes(ctx, buf_data, 2);
+        }
+
+        bool VideoTexture::upload_planes(const OGLRenderContext& ctx,
+                                         const buffer::AVBufferData& buf_data, size_t nb_planes) {
+            const auto& prop = buf_data.prop();
 
-                int bytes_per_pixel = i == 0 ? 1 : 2;
-                glPixelStorei(GL_UNPACK_ROW_LENGTH,
-                              buf_data.prop().video_data[i].stride / bytes_per_pixel);
+            std::array<size_t, 3> plane_offsets = {0, 0, 0};
+            size_t frame_size = 0;
+            for (size_t i = 0; i < nb_planes; i++) {
+                plane_offsets[i] = frame_size;
+                frame_size += static_cast<size_t>(prop.video_data[i].stride) * m_textures[i].height;
+            }
+
+            // the planes are staged in the ring, and copied to the textures by the GPU
+            UploadRing::Slot slot;
+            bool use_ring = m_ring.created() && m_ring.slot_size() >= frame_size;
+            if (!use_ring && !m_ring_disabled) {
+                use_ring = m_ring.create(frame_size);
+                if (!use_ring) {
+                    AKLOG_WARNN("Failed to create the upload ring, falling back to sync uploads");
+                    m_ring_disabled = true;
+                }
+            }
+            if (use_ring && !m_ring.begin(slot)) {
+                use_ring = false;
+            }
+            if (use_ring) {
+                for (size_t i = 0; i < nb_planes; i++) {
+                    const size_t plane_size =
+                        static_cast<size_t>(prop.video_data[i].stride) * m_textures[i].height;
+                    std::memcpy(slot.ptr + plane_offsets[i], prop.video_data[i].buf, plane_size);
+                }
+                use_ring = m_ring.end(slot);
+            }
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (size_t i = 0; i < nb_planes; i++) {
+                auto& tex = m_textures[i];
+                this->alloc_storage(ctx, i);
 
                 glBindTexture(GL_TEXTURE_2D, tex.buffer);
-                glTexImage2D(GL_TEXTURE_2D, 0, tex.internal_format, tex.width, tex.height, 0,
-                             tex.format, GL_UNSIGNED_BYTE, tex.image);
-                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
-                // [XXX] make sure to explicity setup when not using mimap
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                int bytes_per_pixel = tex.format == GL_RG ? 2 : 1;
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, prop.video_data[i].stride / bytes_per_pixel);
 
+                const void* pixels =
+                    use_ring ? reinterpret_cast<const void*>(slot.offset + plane_offsets[i])
+                             : prop.video_data[i].buf;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex.width, tex.height, tex.format,
+                                GL_UNSIGNED_BYTE, pixels);
+
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
                 glBindTexture(GL_TEXTURE_2D, 0);
             }
             glPixelStorei(GL_UNPACK_ALIGNMENT, graphics::DEFAULT_UNPACK_ALIGNMENT);
+
+            if (use_ring) {
+                m_ring.fence(slot);
+            }
             return true;
         }
 
+        void VideoTexture::alloc_storage(const OGLRenderContext& ctx, size_t plane_idx) {
+            auto& tex = m_textures[plane_idx];
+            auto& storage = m_storages[plane_idx];
+            if (storage.width == tex.width && storage.height == tex.height &&
+                storage.internal_format == tex.internal_format) {
+                return;
+            }
+
+            // immutable storages cannot be resized, so that the texture itself is swapped
+            if (storage.internal_format != 0) {
+                OGLTexture old_tex = tex;
+                old_tex.width = storage.width;
+                old_tex.height = storage.height;
+                old_tex.internal_format = storage.internal_format;
+                ctx.texture_pool()->release(old_tex);
+            } else {
+                // the placeholder from create()
+                glDeleteTextures(1, &tex.buffer);
+            }
+            ctx.texture_pool()->acquire(tex);
+            storage = {tex.width, tex.height, tex.internal_format};
+        }
+
         void VideoTexture::free_vaapi_context() {
             if (m_hwctx->needs_free) {
                 for (uint32_t i = 0; i < m_hwctx->desc.num_layers; i++) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../core/eglc.h"
+#include "../core/upload_ring.h"
 
 #include <libakcore/hw_accel.h>
 #include <libakcore/memory.h>
@@ -8,6 +9,7 @@
 #include <va/va.h>
 #include <va/va_drmcommon.h>
 
+#include <array>
 #include <vector>
 
 namespace akashi {
@@ -50,7 +52,7 @@ namespace akashi {
             bool create(const OGLRenderContext& ctx,
                         core::owned_ptr<buffer::AVBufferData>&& buf_data);
 
-            bool destroy();
+            bool destroy(const OGLRenderContext& ctx);
 
             bool update(const OGLRenderContext& ctx,
                         core::owned_ptr<buffer::AVBufferData>&& buf_data);
@@ -73,6 +75,11 @@ namespace akashi {
 
             bool create_inner_vaapi_copy(const OGLRenderContext&, const buffer::AVBufferData&);
 
+            bool upload_planes(const OGLRenderContext& ctx, const buffer::AVBufferData& buf_data,
+                               size_t nb_planes);
+
+            void alloc_storage(const OGLRenderContext& ctx, size_t plane_idx);
+
             void free_vaapi_context();
 
             void update_texture_info(const buffer::AVBufferData& buf_data);
@@ -83,6 +90,17 @@ namespace akashi {
             core::owned_ptr<buffer::AVBufferData> m_buf_data;
             VideoTextureInfo m_info;
             HWContext* m_hwctx = nullptr;
+
+            // the immutable storages of the planes, borrowed from OGLRenderContext::texture_pool()
+            // and swapped only on resolution changes
+            struct PlaneStorage {
+                int width = 0;
+                int height = 0;
+                GLenum internal_format = 0;
+            };
+            std::array<PlaneStorage, 3> m_storages;
+            UploadRing m_ring;
+            bool m_ring_disabled = false;
         };
 
     }
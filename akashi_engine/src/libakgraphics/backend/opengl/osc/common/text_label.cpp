@@ -7,6 +7,7 @@
 #include "../../core/texture.h"
 #include "../../meshes/quad.h"
 #include "../../resource/font.h"
+#include "../../text/text_renderer.h"
 
 #include <libakcore/error.h>
 #include <libakcore/logger.h>
@@ -71,10 +72,11 @@ namespace akashi {
             glm::mat4 model_mat = glm::mat4(1.0f);
         };
 
-        TextLabel::TextLabel(const TextLabel::Params& init_params) : m_obj_params(init_params) {
+        TextLabel::TextLabel(OSCRenderContext& render_ctx, const TextLabel::Params& init_params)
+            : m_obj_params(init_params) {
             m_ctx = new TextLabel::Context;
 
-            this->load_pass();
+            this->load_pass(render_ctx);
         }
 
         TextLabel::~TextLabel() {
@@ -99,7 +101,7 @@ namespace akashi {
         bool TextLabel::render(OSCRenderContext& render_ctx, const RenderParams& /*params*/) {
             if (m_dirty) {
                 free_ogl_texture(m_ctx->tex);
-                this->load_texture();
+                this->load_texture(render_ctx);
                 // [TODO]  translate?
                 m_dirty = false;
             }
@@ -127,7 +129,7 @@ namespace akashi {
             return true;
         }
 
-        bool TextLabel::load_pass() {
+        bool TextLabel::load_pass(OSCRenderContext& render_ctx) {
             m_ctx->prog = glCreateProgram();
 
             CHECK_AK_ERROR2(compile_attach_shader(m_ctx->prog, GL_VERTEX_SHADER, vshader_src));
@@ -137,7 +139,7 @@ namespace akashi {
             m_ctx->mvp_loc = glGetUniformLocation(m_ctx->prog, "u_mvp");
             m_ctx->tex_loc = glGetUniformLocation(m_ctx->prog, "texture0");
 
-            CHECK_AK_ERROR2(this->load_texture());
+            CHECK_AK_ERROR2(this->load_texture(render_ctx));
             CHECK_AK_ERROR2(this->load_mesh());
 
             m_ctx->model_mat = glm::translate(m_ctx->model_mat,
@@ -183,9 +185,7 @@ namespace akashi {
             return true;
         }
 
-        bool TextLabel::create_ogl_texture(OGLTexture& tex) {
-            SDL_Surface* surface = nullptr;
-
+        bool TextLabel::create_ogl_texture(OSCRenderContext& render_ctx, OGLTexture& tex) {
             FontInfo info;
             info.text = m_obj_params.text;
             info.text_align = m_obj_params.text_align;
@@ -207,46 +207,18 @@ namespace akashi {
             shadow.color = hex_to_sdl(style.shadow_color);
             shadow.size = style.shadow_size;
 
-            if (!FontLoader::GetInstance().get_surface(surface, info,
-                                                       style.use_outline ? &outline : nullptr,
-                                                       style.use_shadow ? &shadow : nullptr)) {
-                AKLOG_ERRORN("Failed to getFontsSurface");
+            if (!render_ctx.text_renderer()->render(tex, info,
+                                                    style.use_outline ? &outline : nullptr,
+                                                    style.use_shadow ? &shadow : nullptr)) {
+                AKLOG_ERRORN("Failed to render the text");
                 return false;
             }
 
-            tex.image = surface->pixels;
-            tex.width = surface->w;
-            tex.height = surface->h;
-            tex.effective_width = tex.width;
-            tex.effective_height = tex.height;
-            tex.format = (surface->format->BytesPerPixel == 3) ? GL_RGB : GL_RGBA;
-            tex.surface = surface;
-
             return true;
         }
 
-        bool TextLabel::load_texture() {
-            CHECK_AK_ERROR2(this->create_ogl_texture(m_ctx->tex));
-
-            glGenTextures(1, &m_ctx->tex.buffer);
-
-            glBindTexture(GL_TEXTURE_2D, m_ctx->tex.buffer);
-            glTexImage2D(GL_TEXTURE_2D, 0, m_ctx->tex.internal_format, m_ctx->tex.width,
-                         m_ctx->tex.height, 0, m_ctx->tex.format, GL_UNSIGNED_BYTE,
-                         m_ctx->tex.image);
-
-            // glGenerateMipmap(GL_TEXTURE_2D);
-
-            // [XXX] make sure to explicity setup when not using mimap
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glBindTexture(GL_TEXTURE_2D, 0);
-
-            // SDL_FreeSurface((SDL_Surface*)surface);
-
+        bool TextLabel::load_texture(OSCRenderContext& render_ctx) {
+            CHECK_AK_ERROR2(this->create_ogl_texture(render_ctx, m_ctx->tex));
             return true;
         }
 
@@ -31,7 +31,8 @@ namespace akashi {
                 };
 
               public:
-                explicit TextLabel(const TextLabel::Params& init_params);
+                explicit TextLabel(OSCRenderContext& render_ctx,
+                                   const TextLabel::Params& init_params);
                 virtual ~TextLabel();
 
                 void update_obj_params(const TextLabel::Params& obj_params);
@@ -43,11 +44,11 @@ namespace akashi {
                 bool render(OSCRenderContext& render_ctx, const RenderParams& params);
 
               private:
-                bool load_pass();
+                bool load_pass(OSCRenderContext& render_ctx);
 
-                bool create_ogl_texture(OGLTexture& tex);
+                bool create_ogl_texture(OSCRenderContext& render_ctx, OGLTexture& tex);
 
-                bool load_texture();
+                bool load_texture(OSCRenderContext& render_ctx);
 
                 bool load_mesh();
 
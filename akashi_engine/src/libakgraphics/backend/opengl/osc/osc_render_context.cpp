@@ -3,6 +3,7 @@
 
 #include "../../../item.h"
 #include "../core/glc.h"
+#include "../text/text_renderer.h"
 
 #include <libakcore/memory.h>
 #include <libakcore/error.h>
@@ -17,9 +18,10 @@ namespace akashi {
                                            core::borrowed_ptr<state::AKState> state)
             : m_evt_cb(evt_cb), m_state(state) {
             this->initialize_camera(params);
+            m_text_renderer = core::make_owned<TextRenderer>();
         }
 
-        OSCRenderContext::~OSCRenderContext() {}
+        OSCRenderContext::~OSCRenderContext() { m_text_renderer->destroy(); }
 
         void OSCRenderContext::resize(const RenderParams& params) {
             m_camera.reset(nullptr);
@@ -81,6 +83,10 @@ namespace akashi {
             return core::borrowed_ptr(m_camera.get());
         }
 
+        core::borrowed_ptr<TextRenderer> OSCRenderContext::text_renderer() const {
+            return core::borrowed_ptr(m_text_renderer.get());
+        }
+
         std::string OSCRenderContext::default_font_path() {
             std::string font_path;
             {
@@ -23,6 +23,7 @@ namespace akashi {
     namespace graphics {
 
         struct RenderParams;
+        class TextRenderer;
 
         class OSCRenderContext final {
           public:
@@ -50,6 +51,8 @@ namespace akashi {
 
             const core::borrowed_ptr<osc::Camera> camera() const;
 
+            core::borrowed_ptr<TextRenderer> text_renderer() const;
+
             std::string default_font_path();
 
             void use_default_blend_func() const;
@@ -81,6 +84,7 @@ namespace akashi {
             OSCEventCallback m_evt_cb;
             core::borrowed_ptr<state::AKState> m_state;
             core::owned_ptr<osc::Camera> m_camera;
+            core::owned_ptr<TextRenderer> m_text_renderer;
             bool m_is_second_mode = true;
             size_t m_zoom_level = 1;
             size_t m_second_zoom_level = 1;
@@ -39,7 +39,7 @@ namespace akashi {
             text_params.w = bbox.w;
             text_params.h = bbox.h;
 
-            m_ctx->m_text_label = core::make_owned<osc::TextLabel>(text_params);
+            m_ctx->m_text_label = core::make_owned<osc::TextLabel>(render_ctx, text_params);
         }
 
         PlayBtn::~PlayBtn() {
@@ -183,7 +183,7 @@ namespace akashi {
             text_params.w = m_bbox.w * 6;
             text_params.h = m_bbox.w * 9;
 
-            m_ctx->knob_pass.text_label = core::make_owned<osc::TextLabel>(text_params);
+            m_ctx->knob_pass.text_label = core::make_owned<osc::TextLabel>(render_ctx, text_params);
 
             this->update_knob_transform(m_ctx->knob_pass.model_mat);
             m_ctx->knob_pass.text_label->update_transform(m_ctx->knob_pass.model_mat);
@@ -56,7 +56,7 @@ namespace akashi {
             text_params.h = bbox.h;
             text_params.size_pref = osc::TextLabel::MeshSizePref::FIXED_WIDTH_TEX;
 
-            m_ctx->text_label = core::make_owned<osc::TextLabel>(text_params);
+            m_ctx->text_label = core::make_owned<osc::TextLabel>(render_ctx, text_params);
         }
 
         Timecode::~Timecode() {
@@ -67,8 +67,12 @@ namespace akashi {
 
         bool Timecode::update(OSCRenderContext& render_ctx, const RenderParams& params) {
             auto text_params = m_ctx->text_label->obj_params();
-            text_params.text = this->construct_time_string();
-            m_ctx->text_label->update_obj_params(text_params);
+            auto time_string = this->construct_time_string();
+            // avoid re-rendering the label when the timecode is unchanged
+            if (text_params.text != time_string) {
+                text_params.text = time_string;
+                m_ctx->text_label->update_obj_params(text_params);
+            }
             return true;
         }
 
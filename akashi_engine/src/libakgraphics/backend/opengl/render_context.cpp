@@ -1,6 +1,13 @@
 #include "./render_context.h"
 #include "./fbo.h"
+#include "./fbo_pool.h"
 #include "./camera.h"
+#include "./core/program_cache.h"
+#include "./core/texture_pool.h"
+#include "./text/text_renderer.h"
+#include "./objects/layer_image_texture.h"
+#include "./objects/layer_shape_texture.h"
+#include "./objects/layer_batch.h"
 
 #include <libakcore/memory.h>
 #include <libakcore/error.h>
@@ -20,9 +27,25 @@ namespace akashi {
                                            core::borrowed_ptr<buffer::AVBuffer> buffer)
             : m_state(state), m_buffer(buffer) {
             m_fbo = core::make_owned<FBO>();
+            m_fbo_pool = core::make_owned<FBOPool>();
+            m_texture_pool = core::make_owned<TexturePool>();
+            m_program_cache = core::make_owned<ProgramCache>();
+            m_text_renderer = core::make_owned<TextRenderer>();
+            m_image_textures = core::make_owned<ImageTextureCache>();
+            m_shape_textures = core::make_owned<ShapeTextureCache>();
+            m_layer_batch = core::make_owned<LayerBatch>();
         }
 
-        OGLRenderContext::~OGLRenderContext() { m_fbo->destroy(); }
+        OGLRenderContext::~OGLRenderContext() {
+            m_fbo->destroy();
+            m_program_cache->destroy();
+            m_text_renderer->destroy();
+            m_image_textures->destroy();
+            m_shape_textures->destroy();
+            m_layer_batch->destroy();
+            m_texture_pool->destroy();
+            m_fbo_pool->destroy();
+        }
 
         const FBO& OGLRenderContext::fbo() const { return *m_fbo; }
 
@@ -61,6 +84,34 @@ namespace akashi {
             return core::borrowed_ptr(m_camera.get());
         }
 
+        core::borrowed_ptr<FBOPool> OGLRenderContext::fbo_pool() const {
+            return core::borrowed_ptr(m_fbo_pool.get());
+        }
+
+        core::borrowed_ptr<TexturePool> OGLRenderContext::texture_pool() const {
+            return core::borrowed_ptr(m_texture_pool.get());
+        }
+
+        core::borrowed_ptr<ProgramCache> OGLRenderContext::program_cache() const {
+            return core::borrowed_ptr(m_program_cache.get());
+        }
+
+        core::borrowed_ptr<TextRenderer> OGLRenderContext::text_renderer() const {
+            return core::borrowed_ptr(m_text_renderer.get());
+        }
+
+        core::borrowed_ptr<ImageTextureCache> OGLRenderContext::image_textures() const {
+            return core::borrowed_ptr(m_image_textures.get());
+        }
+
+        core::borrowed_ptr<ShapeTextureCache> OGLRenderContext::shape_textures() const {
+            return core::borrowed_ptr(m_shape_textures.get());
+        }
+
+        core::borrowed_ptr<LayerBatch> OGLRenderContext::layer_batch() const {
+            return core::borrowed_ptr(m_layer_batch.get());
+        }
+
         core::Rational OGLRenderContext::fps() {
             core::Rational fps;
             {
@@ -20,7 +20,14 @@ namespace akashi {
     namespace graphics {
 
         class FBO;
+        class FBOPool;
+        class TexturePool;
         class Camera;
+        class ProgramCache;
+        class TextRenderer;
+        class ImageTextureCache;
+        class ShapeTextureCache;
+        class LayerBatch;
 
         class OGLRenderContext final {
           public:
@@ -38,6 +45,25 @@ namespace akashi {
 
             const core::borrowed_ptr<Camera> camera() const;
 
+            core::borrowed_ptr<FBOPool> fbo_pool() const;
+
+            core::borrowed_ptr<TexturePool> texture_pool() const;
+
+            core::borrowed_ptr<ProgramCache> program_cache() const;
+
+            core::borrowed_ptr<TextRenderer> text_renderer() const;
+
+            core::borrowed_ptr<ImageTextureCache> image_textures() const;
+
+            core::borrowed_ptr<ShapeTextureCache> shape_textures() const;
+
+            core::borrowed_ptr<LayerBatch> layer_batch() const;
+
+            // when false, resources are loaded synchronously, e.g. on encoding
+            bool async_loads() const { return m_async_loads; }
+
+            void set_async_loads(bool async_loads) { m_async_loads = async_loads; }
+
             core::Rational fps();
 
             std::array<long, 2> resolution();
@@ -61,6 +87,15 @@ namespace akashi {
 
             core::owned_ptr<FBO> m_fbo;
             core::owned_ptr<Camera> m_camera;
+            core::owned_ptr<FBOPool> m_fbo_pool;
+            core::owned_ptr<TexturePool> m_texture_pool;
+            core::owned_ptr<ProgramCache> m_program_cache;
+            core::owned_ptr<TextRenderer> m_text_renderer;
+            core::owned_ptr<ImageTextureCache> m_image_textures;
+            core::owned_ptr<ShapeTextureCache> m_shape_textures;
+            core::owned_ptr<LayerBatch> m_layer_batch;
+
+            bool m_async_loads = true;
         };
 
     }
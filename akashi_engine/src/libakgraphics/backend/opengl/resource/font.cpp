@@ -22,9 +22,30 @@ namespace akashi {
 
         FontLoader::~FontLoader(void) {
             // [TODO] usually, this will not be called. how should we treat this?
+            for (auto&& [key, font] : m_fonts) {
+                TTF_CloseFont(font);
+            }
             TTF_Quit();
         };
 
+        TTF_Font* FontLoader::font(const std::string& font_path, int size, int outline) {
+            auto key = font_path + ":" + std::to_string(size) + ":" + std::to_string(outline);
+            if (auto it = m_fonts.find(key); it != m_fonts.end()) {
+                return it->second;
+            }
+
+            auto font = TTF_OpenFont(font_path.c_str(), size);
+            if (!font) {
+                AKLOG_ERROR("TTF_OpenFont failed\n{}", TTF_GetError());
+                return nullptr;
+            }
+            if (outline > 0) {
+                TTF_SetFontOutline(font, outline);
+            }
+            m_fonts.insert({key, font});
+            return font;
+        }
+
         bool FontLoader::get_surface(SDL_Surface*& surface, const FontInfo& info,
                                      const FontOutline* outline, const FontShadow* shadow) {
             if (info.text.empty()) {
@@ -99,17 +120,13 @@ namespace akashi {
 
         bool FontLoader::get_surface_normal(SDL_Surface*& surface, const FontInfo& info,
                                             const FontOutline* outline) {
-            auto font = TTF_OpenFont(info.font_path.c_str(), info.size);
+            auto font =
+                this->font(info.font_path, info.size, outline ? std::max(0, outline->size) : 0);
             if (!font) {
-                AKLOG_ERROR("TTF_OpenFont failed\n{}", TTF_GetError());
                 return false;
             }
-            if (outline && outline->size > 0) {
-                TTF_SetFontOutline(font, outline->size);
-            }
             surface = TTF_RenderUTF8_Blended(font, info.text.c_str(),
                                              outline ? outline->color : info.color);
-            TTF_CloseFont(font);
             if (!surface) {
                 AKLOG_ERROR("TTF_RenderUTF8_Blended failed\n{}", TTF_GetError());
                 return false;
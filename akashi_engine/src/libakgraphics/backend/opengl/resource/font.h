@@ -6,8 +6,10 @@
 
 #include <SDL.h>
 #include <string>
+#include <unordered_map>
 
 typedef struct SDL_Surface SDL_Surface;
+typedef struct _TTF_Font TTF_Font;
 
 namespace akashi {
     namespace graphics {
@@ -41,6 +43,12 @@ namespace akashi {
                              const FontOutline* outline = nullptr,
                              const FontShadow* shadow = nullptr);
 
+            /**
+             * Returns the cached font handle, opening it on the first call.
+             * The handle is owned by FontLoader, and must not be closed by the caller.
+             */
+            TTF_Font* font(const std::string& font_path, int size, int outline = 0);
+
           private:
             explicit FontLoader(void);
             virtual ~FontLoader(void);
@@ -53,6 +61,10 @@ namespace akashi {
 
             bool get_surface_shadow(SDL_Surface*& surface, const FontInfo& info,
                                     const FontShadow& outline);
+
+          private:
+            // keyed by `font_path:size:outline`, since the outline is a state of the handle
+            std::unordered_map<std::string, TTF_Font*> m_fonts;
         };
 
         SDL_Color hex_to_sdl(std::string input);
@@ -0,0 +1,241 @@
+#include "./image_cache.h"
+#include "./image.h"
+
+#include <libakcore/logger.h>
+#include <libakcore/error.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        static std::array<int, 2> scaled_size(int width, int height,
+                                              const std::array<int, 2>& min_size) {
+            // the smallest factor which still covers all the constrained axes
+            double factor = 0.0;
+            if (min_size[0] > 0) {
+                factor = std::max(factor, static_cast<double>(min_size[0]) / width);
+            }
+            if (min_size[1] > 0) {
+                factor = std::max(factor, static_cast<double>(min_size[1]) / height);
+            }
+            if (factor <= 0.0 || factor >= 1.0) {
+                return {width, height};
+            }
+            return {std::max(1, static_cast<int>(std::ceil(width * factor))),
+                    std::max(1, static_cast<int>(std::ceil(height * factor)))};
+        }
+
+        // box filter; colors are weighted by alpha, so that transparent pixels never bleed
+        static void downscale(ImageData& dst, const uint8_t* src, int src_pitch) {
+            const int bpp = dst.bytes_per_pixel;
+            const int sw = dst.source_width;
+            const int sh = dst.source_height;
+            for (int dy = 0; dy < dst.height; dy++) {
+                const int y0 = static_cast<long long>(dy) * sh / dst.height;
+                const int y1 = std::max(
+                    y0 + 1, static_cast<int>(static_cast<long long>(dy + 1) * sh / dst.height));
+                for (int dx = 0; dx < dst.width; dx++) {
+                    const int x0 = static_cast<long long>(dx) * sw / dst.width;
+                    const int x1 = std::max(
+                        x0 + 1, static_cast<int>(static_cast<long long>(dx + 1) * sw / dst.width));
+
+                    uint64_t sums[4] = {0, 0, 0, 0};
+                    for (int y = y0; y < y1; y++) {
+                        const uint8_t* row = src + static_cast<size_t>(y) * src_pitch;
+                        for (int x = x0; x < x1; x++) {
+                            const uint8_t* px = row + x * bpp;
+                            const uint64_t weight = bpp == 4 ? px[3] : 1;
+                            sums[0] += px[0] * weight;
+                            sums[1] += px[1] * weight;
+                            sums[2] += px[2] * weight;
+                            sums[3] += weight;
+                        }
+                    }
+
+                    uint8_t* out =
+                        dst.pixels.data() + (static_cast<size_t>(dy) * dst.width + dx) * bpp;
+                    for (int c = 0; c < 3; c++) {
+                        out[c] = sums[3] > 0 ? sums[c] / sums[3] : 0;
+                    }
+                    if (bpp == 4) {
+                        out[3] = sums[3] / ((y1 - y0) * (x1 - x0));
+                    }
+                }
+            }
+        }
+
+        static std::shared_ptr<ImageData> decode(const std::string& path,
+                                                 const std::array<int, 2>& min_size) {
+            SDL_Surface* loaded = nullptr;
+            if (ImageLoader::getSurface(loaded, path.c_str()) != ErrorType::OK) {
+                AKLOG_ERROR("Failed to getSurface: {}", path.c_str());
+                return nullptr;
+            }
+
+            // indexed and packed formats are converted, so that the pixels can be uploaded as is
+            const bool has_alpha = loaded->format->BytesPerPixel != 3;
+            auto surface = SDL_ConvertSurfaceFormat(
+                loaded, has_alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24, 0);
+            SDL_FreeSurface(loaded);
+            if (!surface) {
+                AKLOG_ERROR("Failed to convert the image: {}\n{}", path.c_str(), SDL_GetError());
+                return nullptr;
+            }
+
+            auto data = std::make_shared<ImageData>();
+            data->bytes_per_pixel = has_alpha ? 4 : 3;
+            data->source_width = surface->w;
+            data->source_height = surface->h;
+            auto size = scaled_size(surface->w, surface->h, min_size);
+            data->width = size[0];
+            data->height = size[1];
+            data->pixels.resize(static_cast<size_t>(data->width) * data->height *
+                                data->bytes_per_pixel);
+
+            const auto src = static_cast<const uint8_t*>(surface->pixels);
+            if (data->width == surface->w && data->height == surface->h) {
+                const size_t row_size = static_cast<size_t>(data->width) * data->bytes_per_pixel;
+                for (int y = 0; y < data->height; y++) {
+                    std::memcpy(data->pixels.data() + y * row_size, src + y * surface->pitch,
+                                row_size);
+                }
+            } else {
+                downscale(*data, src, surface->pitch);
+            }
+
+            SDL_FreeSurface(surface);
+            return data;
+        }
+
+        ImageCache::ImageCache(size_t nb_workers) {
+            // IMG_Init must run before the workers call IMG_Load
+            ImageLoader::GetInstance();
+            for (size_t i = 0; i < std::max<size_t>(nb_workers, 1); i++) {
+                m_workers.emplace_back(&ImageCache::worker_loop, this);
+            }
+        }
+
+        ImageCache::~ImageCache() { this->close_and_wait(); }
+
+        std::string ImageCache::key(const std::string& path, const std::array<int, 2>& min_size) {
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(path, ec);
+            // missing files are left to the decoder to report
+            auto ticks = ec ? 0 : mtime.time_since_epoch().count();
+            return path + '\n' + std::to_string(ticks) + '\n' + std::to_string(min_size[0]) +
+                   'x' + std::to_string(min_size[1]);
+        }
+
+        ImageCache::Status ImageCache::request(std::shared_ptr<const ImageData>& data,
+                                               const std::string& path,
+                                               const std::array<int, 2>& min_size, bool wait) {
+            auto key = ImageCache::key(path, min_size);
+
+            std::unique_lock<std::mutex> lock(m_mtx);
+            if (m_closed) {
+                return Status::FAILED;
+            }
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                m_entries.insert({key, Entry{}});
+                m_jobs.push_back({key, path, min_size});
+                m_job_cv.notify_one();
+            }
+
+            if (wait) {
+                m_done_cv.wait(lock, [&]() {
+                    auto it = m_entries.find(key);
+                    return m_closed || it == m_entries.end() ||
+                           it->second.status != Status::PENDING;
+                });
+            }
+
+            // [XXX] The entry may have been evicted while waiting. Callers just request it again.
+            it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                return m_closed ? Status::FAILED : Status::PENDING;
+            }
+            it->second.last_used = ++m_tick;
+            if (it->second.status == Status::READY) {
+                data = it->second.data;
+            }
+            return it->second.status;
+        }
+
+        void ImageCache::close_and_wait(void) {
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_closed = true;
+            }
+            m_job_cv.notify_all();
+            m_done_cv.notify_all();
+            for (auto&& worker : m_workers) {
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+            m_workers.clear();
+        }
+
+        void ImageCache::worker_loop(void) {
+            while (true) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mtx);
+                    m_job_cv.wait(lock, [&]() { return m_closed || !m_jobs.empty(); });
+                    if (m_closed) {
+                        return;
+                    }
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                }
+
+                auto data = decode(job.path, job.min_size);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mtx);
+                    if (auto it = m_entries.find(job.key); it != m_entries.end()) {
+                        if (data) {
+                            it->second.status = Status::READY;
+                            m_cached_bytes += data->pixels.size();
+                            it->second.data = std::move(data);
+                        } else {
+                            it->second.status = Status::FAILED;
+                        }
+                        it->second.last_used = ++m_tick;
+                    }
+                    this->evict_unused();
+                }
+                m_done_cv.notify_all();
+            }
+        }
+
+        void ImageCache::evict_unused(void) {
+            while (m_cached_bytes > MAX_CACHED_BYTES) {
+                auto oldest = m_entries.end();
+                for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
+                    // images still held by someone are not freed by the eviction anyway
+                    if (it->second.status == Status::READY && it->second.data.use_count() == 1 &&
+                        (oldest == m_entries.end() ||
+                         it->second.last_used < oldest->second.last_used)) {
+                        oldest = it;
+                    }
+                }
+                if (oldest == m_entries.end()) {
+                    break;
+                }
+                m_cached_bytes -= oldest->second.data->pixels.size();
+                m_entries.erase(oldest);
+            }
+        }
+
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace akashi {
+    namespace graphics {
+
+        /**
+         * Decoded pixels, tightly packed, in RGB or RGBA byte order.
+         */
+        struct ImageData {
+            int width = 0;
+            int height = 0;
+            int bytes_per_pixel = 0;
+            // the size before downscaling
+            int source_width = 0;
+            int source_height = 0;
+            std::vector<uint8_t> pixels;
+        };
+
+        /**
+         * Decodes images on background threads, and keeps the results keyed by path and mtime.
+         *
+         * Requests for the same image are coalesced, so that an image used in many layers is
+         * decoded only once. Edited files get a new mtime, and are decoded again.
+         */
+        class ImageCache final {
+          public:
+            enum class Status { PENDING = 0, READY, FAILED };
+
+            static constexpr const size_t DEFAULT_WORKERS = 2;
+            static constexpr const size_t MAX_CACHED_BYTES = 256 * 1024 * 1024;
+
+          public:
+            explicit ImageCache(size_t nb_workers = DEFAULT_WORKERS);
+            virtual ~ImageCache();
+
+            /**
+             * Identifies the current version of the image.
+             * `min_size` is the smallest size the image is displayed at, see request().
+             */
+            static std::string key(const std::string& path, const std::array<int, 2>& min_size);
+
+            /**
+             * Requests the image, and sets `data` when it is READY.
+             *
+             * Images larger than `min_size` are downscaled to the smallest size which still
+             * covers it, keeping the aspect ratio. Negative values leave the axis unconstrained.
+             * Unless `wait` is true, this never blocks.
+             */
+            Status request(std::shared_ptr<const ImageData>& data, const std::string& path,
+                           const std::array<int, 2>& min_size = {-1, -1}, bool wait = false);
+
+            void close_and_wait(void);
+
+          private:
+            struct Job {
+                std::string key;
+                std::string path;
+                std::array<int, 2> min_size;
+            };
+
+            struct Entry {
+                Status status = Status::PENDING;
+                std::shared_ptr<const ImageData> data;
+                uint64_t last_used = 0;
+            };
+
+            void worker_loop(void);
+
+            void evict_unused(void);
+
+          private:
+            std::vector<std::thread> m_workers;
+            std::deque<Job> m_jobs;
+            std::unordered_map<std::string, Entry> m_entries;
+            size_t m_cached_bytes = 0;
+            uint64_t m_tick = 0;
+            bool m_closed = false;
+
+            std::mutex m_mtx;
+            std::condition_variable m_job_cv;
+            std::condition_variable m_done_cv;
+        };
+
+    }
+}
@@ -3,8 +3,10 @@
 #include "./core/glc.h"
 #include "./render_context.h"
 #include "./fbo.h"
+#include "./fbo_pool.h"
 #include "./camera.h"
 #include "./objects/layer_object.h"
+#include "./objects/layer_batch.h"
 
 #include "../../item.h"
 
@@ -44,7 +46,8 @@ namespace akashi {
                 m_base_layer = render_ctx.get_base_layer(m_plane_ctx);
                 auto fb_size = m_base_layer.t_unit->fb_size;
 
-                if (!(m_fbo.create(fb_size[0], fb_size[1], render_ctx.msaa()))) {
+                m_fbo = render_ctx.fbo_pool()->acquire(fb_size[0], fb_size[1], render_ctx.msaa());
+                if (!m_fbo) {
                     AKLOG_ERRORN("Failed to create FBO");
                 }
 
@@ -60,7 +63,10 @@ namespace akashi {
         }
 
         void RenderPlane::destroy(const OGLRenderContext& ctx) {
-            m_fbo.destroy();
+            if (m_fbo) {
+                ctx.fbo_pool()->release(m_fbo);
+                m_fbo = nullptr;
+            }
 
             for (auto&& layer_object : m_layer_objects) {
                 layer_object->destroy(ctx);
@@ -74,12 +80,11 @@ namespace akashi {
 
         bool RenderPlane::render(OGLRenderContext& render_ctx, const core::Rational& pts,
                                  const Stage& stage) {
-            auto& cur_fbo = m_plane_ctx.level == 0 ? render_ctx.mut_fbo() : m_fbo;
-
-            auto bg_color = m_plane_ctx.level == 0 ? m_atom_static_profile.bg_color
-                                                   : m_base_layer.t_unit->bg_color;
-            std::array<float, 4> fb_bg_color = core::to_rgba_float(bg_color);
-            priv::init_renderer(cur_fbo.info(), fb_bg_color);
+            if (m_plane_ctx.level > 0 && !m_fbo) {
+                // already reported on creation
+                return true;
+            }
+            auto& cur_fbo = m_plane_ctx.level == 0 ? render_ctx.mut_fbo() : *m_fbo;
 
             auto cur_layer_ctxs = render_ctx.local_eval(m_plane_ctx);
             if (m_initial_render) {
@@ -96,34 +101,110 @@ namespace akashi {
                 }
             }
 
-            for (auto iter = m_layer_objects.rbegin(), end = m_layer_objects.rend(); iter != end;
-                 ++iter) {
-                auto& layer_object = *iter;
+            m_is_redrawn = this->needs_render(pts, stage);
+            if (!m_is_redrawn) {
+                return true;
+            }
+
+            auto bg_color = m_plane_ctx.level == 0 ? m_atom_static_profile.bg_color
+                                                   : m_base_layer.t_unit->bg_color;
+            std::array<float, 4> fb_bg_color = core::to_rgba_float(bg_color);
+            priv::init_renderer(cur_fbo.info(), fb_bg_color);
+
+            const auto& camera = m_camera ? *m_camera : *render_ctx.camera();
+
+            // the layers beneath an opaque layer covering the whole plane are hidden, as long as
+            // they are not in front of it
+            size_t nb_unoccluded = m_layer_objects.size();
+            float occluder_depth = 0.0f;
+            for (size_t i = 0; i < m_layer_objects.size(); i++) {
+                if (m_layer_objects[i] && m_layer_objects[i]->covers_viewport(camera)) {
+                    nb_unoccluded = i + 1;
+                    occluder_depth = m_layer_objects[i]->depth();
+                    break;
+                }
+            }
+
+            const auto is_occluded = [&](size_t i) {
+                return i >= nb_unoccluded && m_layer_objects[i]->depth() <= occluder_depth;
+            };
+
+            std::vector<LayerObject*> batch;
+            for (size_t i = m_layer_objects.size(); i-- > 0;) {
+                auto& layer_object = m_layer_objects[i];
                 if (!layer_object) {
                     continue;
                 }
 
                 if (layer_object->can_display()) {
+                    if (is_occluded(i)) {
+                        layer_object->skip(render_ctx, pts);
+                        continue;
+                    }
+
+                    // the following layers of the same key are drawn along with this one
+                    layer::BatchKey key;
+                    if (render_ctx.layer_batch()->enabled() && layer_object->batch_key(key)) {
+                        batch = {layer_object};
+                        for (layer::BatchKey next_key; i > 0; i--) {
+                            auto next = m_layer_objects[i - 1];
+                            if (!next || is_occluded(i - 1) || !next->batch_key(next_key) ||
+                                !(next_key == key)) {
+                                break;
+                            }
+                            batch.push_back(next);
+                        }
+                        if (batch.size() > 1) {
+                            CHECK_AK_ERROR2(
+                                render_ctx.layer_batch()->render(render_ctx, batch, camera));
+                            continue;
+                        }
+                    }
+
                     if (layer_object->is_unit()) {
                         RenderPlane* render_plane = nullptr;
                         if (stage.find_render_plane(&render_plane, layer_object->layer_uuid())) {
-                            if (render_plane->m_fbo.initilized()) {
+                            if (render_plane->m_fbo && render_plane->m_fbo->initilized()) {
                                 // // lifetime?
-                                layer_object->set_fbo(core::borrowed_ptr{&render_plane->m_fbo});
+                                layer_object->set_fbo(core::borrowed_ptr{render_plane->m_fbo});
                             }
                         }
                     }
 
-                    CHECK_AK_ERROR2(layer_object->render(
-                        render_ctx, pts, m_camera ? *m_camera : *render_ctx.camera()));
+                    CHECK_AK_ERROR2(layer_object->render(render_ctx, pts, camera));
                 }
             }
 
             cur_fbo.resolve();
 
+            for (auto&& layer_object : m_layer_objects) {
+                layer_object->clear_dirty();
+            }
+            m_is_dirty = false;
+
             return true;
         }
 
+        bool RenderPlane::needs_render(const core::Rational& pts, const Stage& stage) const {
+            // the root plane follows the camera, and is drawn onto the screen anyway
+            if (m_plane_ctx.level == 0 || m_is_dirty) {
+                return true;
+            }
+            for (const auto& layer_object : m_layer_objects) {
+                if (layer_object->needs_render(pts)) {
+                    return true;
+                }
+                // planes are rendered from the deepest level, so that the units are up to date
+                RenderPlane* render_plane = nullptr;
+                if (layer_object->is_unit() && layer_object->can_display() &&
+                    stage.find_render_plane(&render_plane, layer_object->layer_uuid()) &&
+                    render_plane->is_redrawn()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         bool RenderPlane::add_layer(OGLRenderContext& ctx, const core::LayerContext& layer_ctx,
                                     const core::Rational& pts) {
             if (layer_ctx.t_audio) {
@@ -42,12 +42,18 @@ namespace akashi {
 
             void set_defunct(bool defunct) { m_is_defunct = defunct; }
 
+            // whether the last render() drew into the FBO, rather than keeping its contents
+            bool is_redrawn() const { return m_is_redrawn; }
+
           private:
+            bool needs_render(const core::Rational& pts, const Stage& stage) const;
+
             bool add_layer(OGLRenderContext& ctx, const core::LayerContext& layer_ctx,
                            const core::Rational& pts);
 
           private:
-            FBO m_fbo;
+            // borrowed from OGLRenderContext::fbo_pool()
+            FBO* m_fbo = nullptr;
             core::owned_ptr<Camera> m_camera;
             core::PlaneContext m_plane_ctx;
             core::LayerContext m_base_layer;
@@ -55,6 +61,8 @@ namespace akashi {
 
             bool m_initial_render = true;
             bool m_is_defunct = false;
+            bool m_is_dirty = true;
+            bool m_is_redrawn = false;
 
             std::vector<LayerObject*> m_layer_objects;
             std::unordered_map<std::string, LayerObject*> m_layer_object_map;
@@ -0,0 +1,151 @@
+#include "./glyph_atlas.h"
+
+#include <libakcore/logger.h>
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <algorithm>
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        const Glyph* GlyphAtlas::glyph(TTF_Font* font, uint32_t codepoint) {
+            GlyphKey key{font, codepoint};
+            if (auto it = m_glyphs.find(key); it != m_glyphs.end()) {
+                return &it->second;
+            }
+            // not retried on every frame
+            if (m_failed_glyphs.find(key) != m_failed_glyphs.end()) {
+                return nullptr;
+            }
+
+            Glyph glyph;
+            if (!this->rasterize(font, codepoint, glyph)) {
+                m_failed_glyphs.insert(key);
+                return nullptr;
+            }
+            return &m_glyphs.insert({key, glyph}).first->second;
+        }
+
+        bool GlyphAtlas::rasterize(TTF_Font* font, uint32_t codepoint, Glyph& glyph) {
+            int minx, maxx, miny, maxy, advance;
+            if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &advance) != 0) {
+                AKLOG_ERROR("TTF_GlyphMetrics32 failed\n{}", TTF_GetError());
+                return false;
+            }
+
+            glyph.advance = advance;
+            glyph.offset_x = std::min(0, minx);
+
+            // whitespaces have no bitmap
+            auto surface = TTF_RenderGlyph32_Blended(font, codepoint, {255, 255, 255, 255});
+            if (surface) {
+                if (surface->format->BytesPerPixel != 4) {
+                    AKLOG_ERROR("Unexpected glyph format: {}", surface->format->BytesPerPixel);
+                    SDL_FreeSurface(surface);
+                    return false;
+                }
+                glyph.w = surface->w;
+                glyph.h = surface->h;
+                if (!this->allocate(glyph)) {
+                    SDL_FreeSurface(surface);
+                    return false;
+                }
+
+                std::vector<uint8_t> coverage(glyph.w * glyph.h);
+                const auto fmt = surface->format;
+                for (int y = 0; y < glyph.h; y++) {
+                    auto row = reinterpret_cast<const Uint32*>(static_cast<const uint8_t*>(
+                                                                   surface->pixels) +
+                                                               y * surface->pitch);
+                    for (int x = 0; x < glyph.w; x++) {
+                        coverage[y * glyph.w + x] = (row[x] & fmt->Amask) >> fmt->Ashift;
+                    }
+                }
+                SDL_FreeSurface(surface);
+
+                glBindTexture(GL_TEXTURE_2D, m_pages[glyph.page].tex);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, glyph.x, glyph.y, glyph.w, glyph.h, GL_RED,
+                                GL_UNSIGNED_BYTE, coverage.data());
+                glPixelStorei(GL_UNPACK_ALIGNMENT, DEFAULT_UNPACK_ALIGNMENT);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+
+            return true;
+        }
+
+        void GlyphAtlas::destroy(void) {
+            for (auto&& page : m_pages) {
+                glDeleteTextures(1, &page.tex);
+            }
+            m_pages.clear();
+            m_glyphs.clear();
+            m_failed_glyphs.clear();
+        }
+
+        bool GlyphAtlas::allocate(Glyph& glyph) {
+            const int max_size = PAGE_SIZE - GLYPH_PADDING * 2;
+            if (glyph.w > max_size || glyph.h > max_size) {
+                AKLOG_ERROR("Glyph too large: {}x{}", glyph.w, glyph.h);
+                return false;
+            }
+            if (m_pages.empty() && !this->add_page()) {
+                return false;
+            }
+
+            auto* page = &m_pages.back();
+            if (page->shelf_x + glyph.w + GLYPH_PADDING * 2 > PAGE_SIZE) {
+                page->shelf_x = 0;
+                page->shelf_y += page->shelf_h;
+                page->shelf_h = 0;
+            }
+            if (page->shelf_y + glyph.h + GLYPH_PADDING * 2 > PAGE_SIZE) {
+                if (!this->add_page()) {
+                    return false;
+                }
+                page = &m_pages.back();
+            }
+
+            glyph.page = m_pages.size() - 1;
+            glyph.x = page->shelf_x + GLYPH_PADDING;
+            glyph.y = page->shelf_y + GLYPH_PADDING;
+            page->shelf_x += glyph.w + GLYPH_PADDING * 2;
+            page->shelf_h = std::max(page->shelf_h, glyph.h + GLYPH_PADDING * 2);
+            return true;
+        }
+
+        bool GlyphAtlas::add_page(void) {
+            Page page;
+            glGenTextures(1, &page.tex);
+            if (page.tex == 0) {
+                AKLOG_ERRORN("Failed to create a glyph atlas page");
+                return false;
+            }
+
+            // cleared, so that the padding never bleeds
+            std::vector<uint8_t> zeros(PAGE_SIZE * PAGE_SIZE, 0);
+            glBindTexture(GL_TEXTURE_2D, page.tex);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, PAGE_SIZE, PAGE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE,
+                         zeros.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, DEFAULT_UNPACK_ALIGNMENT);
+
+            // glyphs are drawn at 1:1 scale
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            m_pages.push_back(page);
+            return true;
+        }
+
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../core/glc.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef struct _TTF_Font TTF_Font;
+
+namespace akashi {
+    namespace graphics {
+
+        struct Glyph {
+            size_t page = 0;
+            // the bitmap in the page, in pixels
+            int x = 0;
+            int y = 0;
+            int w = 0;
+            int h = 0;
+            // the left edge of the bitmap relative to the pen position
+            int offset_x = 0;
+            int advance = 0;
+        };
+
+        /**
+         * Caches the rasterized glyphs in single-channel coverage textures.
+         *
+         * Glyphs are rasterized in white once per (font handle, codepoint), and tinted at draw
+         * time, so that the colors and the effects of the text do not multiply the entries.
+         * Font handles are expected to come from FontLoader::font(), which keeps them alive.
+         */
+        class GlyphAtlas final {
+          public:
+            static constexpr const int PAGE_SIZE = 1024;
+            static constexpr const int GLYPH_PADDING = 1;
+
+          public:
+            explicit GlyphAtlas() = default;
+            virtual ~GlyphAtlas() = default;
+
+            /**
+             * Returns the glyph, rasterizing it on the first call, or nullptr on failure.
+             * Failures are cached as well, and are not retried until destroy().
+             * The returned pointer stays valid until destroy().
+             */
+            const Glyph* glyph(TTF_Font* font, uint32_t codepoint);
+
+            GLuint page_texture(size_t page) const { return m_pages[page].tex; }
+
+            void destroy(void);
+
+          private:
+            struct GlyphKey {
+                const TTF_Font* font;
+                uint32_t codepoint;
+
+                bool operator==(const GlyphKey& other) const {
+                    return font == other.font && codepoint == other.codepoint;
+                }
+            };
+
+            struct GlyphKeyHash {
+                size_t operator()(const GlyphKey& key) const {
+                    return std::hash<const void*>()(key.font) ^
+                           (std::hash<uint32_t>()(key.codepoint) << 1);
+                }
+            };
+
+            struct Page {
+                GLuint tex = 0;
+                // shelf packing
+                int shelf_x = 0;
+                int shelf_y = 0;
+                int shelf_h = 0;
+            };
+
+            bool rasterize(TTF_Font* font, uint32_t codepoint, Glyph& glyph);
+
+            bool allocate(Glyph& glyph);
+
+            bool add_page(void);
+
+          private:
+            std::unordered_map<GlyphKey, Glyph, GlyphKeyHash> m_glyphs;
+            // the glyphs which failed to be rasterized or allocated
+            std::unordered_set<GlyphKey, GlyphKeyHash> m_failed_glyphs;
+            std::vector<Page> m_pages;
+        };
+
+    }
+}
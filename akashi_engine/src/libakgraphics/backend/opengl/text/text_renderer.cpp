@@ -0,0 +1,418 @@
+#include "./text_renderer.h"
+
+#include "../core/shader.h"
+#include "../core/texture.h"
+#include "../resource/font.h"
+
+#include <libakcore/error.h>
+#include <libakcore/logger.h>
+#include <libakcore/string.h>
+
+#include <SDL_ttf.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+static constexpr const char* vshader_src = u8R"(
+    #version 420 core
+    uniform vec2 u_size;
+
+    layout (location = 0) in vec2 pos;
+    layout (location = 1) in vec2 uv;
+    layout (location = 2) in vec4 color;
+
+    out vec2 vUv;
+    out vec4 vColor;
+
+    void main(void){
+        vUv = uv;
+        vColor = color;
+        gl_Position = vec4((pos / u_size) * 2.0 - 1.0, 0.0, 1.0);
+})";
+
+static constexpr const char* fshader_src = u8R"(
+    #version 420 core
+    uniform sampler2D atlas;
+
+    in vec2 vUv;
+    in vec4 vColor;
+
+    out vec4 fragColor;
+
+    void main(void){
+        float alpha = texture(atlas, vUv).r * vColor.a;
+        fragColor = vec4(vColor.rgb * alpha, alpha);
+})";
+
+using namespace akashi::core;
+
+namespace akashi {
+    namespace graphics {
+
+        struct TextRenderer::Pass {
+            GLuint prog = 0;
+            GLuint vao = 0;
+            GLuint vbo = 0;
+            GLuint fbo = 0;
+            GLint size_loc = -1;
+            GLint atlas_loc = -1;
+        };
+
+        namespace priv {
+
+            struct Vertex {
+                float x, y;
+                float u, v;
+                float r, g, b, a;
+            };
+
+            struct Quad {
+                const Glyph* glyph;
+                int x;
+                int y;
+            };
+
+            struct Batch {
+                size_t page;
+                GLint first;
+                GLsizei count;
+            };
+
+            struct Line {
+                // the glyphs and their pen positions
+                std::vector<std::pair<const Glyph*, int>> fg_glyphs;
+                std::vector<std::pair<const Glyph*, int>> effect_glyphs;
+                int width = 0;
+            };
+
+            static std::array<float, 4> to_rgba(const SDL_Color& color) {
+                // [XXX] hex_to_sdl() swaps red and blue, since SDL surfaces are uploaded as
+                // GL_RGBA on little endian
+                return {color.b / 255.0f, color.g / 255.0f, color.r / 255.0f, color.a / 255.0f};
+            }
+
+            static std::vector<uint32_t> decode_utf8(const std::string& str) {
+                std::vector<uint32_t> codepoints;
+                codepoints.reserve(str.size());
+                for (size_t i = 0; i < str.size();) {
+                    const auto c = static_cast<uint8_t>(str[i]);
+                    size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : 4;
+                    uint32_t cp = len == 1   ? c
+                                  : len == 2 ? c & 0x1f
+                                  : len == 3 ? c & 0x0f
+                                             : c & 0x07;
+                    bool valid = (c < 0x80 || (c >> 6) == 0x3) && i + len <= str.size();
+                    for (size_t k = 1; valid && k < len; k++) {
+                        const auto cc = static_cast<uint8_t>(str[i + k]);
+                        valid = (cc >> 6) == 0x2;
+                        cp = (cp << 6) | (cc & 0x3f);
+                    }
+                    // replacement character
+                    codepoints.push_back(valid ? cp : 0xfffd);
+                    i += valid ? len : 1;
+                }
+                return codepoints;
+            }
+
+            static bool layout_line(Line& line, GlyphAtlas& atlas, TTF_Font* fg_font,
+                                    TTF_Font* effect_font, int fg_shift,
+                                    const std::string& text) {
+                int pen = 0;
+                uint32_t prev = 0;
+                for (const auto& cp : decode_utf8(text)) {
+                    if (prev != 0) {
+                        pen += TTF_GetFontKerningSizeGlyphs32(fg_font, prev, cp);
+                    }
+                    auto fg_glyph = atlas.glyph(fg_font, cp);
+                    if (!fg_glyph) {
+                        return false;
+                    }
+                    line.fg_glyphs.push_back({fg_glyph, pen});
+                    line.width = std::max(line.width,
+                                          fg_shift + pen + fg_glyph->offset_x + fg_glyph->w);
+
+                    if (effect_font) {
+                        auto effect_glyph = atlas.glyph(effect_font, cp);
+                        if (!effect_glyph) {
+                            return false;
+                        }
+                        line.effect_glyphs.push_back({effect_glyph, pen});
+                        line.width = std::max(line.width,
+                                              pen + effect_glyph->offset_x + effect_glyph->w);
+                    }
+
+                    pen += fg_glyph->advance;
+                    line.width = std::max(line.width, pen);
+                    prev = cp;
+                }
+                return true;
+            }
+
+            static void push_quads(std::vector<Vertex>& vertices, std::vector<Batch>& batches,
+                                   std::vector<Quad>& quads, const std::array<float, 4>& color) {
+                // [XXX] keep the order of the effects, while grouping the quads by the pages
+                std::stable_sort(quads.begin(), quads.end(), [](const Quad& a, const Quad& b) {
+                    return a.glyph->page < b.glyph->page;
+                });
+
+                const float ps = GlyphAtlas::PAGE_SIZE;
+                for (const auto& quad : quads) {
+                    const auto& g = *quad.glyph;
+                    if (batches.empty() || batches.back().page != g.page ||
+                        batches.back().first + batches.back().count !=
+                            static_cast<GLint>(vertices.size())) {
+                        batches.push_back({g.page, static_cast<GLint>(vertices.size()), 0});
+                    }
+
+                    const float x0 = quad.x;
+                    const float y0 = quad.y;
+                    const float x1 = quad.x + g.w;
+                    const float y1 = quad.y + g.h;
+                    const float u0 = g.x / ps;
+                    const float v0 = g.y / ps;
+                    const float u1 = (g.x + g.w) / ps;
+                    const float v1 = (g.y + g.h) / ps;
+                    const auto& c = color;
+
+                    vertices.push_back({x0, y0, u0, v0, c[0], c[1], c[2], c[3]});
+                    vertices.push_back({x1, y0, u1, v0, c[0], c[1], c[2], c[3]});
+                    vertices.push_back({x1, y1, u1, v1, c[0], c[1], c[2], c[3]});
+                    vertices.push_back({x0, y0, u0, v0, c[0], c[1], c[2], c[3]});
+                    vertices.push_back({x1, y1, u1, v1, c[0], c[1], c[2], c[3]});
+                    vertices.push_back({x0, y1, u0, v1, c[0], c[1], c[2], c[3]});
+                    batches.back().count += 6;
+                }
+            }
+
+        }
+
+        bool TextRenderer::render(OGLTexture& tex, const FontInfo& info, const FontOutline* outline,
+                                  const FontShadow* shadow) {
+            tex.buffer = 0;
+            if (info.text.empty()) {
+                AKLOG_WARNN("Text length is 0");
+                return false;
+            }
+            if (!m_pass) {
+                CHECK_AK_ERROR2(this->load_pass());
+            }
+
+            auto& loader = FontLoader::GetInstance();
+            auto fg_font = loader.font(info.font_path, info.size);
+            if (!fg_font) {
+                return false;
+            }
+
+            // same precedence as FontLoader::get_surface()
+            const SDL_Color* effect_color = nullptr;
+            int effect_size = 0;
+            int fg_shift = 0;
+            if (shadow) {
+                effect_color = &shadow->color;
+                effect_size = std::max(0, shadow->size);
+            } else if (outline) {
+                effect_color = &outline->color;
+                effect_size = std::max(0, outline->size);
+                fg_shift = effect_size;
+            }
+            TTF_Font* effect_font = nullptr;
+            if (effect_color) {
+                effect_font = loader.font(info.font_path, info.size, effect_size);
+                if (!effect_font) {
+                    return false;
+                }
+            }
+
+            const int line_height = TTF_FontHeight(fg_font) + (effect_font ? effect_size * 2 : 0);
+
+            std::vector<priv::Line> lines;
+            int main_width = 0;
+            for (const auto& text : core::split_by(info.text, "\n")) {
+                priv::Line line;
+                if (!priv::layout_line(line, m_atlas, fg_font, effect_font, fg_shift, text)) {
+                    return false;
+                }
+                main_width = std::max(main_width, line.width);
+                lines.push_back(std::move(line));
+            }
+
+            const int width = main_width + info.pad[0] + info.pad[1];
+            const int height = line_height * lines.size() + info.pad[2] + info.pad[3] +
+                               info.line_span * std::max(0, (int)lines.size() - 1);
+            if (width <= 0 || height <= 0) {
+                AKLOG_ERROR("Invalid text size: {}x{}", width, height);
+                return false;
+            }
+
+            std::vector<priv::Quad> effect_quads;
+            std::vector<priv::Quad> fg_quads;
+            int acc_height = 0;
+            for (const auto& line : lines) {
+                int lx = info.text_align == TextAlign::RIGHT    ? main_width - line.width
+                         : info.text_align == TextAlign::CENTER ? (main_width - line.width) / 2
+                                                                : 0;
+                lx += info.pad[0];
+                const int ly = acc_height + info.pad[2];
+
+                for (const auto& [glyph, pen] : line.effect_glyphs) {
+                    if (glyph->w > 0) {
+                        effect_quads.push_back({glyph, lx + pen + glyph->offset_x, ly});
+                    }
+                }
+                for (const auto& [glyph, pen] : line.fg_glyphs) {
+                    if (glyph->w > 0) {
+                        fg_quads.push_back(
+                            {glyph, lx + fg_shift + pen + glyph->offset_x, ly + fg_shift});
+                    }
+                }
+                acc_height += line_height + info.line_span;
+            }
+
+            std::vector<priv::Vertex> vertices;
+            std::vector<priv::Batch> batches;
+            if (effect_color) {
+                priv::push_quads(vertices, batches, effect_quads, priv::to_rgba(*effect_color));
+            }
+            priv::push_quads(vertices, batches, fg_quads, priv::to_rgba(info.color));
+
+            tex.image = nullptr;
+            tex.surface = nullptr;
+            tex.width = width;
+            tex.height = height;
+            tex.effective_width = width;
+            tex.effective_height = height;
+            tex.format = GL_RGBA;
+
+            glGenTextures(1, &tex.buffer);
+            glBindTexture(GL_TEXTURE_2D, tex.buffer);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // [XXX] this can be called in the middle of a frame, so restore what we touch
+            GLint prev_fbo = 0;
+            GLint prev_viewport[4];
+            GLfloat prev_clear_color[4];
+            GLint prev_blend_func[4];
+            GLint prev_prog = 0;
+            GLint prev_vao = 0;
+            const GLboolean prev_blend = glIsEnabled(GL_BLEND);
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo);
+            glGetIntegerv(GL_VIEWPORT, prev_viewport);
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, prev_clear_color);
+            glGetIntegerv(GL_BLEND_SRC_RGB, &prev_blend_func[0]);
+            glGetIntegerv(GL_BLEND_DST_RGB, &prev_blend_func[1]);
+            glGetIntegerv(GL_BLEND_SRC_ALPHA, &prev_blend_func[2]);
+            glGetIntegerv(GL_BLEND_DST_ALPHA, &prev_blend_func[3]);
+            glGetIntegerv(GL_CURRENT_PROGRAM, &prev_prog);
+            glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
+
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_pass->fbo);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   tex.buffer, 0);
+
+            bool res = true;
+            if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                AKLOG_ERRORN("Text framebuffer is not complete");
+                res = false;
+            } else {
+                glViewport(0, 0, width, height);
+                glClearColor(0, 0, 0, 0);
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+                glUseProgram(m_pass->prog);
+                glUniform2f(m_pass->size_loc, width, height);
+                glUniform1i(m_pass->atlas_loc, 0);
+                glActiveTexture(GL_TEXTURE0);
+
+                glBindVertexArray(m_pass->vao);
+                glBindBuffer(GL_ARRAY_BUFFER, m_pass->vbo);
+                glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(priv::Vertex),
+                             vertices.data(), GL_STREAM_DRAW);
+
+                for (const auto& batch : batches) {
+                    glBindTexture(GL_TEXTURE_2D, m_atlas.page_texture(batch.page));
+                    glDrawArrays(GL_TRIANGLES, batch.first, batch.count);
+                }
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prev_fbo);
+            glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+            glClearColor(prev_clear_color[0], prev_clear_color[1], prev_clear_color[2],
+                         prev_clear_color[3]);
+            glBlendFuncSeparate(prev_blend_func[0], prev_blend_func[1], prev_blend_func[2],
+                                prev_blend_func[3]);
+            if (!prev_blend) {
+                glDisable(GL_BLEND);
+            }
+            glUseProgram(prev_prog);
+            glBindVertexArray(prev_vao);
+
+            if (!res) {
+                glDeleteTextures(1, &tex.buffer);
+                tex.buffer = 0;
+            }
+            return res;
+        }
+
+        void TextRenderer::destroy(void) {
+            if (m_pass) {
+                glDeleteProgram(m_pass->prog);
+                glDeleteVertexArrays(1, &m_pass->vao);
+                glDeleteBuffers(1, &m_pass->vbo);
+                glDeleteFramebuffers(1, &m_pass->fbo);
+                delete m_pass;
+                m_pass = nullptr;
+            }
+            m_atlas.destroy();
+        }
+
+        bool TextRenderer::load_pass(void) {
+            m_pass = new TextRenderer::Pass;
+
+            m_pass->prog = glCreateProgram();
+            CHECK_AK_ERROR2(compile_attach_shader(m_pass->prog, GL_VERTEX_SHADER, vshader_src));
+            CHECK_AK_ERROR2(compile_attach_shader(m_pass->prog, GL_FRAGMENT_SHADER, fshader_src));
+            CHECK_AK_ERROR2(link_shader(m_pass->prog));
+
+            m_pass->size_loc = glGetUniformLocation(m_pass->prog, "u_size");
+            m_pass->atlas_loc = glGetUniformLocation(m_pass->prog, "atlas");
+
+            glGenFramebuffers(1, &m_pass->fbo);
+
+            glGenVertexArrays(1, &m_pass->vao);
+            glGenBuffers(1, &m_pass->vbo);
+
+            glBindVertexArray(m_pass->vao);
+            glBindBuffer(GL_ARRAY_BUFFER, m_pass->vbo);
+
+            const auto stride = sizeof(priv::Vertex);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                                  reinterpret_cast<void*>(offsetof(priv::Vertex, x)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                                  reinterpret_cast<void*>(offsetof(priv::Vertex, u)));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+                                  reinterpret_cast<void*>(offsetof(priv::Vertex, r)));
+
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            return true;
+        }
+
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "./glyph_atlas.h"
+
+namespace akashi {
+    namespace graphics {
+
+        struct OGLTexture;
+        struct FontInfo;
+        struct FontOutline;
+        struct FontShadow;
+
+        /**
+         * Renders texts into textures on the GPU.
+         *
+         * The glyphs are laid out on the CPU, and drawn from GlyphAtlas as batched quads, one draw
+         * call per atlas page and per effect. Unchanged glyphs are never rasterized again, and no
+         * intermediate surfaces are created.
+         *
+         * The resulting textures have premultiplied alpha, and follow the same layout as the
+         * surfaces of FontLoader::get_surface(), so that they can be used in place of them.
+         */
+        class TextRenderer final {
+            struct Pass;
+
+          public:
+            explicit TextRenderer() = default;
+            virtual ~TextRenderer() = default;
+
+            /**
+             * Creates `tex` and renders the text into it.
+             * The texture must be freed by free_ogl_texture().
+             */
+            bool render(OGLTexture& tex, const FontInfo& info, const FontOutline* outline = nullptr,
+                        const FontShadow* shadow = nullptr);
+
+            void destroy(void);
+
+          private:
+            bool load_pass(void);
+
+          private:
+            Pass* m_pass = nullptr;
+            GlyphAtlas m_atlas;
+        };
+
+    }
+}
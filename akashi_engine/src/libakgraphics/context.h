@@ -33,6 +33,7 @@ namespace akashi {
                                 const core::FrameContext& frame_ctx) = 0;
             virtual void encode_render(EncodeRenderParams& params,
                                        const core::FrameContext& frame_ctx) = 0;
+            virtual void encode_flush(EncodeRenderParams& params) = 0;
         };
 
     }
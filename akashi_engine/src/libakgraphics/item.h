@@ -1,6 +1,8 @@
 #pragma once
 
 #include <libakcore/memory.h>
+#include <libakcore/rational.h>
+#include <libakcore/hw_accel.h>
 
 #include <functional>
 #include <cstdint>
@@ -29,11 +31,16 @@ namespace akashi {
         };
 
         struct EncodeRenderParams {
+            /* fields to be filled by the caller */
+            core::VideoBufferFormat format = core::VideoBufferFormat::RGB24;
             /* fields to be filled by the callee */
             uint8_t* buffer = nullptr;
             int width = -1;
             int height = -1;
             core::borrowed_ptr<buffer::HWFrame> hwframe;
+            // the frames are read back asynchronously, and `buffer` may hold an earlier frame
+            bool filled = false;
+            core::Rational pts = core::Rational(-1, 1);
         };
 
     }
@@ -13,12 +13,16 @@
 #include <thread>
 #include <mutex>
 #include <vector>
+#include <atomic>
+#include <chrono>
 
 using namespace akashi::core;
 
 namespace akashi {
     namespace player {
 
+        const static std::chrono::milliseconds AUDIO_DECODE_READY_INTERVAL{10};
+
         DecodeState::DecodeState(core::borrowed_ptr<state::AKState> state) : m_state(state) {
             {
                 std::lock_guard<std::mutex> lock(m_state->m_prop_mtx);
@@ -39,10 +43,21 @@ namespace akashi {
             }
         }
 
-        static bool wait_for_all_decode_ready(core::borrowed_ptr<state::AKState> state) {
+        // the audio callback lowers the queue size without notifying, so the readiness is
+        // re-checked here until the callback has consumed enough
+        static void wait_for_audio_decode_ready(DecodeLoopContext& ctx,
+                                                const std::atomic<bool>& is_alive) {
+            while (is_alive.load() && !ctx.buffer->aq->update_decode_ready()) {
+                ctx.state->wait_for_audio_decode_ready_for(AUDIO_DECODE_READY_INTERVAL);
+            }
+        }
+
+        static bool wait_for_all_decode_ready(DecodeLoopContext& ctx,
+                                              const std::atomic<bool>& is_alive) {
+            auto state = ctx.state;
             state->wait_for_kron_ready();
             state->wait_for_video_decode_ready();
-            state->wait_for_audio_decode_ready();
+            wait_for_audio_decode_ready(ctx, is_alive);
             state->wait_for_seek_completed();
             state->wait_for_decode_layers_not_empty();
             state->wait_for_decode_loop_can_continue();
@@ -65,7 +80,7 @@ namespace akashi {
             auto decoder = new codec::AKDecoder(decode_state.render_prof, decode_state.decode_pts);
             bool decode_finished = false;
             while (loop->m_is_alive.load() && !decode_finished) {
-                if (!wait_for_all_decode_ready(ctx.state)) {
+                if (!wait_for_all_decode_ready(ctx, loop->m_is_alive)) {
                     continue;
                 }
 
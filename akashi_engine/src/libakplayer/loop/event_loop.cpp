@@ -4,6 +4,7 @@
 #include "../eval_buffer.h"
 #include "../reload/seek_manager.h"
 #include "../reload/hr_manager.h"
+#include "../reload/utils.h"
 
 #include <libakcore/element.h>
 #include <libakcore/memory.h>
@@ -150,6 +151,8 @@ namespace akashi {
                     ((profile.duration * fps) - Rational(1l)).to_decimal();
             }
 
+            reload::publish_audio_layers(ctx.state, profile);
+
             ctx.event->emit_set_render_prof(profile); // be careful that the decode_ready is called
 
             ctx.state->set_decode_layers_not_empty(core::has_layers(profile), true);
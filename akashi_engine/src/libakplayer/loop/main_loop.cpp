@@ -18,6 +18,33 @@ namespace akashi {
 
         core::owned_ptr<core::PerfMonitor> MainLoop::p_perf(new core::PerfMonitor);
 
+        // below this, the remaining delay is waited by polling the clock instead of sleeping,
+        // since the wake-up latency of the scheduler is not negligible
+        static const Rational SPIN_THRESHOLD = Rational(1, 1000);     // 1ms
+        static const Rational SPIN_INTERVAL = Rational(100, 1000000); // 100us
+
+        static void sleep_for(const Rational& duration) {
+            std::this_thread::sleep_for(std::chrono::microseconds(
+                static_cast<int64_t>((duration * Rational(1000000l)).to_decimal())));
+        }
+
+        // waits until the audio clock reaches `pts`
+        static void wait_for_pts(const MainLoopContext& ctx, const Rational& pts) {
+            while (true) {
+                auto delay = pts - ctx.player->current_time();
+                if (delay <= Rational(0l)) {
+                    return;
+                }
+                // the clock does not advance unless the audio is playing
+                if (ctx.state->m_atomic_state.audio_play_state != state::PlayState::PLAYING) {
+                    return sleep_for(delay);
+                }
+                // wake up a bit earlier than the deadline, and re-check the clock
+                sleep_for(delay > SPIN_THRESHOLD ? delay - SPIN_THRESHOLD
+                                                 : std::min(delay, SPIN_INTERVAL));
+            }
+        }
+
         void MainLoop::mainloop_thread(MainLoopContext ctx, MainLoop* loop) {
             auto [player, state, event, eval_buf] = ctx;
 
@@ -73,10 +100,7 @@ namespace akashi {
                 //         std::min(Rational(1l) / player_ctx->m_prop.render_prof.fps, delay);
                 // }
 
-                auto factor = Rational(1000l);
-                auto sleep_ms = (long)((adjusted_delay)*factor).to_decimal();
-                // [TODO] if timescale is not 10*3, the calculation below must be changed
-                std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+                wait_for_pts(ctx, frame_ctx.pts);
 
                 p_perf->log_delay(adjusted_delay, 0);
                 return true;
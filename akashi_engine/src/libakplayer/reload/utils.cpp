@@ -6,6 +6,7 @@
 
 #include <libakcore/memory.h>
 #include <libakcore/logger.h>
+#include <libakcore/audio_snapshot.h>
 #include <libakstate/akstate.h>
 #include <libakbuffer/avbuffer.h>
 #include <libakbuffer/audio_queue.h>
@@ -30,7 +31,11 @@ namespace akashi::player::reload {
         rctx.event->emit_time_update(seek_time);
 
         rctx.state->m_atomic_state.audio_play_over = false;
+        auto audio_spec = rctx.state->m_atomic_state.audio_spec.load();
         rctx.state->m_atomic_state.start_time.store(Rational{seek_time.num(), seek_time.den()});
+        rctx.state->m_atomic_state.start_bytes.store(
+            core::to_frame_bytes(seek_time, core::bytes_per_second(audio_spec),
+                                 core::size_table(audio_spec.format) * audio_spec.channels));
         rctx.state->m_atomic_state.bytes_played.store(0);
     }
 
@@ -81,6 +86,8 @@ namespace akashi::player::reload {
                 ((profile.duration * fps) - Rational(1l)).to_decimal();
         }
 
+        publish_audio_layers(rctx.state, profile);
+
         rctx.event->emit_set_render_prof(profile); // be careful that decode_ready is called
 
         rctx.state->set_decode_layers_not_empty(core::has_layers(profile), true);
@@ -93,4 +100,11 @@ namespace akashi::player::reload {
         }
         rctx.event->emit_update();
     }
+
+    void publish_audio_layers(core::borrowed_ptr<state::AKState> state,
+                              const core::RenderProfile& render_prof) {
+        auto audio_spec = state->m_atomic_state.audio_spec.load();
+        state->m_atomic_state.audio_layers.publish(
+            core::make_audio_layer_snapshot(render_prof, audio_spec));
+    }
 }
@@ -7,6 +7,7 @@ namespace akashi {
     namespace core {
         class Rational;
         class Path;
+        struct RenderProfile;
     }
     namespace buffer {
         class AVBuffer;
@@ -41,6 +42,9 @@ namespace akashi {
 
             void render_update(ReloadContext& rctx);
 
+            void publish_audio_layers(core::borrowed_ptr<state::AKState> state,
+                                      const core::RenderProfile& render_prof);
+
         }
 
     }
@@ -7,7 +7,10 @@
 #include <libakcore/path.h>
 #include <libakcore/hw_accel.h>
 #include <libakcore/config.h>
+#include <libakcore/snapshot.h>
+#include <libakcore/audio_snapshot.h>
 
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
@@ -30,6 +33,20 @@
             m_state_##name.cv.notify_all();                                                        \
         }                                                                                          \
     };                                                                                             \
+    /* the value is computed under the lock, and the waiters are notified when it changed */    \
+    template <class Fn>                                                                            \
+    void update_##name(Fn fn) {                                                                    \
+        bool changed = false;                                                                      \
+        {                                                                                          \
+            std::lock_guard<std::mutex> lock(m_state_##name.mtx);                                  \
+            v_type v = fn();                                                                       \
+            changed = m_state_##name.value != v;                                                   \
+            m_state_##name.value = v;                                                              \
+        }                                                                                          \
+        if (changed) {                                                                             \
+            m_state_##name.cv.notify_all();                                                        \
+        }                                                                                          \
+    };                                                                                             \
     v_type get_##name() {                                                                          \
         v_type res = v_init;                                                                       \
         {                                                                                          \
@@ -49,6 +66,13 @@
         while (m_state_##name.value) {                                                             \
             m_state_##name.cv.wait(lock);                                                          \
         }                                                                                          \
+    }                                                                                              \
+    /* returns the value, which is still false when the timeout expired */                         \
+    template <class Rep, class Period>                                                             \
+    v_type wait_for_##name##_for(const std::chrono::duration<Rep, Period>& timeout) {              \
+        std::unique_lock<std::mutex> lock(m_state_##name.mtx);                                     \
+        m_state_##name.cv.wait_for(lock, timeout, [this] { return m_state_##name.value; });        \
+        return m_state_##name.value;                                                               \
     }
 
 namespace akashi {
@@ -123,6 +147,9 @@ namespace akashi {
 
             std::atomic<core::Rational> start_time{core::Rational{0, 1}};
 
+            // `start_time` in bytes, which is used by the audio callback
+            std::atomic<int64_t> start_bytes = 0;
+
             std::atomic<core::AKAudioSpec> audio_spec;
 
             std::atomic<core::AKAudioSpec> encode_audio_spec;
@@ -143,6 +170,9 @@ namespace akashi {
             std::atomic<bool> video_play_over = false;
 
             std::atomic<bool> audio_play_over = false;
+
+            // published by the player whenever the render profile is updated
+            core::SnapshotCell<core::AudioLayerSnapshot> audio_layers;
         };
 
         class AKState final {
@@ -6,10 +6,64 @@
 namespace akashi {
     namespace vgfx {
 
+        static void append_key(std::string& key, const std::string& value) {
+            key += value;
+            key += '\n';
+        }
+
+        static void append_key(std::string& key, double value) {
+            append_key(key, std::to_string(value));
+        }
+
+        static void append_base_key(std::string& key, const core::BaseShapeTField& shape_field) {
+            append_key(key, shape_field.fill_color);
+            append_key(key, shape_field.border_size);
+            append_key(key, shape_field.border_color);
+            append_key(key, static_cast<int>(shape_field.border_direction));
+            append_key(key, shape_field.edge_radius);
+        }
+
         core::owned_ptr<vgfx::Surface> create_surface(const SurfaceEntry& entry,
                                                       const core::LayerContext& layer_ctx) {
             return cairo_create_surface(entry, layer_ctx);
         }
 
+        std::string surface_key(const SurfaceEntry& entry, const core::LayerContext& layer_ctx) {
+            std::string key;
+            append_key(key, entry.width);
+            append_key(key, entry.height);
+            append_key(key, static_cast<int>(entry.format));
+            append_key(key, entry.border_padv);
+
+            if (layer_ctx.t_rect) {
+                append_key(key, "rect");
+                append_base_key(key, *layer_ctx.t_rect);
+                append_key(key, layer_ctx.t_rect->width);
+                append_key(key, layer_ctx.t_rect->height);
+            } else if (layer_ctx.t_circle) {
+                append_key(key, "circle");
+                append_base_key(key, *layer_ctx.t_circle);
+            } else if (layer_ctx.t_tri) {
+                append_key(key, "tri");
+                append_base_key(key, *layer_ctx.t_tri);
+                append_key(key, layer_ctx.t_tri->width);
+                append_key(key, layer_ctx.t_tri->height);
+                append_key(key, layer_ctx.t_tri->wr);
+                append_key(key, layer_ctx.t_tri->hr);
+            } else if (layer_ctx.t_line) {
+                append_key(key, "line");
+                append_base_key(key, *layer_ctx.t_line);
+                append_key(key, layer_ctx.t_line->size);
+                append_key(key, layer_ctx.t_line->begin[0]);
+                append_key(key, layer_ctx.t_line->begin[1]);
+                append_key(key, layer_ctx.t_line->end[0]);
+                append_key(key, layer_ctx.t_line->end[1]);
+                append_key(key, static_cast<int>(layer_ctx.t_line->style));
+            } else {
+                return "";
+            }
+            return key;
+        }
+
     }
 }
@@ -3,6 +3,8 @@
 #include <libakcore/class.h>
 #include <libakcore/memory.h>
 
+#include <string>
+
 namespace akashi {
     namespace core {
         struct LayerContext;
@@ -24,5 +26,11 @@ namespace akashi {
         core::owned_ptr<vgfx::Surface> create_surface(const SurfaceEntry& entry,
                                                       const core::LayerContext& layer_ctx);
 
+        /**
+         * Identifies the result of create_surface(), so that identical shapes can be shared.
+         * Returns an empty string for the layers which have no shapes.
+         */
+        std::string surface_key(const SurfaceEntry& entry, const core::LayerContext& layer_ctx);
+
     }
 }